@@ -0,0 +1,744 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bench.c
+*
+*   Description: End-to-end benchmark driver. Generates reproducible
+*   synthetic corpora, runs the compressor and the decompressor on each
+*   of them as separate processes, checks the round trip, and reports
+*   throughput of each phase, compression ratio and peak resident memory
+*   as a text table and as JSON
+*
+*   Usage: bench-huffman [-s <sizes>] [-c <corpora>] [-m <match levels>]
+*          [-r <repeats>] [-d <corpus directory>] [-j <JSON file>]
+*          <huffman> [options]
+*   Sizes are a comma-separated list such as 1K,64K,1M,4G. Match levels
+*   are a comma-separated list such as 0,1,6,9, each corpus being
+*   compressed with `-M <level>` for each of them, 0 for no matches, so
+*   that their speed and ratio can be compared. Options after the program
+*   name are passed to both the compressor and decompressor
+*
+****************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define CHUNK_SIZE (1 << 20)
+#define MAX_SIZES 32
+#define MAX_MATCH_LEVELS 10
+#define MAX_HUFFMAN_ARGS 32
+#define PATH_SIZE 4096
+#define VOCABULARY_SIZE 4096
+#define MAX_WORD_LENGTH 12
+#define FIBONACCI_SYMBOLS 24
+#define LINE_WIDTH 72
+
+#define DEFAULT_SIZES "1K,64K,1M,16M"
+#define DEFAULT_MATCH_LEVELS "0"
+#define DEFAULT_REPEATS 3
+#define DEFAULT_DIRECTORY "bench/corpora"
+
+/* structure of the state of a corpus generator. Bytes are produced one
+ * word at a time through `pending`, so that words, runs and lines can
+ * cross the boundary between two chunks */
+typedef struct Generator
+{
+    uint64_t rng;
+    uint8_t pending[MAX_WORD_LENGTH + 2];
+    unsigned pending_size;
+    unsigned pending_next;
+    unsigned column;            // column of the next text byte
+    int capitalize;             // whether the next text word starts a sentence
+    uint64_t zero_run;          // zeros left in the current run
+    uint64_t *weights;          // cumulative weights of the sampled symbols
+    unsigned num_weights;
+    char (*words)[MAX_WORD_LENGTH + 1];
+} Generator;
+
+typedef void Generate_function(Generator *generator, uint8_t *buffer, size_t size);
+
+/* structure of a corpus: name used in reports and file names, and the
+ * function filling its next bytes */
+typedef struct Corpus
+{
+    const char *name;
+    Generate_function *generate;
+} Corpus;
+
+/* structure of the result of one corpus and size */
+typedef struct Result
+{
+    const char *corpus;
+    uint64_t size;
+    unsigned match_level;
+    uint64_t compressed_size;
+    double compress_seconds;
+    double decompress_seconds;
+    long compress_rss_kib;
+    long decompress_rss_kib;
+    int round_trip;
+} Result;
+
+/* Most frequent English words, in decreasing order of frequency */
+static const char *english_words[] = {
+    "the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "as",
+    "was", "with", "be", "by", "on", "not", "he", "this", "are", "or",
+    "his", "from", "at", "which", "but", "have", "an", "had", "they", "you",
+    "were", "their", "one", "all", "we", "can", "her", "has", "there",
+    "been", "if", "more", "when", "will", "would", "who", "so", "no",
+    "time", "people", "year", "way", "day", "man", "thing", "woman", "life",
+    "child", "world", "school", "state", "family", "student", "group",
+    "country", "problem", "hand", "part", "place", "case", "week",
+    "company", "system", "program", "question", "work", "government",
+    "number", "night", "point", "home", "water", "room", "mother", "area",
+    "money", "story", "fact", "month", "lot", "right", "study", "book",
+    "eye", "job", "word", "business", "issue", "side", "kind", "head",
+    "house", "service", "friend", "father", "power", "hour", "game", "line"
+};
+#define NUM_ENGLISH_WORDS (sizeof(english_words) / sizeof(english_words[0]))
+
+/* Helper function prototypes */
+static uint64_t next_random(Generator *generator);
+static unsigned sample(Generator *generator);
+static void set_zipf_weights(Generator *generator, unsigned num_symbols);
+static void generate_uniform(Generator *generator, uint8_t *buffer, size_t size);
+static void generate_zipf(Generator *generator, uint8_t *buffer, size_t size);
+static void generate_zeros(Generator *generator, uint8_t *buffer, size_t size);
+static void generate_repeated(Generator *generator, uint8_t *buffer, size_t size);
+static void generate_fibonacci(Generator *generator, uint8_t *buffer, size_t size);
+static void generate_text(Generator *generator, uint8_t *buffer, size_t size);
+static void init_generator(Generator *generator, const Corpus *corpus);
+static void free_generator(Generator *generator);
+static void write_corpus(const Corpus *corpus, uint64_t size, const char *path);
+static uint64_t file_size(const char *path);
+static int same_content(const char *path_a, const char *path_b);
+static double run(char **argv, long *peak_rss_kib);
+static double run_best(char **argv, unsigned repeats, long *peak_rss_kib);
+static uint64_t parse_size(const char *text);
+static void format_size(uint64_t size, char *text, size_t text_size);
+static void print_result(const Result *result);
+static void write_json(const char *path, const Result *results, unsigned num_results,
+                       unsigned repeats);
+static void usage(char *program_name);
+
+static const Corpus corpora[] = {
+    {"uniform", generate_uniform},
+    {"zipf", generate_zipf},
+    {"zeros", generate_zeros},
+    {"repeated", generate_repeated},
+    {"fibonacci", generate_fibonacci},
+    {"text", generate_text}
+};
+#define NUM_CORPORA (sizeof(corpora) / sizeof(corpora[0]))
+
+int main(int argc, char *argv[])
+{
+    const char *sizes_text = DEFAULT_SIZES;
+    const char *corpora_text = NULL;
+    const char *levels_text = DEFAULT_MATCH_LEVELS;
+    const char *directory = DEFAULT_DIRECTORY;
+    const char *json_path = NULL;
+    unsigned repeats = DEFAULT_REPEATS;
+
+    // Options of the driver come before the path of the compressor
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-s"))
+            sizes_text = argv[++i];
+        else if (!strcmp(argv[i], "-c"))
+            corpora_text = argv[++i];
+        else if (!strcmp(argv[i], "-m"))
+            levels_text = argv[++i];
+        else if (!strcmp(argv[i], "-d"))
+            directory = argv[++i];
+        else if (!strcmp(argv[i], "-j"))
+            json_path = argv[++i];
+        else if (!strcmp(argv[i], "-r"))
+        {
+            int value = atoi(argv[++i]);
+            if (value < 1)
+                usage(argv[0]);
+            repeats = (unsigned)value;
+        }
+        else
+            usage(argv[0]);
+    }
+    if (i == argc)
+        usage(argv[0]);
+    char *huffman = argv[i++];
+    int num_options = argc - i;
+    if (num_options > MAX_HUFFMAN_ARGS - 7)
+        usage(argv[0]);
+
+    uint64_t sizes[MAX_SIZES];
+    unsigned num_sizes = 0;
+    char sizes_copy[PATH_SIZE];
+    snprintf(sizes_copy, sizeof(sizes_copy), "%s", sizes_text);
+    for (char *token = strtok(sizes_copy, ","); token; token = strtok(NULL, ","))
+    {
+        if (num_sizes == MAX_SIZES)
+            usage(argv[0]);
+        sizes[num_sizes] = parse_size(token);
+        if (sizes[num_sizes] == 0)
+        {
+            fprintf(stderr, "Invalid size `%s`\n", token);
+            exit(1);
+        }
+        num_sizes++;
+    }
+
+    unsigned match_levels[MAX_MATCH_LEVELS];
+    unsigned num_levels = 0;
+    char levels_copy[PATH_SIZE];
+    snprintf(levels_copy, sizeof(levels_copy), "%s", levels_text);
+    for (char *token = strtok(levels_copy, ","); token; token = strtok(NULL, ","))
+    {
+        char *end = NULL;
+        long level = strtol(token, &end, 10);
+        if (num_levels == MAX_MATCH_LEVELS || end == token || *end != '\0' ||
+            level < 0 || level > 9)
+        {
+            fprintf(stderr, "Invalid match level `%s`\n", token);
+            exit(1);
+        }
+        match_levels[num_levels++] = (unsigned)level;
+    }
+    if (num_levels == 0)
+        usage(argv[0]);
+
+    const Corpus *selected[NUM_CORPORA];
+    unsigned num_selected = 0;
+    for (unsigned c = 0; c < NUM_CORPORA; c++)
+    {
+        if (corpora_text)
+        {
+            // Match whole names of the comma-separated list
+            size_t length = strlen(corpora[c].name);
+            const char *match = strstr(corpora_text, corpora[c].name);
+            while (match && ((match != corpora_text && match[-1] != ',') ||
+                             (match[length] != ',' && match[length] != '\0')))
+                match = strstr(match + 1, corpora[c].name);
+            if (!match)
+                continue;
+        }
+        selected[num_selected++] = &corpora[c];
+    }
+    if (num_selected == 0)
+    {
+        fprintf(stderr, "No corpus selected, available: uniform, zipf, zeros, "
+                "repeated, fibonacci, text\n");
+        exit(1);
+    }
+
+    if (mkdir(directory, 0755) && file_size(directory) == UINT64_MAX)
+    {
+        fprintf(stderr, "Directory `%s` cannot be created!\n", directory);
+        exit(1);
+    }
+
+    Result *results = calloc(num_selected * num_sizes * num_levels, sizeof(Result));
+    unsigned num_results = 0;
+    printf("%-10s %9s %7s %8s %14s %16s %12s %14s %6s\n", "corpus", "size", "matches",
+           "ratio", "compress MB/s", "decompress MB/s", "compress RSS",
+           "decompress RSS", "check");
+
+    for (unsigned c = 0; c < num_selected; c++)
+    {
+        for (unsigned s = 0; s < num_sizes; s++)
+        {
+            char size_text[32];
+            format_size(sizes[s], size_text, sizeof(size_text));
+            // Room is left for the suffix of the other two files
+            char corpus_path[PATH_SIZE - 8], compressed_path[PATH_SIZE];
+            char decompressed_path[PATH_SIZE];
+            snprintf(corpus_path, sizeof(corpus_path), "%s/%s-%s", directory,
+                     selected[c]->name, size_text);
+            snprintf(compressed_path, PATH_SIZE, "%s.huf", corpus_path);
+            snprintf(decompressed_path, PATH_SIZE, "%s.out", corpus_path);
+
+            // Corpora are deterministic, so that one left by an earlier
+            // run with the same size is reused
+            if (file_size(corpus_path) != sizes[s])
+                write_corpus(selected[c], sizes[s], corpus_path);
+
+            for (unsigned l = 0; l < num_levels; l++)
+            {
+                // The match level only applies to the compressor
+                char level_text[16];
+                snprintf(level_text, sizeof(level_text), "%u", match_levels[l]);
+                char *huffman_argv[MAX_HUFFMAN_ARGS];
+                int num_args = 0;
+                huffman_argv[num_args++] = huffman;
+                huffman_argv[num_args++] = "-c";
+                if (match_levels[l] > 0)
+                {
+                    huffman_argv[num_args++] = "-M";
+                    huffman_argv[num_args++] = level_text;
+                }
+                for (int o = 0; o < num_options; o++)
+                    huffman_argv[num_args++] = argv[i + o];
+                huffman_argv[num_args] = corpus_path;
+                huffman_argv[num_args + 1] = compressed_path;
+                huffman_argv[num_args + 2] = NULL;
+
+                Result *result = &results[num_results++];
+                result->corpus = selected[c]->name;
+                result->size = sizes[s];
+                result->match_level = match_levels[l];
+                result->compress_seconds = run_best(huffman_argv, repeats,
+                                                    &result->compress_rss_kib);
+
+                huffman_argv[1] = "-d";
+                for (int o = 0; o < num_options; o++)
+                    huffman_argv[2 + o] = argv[i + o];
+                huffman_argv[2 + num_options] = compressed_path;
+                huffman_argv[3 + num_options] = decompressed_path;
+                huffman_argv[4 + num_options] = NULL;
+                result->decompress_seconds = run_best(huffman_argv, repeats,
+                                                      &result->decompress_rss_kib);
+
+                result->compressed_size = file_size(compressed_path);
+                result->round_trip = same_content(corpus_path, decompressed_path);
+                print_result(result);
+                fflush(stdout);
+
+                remove(compressed_path);
+                remove(decompressed_path);
+            }
+        }
+    }
+
+    if (json_path)
+        write_json(json_path, results, num_results, repeats);
+
+    int all_passed = 1;
+    for (unsigned r = 0; r < num_results; r++)
+        all_passed &= results[r].round_trip;
+    free(results);
+    if (!all_passed)
+    {
+        fprintf(stderr, "Some round trips did not give back the corpus!\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Helper function to print usage and exit
+static void usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-s <sizes>] [-c <corpora>] [-m <match levels>] "
+            "[-r <repeats>] [-d <corpus directory>] [-j <JSON file>] <huffman> "
+            "[options]\n"
+            "Sizes are comma-separated, e.g. %s, corpora among uniform, zipf, "
+            "zeros, repeated, fibonacci and text, and match levels among 0, for "
+            "no matches, to 9, e.g. 0,1,6,9\n",
+            program_name, DEFAULT_SIZES);
+    exit(1);
+}
+
+// Helper function to get the next pseudo-random number (xorshift64*)
+static uint64_t next_random(Generator *generator)
+{
+    generator->rng ^= generator->rng >> 12;
+    generator->rng ^= generator->rng << 25;
+    generator->rng ^= generator->rng >> 27;
+    return generator->rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Helper function to draw a symbol following the cumulative weights
+static unsigned sample(Generator *generator)
+{
+    uint64_t target = next_random(generator) % generator->weights[generator->num_weights - 1];
+    unsigned low = 0, high = generator->num_weights - 1;
+    while (low < high)
+    {
+        unsigned middle = (low + high) / 2;
+        if (generator->weights[middle] > target)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+// Helper function to give symbol k a weight proportional to 1 / (k + 1)
+static void set_zipf_weights(Generator *generator, unsigned num_symbols)
+{
+    generator->weights = malloc(num_symbols * sizeof(uint64_t));
+    generator->num_weights = num_symbols;
+    uint64_t total = 0;
+    for (unsigned k = 0; k < num_symbols; k++)
+    {
+        total += 1000000000ULL / (k + 1);
+        generator->weights[k] = total;
+    }
+}
+
+// Helper function to fill a buffer with uniformly random bytes
+static void generate_uniform(Generator *generator, uint8_t *buffer, size_t size)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word = next_random(generator);
+        memcpy(buffer + i, &word, sizeof(uint64_t));
+    }
+    for (; i < size; i++)
+        buffer[i] = (uint8_t)next_random(generator);
+}
+
+// Helper function to fill a buffer with words of a random vocabulary drawn
+// with Zipfian frequencies, separated by spaces and line breaks
+static void generate_zipf(Generator *generator, uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (generator->pending_next == generator->pending_size)
+        {
+            const char *word = generator->words[sample(generator)];
+            size_t length = strlen(word);
+            memcpy(generator->pending, word, length);
+            generator->pending[length] = next_random(generator) % 12 ? ' ' : '\n';
+            generator->pending_size = (unsigned)length + 1;
+            generator->pending_next = 0;
+        }
+        buffer[i] = generator->pending[generator->pending_next++];
+    }
+}
+
+// Helper function to fill a buffer with runs of 1 to 64 KiB of zeros,
+// each followed by 16 to 271 random bytes
+static void generate_zeros(Generator *generator, uint8_t *buffer, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        if (generator->zero_run == 0)
+        {
+            unsigned num_random = 16 + next_random(generator) % 256;
+            for (unsigned r = 0; r < num_random && i < size; r++)
+                buffer[i++] = (uint8_t)next_random(generator);
+            generator->zero_run = 1024 + next_random(generator) % (63 * 1024 + 1);
+            continue;
+        }
+        size_t run = size - i < generator->zero_run ? size - i : generator->zero_run;
+        memset(buffer + i, 0, run);
+        i += run;
+        generator->zero_run -= run;
+    }
+}
+
+// Helper function to fill a buffer with a single repeated byte
+static void generate_repeated(Generator *generator, uint8_t *buffer, size_t size)
+{
+    (void)generator;
+    memset(buffer, 'a', size);
+}
+
+// Helper function to fill a buffer with FIBONACCI_SYMBOLS symbols whose
+// frequencies are Fibonacci numbers, which gives the deepest Huffman tree
+static void generate_fibonacci(Generator *generator, uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buffer[i] = (uint8_t)('A' + sample(generator));
+}
+
+// Helper function to fill a buffer with English-like text: frequent words
+// with Zipfian frequencies, sentences, punctuation and wrapped lines
+static void generate_text(Generator *generator, uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (generator->pending_next == generator->pending_size)
+        {
+            const char *word = english_words[sample(generator)];
+            size_t length = strlen(word);
+            if (generator->column + length + 2 > LINE_WIDTH)
+            {
+                generator->pending[0] = '\n';
+                generator->pending_size = 1;
+                generator->column = 0;
+            }
+            else
+            {
+                unsigned size_so_far = 0;
+                if (generator->column > 0)
+                    generator->pending[size_so_far++] = ' ';
+                memcpy(generator->pending + size_so_far, word, length);
+                if (generator->capitalize)
+                    generator->pending[size_so_far] -= 'a' - 'A';
+                size_so_far += (unsigned)length;
+
+                uint64_t punctuation = next_random(generator) % 16;
+                generator->capitalize = punctuation == 0;
+                if (punctuation == 0)
+                    generator->pending[size_so_far++] = '.';
+                else if (punctuation == 1)
+                    generator->pending[size_so_far++] = ',';
+                generator->pending_size = size_so_far;
+                generator->column += size_so_far;
+            }
+            generator->pending_next = 0;
+        }
+        buffer[i] = generator->pending[generator->pending_next++];
+    }
+}
+
+// Helper function to set a generator to the start of a corpus
+static void init_generator(Generator *generator, const Corpus *corpus)
+{
+    memset(generator, 0, sizeof(*generator));
+    generator->rng = 0x9E3779B97F4A7C15ULL;
+    for (const char *c = corpus->name; *c; c++)
+        generator->rng = (generator->rng ^ (uint8_t)*c) * 0x100000001B3ULL;
+    generator->capitalize = 1;
+
+    if (corpus->generate == generate_zipf)
+    {
+        set_zipf_weights(generator, VOCABULARY_SIZE);
+        generator->words = malloc(VOCABULARY_SIZE * sizeof(*generator->words));
+        for (unsigned w = 0; w < VOCABULARY_SIZE; w++)
+        {
+            unsigned length = 1 + next_random(generator) % MAX_WORD_LENGTH;
+            for (unsigned l = 0; l < length; l++)
+                generator->words[w][l] = (char)('a' + next_random(generator) % 26);
+            generator->words[w][length] = '\0';
+        }
+    }
+    else if (corpus->generate == generate_text)
+        set_zipf_weights(generator, NUM_ENGLISH_WORDS);
+    else if (corpus->generate == generate_fibonacci)
+    {
+        generator->weights = malloc(FIBONACCI_SYMBOLS * sizeof(uint64_t));
+        generator->num_weights = FIBONACCI_SYMBOLS;
+        uint64_t previous = 0, current = 1, total = 0;
+        for (unsigned k = 0; k < FIBONACCI_SYMBOLS; k++)
+        {
+            total += current;
+            generator->weights[k] = total;
+            uint64_t next = previous + current;
+            previous = current;
+            current = next;
+        }
+    }
+}
+
+// Helper function to free the tables of a generator
+static void free_generator(Generator *generator)
+{
+    free(generator->weights);
+    free(generator->words);
+}
+
+// Helper function to write size bytes of a corpus to path
+static void write_corpus(const Corpus *corpus, uint64_t size, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "File `%s` cannot be opened!\n", path);
+        exit(1);
+    }
+    Generator generator;
+    init_generator(&generator, corpus);
+    uint8_t *chunk = malloc(CHUNK_SIZE);
+    for (uint64_t written = 0; written < size; written += CHUNK_SIZE)
+    {
+        size_t chunk_size = size - written < CHUNK_SIZE ? size - written : CHUNK_SIZE;
+        corpus->generate(&generator, chunk, chunk_size);
+        if (fwrite(chunk, 1, chunk_size, file) != chunk_size)
+        {
+            fprintf(stderr, "File `%s` cannot be written!\n", path);
+            exit(1);
+        }
+    }
+    free(chunk);
+    free_generator(&generator);
+    fclose(file);
+}
+
+// Helper function to get the size of a file, UINT64_MAX if it is missing
+static uint64_t file_size(const char *path)
+{
+    struct stat status;
+    if (stat(path, &status))
+        return UINT64_MAX;
+    return (uint64_t)status.st_size;
+}
+
+// Helper function to check whether two files hold the same bytes
+static int same_content(const char *path_a, const char *path_b)
+{
+    FILE *file_a = fopen(path_a, "rb");
+    FILE *file_b = fopen(path_b, "rb");
+    int same = file_a && file_b;
+    uint8_t *chunk_a = malloc(CHUNK_SIZE);
+    uint8_t *chunk_b = malloc(CHUNK_SIZE);
+    while (same)
+    {
+        size_t size_a = fread(chunk_a, 1, CHUNK_SIZE, file_a);
+        size_t size_b = fread(chunk_b, 1, CHUNK_SIZE, file_b);
+        if (size_a != size_b || memcmp(chunk_a, chunk_b, size_a))
+            same = 0;
+        if (size_a < CHUNK_SIZE)
+            break;
+    }
+    free(chunk_a);
+    free(chunk_b);
+    if (file_a)
+        fclose(file_a);
+    if (file_b)
+        fclose(file_b);
+    return same;
+}
+
+// Helper function to run a program with its output discarded, returning
+// its wall-clock time in seconds and updating its peak resident memory
+static double run(char **argv, long *peak_rss_kib)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+            dup2(null_fd, STDOUT_FILENO);
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0)
+    {
+        perror("wait4");
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "`%s %s` failed\n", argv[0], argv[1]);
+        exit(1);
+    }
+    if (usage.ru_maxrss > *peak_rss_kib)
+        *peak_rss_kib = usage.ru_maxrss;
+    return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+// Helper function to run a program repeats times, returning the best time
+static double run_best(char **argv, unsigned repeats, long *peak_rss_kib)
+{
+    *peak_rss_kib = 0;
+    double best = run(argv, peak_rss_kib);
+    for (unsigned r = 1; r < repeats; r++)
+    {
+        double seconds = run(argv, peak_rss_kib);
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+// Helper function to parse a size such as 512, 64K, 16M or 4G, 0 if invalid
+static uint64_t parse_size(const char *text)
+{
+    char *end = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text)
+        return 0;
+    if (*end == 'K' || *end == 'k')
+        value <<= 10;
+    else if (*end == 'M' || *end == 'm')
+        value <<= 20;
+    else if (*end == 'G' || *end == 'g')
+        value <<= 30;
+    else if (*end != '\0')
+        return 0;
+    if (*end != '\0' && end[1] != '\0')
+        return 0;
+    return value;
+}
+
+// Helper function to print a size with the largest exact binary unit
+static void format_size(uint64_t size, char *text, size_t text_size)
+{
+    if (size >= (1ULL << 30) && size % (1ULL << 30) == 0)
+        snprintf(text, text_size, "%lluG", (unsigned long long)(size >> 30));
+    else if (size >= (1ULL << 20) && size % (1ULL << 20) == 0)
+        snprintf(text, text_size, "%lluM", (unsigned long long)(size >> 20));
+    else if (size >= (1ULL << 10) && size % (1ULL << 10) == 0)
+        snprintf(text, text_size, "%lluK", (unsigned long long)(size >> 10));
+    else
+        snprintf(text, text_size, "%llu", (unsigned long long)size);
+}
+
+// Helper function to print one line of the text report
+static void print_result(const Result *result)
+{
+    char size_text[32];
+    format_size(result->size, size_text, sizeof(size_text));
+    char level_text[16] = "-";
+    if (result->match_level > 0)
+        snprintf(level_text, sizeof(level_text), "%u", result->match_level);
+    printf("%-10s %9s %7s %8.4f %14.1f %16.1f %9ld KiB %11ld KiB %6s\n",
+           result->corpus, size_text, level_text,
+           (double)result->compressed_size / result->size,
+           result->size / result->compress_seconds / 1e6,
+           result->size / result->decompress_seconds / 1e6,
+           result->compress_rss_kib, result->decompress_rss_kib,
+           result->round_trip ? "ok" : "FAILED");
+}
+
+// Helper function to write every result to a JSON file
+static void write_json(const char *path, const Result *results, unsigned num_results,
+                       unsigned repeats)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "File `%s` cannot be opened!\n", path);
+        exit(1);
+    }
+    fprintf(file, "{\n  \"repeats\": %u,\n  \"results\": [", repeats);
+    for (unsigned r = 0; r < num_results; r++)
+    {
+        const Result *result = &results[r];
+        fprintf(file, "%s\n    {\"corpus\": \"%s\", \"size\": %llu, "
+                "\"match_level\": %u, \"compressed_size\": %llu, \"ratio\": %.6f, "
+                "\"compress_mb_per_s\": %.3f, \"decompress_mb_per_s\": %.3f, "
+                "\"compress_seconds\": %.6f, \"decompress_seconds\": %.6f, "
+                "\"compress_peak_rss_kib\": %ld, \"decompress_peak_rss_kib\": %ld, "
+                "\"round_trip\": %s}",
+                r ? "," : "", result->corpus, (unsigned long long)result->size,
+                result->match_level,
+                (unsigned long long)result->compressed_size,
+                (double)result->compressed_size / result->size,
+                result->size / result->compress_seconds / 1e6,
+                result->size / result->decompress_seconds / 1e6,
+                result->compress_seconds, result->decompress_seconds,
+                result->compress_rss_kib, result->decompress_rss_kib,
+                result->round_trip ? "true" : "false");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+}
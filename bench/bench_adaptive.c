@@ -0,0 +1,211 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bench_adaptive.c
+*
+*   Description: Micro-benchmark of the adaptive coder against the block
+*   coder on small messages. For messages of English-like text from 64
+*   bytes to 16 KiB, gives the compressed size and the time to compress
+*   then decompress one message in memory, and checks the round trip
+*
+*   Usage: bench-adaptive [-n <messages>] [-r <repeats>]
+*
+****************************************************************/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/huffman.h"
+#include "../include/adaptive.h"
+
+#define DEFAULT_MESSAGES 2000
+#define DEFAULT_REPEATS 5
+#define MAX_MESSAGE_SIZE 16384
+
+/* Compresses then decompresses a message, returning the compressed size */
+typedef size_t Round_trip_function(const uint8_t *message, size_t size);
+
+/* structure of a coder: name used in reports, and its round trip */
+typedef struct Coder
+{
+    const char *name;
+    Round_trip_function *round_trip;
+} Coder;
+
+/* Helper function prototypes */
+static uint64_t next_random(uint64_t *rng);
+static void make_text(uint8_t *text, size_t size);
+static size_t round_trip_static(const uint8_t *message, size_t size);
+static size_t round_trip_adaptive(const uint8_t *message, size_t size);
+static double time_coder(const Coder *coder, const uint8_t *text, size_t size,
+                         unsigned num_messages, unsigned repeats, size_t *compressed_size);
+static void usage(char *program_name);
+
+static const Coder coders[] = {
+    {"static", round_trip_static},
+    {"adaptive", round_trip_adaptive}
+};
+#define NUM_CODERS (sizeof(coders) / sizeof(coders[0]))
+
+static const size_t message_sizes[] = {64, 256, 1024, 4096, 16384};
+#define NUM_SIZES (sizeof(message_sizes) / sizeof(message_sizes[0]))
+
+/* Buffers and coder reused by every message */
+static uint64_t workspace[HUFFMAN_COMPRESS_WORKSPACE_SIZE / sizeof(uint64_t)];
+static uint64_t decode_workspace[HUFFMAN_DECOMPRESS_WORKSPACE_SIZE / sizeof(uint64_t)];
+static uint8_t *compressed;
+static size_t compressed_capacity;
+static uint8_t decompressed[MAX_MESSAGE_SIZE];
+static Adaptive_Coder_T adaptive_coder;
+
+int main(int argc, char *argv[])
+{
+    unsigned num_messages = DEFAULT_MESSAGES;
+    unsigned repeats = DEFAULT_REPEATS;
+    int option;
+    while ((option = getopt(argc, argv, "n:r:")) != -1)
+    {
+        if (option == 'n' && atoi(optarg) > 0)
+            num_messages = atoi(optarg);
+        else if (option == 'r' && atoi(optarg) > 0)
+            repeats = atoi(optarg);
+        else
+            usage(argv[0]);
+    }
+    if (optind != argc)
+        usage(argv[0]);
+
+    // Messages are consecutive slices of the text, so that each differs
+    static uint8_t text[MAX_MESSAGE_SIZE * 64];
+    make_text(text, sizeof(text));
+    adaptive_coder = Adaptive_coder_new();
+
+    // Room for the bound of the block coder, or twice the message for the
+    // adaptive one
+    compressed_capacity = Huffman_compress_bound(MAX_MESSAGE_SIZE);
+    if (compressed_capacity < MAX_MESSAGE_SIZE * 2 + 4096)
+        compressed_capacity = MAX_MESSAGE_SIZE * 2 + 4096;
+    compressed = malloc(compressed_capacity);
+    assert(compressed);
+
+    printf("%-8s", "bytes");
+    for (unsigned c = 0; c < NUM_CODERS; c++)
+        printf(" %10s size %10s ns", coders[c].name, coders[c].name);
+    printf("\n");
+    for (unsigned s = 0; s < NUM_SIZES; s++)
+    {
+        printf("%-8zu", message_sizes[s]);
+        for (unsigned c = 0; c < NUM_CODERS; c++)
+        {
+            size_t compressed_size = 0;
+            double seconds = time_coder(&coders[c], text, message_sizes[s], num_messages,
+                                        repeats, &compressed_size);
+            printf(" %15.1f %13.0f", (double)compressed_size / num_messages, seconds * 1e9);
+        }
+        printf("\n");
+    }
+
+    Adaptive_coder_free(&adaptive_coder);
+    free(compressed);
+    return 0;
+}
+
+// Helper function to print usage and exit
+static void usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-n <messages>] [-r <repeats>]\n", program_name);
+    exit(1);
+}
+
+// Helper function to get the next pseudo-random number (xorshift64*)
+static uint64_t next_random(uint64_t *rng)
+{
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return *rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Helper function to fill text with words drawn with Zipfian weights from
+// a small vocabulary, separated by spaces and the odd newline
+static void make_text(uint8_t *text, size_t size)
+{
+    static const char *words[] = {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+        "as", "was", "with", "be", "by", "on", "not", "he", "this", "are",
+        "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+        "request", "response", "status", "error", "timeout", "server", "client",
+        "message", "stream", "header"
+    };
+    enum { NUM_WORDS = sizeof(words) / sizeof(words[0]) };
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    size_t position = 0;
+    while (position < size)
+    {
+        // Word i is drawn with a weight of 1 / (i + 1)
+        unsigned i = 0;
+        double draw = (double)(next_random(&rng) >> 11) / (1ULL << 53) * 4.3;
+        while (i + 1 < NUM_WORDS && draw > 1.0 / (i + 1))
+            draw -= 1.0 / (i + 1), i++;
+        for (const char *c = words[i]; *c && position < size; c++)
+            text[position++] = (uint8_t)*c;
+        if (position < size)
+            text[position++] = next_random(&rng) % 12 ? ' ' : '\n';
+    }
+}
+
+// Helper function to round trip a message through the block coder
+static size_t round_trip_static(const uint8_t *message, size_t size)
+{
+    size_t compressed_size = Huffman_compress(message, size, compressed, compressed_capacity,
+                                              workspace);
+    Huffman_decompress(compressed, compressed_size, decompressed, size, decode_workspace);
+    return compressed_size;
+}
+
+// Helper function to round trip a message through the adaptive coder
+static size_t round_trip_adaptive(const uint8_t *message, size_t size)
+{
+    size_t compressed_size = Adaptive_compress(adaptive_coder, message, size, compressed,
+                                               compressed_capacity);
+    Adaptive_decompress(adaptive_coder, compressed, compressed_size, decompressed, size);
+    return compressed_size;
+}
+
+// Helper function to round trip num_messages messages of a size, checking
+// the first one, and to sum their compressed sizes. Returns the best
+// seconds per message over repeats rounds
+static double time_coder(const Coder *coder, const uint8_t *text, size_t size,
+                         unsigned num_messages, unsigned repeats, size_t *compressed_size)
+{
+    size_t num_slices = MAX_MESSAGE_SIZE * 64 / size;
+    coder->round_trip(text, size);
+    if (memcmp(decompressed, text, size) != 0)
+    {
+        fprintf(stderr, "Round trip of %s coder failed\n", coder->name);
+        exit(1);
+    }
+
+    double best = 0;
+    for (unsigned r = 0; r < repeats; r++)
+    {
+        struct timespec start, end;
+        size_t total = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned m = 0; m < num_messages; m++)
+            total += coder->round_trip(text + (m % num_slices) * size, size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = ((double)(end.tv_sec - start.tv_sec) +
+                          (end.tv_nsec - start.tv_nsec) * 1e-9) / num_messages;
+        if (r == 0 || seconds < best)
+            best = seconds;
+        *compressed_size = total;
+    }
+    return best;
+}
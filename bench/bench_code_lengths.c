@@ -0,0 +1,243 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bench_code_lengths.c
+*
+*   Description: Micro-benchmark of the code length builders. Times the
+*   Huffman tree built through the priority queue against the linear-time
+*   lengths of the canonical module, with and without the length limit,
+*   on histograms shaped like the blocks of the end-to-end corpora, and
+*   checks that every builder gives codes of the same total length
+*
+*   Usage: bench-code-lengths [-n <iterations>] [-r <repeats>]
+*
+****************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../hanson/include/array.h"
+#include "../include/priority_queue.h"
+#include "../include/huffman_tree.h"
+#include "../include/canonical.h"
+
+#define DEFAULT_ITERATIONS 20000
+#define DEFAULT_REPEATS 5
+#define BLOCK_SIZE (1 << 20)
+#define FIBONACCI_SYMBOLS 24
+#define SPARSE_SYMBOLS 16
+
+/* structure of a histogram to build codes for */
+typedef struct Histogram
+{
+    const char *name;
+    uint64_t freq_array[MAX_NUM_CHAR];
+} Histogram;
+
+typedef uint64_t Build_function(const uint64_t *freq_array);
+
+/* structure of a builder: name used in reports, and the function building
+ * codes for a histogram and returning their total length in bits */
+typedef struct Builder
+{
+    const char *name;
+    Build_function *build;
+} Builder;
+
+/* Helper function prototypes */
+static uint64_t next_random(uint64_t *rng);
+static void make_histograms(Histogram *histograms);
+static uint64_t build_tree(const uint64_t *freq_array);
+static uint64_t build_optimal(const uint64_t *freq_array);
+static uint64_t build_limited(const uint64_t *freq_array);
+static double time_builder(const Builder *builder, const uint64_t *freq_array,
+                           unsigned iterations, unsigned repeats);
+static void usage(char *program_name);
+
+enum { NUM_HISTOGRAMS = 4 };
+
+static const Builder builders[] = {
+    {"tree", build_tree},
+    {"linear", build_optimal},
+    {"limited", build_limited}
+};
+#define NUM_BUILDERS (sizeof(builders) / sizeof(builders[0]))
+
+/* Tree reused by calls of build_tree, and workspace of build_limited */
+static Huffman_Tree_T tree;
+static uint64_t workspace[CANONICAL_WORKSPACE_SIZE / sizeof(uint64_t)];
+
+int main(int argc, char *argv[])
+{
+    unsigned iterations = DEFAULT_ITERATIONS;
+    unsigned repeats = DEFAULT_REPEATS;
+    int option;
+    while ((option = getopt(argc, argv, "n:r:")) != -1)
+    {
+        if (option == 'n' && atoi(optarg) > 0)
+            iterations = atoi(optarg);
+        else if (option == 'r' && atoi(optarg) > 0)
+            repeats = atoi(optarg);
+        else
+            usage(argv[0]);
+    }
+    if (optind != argc)
+        usage(argv[0]);
+
+    static Histogram histograms[NUM_HISTOGRAMS];
+    make_histograms(histograms);
+    tree = Huffman_tree_new();
+
+    printf("%-10s", "histogram");
+    for (unsigned b = 0; b < NUM_BUILDERS; b++)
+        printf(" %10s ns", builders[b].name);
+    printf(" %10s\n", "same cost");
+
+    for (int h = 0; h < NUM_HISTOGRAMS; h++)
+    {
+        const uint64_t *freq_array = histograms[h].freq_array;
+        printf("%-10s", histograms[h].name);
+        for (unsigned b = 0; b < NUM_BUILDERS; b++)
+            printf(" %13.1f", time_builder(&builders[b], freq_array,
+                                           iterations, repeats) * 1e9);
+
+        // The limit only binds for the Fibonacci histogram
+        uint64_t tree_cost = build_tree(freq_array);
+        int same_cost = build_optimal(freq_array) == tree_cost &&
+                        (h == NUM_HISTOGRAMS - 1 || build_limited(freq_array) == tree_cost);
+        printf(" %10s\n", same_cost ? "ok" : "FAILED");
+        if (!same_cost)
+            return 1;
+    }
+
+    Huffman_tree_free(&tree);
+    return 0;
+}
+
+// Helper function to print usage and exit
+static void usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-n <iterations>] [-r <repeats>]\n", program_name);
+    exit(1);
+}
+
+// Helper function to get the next pseudo-random number (xorshift64*)
+static uint64_t next_random(uint64_t *rng)
+{
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return *rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Helper function to fill the histograms of a 1 MiB block of uniform bytes,
+// of Zipfian bytes, of a few random bytes, and of Fibonacci-skewed bytes
+// whose codes are longer than CANONICAL_MAX_CODE_LENGTH without a limit
+static void make_histograms(Histogram *histograms)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    memset(histograms, 0, NUM_HISTOGRAMS * sizeof(Histogram));
+
+    histograms[0].name = "uniform";
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        histograms[0].freq_array[i] = BLOCK_SIZE / MAX_NUM_CHAR - 64 +
+                                      next_random(&rng) % 128;
+
+    histograms[1].name = "zipf";
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        histograms[1].freq_array[i] = BLOCK_SIZE / 6 / (i + 1) + 1;
+
+    histograms[2].name = "sparse";
+    for (int i = 0; i < SPARSE_SYMBOLS; i++)
+        histograms[2].freq_array[next_random(&rng) % MAX_NUM_CHAR] =
+            1 + next_random(&rng) % (BLOCK_SIZE / SPARSE_SYMBOLS);
+
+    histograms[3].name = "fibonacci";
+    uint64_t prev = 1, curr = 1;
+    for (int i = 0; i < FIBONACCI_SYMBOLS; i++)
+    {
+        histograms[3].freq_array[i] = curr;
+        uint64_t next = prev + curr;
+        prev = curr;
+        curr = next;
+    }
+}
+
+// Helper function to build a Huffman tree through the priority queue, and
+// its encoding table. Returns the total length of the codes
+static uint64_t build_tree(const uint64_t *freq_array)
+{
+    int num_entries = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        num_entries += freq_array[i] != 0;
+
+    Huffman_tree_clear(tree);
+    Array_T entries = Array_new(num_entries, sizeof(Node));
+    for (int i = 0, entry = 0; i < MAX_NUM_CHAR; i++)
+    {
+        if (freq_array[i] == 0)
+            continue;
+        Node node = {Huffman_tree_new_leaf(tree, (char)i, freq_array[i]), freq_array[i]};
+        Array_put(entries, entry++, &node);
+    }
+    Huffman_tree_build(tree, entries);
+    Array_T encoding = Huffman_tree_create_encoding_table(tree);
+    Array_free(&entries);
+
+    uint64_t cost = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        cost += freq_array[i] * ((Encoded_value *)Array_get(encoding, i))->bit_length;
+    return cost;
+}
+
+// Helper function to compute lengths without a limit in linear time.
+// Returns the total length of the codes
+static uint64_t build_optimal(const uint64_t *freq_array)
+{
+    uint8_t lengths[MAX_NUM_CHAR];
+    Canonical_optimal_lengths(freq_array, lengths);
+    uint64_t cost = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        cost += freq_array[i] * lengths[i];
+    return cost;
+}
+
+// Helper function to compute lengths limited to CANONICAL_MAX_CODE_LENGTH,
+// as each block does. Returns the total length of the codes
+static uint64_t build_limited(const uint64_t *freq_array)
+{
+    uint8_t lengths[MAX_NUM_CHAR];
+    Canonical_code_lengths(freq_array, CANONICAL_MAX_CODE_LENGTH, lengths, workspace);
+    uint64_t cost = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        cost += freq_array[i] * lengths[i];
+    return cost;
+}
+
+// Helper function to time iterations calls of a builder, returning the best
+// seconds per call over repeats rounds
+static double time_builder(const Builder *builder, const uint64_t *freq_array,
+                           unsigned iterations, unsigned repeats)
+{
+    double best = 0;
+    volatile uint64_t sink = 0;
+    for (unsigned r = 0; r < repeats; r++)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned i = 0; i < iterations; i++)
+            sink += builder->build(freq_array);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = ((double)(end.tv_sec - start.tv_sec) +
+                          (end.tv_nsec - start.tv_nsec) * 1e-9) / iterations;
+        if (r == 0 || seconds < best)
+            best = seconds;
+    }
+    (void)sink;
+    return best;
+}
@@ -0,0 +1,170 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bench_priority_queue.c
+*
+*   Description: Micro-benchmark of the priority queue. Times binary and
+*   4-ary heaps on the merges of a Huffman tree build over 256 characters,
+*   and on sorting a large number of random values through the queue
+*
+*   Usage: bench-priority-queue [-n <values>] [-r <repeats>]
+*
+****************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "../hanson/include/array.h"
+#include "../include/priority_queue.h"
+
+#define DEFAULT_VALUES 1000000
+#define DEFAULT_REPEATS 5
+#define NUM_LEAVES 256
+#define TREE_BUILDS 2000
+
+/* Helper function prototypes */
+static uint64_t next_random(uint64_t *rng);
+static double seconds_since(const struct timespec *start);
+static double time_tree_builds(int arity, Array_T leaves, unsigned repeats);
+static double time_sort(int arity, const uint64_t *values, int num_values,
+                        unsigned repeats);
+static void usage(char *program_name);
+
+static const int arities[] = {2, 4};
+#define NUM_ARITIES (sizeof(arities) / sizeof(arities[0]))
+
+int main(int argc, char *argv[])
+{
+    int num_values = DEFAULT_VALUES;
+    unsigned repeats = DEFAULT_REPEATS;
+    int option;
+    while ((option = getopt(argc, argv, "n:r:")) != -1)
+    {
+        if (option == 'n' && atoi(optarg) > 0)
+            num_values = atoi(optarg);
+        else if (option == 'r' && atoi(optarg) > 0)
+            repeats = atoi(optarg);
+        else
+            usage(argv[0]);
+    }
+    if (optind != argc)
+        usage(argv[0]);
+
+    // Counts of a 1 MiB block over every character, and random values
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    static int item;
+    Array_T leaves = Array_new(NUM_LEAVES, sizeof(Node));
+    for (int i = 0; i < NUM_LEAVES; i++)
+    {
+        Node node = {&item, 1 + next_random(&rng) % (1 << 13)};
+        Array_put(leaves, i, &node);
+    }
+    uint64_t *values = malloc((size_t)num_values * sizeof(uint64_t));
+    if (!values)
+    {
+        fprintf(stderr, "%s\n", "Out of memory");
+        return 1;
+    }
+    for (int i = 0; i < num_values; i++)
+        values[i] = next_random(&rng);
+
+    printf("%-8s %18s %18s\n", "arity", "tree build ns", "sort ns/value");
+    for (unsigned a = 0; a < NUM_ARITIES; a++)
+        printf("%-8d %18.1f %18.1f\n", arities[a],
+               time_tree_builds(arities[a], leaves, repeats) * 1e9,
+               time_sort(arities[a], values, num_values, repeats) * 1e9);
+
+    free(values);
+    Array_free(&leaves);
+    return 0;
+}
+
+// Helper function to print usage and exit
+static void usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [-n <values>] [-r <repeats>]\n", program_name);
+    exit(1);
+}
+
+// Helper function to get the next pseudo-random number (xorshift64*)
+static uint64_t next_random(uint64_t *rng)
+{
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return *rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Helper function to get the seconds elapsed since start
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Helper function to time the queue operations of Huffman_tree_build: a
+// queue built from the leaves, whose two smallest nodes are merged until
+// one is left. Returns the best seconds per build over repeats rounds
+static double time_tree_builds(int arity, Array_T leaves, unsigned repeats)
+{
+    double best = 0;
+    for (unsigned r = 0; r < repeats; r++)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int b = 0; b < TREE_BUILDS; b++)
+        {
+            Priority_Queue_T queue = Priority_queue_new_d_ary(0, arity);
+            Priority_queue_build(queue, leaves);
+            while (Priority_queue_size(queue) > 1)
+            {
+                Node first = *(Node *)Priority_queue_pop(queue);
+                Node second = *(Node *)Priority_queue_pop(queue);
+                Priority_queue_insert(queue, first.obj, first.value + second.value);
+            }
+            Priority_queue_free(&queue);
+        }
+        double seconds = seconds_since(&start) / TREE_BUILDS;
+        if (r == 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+// Helper function to time inserting every value then popping them all.
+// Returns the best seconds per value over repeats rounds
+static double time_sort(int arity, const uint64_t *values, int num_values,
+                        unsigned repeats)
+{
+    static int item;
+    double best = 0;
+    for (unsigned r = 0; r < repeats; r++)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Priority_Queue_T queue = Priority_queue_new_d_ary(0, arity);
+        for (int i = 0; i < num_values; i++)
+            Priority_queue_insert(queue, &item, values[i]);
+        uint64_t last = 0;
+        for (int i = 0; i < num_values; i++)
+        {
+            Node *node = (Node *)Priority_queue_pop(queue);
+            if (node->value < last)
+            {
+                fprintf(stderr, "%s\n", "Values popped out of order");
+                exit(1);
+            }
+            last = node->value;
+        }
+        Priority_queue_free(&queue);
+
+        double seconds = seconds_since(&start) / num_values;
+        if (r == 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
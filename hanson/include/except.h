@@ -38,7 +38,9 @@ enum
     Except_handled,
     Except_finalized
 };
-extern Except_Frame *Except_stack;
+// Each thread has its own stack of handlers, so blocks can be decoded
+// in parallel while exceptions are raised
+extern __thread Except_Frame *Except_stack;
 extern const Except_T Assert_Failed;
 void Except_raise(const T *e, const char *file, int line);
 #ifdef WIN32
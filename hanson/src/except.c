@@ -18,7 +18,7 @@
 #include <assert.h>
 #include "../include/except.h"
 #define T Except_T
-Except_Frame *Except_stack = NULL;
+__thread Except_Frame *Except_stack = NULL;
 void Except_raise(const T *e, const char *file,
                   int line)
 {
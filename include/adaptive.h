@@ -0,0 +1,186 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: adaptive.h
+*
+*   Description: Header file for adaptive Huffman coder, which codes
+*   characters in one pass with the FGK algorithm. Encoder and decoder
+*   start from the same tree and update it identically after each
+*   character, so that no code table is transmitted and output starts
+*   with the first character
+*
+*   The tree starts with a single NYT (not yet transmitted) leaf of zero
+*   frequency. A character seen for the first time is sent as the code
+*   of the NYT leaf followed by ADAPTIVE_ESCAPE_BITS bits of its value,
+*   and the end of the stream as the same escape with value
+*   ADAPTIVE_END. Compressed streams are laid out as follows
+*
+*       <ADAPTIVE_MAGIC><CODES>...<NYT><ADAPTIVE_END>
+*
+*   with codes packed from the top of 64-bit words as in the bit I/O
+*   module
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../hanson/include/except.h"
+#include "huffman_tree.h"
+#include "bitio.h"
+#include "stats.h"
+
+#ifndef ADAPTIVE_INCLUDED
+#define ADAPTIVE_INCLUDED
+#define T Adaptive_Coder_T
+
+/* Magic bytes at the top of adaptively coded files */
+#define ADAPTIVE_MAGIC "HUFA"
+#define ADAPTIVE_MAGIC_SIZE 4
+
+/* Value following the NYT code at the end of the stream */
+#define ADAPTIVE_END MAX_NUM_CHAR
+#define ADAPTIVE_ESCAPE_BITS 9
+
+/* Most nodes of the tree: a leaf for every character and the NYT leaf */
+#define ADAPTIVE_MAX_NODES (2 * MAX_NUM_CHAR + 1)
+
+/* Longest code of a character or of the end: the deepest leaf of a tree
+ * with MAX_NUM_CHAR internal nodes, then the escaped value */
+#define ADAPTIVE_MAX_CODE_BITS (MAX_NUM_CHAR + ADAPTIVE_ESCAPE_BITS)
+
+typedef struct T *T;
+
+/* Raised when a stream decodes to an impossible character, or runs past
+ * its end */
+extern const Except_T Adaptive_Corrupted;
+
+/* Raised when the output buffer cannot hold the result */
+extern const Except_T Adaptive_Output_Too_Small;
+
+/*
+ * Function:        Adaptive_coder_new
+ * Description:     Allocates a coder holding the tree of a new stream
+ * Return:          Pointer to newly created Adaptive Coder
+ */
+extern T Adaptive_coder_new(void);
+
+/*
+ * Function:        Adaptive_coder_free
+ * Description:     Deallocates the coder after done using
+ * Parameters:      T *coder: double pointer to struct `Adaptive_Coder_T`
+ * Return:          void
+ */
+extern void Adaptive_coder_free(T *coder);
+
+/*
+ * Function:        Adaptive_coder_reset
+ * Description:     Goes back to the tree of a new stream, with only the
+ *                  NYT leaf, so that the coder can be reused
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ * Return:          void
+ */
+extern void Adaptive_coder_reset(T coder);
+
+/*
+ * Function:        Adaptive_coder_num_bits
+ * Description:     Gets the number of bits coded since the last reset
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ * Return:          uint64_t: number of bits written or read
+ */
+extern uint64_t Adaptive_coder_num_bits(T coder);
+
+/*
+ * Function:        Adaptive_encode
+ * Description:     Writes the code of a character, or the end of the
+ *                  stream, then updates the tree. The writer may store up
+ *                  to ADAPTIVE_MAX_CODE_BITS / 64 + 1 words
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  Bit_writer *writer: pointer to the writer
+ *                  int c: character, or ADAPTIVE_END
+ * Return:          void
+ */
+extern void Adaptive_encode(T coder, Bit_writer *writer, int c);
+
+/*
+ * Function:        Adaptive_decode
+ * Description:     Reads the code of a character, then updates the tree
+ *                  as Adaptive_encode did. The reader must hold up to
+ *                  ADAPTIVE_MAX_CODE_BITS bits. Raises Adaptive_Corrupted
+ *                  if a character is escaped twice
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  Bit_reader *reader: pointer to the reader
+ * Return:          int: character, or ADAPTIVE_END
+ */
+extern int Adaptive_decode(T coder, Bit_reader *reader);
+
+/*
+ * Function:        Adaptive_compress_bound
+ * Description:     Gets the largest possible size of a compressed buffer
+ * Parameters:      size_t src_size: number of bytes to compress
+ * Return:          size_t: capacity of dst that always suffices
+ */
+extern size_t Adaptive_compress_bound(size_t src_size);
+
+/*
+ * Function:        Adaptive_compress
+ * Description:     Compresses src into dst in one pass, starting from a
+ *                  reset tree. Raises Adaptive_Output_Too_Small if dst
+ *                  may not hold the next code, which never happens with a
+ *                  capacity of Adaptive_compress_bound(src_size)
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  void *src: bytes to compress
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ * Return:          size_t: number of bytes written to dst
+ */
+extern size_t Adaptive_compress(T coder, const void *src, size_t src_size,
+                                void *dst, size_t dst_capacity);
+
+/*
+ * Function:        Adaptive_decompress
+ * Description:     Decompresses a buffer made by Adaptive_compress or
+ *                  `huffman -A`. Raises Adaptive_Corrupted on malformed or
+ *                  truncated input, and Adaptive_Output_Too_Small if dst
+ *                  cannot hold the decoded bytes
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  void *src: compressed bytes
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ * Return:          size_t: number of bytes written to dst
+ */
+extern size_t Adaptive_decompress(T coder, const void *src, size_t src_size,
+                                  void *dst, size_t dst_capacity);
+
+/*
+ * Function:        Adaptive_compress_file
+ * Description:     Reads infile until end of file and writes its codes to
+ *                  outfile as they fill the output buffer, so that input
+ *                  and output can be pipes
+ * Parameters:      FILE *infile: pointer to the input file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Stats *stats: updated with bytes and timings, or NULL
+ * Return:          void
+ */
+extern void Adaptive_compress_file(FILE *infile, FILE *outfile, Stats *stats);
+
+/*
+ * Function:        Adaptive_decompress_file
+ * Description:     Decodes codes up to the end of the stream and writes
+ *                  them to outfile. infile must be positioned right after
+ *                  ADAPTIVE_MAGIC. Raises Adaptive_Corrupted on malformed
+ *                  or truncated input
+ * Parameters:      FILE *infile: pointer to the compressed file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Stats *stats: updated with bytes and timings, or NULL
+ * Return:          void
+ */
+extern void Adaptive_decompress_file(FILE *infile, FILE *outfile, Stats *stats);
+
+#undef T
+#endif
@@ -0,0 +1,243 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bitio.h
+*
+*   Description: Header file for bit I/O module, which writes and reads
+*   streams of codes packed from the top of native-endian 64-bit words,
+*   the layout of every compressed body. Unlike the bitpack module, codes
+*   are appended to and consumed from a 64-bit accumulator, and whole
+*   words move to and from memory buffers without checks per code
+*
+*   The per-code functions, and every function on the reader, are defined
+*   in this header so that encoding and decoding loops can inline them
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef BITIO_INCLUDED
+#define BITIO_INCLUDED
+
+/* Per-code functions are inlined even when the build does not optimize */
+#define BITIO_INLINE __attribute__((always_inline))
+
+/* Number of bits Bit_reader_peek can always see after Bit_reader_refill */
+#define BIT_READER_MIN_BITS 32
+
+/* structure of the bit writer. Codes are appended below the bits already
+ * held in `accumulator`, which is stored to the buffer once full */
+struct Bit_writer
+{
+    uint8_t *buffer;      // first byte of the output buffer
+    uint8_t *next;        // where the next full word is stored
+    uint64_t accumulator; // word being filled, from its top bit
+    unsigned free_bits;   // number of bits left in accumulator
+};
+typedef struct Bit_writer Bit_writer;
+
+/* structure of the bit reader. Encoded bits are kept left-aligned in
+ * `window`, topped up 32 bits at a time from the halves of the input
+ * words. Every function on the reader is inline, so that a decoding loop
+ * keeps it in registers */
+struct Bit_reader
+{
+    const uint8_t *next;  // word holding the next unread half
+    const uint8_t *end;   // end of the current chunk of words
+    uint64_t window;
+    unsigned window_bits;
+    unsigned low_half;    // whether the next half is the low one of *next
+};
+typedef struct Bit_reader Bit_reader;
+
+/*
+ * Function:        Bit_writer_init
+ * Description:     Starts writing codes to buffer
+ * Parameters:      Bit_writer *writer: writer to initialize
+ *                  uint8_t *buffer: output, large enough for every code
+ *                  written before the next Bit_writer_rewind
+ * Return:          void
+ */
+extern void Bit_writer_init(Bit_writer *writer, uint8_t *buffer);
+
+/*
+ * Function:        Bit_writer_flush
+ * Description:     Stores the partly filled word, if any, padded with
+ *                  zeros. No code may be written afterwards
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ * Return:          size_t: number of bytes in the buffer
+ */
+extern size_t Bit_writer_flush(Bit_writer *writer);
+
+/*
+ * Function:        Bit_writer_put
+ * Description:     Appends a code after the bits already written
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ *                  uint64_t value: code, in its bit_length low bits
+ *                  unsigned bit_length: length of the code, 1 to 64
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_writer_put(Bit_writer *writer,
+                                               uint64_t value,
+                                               unsigned bit_length)
+{
+    if (bit_length < writer->free_bits)
+    {
+        writer->free_bits -= bit_length;
+        writer->accumulator |= value << writer->free_bits;
+        return;
+    }
+    // Split code across the filled word and the next one
+    unsigned back_bits_len = bit_length - writer->free_bits;
+    uint64_t word = writer->accumulator | value >> back_bits_len;
+    memcpy(writer->next, &word, sizeof(uint64_t));
+    writer->next += sizeof(uint64_t);
+
+    writer->free_bits = 64 - back_bits_len;
+    writer->accumulator = back_bits_len ? value << writer->free_bits : 0;
+}
+
+/*
+ * Function:        Bit_writer_num_bytes
+ * Description:     Gets the number of bytes of full words in the buffer
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ * Return:          size_t: number of bytes stored so far
+ */
+static inline BITIO_INLINE size_t Bit_writer_num_bytes(const Bit_writer *writer)
+{
+    return (size_t)(writer->next - writer->buffer);
+}
+
+/*
+ * Function:        Bit_writer_num_bits
+ * Description:     Gets the number of bits written, including those not
+ *                  stored to the buffer yet
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ * Return:          uint64_t: number of bits written
+ */
+static inline BITIO_INLINE uint64_t Bit_writer_num_bits(const Bit_writer *writer)
+{
+    return (uint64_t)Bit_writer_num_bytes(writer) * 8 + 64 - writer->free_bits;
+}
+
+/*
+ * Function:        Bit_writer_rewind
+ * Description:     Stores the next full words from the top of the buffer
+ *                  again, once its content has been written elsewhere
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_writer_rewind(Bit_writer *writer)
+{
+    writer->next = writer->buffer;
+}
+
+/*
+ * Function:        Bit_reader_init
+ * Description:     Starts reading codes from num_words encoded words.
+ *                  Past the end of the words, zero bits are read
+ * Parameters:      Bit_reader *reader: reader to initialize
+ *                  uint8_t *words: encoded words
+ *                  size_t num_words: number of words
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_reader_init(Bit_reader *reader,
+                                                const uint8_t *words,
+                                                size_t num_words)
+{
+    reader->next = words;
+    reader->end = words + num_words * sizeof(uint64_t);
+    reader->window = 0;
+    reader->window_bits = 0;
+    reader->low_half = 0;
+}
+
+/*
+ * Function:        Bit_reader_needs_input
+ * Description:     Checks whether the words given to the reader are used
+ *                  up, so that input read in chunks can be fed in before
+ *                  the next Bit_reader_refill
+ * Parameters:      Bit_reader *reader: pointer to the reader
+ * Return:          int: 1 if every word has been read, 0 otherwise
+ */
+static inline BITIO_INLINE int Bit_reader_needs_input(const Bit_reader *reader)
+{
+    return reader->next == reader->end;
+}
+
+/*
+ * Function:        Bit_reader_feed
+ * Description:     Continues reading from the next chunk of encoded words,
+ *                  once Bit_reader_needs_input tells the current one is
+ *                  used up. Bits already in the window are kept
+ * Parameters:      Bit_reader *reader: pointer to the reader
+ *                  uint8_t *words: next chunk of encoded words
+ *                  size_t num_words: number of words in the chunk
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_reader_feed(Bit_reader *reader,
+                                                const uint8_t *words,
+                                                size_t num_words)
+{
+    reader->next = words;
+    reader->end = words + num_words * sizeof(uint64_t);
+}
+
+/*
+ * Function:        Bit_reader_refill
+ * Description:     Tops up the window to at least BIT_READER_MIN_BITS bits
+ * Parameters:      Bit_reader *reader: pointer to the reader
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_reader_refill(Bit_reader *reader)
+{
+    if (reader->window_bits >= BIT_READER_MIN_BITS)
+        return;
+    // Append the next 32-bit half below the buffered bits, stepping to
+    // the next word after its low half
+    uint64_t half = 0;
+    if (reader->next < reader->end)
+    {
+        uint64_t word;
+        memcpy(&word, reader->next, sizeof(uint64_t));
+        half = (uint32_t)(word >> (reader->low_half ? 0 : 32));
+        reader->next += reader->low_half ? sizeof(uint64_t) : 0;
+        reader->low_half ^= 1;
+    }
+    reader->window |= half << (32 - reader->window_bits);
+    reader->window_bits += 32;
+}
+
+/*
+ * Function:        Bit_reader_peek
+ * Description:     Gets the next bits without consuming them
+ * Parameters:      Bit_reader *reader: pointer to the reader
+ *                  unsigned bits: number of bits, 1 to the buffered ones
+ * Return:          uint64_t: the bits, in the low bits of the result
+ */
+static inline BITIO_INLINE uint64_t Bit_reader_peek(const Bit_reader *reader,
+                                                    unsigned bits)
+{
+    return reader->window >> (64 - bits);
+}
+
+/*
+ * Function:        Bit_reader_consume
+ * Description:     Drops bits that have been decoded
+ * Parameters:      Bit_reader *reader: pointer to the reader
+ *                  unsigned bits: number of bits, up to the buffered ones
+ * Return:          void
+ */
+static inline BITIO_INLINE void Bit_reader_consume(Bit_reader *reader,
+                                                   unsigned bits)
+{
+    reader->window <<= bits;
+    reader->window_bits -= bits;
+}
+
+#endif
@@ -0,0 +1,365 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: block.h
+*
+*   Description: Header file for block module, which compresses one
+*   block of input in memory with its own canonical code table
+*
+*   Each block is laid out as follows
+*
+*       <RAW_SIZE><MODE><NUM_BITS><NUM_STREAMS><PACKED_CODE_LENGTHS>
+*       [stream_bits_1]...[stream_bits_n-1]<PAYLOAD>
+*
+*   MODE is BLOCK_CODED for a block with codes. Character i of the block
+*   is encoded in stream i % NUM_STREAMS, so that the streams can be
+*   decoded side by side. The payload holds the streams one after the
+*   other, each packed from the top of 64-bit words.
+*   The jump table gives the number of bits of every stream but the last,
+*   which holds the rest of the NUM_BITS encoded bits
+*
+*   A block may have up to BLOCK_MAX_TABLES code tables, each character
+*   being coded with the table of the byte before it. The high 4 bits of
+*   NUM_STREAMS then give the number of tables minus one, and the jump
+*   table is followed by the packed table number of each previous byte
+*   and the packed code lengths of every table but the first
+*
+*       [stream_bits]...<PACKED_CONTEXT_MAP>[packed_code_lengths_2]...
+*
+*   The first character of the block is coded as if it followed a zero
+*
+*   A block may instead code the most frequent byte pairs as symbols of
+*   their own, symbols 0 to 255 standing for bytes and the next ones for
+*   pairs. Bit 1 of NUM_STREAMS, unused by 1, 4 and 8, then flags the
+*   pairs, the high 4 bits give their number of pages of BLOCK_PAIR_PAGE
+*   pairs minus one, and the jump table is followed by the two bytes of
+*   every pair and the packed code lengths of the pairs
+*
+*       [stream_bits]...<PAIRS><PACKED_PAIR_CODE_LENGTHS>
+*
+*   The block is parsed from its first byte, a pair being coded wherever
+*   one starts, and symbol i is encoded in stream i % NUM_STREAMS
+*
+*   A block may instead code runs of a byte, symbols above 255 standing
+*   for the number of times the byte before is repeated. The pairs flag
+*   with the high 4 bits all set, which no number of pages reaches, then
+*   flags runs, and the jump table is followed by the packed code lengths
+*   of the BLOCK_RUN_SYMBOLS run symbols
+*
+*       [stream_bits]...<PACKED_RUN_CODE_LENGTHS>
+*
+*   Run symbol k stands for a run of BLOCK_MIN_RUN - 1 + 2^k + x repeats,
+*   x being given by the k bits that follow its code in the same stream.
+*   Runs never start a block, nor cover its last BLOCK_MAX_STREAMS - 1
+*   bytes
+*
+*   A block may instead code matches, as LZ77 does, symbols above 255
+*   standing for the length of a copy of earlier bytes, with the same
+*   classes as runs. Each length is followed in its stream by the code of
+*   a distance symbol in a table of its own, then by the bits of the
+*   distance. NUM_STREAMS with its low 4 bits clear flags matches, the
+*   high 4 bits giving the number of streams, and the jump table is
+*   followed by the packed code lengths of the length and distance symbols
+*
+*       [stream_bits]...<PACKED_LENGTH_CODE_LENGTHS><PACKED_DISTANCE_CODE_LENGTHS>
+*
+*   Distance symbol k stands for 2^k + x bytes back, x being given by the
+*   k bits after its code. Matches never cover the last
+*   BLOCK_MAX_STREAMS - 1 bytes of a block, and a match of distance 1 is
+*   a run
+*
+*   A block whose codes would take about as many bytes as its characters
+*   is instead stored as it is, and a block of a single repeated byte is
+*   filled with it. Their header is only the raw size and MODE,
+*   BLOCK_STORED or BLOCK_FILLED, followed by the bytes of the block or
+*   the byte repeated
+*
+*       <RAW_SIZE><BLOCK_STORED><BYTES>
+*       <RAW_SIZE><BLOCK_FILLED><FILL_BYTE>
+*
+*   The choice is made from the histogram of the block and the code
+*   lengths built from it, before any bit is packed
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../hanson/include/except.h"
+#include "huffman_tree.h"
+#include "canonical.h"
+#include "stats.h"
+#include "lz77.h"
+
+#ifndef BLOCK_INCLUDED
+#define BLOCK_INCLUDED
+
+/* Size of the raw size and mode starting every block header, which give
+ * the size of the rest */
+#define BLOCK_PREFIX_SIZE (sizeof(uint32_t) + 1)
+
+/* Size of the header of a coded block preceding the jump table, the
+ * largest block header */
+#define BLOCK_HEADER_SIZE (BLOCK_PREFIX_SIZE + sizeof(uint32_t) + 1 + CANONICAL_PACKED_SIZE)
+
+/* Largest and default number of streams per block */
+#define BLOCK_MAX_STREAMS 8
+#define BLOCK_DEFAULT_STREAMS 4
+
+/* Most code tables of a block, chosen by the previous byte. Their codes
+ * are no longer than the root decoding table, so that each character is
+ * decoded with a single lookup in the table of its context */
+#define BLOCK_MAX_TABLES 16
+#define BLOCK_CONTEXT_MAX_CODE_LENGTH DECODING_TABLE_BITS
+
+/* Most symbols of a block with byte pairs, and most pairs among them.
+ * Pairs are listed by pages, the bytes and code lengths of a page taking
+ * BLOCK_PAIR_PAGE_SIZE bytes */
+#define BLOCK_MAX_SYMBOLS CANONICAL_MAX_SYMBOLS
+#define BLOCK_MAX_PAIRS (BLOCK_MAX_SYMBOLS - MAX_NUM_CHAR)
+#define BLOCK_PAIR_PAGE 256
+#define BLOCK_PAIR_PAGE_SIZE (BLOCK_PAIR_PAGE * 2 + BLOCK_PAIR_PAGE / 2)
+
+/* Number of run symbols, enough for runs of 2^32 bytes, and fewest
+ * repeats of a byte coded as a run */
+#define BLOCK_RUN_SYMBOLS 32
+#define BLOCK_MIN_RUN 4
+
+/* Number of distance symbols of matches, whose lengths take the classes
+ * of runs */
+#define BLOCK_DISTANCE_SYMBOLS 32
+#define BLOCK_MIN_MATCH LZ77_MIN_MATCH
+
+/* Size of the largest jump table, with the context map and code tables
+ * or the pairs that follow it */
+#define BLOCK_MAX_JUMP_TABLE_SIZE ((BLOCK_MAX_STREAMS - 1) * sizeof(uint32_t) + \
+    (BLOCK_MAX_TABLES * CANONICAL_PACKED_SIZE > \
+     BLOCK_MAX_PAIRS / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE_SIZE ? \
+     BLOCK_MAX_TABLES * CANONICAL_PACKED_SIZE : \
+     BLOCK_MAX_PAIRS / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE_SIZE))
+
+/* Bytes of workspace used by Block_encode: the counts and lists of the
+ * characters after each byte, the counts and codes of each table, the
+ * symbol of each pair, the counts, lengths and codes of every symbol in
+ * each stream, the same for bytes and runs and for bytes, lengths and
+ * distances of matches, and the package-merge lists */
+#define BLOCK_ENCODE_WORKSPACE_SIZE \
+    (MAX_NUM_CHAR * MAX_NUM_CHAR * (sizeof(uint32_t) + 1 + sizeof(uint16_t)) + \
+     BLOCK_MAX_TABLES * MAX_NUM_CHAR * (sizeof(uint64_t) + sizeof(Encoded_value)) + \
+     BLOCK_MAX_PAIRS * 2 + BLOCK_MAX_STREAMS * BLOCK_MAX_SYMBOLS * sizeof(uint32_t) + \
+     BLOCK_MAX_SYMBOLS * (sizeof(uint64_t) + 1 + sizeof(Encoded_value)) + \
+     BLOCK_MAX_STREAMS * (MAX_NUM_CHAR + BLOCK_RUN_SYMBOLS + 2) * sizeof(uint32_t) + \
+     (MAX_NUM_CHAR + BLOCK_RUN_SYMBOLS) * (sizeof(uint64_t) + 1 + sizeof(Encoded_value)) + \
+     BLOCK_MAX_STREAMS * (MAX_NUM_CHAR + BLOCK_RUN_SYMBOLS + BLOCK_DISTANCE_SYMBOLS + 2) * \
+     sizeof(uint32_t) + (MAX_NUM_CHAR + BLOCK_RUN_SYMBOLS + BLOCK_DISTANCE_SYMBOLS) * \
+     (sizeof(uint64_t) + 1 + sizeof(Encoded_value)) + \
+     CANONICAL_ALPHABET_WORKSPACE_SIZE(BLOCK_MAX_SYMBOLS))
+
+/* Bytes of workspace used by Block_decode: the decoding table of every
+ * code table, or the single table with its sub-tables, of bytes or of
+ * bytes and pairs followed by the bytes of every symbol */
+#define BLOCK_DECODE_WORKSPACE_SIZE \
+    (BLOCK_MAX_TABLES * (1 << DECODING_TABLE_BITS) > \
+     CANONICAL_ALPHABET_DECODING_TABLE_SIZE(BLOCK_MAX_SYMBOLS) ? \
+     BLOCK_MAX_TABLES * (1 << DECODING_TABLE_BITS) * sizeof(Decoded_value) : \
+     CANONICAL_ALPHABET_DECODING_TABLE_SIZE(BLOCK_MAX_SYMBOLS) * sizeof(Decoded_value) + \
+     BLOCK_MAX_SYMBOLS * sizeof(uint32_t))
+
+/* Bytes of workspace used by Block_encode and Block_decode */
+#define BLOCK_WORKSPACE_SIZE \
+    (BLOCK_ENCODE_WORKSPACE_SIZE > BLOCK_DECODE_WORKSPACE_SIZE ? \
+     BLOCK_ENCODE_WORKSPACE_SIZE : BLOCK_DECODE_WORKSPACE_SIZE)
+
+/* Modes of a block, the byte after its raw size: written with codes,
+ * stored as it is, or filled with a single byte */
+#define BLOCK_CODED 0
+#define BLOCK_STORED 1
+#define BLOCK_FILLED 2
+
+/* Raised when a block header or payload cannot be decoded */
+extern const Except_T Block_Corrupted;
+
+/* structure of the options of Block_encode */
+struct Block_options
+{
+    unsigned max_code_length; // maximum length of codes
+    unsigned num_streams;     // 1, 4 or 8 interleaved streams
+    unsigned max_tables;      // most code tables chosen by the previous
+                              // byte, 1 for a single table
+    unsigned max_pairs;       // most byte pairs coded as one symbol, 0 for
+                              // none
+    unsigned runs;            // whether runs of a byte may be coded as one
+                              // symbol
+    unsigned match_level;     // effort of the search for matches, 0 for none
+    unsigned window_bits;     // number of bits of the farthest match
+};
+typedef struct Block_options Block_options;
+
+/* structure of a parsed block header */
+struct Block_header
+{
+    uint32_t raw_size;             // number of bytes the block decodes to
+    uint32_t coding;               // BLOCK_CODED, BLOCK_STORED or BLOCK_FILLED
+    uint32_t header_size;          // number of bytes of the header
+    uint8_t fill_byte;             // byte repeated by a filled block
+    uint32_t num_bits;             // number of encoded bits in payload
+    uint32_t num_streams;          // 1, 4 or 8 interleaved streams
+    uint32_t num_tables;           // number of code tables
+    uint32_t jump_table_size;      // number of bytes of the jump table,
+                                   // context map and extra code tables
+    uint32_t stream_bits[BLOCK_MAX_STREAMS]; // encoded bits of each stream
+    uint32_t payload_size;         // number of encoded bytes after jump table
+    uint8_t context_map[MAX_NUM_CHAR]; // table of each previous byte
+    uint8_t lengths[BLOCK_MAX_TABLES][MAX_NUM_CHAR]; // canonical code length
+                                                     // of each byte per table
+    uint32_t num_pairs;            // number of pair symbols, 0 for none
+    uint8_t pairs[BLOCK_MAX_PAIRS][2]; // bytes of each pair symbol
+    uint8_t pair_lengths[BLOCK_MAX_PAIRS]; // canonical code length of each
+                                           // pair symbol
+    uint32_t num_run_symbols;      // number of run or match length
+                                   // symbols, 0 for none
+    uint8_t run_lengths[BLOCK_RUN_SYMBOLS]; // canonical code length of each
+                                            // run or match length symbol
+    uint32_t num_distance_symbols; // number of distance symbols of matches,
+                                   // 0 for none
+    uint8_t distance_lengths[BLOCK_DISTANCE_SYMBOLS]; // canonical code length
+                                                      // of each distance symbol
+};
+typedef struct Block_header Block_header;
+
+/*
+ * Function:        Block_bound
+ * Description:     Gets the largest possible size of an encoded block
+ * Parameters:      size_t raw_size: number of bytes in the block
+ *                  unsigned max_code_length: maximum length of codes
+ * Return:          size_t: bytes needed for header and payload
+ */
+extern size_t Block_bound(size_t raw_size, unsigned max_code_length);
+
+/*
+ * Function:        Block_default_options
+ * Description:     Gets the options of a block with a single code table
+ * Parameters:      void
+ * Return:          Block_options: longest codes, default number of streams
+ *                  and a single table, without pairs, runs or matches
+ */
+extern Block_options Block_default_options(void);
+
+/*
+ * Function:        Block_workspace_size
+ * Description:     Gets the number of bytes of workspace used by
+ *                  Block_encode: BLOCK_WORKSPACE_SIZE, followed when
+ *                  matches are allowed by room for the matches of the
+ *                  block and the chains of the match finder
+ * Parameters:      uint32_t raw_size: number of bytes in the block
+ *                  Block_options *options: options of the block
+ * Return:          size_t: bytes of workspace
+ */
+extern size_t Block_workspace_size(uint32_t raw_size, const Block_options *options);
+
+/*
+ * Function:        Block_encode
+ * Description:     Counts characters of one block, builds its canonical
+ *                  codes and writes header, jump table and payload to dst.
+ *                  With more than one table allowed, previous bytes whose
+ *                  next characters are alike are clustered to share a
+ *                  table, and several tables are used only if they take
+ *                  fewer bits than a single one, tables included. With
+ *                  pairs allowed, the most frequent byte pairs become
+ *                  symbols of their own when that takes fewer bits than
+ *                  the tables chosen so far, the pairs included. Likewise
+ *                  with runs allowed, for runs of a byte, and with
+ *                  matches allowed, for the matches found by the LZ77
+ *                  module. A block is stored as it is instead when the
+ *                  codes chosen would not make it smaller, and filled
+ *                  with its byte when it has a single one
+ * Parameters:      uint8_t *src: bytes of the block
+ *                  uint32_t raw_size: number of bytes in the block, > 0
+ *                  Block_options *options: maximum length of codes, number
+ *                  of streams, 1, 4 or 8, of tables, 1 to
+ *                  BLOCK_MAX_TABLES, and of pairs, 0 to BLOCK_MAX_PAIRS,
+ *                  whether runs are allowed, and the level, 0 to
+ *                  LZ77_MAX_LEVEL, and window of matches
+ *                  uint8_t *dst: output of at least Block_bound bytes
+ *                  void *workspace: Block_workspace_size bytes aligned like
+ *                  malloc, so that nothing is allocated
+ *                  Stats *stats: updated with timings and codes, or NULL
+ * Return:          size_t: number of bytes written to dst
+ */
+extern size_t Block_encode(const uint8_t *src, uint32_t raw_size,
+                           const Block_options *options, uint8_t *dst,
+                           void *workspace, Stats *stats);
+
+/*
+ * Function:        Block_payload_size
+ * Description:     Gets the number of bytes holding num_bits encoded bits
+ * Parameters:      uint32_t num_bits: number of encoded bits
+ * Return:          uint32_t: size of the payload, a whole number of words
+ */
+extern uint32_t Block_payload_size(uint32_t num_bits);
+
+/*
+ * Function:        Block_header_size
+ * Description:     Gets the size of a block header from the mode in its
+ *                  first BLOCK_PREFIX_SIZE bytes. Raises Block_Corrupted
+ *                  if the mode is unknown
+ * Parameters:      uint8_t *src: BLOCK_PREFIX_SIZE bytes of the header
+ * Return:          size_t: bytes of the header, BLOCK_HEADER_SIZE for a
+ *                  coded block
+ */
+extern size_t Block_header_size(const uint8_t *src);
+
+/*
+ * Function:        Block_read_header
+ * Description:     Parses the Block_header_size bytes of a block header,
+ *                  up to its jump table of header->jump_table_size bytes.
+ *                  Raises Block_Corrupted if the mode is unknown or the
+ *                  sizes are inconsistent
+ * Parameters:      uint8_t *src: bytes of the header
+ *                  Block_header *header: updated after the function is called
+ * Return:          void
+ */
+extern void Block_read_header(const uint8_t *src, Block_header *header);
+
+/*
+ * Function:        Block_read_jump_table
+ * Description:     Parses the jump table following the header and sets the
+ *                  size of every stream, then the context map and code
+ *                  lengths of a block with several tables, the pairs
+ *                  and their code lengths, or the code lengths of runs,
+ *                  or of the lengths and distances of matches. Raises
+ *                  Block_Corrupted if the sizes or tables are inconsistent
+ * Parameters:      uint8_t *src: header->jump_table_size bytes of the table
+ *                  Block_header *header: header parsed by Block_read_header,
+ *                  updated after the function is called
+ * Return:          void
+ */
+extern void Block_read_jump_table(const uint8_t *src, Block_header *header);
+
+/*
+ * Function:        Block_decode
+ * Description:     Decodes the payload of a block, advancing every stream
+ *                  in the same loop, or copies or fills a stored or
+ *                  filled block at once. With several tables, each character
+ *                  is decoded in the table of the one before it. With
+ *                  pairs, each symbol gives one or two bytes. With runs,
+ *                  each run is filled at once, and with matches, each
+ *                  match is copied 8 bytes at a time. Raises
+ *                  Huffman_Invalid_Lengths if the code lengths are
+ *                  corrupted, and Block_Corrupted if pairs, runs or
+ *                  matches go past the end of the block, or a run or
+ *                  match reaches before its start
+ * Parameters:      Block_header *header: parsed header and jump table
+ *                  uint8_t *payload: header->payload_size encoded bytes
+ *                  uint8_t *dst: output of header->raw_size bytes
+ *                  void *workspace: BLOCK_DECODE_WORKSPACE_SIZE bytes aligned
+ *                  like malloc, holding the decoding tables
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          void
+ */
+extern void Block_decode(const Block_header *header, const uint8_t *payload,
+                         uint8_t *dst, void *workspace, Stats *stats);
+
+#endif
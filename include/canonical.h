@@ -0,0 +1,210 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: canonical.h
+*
+*   Description: Header file for canonical Huffman codes module. Code
+*   lengths are computed in linear time with the in-place algorithm of
+*   Moffat and Katajainen, and limited to a maximum with the package-merge
+*   algorithm when they are too long, so only the lengths need to be
+*   stored for the decompressor
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stdint.h>
+#include "huffman_tree.h"
+
+#ifndef CANONICAL_INCLUDED
+#define CANONICAL_INCLUDED
+
+/* Bounds of the configurable maximum code length. Lengths are packed
+ * into 4 bits each, and 8 bits is enough for all 256 characters */
+#define CANONICAL_MIN_CODE_LENGTH 8
+#define CANONICAL_MAX_CODE_LENGTH 15
+
+/* Largest alphabet of the Canonical_alphabet functions, whose symbols
+ * may stand for more than one character */
+#define CANONICAL_MAX_SYMBOLS 4096
+
+/* Size of the packed code lengths in the header */
+#define CANONICAL_PACKED_SIZE (MAX_NUM_CHAR / 2)
+
+/* Bytes of workspace used by Canonical_alphabet_code_lengths: one
+ * package-merge list of up to 2 * num_symbols items of 16 bytes per code
+ * length */
+#define CANONICAL_ALPHABET_WORKSPACE_SIZE(num_symbols) \
+    (CANONICAL_MAX_CODE_LENGTH * 2 * (num_symbols) * 16)
+#define CANONICAL_WORKSPACE_SIZE CANONICAL_ALPHABET_WORKSPACE_SIZE(MAX_NUM_CHAR)
+
+/* Largest number of entries of a decoding table of num_symbols symbols.
+ * Codes longer than the DECODING_TABLE_BITS root table share their root
+ * entry with at least one other code, and need at most 4 more bits */
+#define CANONICAL_ALPHABET_DECODING_TABLE_SIZE(num_symbols) ((1 << DECODING_TABLE_BITS) + \
+        (num_symbols) / 2 * (1 << (CANONICAL_MAX_CODE_LENGTH - DECODING_TABLE_BITS)))
+#define CANONICAL_DECODING_TABLE_SIZE CANONICAL_ALPHABET_DECODING_TABLE_SIZE(MAX_NUM_CHAR)
+
+/*
+ * Function:        Canonical_optimal_lengths
+ * Description:     Computes optimal code lengths without a maximum, as a
+ *                  Huffman tree would, in time linear in the number of
+ *                  characters once they are sorted by frequency. Characters
+ *                  with zero frequency get length 0, and a lone character
+ *                  gets length 1 as in Canonical_code_lengths
+ * Parameters:      uint64_t *freq_array: frequencies of each character
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ * Return:          unsigned: length of the longest code
+ */
+extern unsigned Canonical_optimal_lengths(const uint64_t *freq_array, uint8_t *lengths);
+
+/*
+ * Function:        Canonical_code_lengths
+ * Description:     Computes optimal code lengths no longer than max_length.
+ *                  Lengths are those of Canonical_optimal_lengths when they
+ *                  fit, and are found with the package-merge algorithm
+ *                  otherwise. Characters with zero frequency get length 0.
+ *                  A lone character gets length 1 so that each occurrence
+ *                  still takes one bit
+ * Parameters:      uint64_t *freq_array: frequencies of each character
+ *                  unsigned max_length: maximum code length, between
+ *                  CANONICAL_MIN_CODE_LENGTH and CANONICAL_MAX_CODE_LENGTH
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ *                  void *workspace: CANONICAL_WORKSPACE_SIZE bytes aligned
+ *                  like malloc, or NULL to allocate them
+ * Return:          void
+ */
+extern void Canonical_code_lengths(const uint64_t *freq_array, unsigned max_length,
+                                   uint8_t *lengths, void *workspace);
+
+/*
+ * Function:        Canonical_alphabet_code_lengths
+ * Description:     Computes optimal code lengths no longer than max_length
+ *                  as Canonical_code_lengths does, for an alphabet of
+ *                  num_symbols symbols. At most 2^max_length symbols may
+ *                  have a nonzero frequency
+ * Parameters:      uint64_t *freq_array: frequencies of each symbol
+ *                  unsigned num_symbols: size of the alphabet, between 2
+ *                  and CANONICAL_MAX_SYMBOLS
+ *                  unsigned max_length: maximum code length, between
+ *                  CANONICAL_MIN_CODE_LENGTH and CANONICAL_MAX_CODE_LENGTH
+ *                  uint8_t *lengths: num_symbols code lengths, updated
+ *                  after the function is called
+ *                  void *workspace: CANONICAL_ALPHABET_WORKSPACE_SIZE(
+ *                  num_symbols) bytes aligned like malloc, or NULL to
+ *                  allocate them
+ * Return:          void
+ */
+extern void Canonical_alphabet_code_lengths(const uint64_t *freq_array,
+                                            unsigned num_symbols, unsigned max_length,
+                                            uint8_t *lengths, void *workspace);
+
+/*
+ * Function:        Canonical_codes
+ * Description:     Assigns canonical codes to valid code lengths, in order
+ *                  of length then character, as Huffman_tree_build_canonical
+ *                  does, without building the tree
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, 0 for
+ *                  characters without a code
+ *                  Encoded_value *codes: MAX_NUM_CHAR codes, updated after
+ *                  the function is called
+ * Return:          void
+ */
+extern void Canonical_codes(const uint8_t *lengths, Encoded_value *codes);
+
+/*
+ * Function:        Canonical_alphabet_codes
+ * Description:     Assigns canonical codes to valid code lengths of an
+ *                  alphabet, in order of length then symbol
+ * Parameters:      uint8_t *lengths: num_symbols code lengths, 0 for
+ *                  symbols without a code
+ *                  unsigned num_symbols: size of the alphabet, at most
+ *                  CANONICAL_MAX_SYMBOLS
+ *                  Encoded_value *codes: num_symbols codes, updated after
+ *                  the function is called
+ * Return:          void
+ */
+extern void Canonical_alphabet_codes(const uint8_t *lengths, unsigned num_symbols,
+                                     Encoded_value *codes);
+
+/*
+ * Function:        Canonical_decoding_table
+ * Description:     Builds the decoding table of canonical codes straight
+ *                  from their lengths, with the layout of
+ *                  Huffman_tree_create_decoding_table. Raises
+ *                  Huffman_Invalid_Lengths if the lengths do not form a
+ *                  complete prefix code
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, at most
+ *                  CANONICAL_MAX_CODE_LENGTH
+ *                  Decoded_value *table: CANONICAL_DECODING_TABLE_SIZE
+ *                  entries, updated after the function is called
+ *                  unsigned *root_bits: updated with the root table width
+ * Return:          void
+ */
+extern void Canonical_decoding_table(const uint8_t *lengths, Decoded_value *table,
+                                     unsigned *root_bits);
+
+/*
+ * Function:        Canonical_alphabet_decoding_table
+ * Description:     Builds the decoding table of the canonical codes of an
+ *                  alphabet as Canonical_decoding_table does, the symbol
+ *                  of each entry being an index in the alphabet. Raises
+ *                  Huffman_Invalid_Lengths if the lengths do not form a
+ *                  complete prefix code
+ * Parameters:      uint8_t *lengths: num_symbols code lengths, at most
+ *                  CANONICAL_MAX_CODE_LENGTH
+ *                  unsigned num_symbols: size of the alphabet, at most
+ *                  CANONICAL_MAX_SYMBOLS
+ *                  Decoded_value *table: CANONICAL_ALPHABET_DECODING_TABLE_SIZE(
+ *                  num_symbols) entries, updated after the function is called
+ *                  unsigned *root_bits: updated with the root table width
+ * Return:          void
+ */
+extern void Canonical_alphabet_decoding_table(const uint8_t *lengths, unsigned num_symbols,
+                                              Decoded_value *table, unsigned *root_bits);
+
+/*
+ * Function:        Canonical_pack_lengths
+ * Description:     Packs MAX_NUM_CHAR code lengths into 4 bits each
+ * Parameters:      uint8_t *lengths: code lengths of each character
+ *                  uint8_t *packed: CANONICAL_PACKED_SIZE bytes output
+ * Return:          void
+ */
+extern void Canonical_pack_lengths(const uint8_t *lengths, uint8_t *packed);
+
+/*
+ * Function:        Canonical_unpack_lengths
+ * Description:     Unpacks code lengths packed by Canonical_pack_lengths
+ * Parameters:      uint8_t *packed: CANONICAL_PACKED_SIZE bytes input
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths output
+ * Return:          void
+ */
+extern void Canonical_unpack_lengths(const uint8_t *packed, uint8_t *lengths);
+
+/*
+ * Function:        Canonical_alphabet_pack_lengths
+ * Description:     Packs the code lengths of an alphabet into 4 bits each
+ * Parameters:      uint8_t *lengths: code lengths of each symbol
+ *                  unsigned num_symbols: size of the alphabet, even
+ *                  uint8_t *packed: num_symbols / 2 bytes output
+ * Return:          void
+ */
+extern void Canonical_alphabet_pack_lengths(const uint8_t *lengths, unsigned num_symbols,
+                                            uint8_t *packed);
+
+/*
+ * Function:        Canonical_alphabet_unpack_lengths
+ * Description:     Unpacks code lengths packed by
+ *                  Canonical_alphabet_pack_lengths
+ * Parameters:      uint8_t *packed: num_symbols / 2 bytes input
+ *                  unsigned num_symbols: size of the alphabet, even
+ *                  uint8_t *lengths: num_symbols code lengths output
+ * Return:          void
+ */
+extern void Canonical_alphabet_unpack_lengths(const uint8_t *packed, unsigned num_symbols,
+                                              uint8_t *lengths);
+
+#endif
@@ -0,0 +1,46 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: crc32c.h
+*
+*   Description: Header file for CRC32C module, which computes the
+*   Castagnoli CRC of a buffer, as used by iSCSI and ext4, to check
+*   decompressed blocks. The SSE4.2 instruction computes it over three
+*   interleaved parts of the buffer, whose CRCs are then combined, and
+*   other processors look up 8 bytes at a time in 8 tables
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CRC32C_INCLUDED
+#define CRC32C_INCLUDED
+
+/*
+ * Function:        Crc32c_update
+ * Description:     Extends the CRC32C of the bytes before src with the
+ *                  bytes of src, using the SSE4.2 instruction when the
+ *                  processor supports it
+ * Parameters:      uint32_t crc: CRC32C of the bytes before, 0 for none
+ *                  uint8_t *src: bytes to add
+ *                  size_t size: number of bytes in src
+ * Return:          uint32_t: CRC32C of the bytes before followed by src
+ */
+extern uint32_t Crc32c_update(uint32_t crc, const uint8_t *src, size_t size);
+
+/*
+ * Function:        Crc32c_update_portable
+ * Description:     Same as Crc32c_update, without processor-specific
+ *                  instructions
+ * Parameters:      uint32_t crc: CRC32C of the bytes before, 0 for none
+ *                  uint8_t *src: bytes to add
+ *                  size_t size: number of bytes in src
+ * Return:          uint32_t: CRC32C of the bytes before followed by src
+ */
+extern uint32_t Crc32c_update_portable(uint32_t crc, const uint8_t *src, size_t size);
+
+#endif
@@ -0,0 +1,176 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: frame.h
+*
+*   Description: Header file for frame module, which streams a file
+*   through the block module in a single pass, so input and output
+*   can be pipes. Compressed files are laid out as follows
+*
+*       <FRAME_MAGIC><BLOCK_SIZE>[block_1]...[block_n]<END_MARKER>
+*       [index_entry_1]...[index_entry_n]<NUM_BLOCKS><FRAME_INDEX_MAGIC>
+*
+*   where END_MARKER is a zero raw size in place of a block header. The
+*   block index lets seekable files be decoded in parallel, or only in
+*   the blocks covering a range of bytes, while a stream reader can stop
+*   at the end marker. When BLOCK_SIZE carries
+*   FRAME_CHECKSUMS_FLAG, each block is followed by the CRC32C of the
+*   bytes it decodes to, counted in the size of its index entry
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../hanson/include/except.h"
+#include "stats.h"
+
+#ifndef FRAME_INCLUDED
+#define FRAME_INCLUDED
+
+/* Magic bytes at the top of block-framed files */
+#define FRAME_MAGIC "HUFB"
+#define FRAME_MAGIC_SIZE 4
+
+/* Magic bytes closing the block index at the end of the file */
+#define FRAME_INDEX_MAGIC "HUFX"
+#define FRAME_FOOTER_SIZE (sizeof(uint64_t) + FRAME_MAGIC_SIZE)
+
+/* Bounds and default of the number of input bytes per block */
+#define FRAME_MIN_BLOCK_SIZE (1 << 10)
+#define FRAME_MAX_BLOCK_SIZE (1 << 26)
+#define FRAME_DEFAULT_BLOCK_SIZE (1 << 20)
+
+/* Set in BLOCK_SIZE when blocks are followed by checksums */
+#define FRAME_CHECKSUMS_FLAG 0x80000000u
+#define FRAME_CHECKSUM_SIZE sizeof(uint32_t)
+
+/* Raised when decoded blocks cannot be written at their offsets */
+extern const Except_T Frame_Write_Failed;
+
+/* Raised when a decoded block does not match its checksum */
+extern const Except_T Frame_Checksum_Failed;
+
+/* Raised when a range is asked of a compressed file without block index */
+extern const Except_T Frame_No_Index;
+
+/* structure of an entry of the block index */
+struct Frame_index_entry
+{
+    uint64_t offset;     // position of the block header in compressed file
+    uint64_t raw_offset; // position of the decoded block in decompressed file
+    uint32_t raw_size;   // number of bytes the block decodes to
+    uint32_t size;       // number of bytes of the encoded block and of
+                         // its checksum
+};
+typedef struct Frame_index_entry Frame_index_entry;
+
+/* structure of the options of Frame_compress */
+struct Frame_options
+{
+    uint32_t block_size;      // number of input bytes per block
+    unsigned max_code_length; // maximum length of codes
+    unsigned num_streams;     // number of interleaved streams per block
+    unsigned max_tables;      // most code tables per block, chosen by the
+                              // previous byte
+    unsigned max_pairs;       // most byte pairs per block coded as one
+                              // symbol, 0 for none
+    unsigned runs;            // whether runs of a byte may be coded as one
+                              // symbol, in the blocks where they pay off
+    unsigned match_level;     // effort of the search for matches of earlier
+                              // bytes, 0 for none
+    unsigned window_bits;     // number of bits of the farthest match
+    unsigned checksums;       // whether blocks are followed by the CRC32C
+                              // of their bytes
+    unsigned num_threads;     // number of encoding threads
+    Stats *stats;             // updated with timings and codes, or NULL
+};
+typedef struct Frame_options Frame_options;
+
+/*
+ * Function:        Frame_default_options
+ * Description:     Gets the options used when none is given
+ * Parameters:      void
+ * Return:          Frame_options: default block size, code length and
+ *                  number of streams, with a single code table per block,
+ *                  checksums, a single thread and no stats
+ */
+extern Frame_options Frame_default_options(void);
+
+/*
+ * Function:        Frame_compress
+ * Description:     Reads infile block by block until end of file and
+ *                  writes each block with its own code table to outfile.
+ *                  Blocks are encoded in batches of num_threads blocks on
+ *                  a thread pool, while the next batch is read and the
+ *                  previous one written in order. Output does not depend
+ *                  on the number of threads. Regular input files are
+ *                  mapped and encoded in place
+ * Parameters:      FILE *infile: pointer to the input file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Frame_options *options: block size, maximum length of
+ *                  codes, number of streams and of encoding threads
+ * Return:          void
+ */
+extern void Frame_compress(FILE *infile, FILE *outfile, const Frame_options *options);
+
+/*
+ * Function:        Frame_read_index
+ * Description:     Reads the block index from the end of a seekable
+ *                  compressed file. Raises Block_Corrupted if the index is
+ *                  inconsistent with the file
+ * Parameters:      FILE *infile: pointer to the compressed file
+ *                  uint64_t *num_blocks: updated with the number of blocks
+ * Return:          Array of num_blocks entries to be freed by the caller,
+ *                  or NULL if infile cannot seek or has no index
+ */
+extern Frame_index_entry *Frame_read_index(FILE *infile, uint64_t *num_blocks);
+
+/*
+ * Function:        Frame_decompress
+ * Description:     Decodes blocks and writes them to outfile. infile must
+ *                  be positioned right after FRAME_MAGIC. With more than
+ *                  one thread or a regular infile, blocks located through
+ *                  the index are decoded in parallel, in place when the
+ *                  files can be mapped, so that a single thread also
+ *                  decodes regular files through the index. Other inputs,
+ *                  such as pipes, are streamed up to the end marker.
+ *                  Raises Block_Corrupted on malformed or truncated input,
+ *                  and Frame_Checksum_Failed when verifying a block that
+ *                  does not match its checksum
+ * Parameters:      FILE *infile: pointer to the compressed file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  unsigned num_threads: number of decoding threads
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums, when the file has them
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          void
+ */
+extern void Frame_decompress(FILE *infile, FILE *outfile, unsigned num_threads,
+                             int verify, Stats *stats);
+
+/*
+ * Function:        Frame_decompress_range
+ * Description:     Writes to outfile the decompressed bytes from offset to
+ *                  offset + length, clipped to the end of the decompressed
+ *                  file. Only the blocks covering them are read and
+ *                  decoded, found through the block index, so that the
+ *                  block size sets the granularity of access. infile must
+ *                  be seekable and positioned right after FRAME_MAGIC.
+ *                  Raises Frame_No_Index if it has no block index, and
+ *                  the exceptions of Frame_decompress
+ * Parameters:      FILE *infile: pointer to the compressed file
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  uint64_t offset: position of the first byte to write
+ *                  uint64_t length: number of bytes to write
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums, when the file has them
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          uint64_t: number of bytes written
+ */
+extern uint64_t Frame_decompress_range(FILE *infile, FILE *outfile, uint64_t offset,
+                                       uint64_t length, int verify, Stats *stats);
+
+#endif
@@ -0,0 +1,51 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: histogram.h
+*
+*   Description: Header file for histogram module, which counts the
+*   occurrences of every byte of a buffer. Bytes are spread over several
+*   interleaved sub-histograms, so that runs of the same byte do not wait
+*   on the counter they just incremented, then the sub-histograms are
+*   merged into 64-bit counts
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HISTOGRAM_INCLUDED
+#define HISTOGRAM_INCLUDED
+
+/* Number of counts in a histogram, one per byte value */
+#define HISTOGRAM_SIZE 256
+
+/*
+ * Function:        Histogram_count
+ * Description:     Adds the occurrences of each byte of src to counts,
+ *                  using the AVX2 kernel when the processor supports it
+ * Parameters:      uint8_t *src: bytes to count
+ *                  size_t size: number of bytes in src
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts, updated after
+ *                  the function is called
+ * Return:          void
+ */
+extern void Histogram_count(const uint8_t *src, size_t size, uint64_t *counts);
+
+/*
+ * Function:        Histogram_count_portable
+ * Description:     Same as Histogram_count, without processor-specific
+ *                  instructions
+ * Parameters:      uint8_t *src: bytes to count
+ *                  size_t size: number of bytes in src
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts, updated after
+ *                  the function is called
+ * Return:          void
+ */
+extern void Histogram_count_portable(const uint8_t *src, size_t size,
+                                     uint64_t *counts);
+
+#endif
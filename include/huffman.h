@@ -0,0 +1,95 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: huffman.h
+*
+*   Description: Header file for huffman module, the library interface
+*   that compresses and decompresses buffers in memory, without files.
+*   Nothing is allocated: the tables of each block are built in a
+*   workspace given by the caller, which may be reused across calls but
+*   not shared between threads at the same time
+*
+*   Buffers of at most FRAME_DEFAULT_BLOCK_SIZE bytes are written as a
+*   single block, without block size, end marker or index, and the empty
+*   buffer as a zero raw size
+*
+*       <HUFFMAN_SINGLE_MAGIC>[block]
+*       <HUFFMAN_SINGLE_MAGIC><0>
+*
+*   so that incompressible ones, stored as they are, grow by the magic and
+*   the header of a stored block only. Larger buffers use the
+*   block-framed layout of the frame module without the block index
+*
+*       <FRAME_MAGIC><BLOCK_SIZE>[block_1]...[block_n]<END_MARKER>
+*
+*   so that they can also be decompressed by `huffman -d`
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include "../hanson/include/except.h"
+#include "block.h"
+
+#ifndef HUFFMAN_INCLUDED
+#define HUFFMAN_INCLUDED
+
+/* Magic number of a buffer compressed as a single block */
+#define HUFFMAN_SINGLE_MAGIC "HUFS"
+#define HUFFMAN_SINGLE_MAGIC_SIZE 4
+
+/* Bytes of workspace needed by Huffman_compress, and by
+ * Huffman_decompress, which only builds decoding tables */
+#define HUFFMAN_COMPRESS_WORKSPACE_SIZE BLOCK_WORKSPACE_SIZE
+#define HUFFMAN_DECOMPRESS_WORKSPACE_SIZE BLOCK_DECODE_WORKSPACE_SIZE
+
+/* Raised when the output buffer cannot hold the result */
+extern const Except_T Huffman_Output_Too_Small;
+
+/*
+ * Function:        Huffman_compress_bound
+ * Description:     Gets the largest possible size of a compressed buffer
+ * Parameters:      size_t src_size: number of bytes to compress
+ * Return:          size_t: capacity of dst that always suffices
+ */
+extern size_t Huffman_compress_bound(size_t src_size);
+
+/*
+ * Function:        Huffman_compress
+ * Description:     Compresses src into dst, as a single block if it fits
+ *                  in one, or else one block of FRAME_DEFAULT_BLOCK_SIZE
+ *                  bytes at a time. Raises Huffman_Output_Too_Small if dst
+ *                  may not hold the next block, which never happens with
+ *                  a capacity of Huffman_compress_bound(src_size)
+ * Parameters:      void *src: bytes to compress
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ *                  void *workspace: HUFFMAN_COMPRESS_WORKSPACE_SIZE bytes
+ *                  aligned like malloc
+ * Return:          size_t: number of bytes written to dst
+ */
+extern size_t Huffman_compress(const void *src, size_t src_size, void *dst,
+                               size_t dst_capacity, void *workspace);
+
+/*
+ * Function:        Huffman_decompress
+ * Description:     Decompresses a buffer made by Huffman_compress or
+ *                  `huffman`. Raises Block_Corrupted on malformed or
+ *                  truncated input, or blocks that do not match their
+ *                  checksums, and Huffman_Output_Too_Small if dst cannot
+ *                  hold the decoded bytes
+ * Parameters:      void *src: compressed bytes
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ *                  void *workspace: HUFFMAN_DECOMPRESS_WORKSPACE_SIZE
+ *                  bytes aligned like malloc
+ * Return:          size_t: number of bytes written to dst
+ */
+extern size_t Huffman_decompress(const void *src, size_t src_size, void *dst,
+                                 size_t dst_capacity, void *workspace);
+
+#endif
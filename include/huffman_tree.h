@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include "../hanson/include/array.h"
+#include "../hanson/include/except.h"
 
 #ifndef HUFFMAN_TREE_INCLUDED
 #define HUFFMAN_TREE_INCLUDED
@@ -22,17 +23,29 @@
 
 #define MAX_NUM_CHAR 256
 
-/* structure of a Huffman Node */
+/* Width of the root decoding table and of each chained sub-table */
+#define DECODING_TABLE_BITS 11
+#define DECODING_SUBTABLE_BITS 8
+
+/* Most nodes a tree of MAX_NUM_CHAR leaves may have */
+#define HUFFMAN_TREE_MAX_NODES (2 * MAX_NUM_CHAR - 1)
+
+/* structure of a Huffman Node. Nodes of a tree are stored in one array,
+ * root first, and children are known by their index in that array. The
+ * root is never a child, so leaves have both indices set to 0 */
 typedef struct Huffman_node Huffman_node;
 struct Huffman_node
 {
-    int frequency;
+    uint64_t frequency;
+    uint16_t left_node;
+    uint16_t right_node;
     char key;
-    Huffman_node *left_node;
-    Huffman_node *right_node;
 };
 typedef struct T *T;
 
+/* Raised when code lengths do not describe a complete prefix code */
+extern const Except_T Huffman_Invalid_Lengths;
+
 /* structure of the encoded value in encoding table */
 struct Encoded_value
 {
@@ -41,6 +54,17 @@ struct Encoded_value
 };
 typedef struct Encoded_value Encoded_value;
 
+/* structure of an entry in the decoding table. An entry either decodes a
+ * character, or links to a sub-table indexed by the next bits of the code */
+struct Decoded_value
+{
+    uint32_t subtable;     // offset of the linked sub-table in the table
+    uint16_t symbol;       // decoded character (leaf entries)
+    uint8_t bit_length;    // number of bits consumed at this level
+    uint8_t subtable_bits; // index width of linked sub-table, 0 for leaves
+};
+typedef struct Decoded_value Decoded_value;
+
 /*
  * Function:        Huffman_tree_new
  * Description:     Allocates space for data structure
@@ -57,15 +81,55 @@ extern T Huffman_tree_new();
  */
 extern void Huffman_tree_free(T *huffman_tree);
 
+/*
+ * Function:        Huffman_tree_clear
+ * Description:     Removes every node and leaf of the tree, so that the
+ *                  tree can be built again. Tables are kept for the next
+ *                  call creating them
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ * Return:          void
+ */
+extern void Huffman_tree_clear(T huffman_tree);
+
+/*
+ * Function:        Huffman_tree_new_leaf
+ * Description:     Adds a leaf to the tree, to be put in the entries
+ *                  given to Huffman_tree_build. A tree holds at most
+ *                  MAX_NUM_CHAR leaves until it is cleared, and the leaf
+ *                  is released with the tree
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  char key: character of the leaf
+ *                  uint64_t frequency: frequency of the character
+ * Return:          Pointer to struct `Huffman_node`
+ */
+extern Huffman_node *Huffman_tree_new_leaf(T huffman_tree, char key, uint64_t frequency);
+
 /*
  * Function:        Huffman_tree_build
- * Description:     Builds huffman tree given the array of node entries
+ * Description:     Builds huffman tree given the array of node entries,
+ *                  staging its nodes in space kept by the tree, so that
+ *                  building it again allocates nothing
  * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
- *                  Array_T entries: All node entries (char and frequency)
+ *                  Array_T entries: All node entries (char and frequency),
+ *                  whose leaves come from Huffman_tree_new_leaf
  * Return:          void     
  */
 extern void Huffman_tree_build(T huffman_tree, Array_T entries);
 
+/*
+ * Function:        Huffman_tree_build_canonical
+ * Description:     Builds the canonical Huffman tree for the given code
+ *                  lengths. Codes are assigned in order of length, then
+ *                  character, so the lengths alone describe the tree.
+ *                  Raises Huffman_Invalid_Lengths if the lengths do not
+ *                  form a complete prefix code
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, 0 for
+ *                  characters without a code
+ * Return:          void
+ */
+extern void Huffman_tree_build_canonical(T huffman_tree, const uint8_t *lengths);
+
 /*
  * Function:        Huffman_tree_create_encoding_table
  * Description:     Builds a dictionary with fle characters as key and binary
@@ -75,9 +139,27 @@ extern void Huffman_tree_build(T huffman_tree, Array_T entries);
  */
 extern Array_T Huffman_tree_create_encoding_table(T huffman_tree);
 
+/*
+ * Function:        Huffman_tree_create_decoding_table
+ * Description:     Builds a lookup table that decodes up to
+ *                  DECODING_TABLE_BITS bits of the encoded stream in one
+ *                  step. Longer codes continue through chained sub-tables
+ *                  of up to DECODING_SUBTABLE_BITS bits each. The table is
+ *                  owned by the tree and freed along with it.
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  unsigned *root_bits: updated with the index width of the
+ *                  root table (1 if the tree is a single leaf, whose
+ *                  character then takes one bit)
+ * Return           Pointer to the root table of `Decoded_value` entries
+ */
+extern Decoded_value *Huffman_tree_create_decoding_table(T huffman_tree,
+                                                         unsigned *root_bits);
+
 /*
  * Function:        Huffman_tree_get_root
- * Description:     Returns the root of Huffman Tree
+ * Description:     Returns the root of Huffman Tree, which is the first of
+ *                  its nodes in breadth-first order. Children of any node
+ *                  are found at their index from the root
  * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
  * Return           Pointer to struct `Huffman_node`
  */
@@ -0,0 +1,91 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: lz77.h
+*
+*   Description: Header file for LZ77 module, which finds repeated
+*   strings of a buffer as matches of earlier bytes, for the block module
+*   to code them with their length and distance
+*
+*   Positions are chained by the hash of their first LZ77_MIN_MATCH
+*   bytes, the most recent first, within a window of the last
+*   2^window_bits bytes. The level sets how many positions of a chain are
+*   compared before taking the longest match, and from LZ77_LAZY_LEVEL
+*   up, whether the match at the next position is looked at before
+*   taking one, as deflate does
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LZ77_INCLUDED
+#define LZ77_INCLUDED
+
+/* Fewest bytes of a match */
+#define LZ77_MIN_MATCH 4
+
+/* Bounds and default of the number of bits of the farthest distance */
+#define LZ77_MIN_WINDOW_BITS 10
+#define LZ77_MAX_WINDOW_BITS 24
+#define LZ77_DEFAULT_WINDOW_BITS 20
+
+/* Bounds and default of the effort level, and first level looking at the
+ * match at the next position before taking one */
+#define LZ77_MIN_LEVEL 1
+#define LZ77_MAX_LEVEL 9
+#define LZ77_DEFAULT_LEVEL 6
+#define LZ77_LAZY_LEVEL 4
+
+/* Most matches found in size bytes */
+#define LZ77_MAX_MATCHES(size) ((size) / LZ77_MIN_MATCH + 1)
+
+/* structure of a match: length bytes at position repeat the bytes at
+ * position - distance */
+struct Lz77_match
+{
+    uint32_t position;
+    uint32_t length;
+    uint32_t distance;
+};
+typedef struct Lz77_match Lz77_match;
+
+/*
+ * Function:        Lz77_workspace_size
+ * Description:     Gets the number of bytes of workspace used to find the
+ *                  matches of a buffer: the head of each hash chain and
+ *                  the next position of each position of the window
+ * Parameters:      uint32_t size: number of bytes in the buffer
+ *                  unsigned window_bits: number of bits of the farthest
+ *                  distance
+ * Return:          size_t: bytes of workspace
+ */
+extern size_t Lz77_workspace_size(uint32_t size, unsigned window_bits);
+
+/*
+ * Function:        Lz77_find_matches
+ * Description:     Parses src from its first byte into bytes and matches
+ *                  of at least LZ77_MIN_MATCH bytes, ending at most at end,
+ *                  and at most 2^window_bits - 1 bytes away. Bytes from
+ *                  end to size may still be repeated by matches ending
+ *                  before end
+ * Parameters:      uint8_t *src: bytes to parse
+ *                  uint32_t size: number of bytes in src
+ *                  uint32_t end: most bytes covered by matches, <= size
+ *                  unsigned level: effort, LZ77_MIN_LEVEL to LZ77_MAX_LEVEL
+ *                  unsigned window_bits: LZ77_MIN_WINDOW_BITS to
+ *                  LZ77_MAX_WINDOW_BITS
+ *                  Lz77_match *matches: room for LZ77_MAX_MATCHES(end)
+ *                  matches, updated after the function is called
+ *                  void *workspace: Lz77_workspace_size bytes aligned like
+ *                  malloc, so that nothing is allocated
+ * Return:          uint32_t: number of matches, in order of position
+ */
+extern uint32_t Lz77_find_matches(const uint8_t *src, uint32_t size, uint32_t end,
+                                  unsigned level, unsigned window_bits,
+                                  Lz77_match *matches, void *workspace);
+
+#endif
@@ -0,0 +1,74 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: mapped_file.h
+*
+*   Description: Header file for implementation of memory-mapped files,
+*   which let blocks be encoded and decoded in place instead of being
+*   copied through stdio buffers. Only regular files can be mapped,
+*   callers fall back to reading and writing streams otherwise
+*
+*   See comments on top of each function to understand the interface
+*   of implemented data structure
+*
+****************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef MAPPED_FILE_INCLUDED
+#define MAPPED_FILE_INCLUDED
+#define T Mapped_File_T
+
+typedef struct T *T;
+
+/*
+ * Function:        Mapped_file_open
+ * Description:     Maps the whole of a regular file for sequential reading
+ * Parameters:      FILE *file: pointer to the file to map
+ * Return:          Pointer to newly created mapping, or NULL if file is
+ *                  empty, is not a regular file or cannot be mapped
+ */
+extern T Mapped_file_open(FILE *file);
+
+/*
+ * Function:        Mapped_file_create
+ * Description:     Preallocates a regular file opened for both reading and
+ *                  writing to size bytes and maps it for writing
+ * Parameters:      FILE *file: pointer to the file to map
+ *                  uint64_t size: size of the file once written, > 0
+ * Return:          Pointer to newly created mapping, or NULL if file
+ *                  cannot be resized or mapped, or if its blocks cannot be
+ *                  reserved on a file system that supports it
+ */
+extern T Mapped_file_create(FILE *file, uint64_t size);
+
+/*
+ * Function:        Mapped_file_data
+ * Description:     Gets the mapped bytes, which are read-only for files
+ *                  mapped with Mapped_file_open
+ * Parameters:      T mapped_file: pointer to struct `Mapped_File_T`
+ * Return:          uint8_t *: first byte of the file
+ */
+extern uint8_t *Mapped_file_data(T mapped_file);
+
+/*
+ * Function:        Mapped_file_size
+ * Description:     Gets the number of mapped bytes
+ * Parameters:      T mapped_file: pointer to struct `Mapped_File_T`
+ * Return:          uint64_t: size of the file
+ */
+extern uint64_t Mapped_file_size(T mapped_file);
+
+/*
+ * Function:        Mapped_file_free
+ * Description:     Unmaps the file and deallocates the mapping. Written
+ *                  bytes are kept in the file
+ * Parameters:      T *mapped_file: double pointer to struct `Mapped_File_T`
+ * Return:          void
+ */
+extern void Mapped_file_free(T *mapped_file);
+
+#undef T
+#endif
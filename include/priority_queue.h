@@ -24,12 +24,15 @@
 struct Node
 {
     void *obj; // void pointer to the object the node contains
-    int value; // value of priority queue indexing
+    uint64_t value; // value of priority queue indexing
 };
 typedef struct Node Node;
 
 typedef struct T *T;
 
+/* Widest node of a d-ary heap */
+#define PRIORITY_QUEUE_MAX_ARITY 8
+
 /*
  * Function:        Priority_queue_new
  * Description:     Allocates heap data structures for usage
@@ -43,6 +46,19 @@ typedef struct T *T;
  */
 extern T Priority_queue_new(int type);
 
+/*
+ * Function:        Priority_queue_new_d_ary
+ * Description:     Allocates a heap whose nodes have arity children
+ *                  instead of 2. Wider nodes make the heap shallower, so
+ *                  that popping compares more children per level but
+ *                  moves through fewer levels
+ * Parameters:      int type: 0 for min-heap, 1 for max-heap
+ *                  int arity: number of children of each node, between
+ *                  2 and PRIORITY_QUEUE_MAX_ARITY
+ * Return:          Pointer to created priority queue
+ */
+extern T Priority_queue_new_d_ary(int type, int arity);
+
 /*
  * Function:        Priority_queue_free
  * Description:     Deallocates heap data structure after done using
@@ -52,9 +68,29 @@ extern T Priority_queue_new(int type);
  */
 extern void Priority_queue_free(T *priority_queue);
 
+/*
+ * Function:        Priority_queue_reserve
+ * Description:     Makes room for capacity nodes, so that inserting up to
+ *                  that many nodes allocates nothing
+ * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
+ *                  int capacity: number of nodes the queue may hold
+ * Return:          void
+ */
+extern void Priority_queue_reserve(T priority_queue, int capacity);
+
+/*
+ * Function:        Priority_queue_clear
+ * Description:     Removes every node, keeping the memory of the queue
+ *                  for the next nodes
+ * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
+ * Return:          void
+ */
+extern void Priority_queue_clear(T priority_queue);
+
 /*
  * Function:        Priority_queue_build
- * Description:     Build heap given queue and entries array
+ * Description:     Build heap given queue and entries array. Nodes already
+ *                  in the queue are replaced
  * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
  *                  Array_T entries: All entries in the heap
  * Return:          void     
@@ -71,14 +107,15 @@ extern int Priority_queue_size(T priority_queue);
 
 /*
  * Function:        Priority_queue_insert
- * Description:     Inserts object to heap data structure
+ * Description:     Inserts object to heap data structure. The queue grows
+ *                  by doubling when it is full
  * Parameters:      *   T priority_queue: pointer to struct `Priority_Queue_T`
  *                  *   void pointer: Object inserted
- *                  *   int value: value associated to the object for heapifying
+ *                  *   uint64_t value: value associated to the object for heapifying
  *                  
  * Return:          void
  */
-extern void Priority_queue_insert(T priority_queue, void *item, unsigned int value);
+extern void Priority_queue_insert(T priority_queue, void *item, uint64_t value);
 
 /*
  * Function:        Priority_queue_top
@@ -93,6 +130,7 @@ extern void *Priority_queue_top(T priority_queue);
  * Function:        Priority_queue_pop
  * Description:     Pops the node with maximum or minimum value depending on
  *                  type of heap. If priority queue is empty, raise Exception.
+ *                  The node stays valid until the next insertion
  * Parameters:      *   T priority_queue: pointer to struct `Priority_Queue_T`  
  *                  
  * Return:          void pointer: max/min node in the queue
@@ -0,0 +1,135 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: stats.h
+*
+*   Description: Header file for stats module, which collects the time
+*   spent in each phase of compression and decompression, the bytes
+*   read and written, and how close the codes come to the entropy of
+*   the input. Every function accepts a NULL Stats pointer and then does
+*   nothing, so that instrumented code costs a test when stats are off
+*
+*   Phase times of blocks coded on several threads are summed, so that
+*   they may add up to more than the wall-clock time
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include "histogram.h"
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+/* Phases timed separately */
+typedef enum Stats_phase
+{
+    STATS_READ,          // reading input, or mapping it in
+    STATS_COUNT,         // counting characters
+    STATS_CODE_LENGTHS,  // computing length-limited code lengths
+    STATS_TABLES,        // building encoding or decoding tables
+    STATS_ENCODE,        // packing codes into streams
+    STATS_DECODE,        // decoding streams
+    STATS_CHECKSUM,      // computing checksums of blocks
+    STATS_WRITE,         // writing output
+    STATS_NUM_PHASES
+} Stats_phase;
+
+/* structure of the statistics of one run */
+struct Stats
+{
+    double phase_seconds[STATS_NUM_PHASES];
+    double total_seconds;             // wall-clock time of the whole run
+    uint64_t bytes_in;                // bytes of the input file
+    uint64_t bytes_out;               // bytes of the output file
+    uint64_t num_blocks;              // number of blocks coded
+    uint64_t counts[HISTOGRAM_SIZE];  // characters of the whole input
+    double block_entropy_bits;        // sum of the entropy of each block
+    uint64_t code_bits;               // bits of all codes written
+    uint64_t num_words;               // 64-bit words flushed by bit writers
+    unsigned max_code_length;         // longest code used by any block
+};
+typedef struct Stats Stats;
+
+/*
+ * Function:        Stats_init
+ * Description:     Resets every statistic to zero
+ * Parameters:      Stats *stats: statistics to reset
+ * Return:          void
+ */
+extern void Stats_init(Stats *stats);
+
+/*
+ * Function:        Stats_start
+ * Description:     Reads the monotonic clock, to start timing a phase
+ * Parameters:      Stats *stats: statistics, or NULL
+ * Return:          double: current time in seconds, 0 if stats is NULL
+ */
+extern double Stats_start(const Stats *stats);
+
+/*
+ * Function:        Stats_lap
+ * Description:     Adds the time since start to a phase
+ * Parameters:      Stats *stats: statistics, or NULL
+ *                  Stats_phase phase: phase that just ended
+ *                  double start: time the phase started, from Stats_start
+ *                  or the previous Stats_lap
+ * Return:          double: current time, to start timing the next phase
+ */
+extern double Stats_lap(Stats *stats, Stats_phase phase, double start);
+
+/*
+ * Function:        Stats_add_block
+ * Description:     Records the characters of a coded block and the codes
+ *                  that encode them
+ * Parameters:      Stats *stats: statistics, or NULL
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts of the block
+ *                  uint64_t code_bits: bits of the codes of every character
+ *                  unsigned max_code_length: longest code of the block
+ *                  uint64_t num_words: number of words of the payload
+ * Return:          void
+ */
+extern void Stats_add_block(Stats *stats, const uint64_t *counts, uint64_t code_bits,
+                            unsigned max_code_length, uint64_t num_words);
+
+/*
+ * Function:        Stats_merge
+ * Description:     Adds the statistics collected on another thread
+ * Parameters:      Stats *stats: statistics updated, or NULL
+ *                  Stats *other: statistics added to them
+ * Return:          void
+ */
+extern void Stats_merge(Stats *stats, const Stats *other);
+
+/*
+ * Function:        Stats_entropy
+ * Description:     Gets the order-0 entropy of the characters counted
+ * Parameters:      Stats *stats: statistics of a compression
+ * Return:          double: entropy in bits per character, 0 if none
+ */
+extern double Stats_entropy(const Stats *stats);
+
+/*
+ * Function:        Stats_print
+ * Description:     Prints the statistics as text
+ * Parameters:      Stats *stats: statistics to print
+ *                  char *operation: "compress" or "decompress"
+ *                  FILE *file: where to print, usually stderr
+ * Return:          void
+ */
+extern void Stats_print(const Stats *stats, const char *operation, FILE *file);
+
+/*
+ * Function:        Stats_write_json
+ * Description:     Writes the statistics as a JSON object
+ * Parameters:      Stats *stats: statistics to write
+ *                  char *operation: "compress" or "decompress"
+ *                  FILE *file: where to write
+ * Return:          void
+ */
+extern void Stats_write_json(const Stats *stats, const char *operation, FILE *file);
+
+#endif
@@ -0,0 +1,61 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: thread_pool.h
+*
+*   Description: Header file for implementation of a pool of worker
+*   threads, which will be used to encode and decode blocks in parallel
+*
+*   See comments on top of each function to understand the interface
+*   of implemented data structure
+*
+****************************************************************/
+
+#ifndef THREAD_POOL_INCLUDED
+#define THREAD_POOL_INCLUDED
+#define T Thread_Pool_T
+
+/* Largest number of worker threads in a pool */
+#define THREAD_POOL_MAX_THREADS 256
+
+typedef struct T *T;
+
+/*
+ * Function:        Thread_pool_new
+ * Description:     Allocates the pool and starts its worker threads
+ * Parameters:      unsigned num_threads: number of worker threads,
+ *                  between 1 and THREAD_POOL_MAX_THREADS
+ * Return:          Pointer to newly created thread pool
+ */
+extern T Thread_pool_new(unsigned num_threads);
+
+/*
+ * Function:        Thread_pool_free
+ * Description:     Waits for submitted jobs, stops the worker threads
+ *                  and deallocates the pool
+ * Parameters:      T *thread_pool: double pointer to struct `Thread_Pool_T`
+ * Return:          void
+ */
+extern void Thread_pool_free(T *thread_pool);
+
+/*
+ * Function:        Thread_pool_submit
+ * Description:     Queues a job to be run by the next idle worker thread
+ * Parameters:      T thread_pool: pointer to struct `Thread_Pool_T`
+ *                  void job(void *arg): function run by the worker
+ *                  void *arg: argument passed to the job
+ * Return:          void
+ */
+extern void Thread_pool_submit(T thread_pool, void job(void *arg), void *arg);
+
+/*
+ * Function:        Thread_pool_wait
+ * Description:     Blocks until every submitted job has finished
+ * Parameters:      T thread_pool: pointer to struct `Thread_Pool_T`
+ * Return:          void
+ */
+extern void Thread_pool_wait(T thread_pool);
+
+#undef T
+#endif
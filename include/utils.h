@@ -20,25 +20,33 @@
 #ifndef UTILS_INCLUDED
 #define UTILS_INCLUDED
 
+/* Magic bytes at the top of files compressed with canonical codes */
+#define CANONICAL_MAGIC "HUFC"
+#define CANONICAL_MAGIC_SIZE 4
+
 /*
  * Function:        get_frequency_of_characters_from_file
  * Description:     Gets array of character frequencies from file
  * Parameters:      FILE *infile: pointer to file
  *                  Pointer to num_unique_chars, which will be updated
  *                  after the function is called
- * Return           int: frequencies of each character array
+ * Return           uint64_t: frequencies of each character array
  */
-extern int *get_frequency_of_characters_from_file(FILE *infile, int *num_unique_chars);
+extern uint64_t *get_frequency_of_characters_from_file(FILE *infile, int *num_unique_chars);
 
 /*
  * Function:        create_unique_characters_freq_array
  * Description:     Builds array of unique character frequencies for Huffman 
  *                  tree building later on
- * Parameters:      int *freq_array: pointer to frequency array
+ * Parameters:      uint64_t *freq_array: pointer to frequency array
  *                  int num_unique_char: length of freq_array
+ *                  Huffman_Tree_T huffman_tree: tree the leaves are
+ *                  allocated in, and later built from the array
  * Return           Array_T
  */
-extern Array_T create_unique_characters_freq_array(int *freq_array, int num_unique_char);
+extern Array_T create_unique_characters_freq_array(const uint64_t *freq_array,
+                                                    int num_unique_char,
+                                                    Huffman_Tree_T huffman_tree);
 
 /*
  * Function:        write_total_num_bits
@@ -46,11 +54,12 @@ extern Array_T create_unique_characters_freq_array(int *freq_array, int num_uniq
  *                  compressed file.
  * 
  * Parameters:      FILE *outfile: pointer to file
- *                  int *freq_array
+ *                  uint64_t *freq_array
  *                  Array_T encoding
  * Return:          void
  */
-extern void write_total_num_bits(int *freq_array, Array_T encoding, FILE *outfile);
+extern void write_total_num_bits(const uint64_t *freq_array, Array_T encoding,
+                                 FILE *outfile);
 
 /*
  * Function:        read_total_num_bits
@@ -80,9 +89,37 @@ extern void write_header(Array_T freq_array, FILE *outfile);
  * Description:     Read header in compressed file. Returns an Array_T so
  *                  decompressor can rebuild Huffman tree
  * Parameters:      FILE *infile: pointer to file
+ *                  Huffman_Tree_T huffman_tree: tree the leaves are
+ *                  allocated in, and later built from the array
  * Return:          Pointer to struct `Array_T`
  */
-extern Array_T read_header(FILE *infile);
+extern Array_T read_header(FILE *infile, Huffman_Tree_T huffman_tree);
+
+/*
+ * Function:        write_canonical_header
+ * Description:     Write header of a file compressed with canonical codes
+ *                  in the following format. The code lengths alone allow
+ *                  decompressor to rebuild the canonical Huffman tree
+ *
+ *                  <CANONICAL_MAGIC><PACKED_CODE_LENGTHS>
+ *
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths
+ *                  FILE *outfile: pointer to file
+ * Return:          void
+ */
+extern void write_canonical_header(const uint8_t *lengths, FILE *outfile);
+
+/*
+ * Function:        read_canonical_header
+ * Description:     Read header of a file compressed with canonical codes.
+ *                  If the file does not start with CANONICAL_MAGIC, the
+ *                  file position is restored and nothing is read
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ *                  FILE *infile: pointer to file
+ * Return:          int: 1 if the canonical header was read, 0 otherwise
+ */
+extern int read_canonical_header(uint8_t *lengths, FILE *infile);
 
 /*
  * Function:        write_body
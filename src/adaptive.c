@@ -0,0 +1,561 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: adaptive.c
+*
+*   Description: Implementation of adaptive Huffman coder, which codes
+*   characters in one pass with the FGK algorithm
+*
+*   Nodes are kept in slots of non-increasing frequency, the root in slot
+*   0 and the NYT leaf in the last slot, with siblings in slots 2k - 1 and
+*   2k. Before the frequency of a node is incremented, the subtree in its
+*   slot is swapped with the one in the first slot of the same frequency,
+*   so that slots stay ordered and the tree stays a Huffman tree of the
+*   characters coded so far
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/adaptive.h"
+
+#define T Adaptive_Coder_T
+
+/* Slot of the leaf of characters not coded yet */
+#define NO_LEAF UINT16_MAX
+
+/* Words the writer may store for one code */
+#define CODE_WORDS (ADAPTIVE_MAX_CODE_BITS / 64 + 1)
+
+/* Buffer sizes of the file functions */
+#define IN_BUFFER_SIZE 65536
+#define OUT_BUFFER_SIZE 65536
+#define READ_BUFFER_WORDS 8192
+
+const Except_T Adaptive_Corrupted = {"Corrupted adaptive stream"};
+const Except_T Adaptive_Output_Too_Small = {"Output buffer too small"};
+
+/* structure of the adaptive coder */
+struct T
+{
+    Huffman_node nodes[ADAPTIVE_MAX_NODES];
+    uint16_t parents[ADAPTIVE_MAX_NODES];  // parent of each slot, unused for the root
+    uint16_t leaves[MAX_NUM_CHAR];         // slot of each character, or NO_LEAF
+    uint16_t nyt;                          // slot of the NYT leaf
+    uint16_t num_nodes;
+    uint64_t num_bits;                     // bits coded since the last reset
+};
+
+/* Helper function prototypes */
+static inline int is_leaf(const Huffman_node *node);
+static void add_character(T coder, int c);
+static void update(T coder, int c);
+static void increment_path(T coder, unsigned slot);
+static inline unsigned first_slot(T coder, unsigned slot);
+static void swap_slots(T coder, unsigned a, unsigned b);
+static void link_children(T coder, unsigned slot);
+static void put_path(T coder, Bit_writer *writer, unsigned slot);
+
+/*
+ * Function:        Adaptive_coder_new
+ * Description:     Allocates a coder holding the tree of a new stream
+ * Return:          Pointer to newly created Adaptive Coder
+ */
+T Adaptive_coder_new(void)
+{
+    T coder = malloc(sizeof(struct T));
+    assert(coder);
+    Adaptive_coder_reset(coder);
+    return coder;
+}
+
+/*
+ * Function:        Adaptive_coder_free
+ * Description:     Deallocates the coder after done using
+ * Parameters:      T *coder: double pointer to struct `Adaptive_Coder_T`
+ * Return:          void
+ */
+void Adaptive_coder_free(T *coder)
+{
+    assert(coder && *coder);
+    free(*coder);
+    *coder = NULL;
+}
+
+/*
+ * Function:        Adaptive_coder_reset
+ * Description:     Goes back to the tree of a new stream, with only the
+ *                  NYT leaf, so that the coder can be reused
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ * Return:          void
+ */
+void Adaptive_coder_reset(T coder)
+{
+    assert(coder);
+    memset(&coder->nodes[0], 0, sizeof(Huffman_node));
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        coder->leaves[c] = NO_LEAF;
+    coder->nyt = 0;
+    coder->num_nodes = 1;
+    coder->num_bits = 0;
+}
+
+/*
+ * Function:        Adaptive_coder_num_bits
+ * Description:     Gets the number of bits coded since the last reset
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ * Return:          uint64_t: number of bits written or read
+ */
+uint64_t Adaptive_coder_num_bits(T coder)
+{
+    assert(coder);
+    return coder->num_bits;
+}
+
+/*
+ * Function:        Adaptive_encode
+ * Description:     Writes the code of a character, or the end of the
+ *                  stream, then updates the tree. The writer may store up
+ *                  to ADAPTIVE_MAX_CODE_BITS / 64 + 1 words
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  Bit_writer *writer: pointer to the writer
+ *                  int c: character, or ADAPTIVE_END
+ * Return:          void
+ */
+void Adaptive_encode(T coder, Bit_writer *writer, int c)
+{
+    assert(coder && writer && c >= 0 && c <= ADAPTIVE_END);
+    if (c != ADAPTIVE_END && coder->leaves[c] != NO_LEAF)
+    {
+        put_path(coder, writer, coder->leaves[c]);
+        update(coder, c);
+        return;
+    }
+
+    // New characters and the end are escaped through the NYT leaf
+    put_path(coder, writer, coder->nyt);
+    Bit_writer_put(writer, (uint64_t)c, ADAPTIVE_ESCAPE_BITS);
+    coder->num_bits += ADAPTIVE_ESCAPE_BITS;
+    if (c != ADAPTIVE_END)
+    {
+        add_character(coder, c);
+        update(coder, c);
+    }
+}
+
+/*
+ * Function:        Adaptive_decode
+ * Description:     Reads the code of a character, then updates the tree
+ *                  as Adaptive_encode did. The reader must hold up to
+ *                  ADAPTIVE_MAX_CODE_BITS bits. Raises Adaptive_Corrupted
+ *                  if a character is escaped twice
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  Bit_reader *reader: pointer to the reader
+ * Return:          int: character, or ADAPTIVE_END
+ */
+int Adaptive_decode(T coder, Bit_reader *reader)
+{
+    assert(coder && reader);
+    // Walk down from the root one bit at a time, 1 for a right child,
+    // consuming the bits walked at most BIT_READER_MIN_BITS at a time
+    const Huffman_node *nodes = coder->nodes;
+    unsigned slot = 0;
+    while (!is_leaf(&nodes[slot]))
+    {
+        Bit_reader_refill(reader);
+        uint64_t bits = Bit_reader_peek(reader, BIT_READER_MIN_BITS);
+        unsigned length = 0;
+        do
+        {
+            unsigned bit = (unsigned)(bits >> (BIT_READER_MIN_BITS - 1 - length)) & 1;
+            slot = bit ? nodes[slot].right_node : nodes[slot].left_node;
+            length++;
+        } while (!is_leaf(&nodes[slot]) && length < BIT_READER_MIN_BITS);
+        Bit_reader_consume(reader, length);
+        coder->num_bits += length;
+    }
+
+    int c;
+    if (slot == coder->nyt)
+    {
+        Bit_reader_refill(reader);
+        c = (int)Bit_reader_peek(reader, ADAPTIVE_ESCAPE_BITS);
+        Bit_reader_consume(reader, ADAPTIVE_ESCAPE_BITS);
+        coder->num_bits += ADAPTIVE_ESCAPE_BITS;
+        if (c == ADAPTIVE_END)
+            return c;
+        if (c > ADAPTIVE_END || coder->leaves[c] != NO_LEAF)
+            RAISE(Adaptive_Corrupted);
+        add_character(coder, c);
+    }
+    else
+        c = (unsigned char)coder->nodes[slot].key;
+    update(coder, c);
+    return c;
+}
+
+/*
+ * Function:        Adaptive_compress_bound
+ * Description:     Gets the largest possible size of a compressed buffer
+ * Parameters:      size_t src_size: number of bytes to compress
+ * Return:          size_t: capacity of dst that always suffices
+ */
+size_t Adaptive_compress_bound(size_t src_size)
+{
+    // Room for the longest code of every character and of the end, each
+    // checked against CODE_WORDS words, and the padded last word
+    return ADAPTIVE_MAGIC_SIZE +
+           sizeof(uint64_t) * ((src_size + 1) * ADAPTIVE_MAX_CODE_BITS / 64 +
+                               CODE_WORDS + 1);
+}
+
+/*
+ * Function:        Adaptive_compress
+ * Description:     Compresses src into dst in one pass, starting from a
+ *                  reset tree. Raises Adaptive_Output_Too_Small if dst
+ *                  may not hold the next code, which never happens with a
+ *                  capacity of Adaptive_compress_bound(src_size)
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  void *src: bytes to compress
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ * Return:          size_t: number of bytes written to dst
+ */
+size_t Adaptive_compress(T coder, const void *src, size_t src_size,
+                         void *dst, size_t dst_capacity)
+{
+    assert(coder && (src || src_size == 0) && dst);
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    if (dst_capacity < ADAPTIVE_MAGIC_SIZE)
+        RAISE(Adaptive_Output_Too_Small);
+    memcpy(out, ADAPTIVE_MAGIC, ADAPTIVE_MAGIC_SIZE);
+
+    // Codes are written straight into dst, each checked for the words it
+    // may store, the last one also for the padded word of the flush
+    size_t capacity = dst_capacity - ADAPTIVE_MAGIC_SIZE;
+    Bit_writer writer;
+    Bit_writer_init(&writer, out + ADAPTIVE_MAGIC_SIZE);
+    Adaptive_coder_reset(coder);
+    for (size_t i = 0; i <= src_size; i++)
+    {
+        size_t room = (i == src_size ? CODE_WORDS + 1 : CODE_WORDS) * sizeof(uint64_t);
+        if (capacity - Bit_writer_num_bytes(&writer) < room)
+            RAISE(Adaptive_Output_Too_Small);
+        Adaptive_encode(coder, &writer, i == src_size ? ADAPTIVE_END : in[i]);
+    }
+    return ADAPTIVE_MAGIC_SIZE + Bit_writer_flush(&writer);
+}
+
+/*
+ * Function:        Adaptive_decompress
+ * Description:     Decompresses a buffer made by Adaptive_compress or
+ *                  `huffman -A`. Raises Adaptive_Corrupted on malformed or
+ *                  truncated input, and Adaptive_Output_Too_Small if dst
+ *                  cannot hold the decoded bytes
+ * Parameters:      T coder: pointer to struct `Adaptive_Coder_T`
+ *                  void *src: compressed bytes
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ * Return:          size_t: number of bytes written to dst
+ */
+size_t Adaptive_decompress(T coder, const void *src, size_t src_size,
+                           void *dst, size_t dst_capacity)
+{
+    assert(coder && (src || src_size == 0) && (dst || dst_capacity == 0));
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    if (src_size < ADAPTIVE_MAGIC_SIZE ||
+        memcmp(in, ADAPTIVE_MAGIC, ADAPTIVE_MAGIC_SIZE) != 0 ||
+        (src_size - ADAPTIVE_MAGIC_SIZE) % sizeof(uint64_t) != 0)
+        RAISE(Adaptive_Corrupted);
+
+    // The reader gives zeros past the last word, which decode to codes of
+    // at least one bit each, so running past the end is caught by count
+    size_t num_words = (src_size - ADAPTIVE_MAGIC_SIZE) / sizeof(uint64_t);
+    Bit_reader reader;
+    Bit_reader_init(&reader, in + ADAPTIVE_MAGIC_SIZE, num_words);
+    Adaptive_coder_reset(coder);
+    size_t size = 0;
+    while (1)
+    {
+        int c = Adaptive_decode(coder, &reader);
+        if (coder->num_bits > (uint64_t)num_words * 64)
+            RAISE(Adaptive_Corrupted);
+        if (c == ADAPTIVE_END)
+            break;
+        if (size == dst_capacity)
+            RAISE(Adaptive_Output_Too_Small);
+        out[size++] = (uint8_t)c;
+    }
+    return size;
+}
+
+/*
+ * Function:        Adaptive_compress_file
+ * Description:     Reads infile until end of file and writes its codes to
+ *                  outfile as they fill the output buffer, so that input
+ *                  and output can be pipes
+ * Parameters:      FILE *infile: pointer to the input file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Stats *stats: updated with bytes and timings, or NULL
+ * Return:          void
+ */
+void Adaptive_compress_file(FILE *infile, FILE *outfile, Stats *stats)
+{
+    assert(infile && outfile);
+    T coder = Adaptive_coder_new();
+    static uint8_t in_buffer[IN_BUFFER_SIZE];
+    static uint64_t out_words[OUT_BUFFER_SIZE / sizeof(uint64_t) + CODE_WORDS + 1];
+    uint8_t *out_buffer = (uint8_t *)out_words;
+    Bit_writer writer;
+    Bit_writer_init(&writer, out_buffer);
+
+    fwrite(ADAPTIVE_MAGIC, 1, ADAPTIVE_MAGIC_SIZE, outfile);
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = ADAPTIVE_MAGIC_SIZE;
+    size_t in_size;
+    double start = Stats_start(stats);
+    while ((in_size = fread(in_buffer, 1, IN_BUFFER_SIZE, infile)) > 0)
+    {
+        start = Stats_lap(stats, STATS_READ, start);
+        if (stats)
+            Histogram_count(in_buffer, in_size, stats->counts);
+        start = Stats_lap(stats, STATS_COUNT, start);
+
+        // Codes store several words at once, so the buffer is written out
+        // once it is full or over
+        for (size_t i = 0; i < in_size; i++)
+        {
+            Adaptive_encode(coder, &writer, in_buffer[i]);
+            if (Bit_writer_num_bytes(&writer) >= OUT_BUFFER_SIZE)
+            {
+                start = Stats_lap(stats, STATS_ENCODE, start);
+                fwrite(out_buffer, 1, Bit_writer_num_bytes(&writer), outfile);
+                bytes_out += Bit_writer_num_bytes(&writer);
+                Bit_writer_rewind(&writer);
+                start = Stats_lap(stats, STATS_WRITE, start);
+            }
+        }
+        start = Stats_lap(stats, STATS_ENCODE, start);
+        bytes_in += in_size;
+    }
+    Adaptive_encode(coder, &writer, ADAPTIVE_END);
+    size_t size = Bit_writer_flush(&writer);
+    start = Stats_lap(stats, STATS_ENCODE, start);
+    fwrite(out_buffer, 1, size, outfile);
+    Stats_lap(stats, STATS_WRITE, start);
+    bytes_out += size;
+
+    if (stats)
+    {
+        stats->bytes_in += bytes_in;
+        stats->bytes_out += bytes_out;
+        stats->code_bits += coder->num_bits;
+        stats->num_words += (bytes_out - ADAPTIVE_MAGIC_SIZE) / sizeof(uint64_t);
+    }
+    Adaptive_coder_free(&coder);
+}
+
+/*
+ * Function:        Adaptive_decompress_file
+ * Description:     Decodes codes up to the end of the stream and writes
+ *                  them to outfile. infile must be positioned right after
+ *                  ADAPTIVE_MAGIC. Raises Adaptive_Corrupted on malformed
+ *                  or truncated input
+ * Parameters:      FILE *infile: pointer to the compressed file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Stats *stats: updated with bytes and timings, or NULL
+ * Return:          void
+ */
+void Adaptive_decompress_file(FILE *infile, FILE *outfile, Stats *stats)
+{
+    assert(infile && outfile);
+    volatile T coder = Adaptive_coder_new();
+    static uint64_t words[READ_BUFFER_WORDS];
+    static uint8_t out_buffer[OUT_BUFFER_SIZE];
+    Bit_reader reader;
+    Bit_reader_init(&reader, (const uint8_t *)words, 0);
+
+    volatile uint64_t words_read = 0;
+    volatile uint64_t bytes_out = 0;
+    size_t out_size = 0;
+    int end_of_file = 0;
+    double start = Stats_start(stats);
+    TRY
+        while (1)
+        {
+            // Keep the longest code in the buffer, moving the words left
+            // to its top before reading more
+            size_t words_left = (size_t)(reader.end - reader.next) / sizeof(uint64_t);
+            if (words_left < CODE_WORDS + 1 && !end_of_file)
+            {
+                start = Stats_lap(stats, STATS_DECODE, start);
+                memmove(words, reader.next, words_left * sizeof(uint64_t));
+                size_t num_read = fread(words + words_left, sizeof(uint64_t),
+                                        READ_BUFFER_WORDS - words_left, infile);
+                end_of_file = num_read < READ_BUFFER_WORDS - words_left;
+                words_read += num_read;
+                Bit_reader_feed(&reader, (const uint8_t *)words, words_left + num_read);
+                start = Stats_lap(stats, STATS_READ, start);
+            }
+
+            int c = Adaptive_decode(coder, &reader);
+            if (coder->num_bits > words_read * 64)
+                RAISE(Adaptive_Corrupted);
+            if (c == ADAPTIVE_END)
+                break;
+            out_buffer[out_size++] = (uint8_t)c;
+            if (out_size == OUT_BUFFER_SIZE)
+            {
+                start = Stats_lap(stats, STATS_DECODE, start);
+                fwrite(out_buffer, 1, out_size, outfile);
+                bytes_out += out_size;
+                out_size = 0;
+                start = Stats_lap(stats, STATS_WRITE, start);
+            }
+        }
+    FINALLY
+        Adaptive_coder_free((T *)&coder);
+    END_TRY;
+    start = Stats_lap(stats, STATS_DECODE, start);
+    fwrite(out_buffer, 1, out_size, outfile);
+    Stats_lap(stats, STATS_WRITE, start);
+    bytes_out += out_size;
+
+    if (stats)
+    {
+        stats->bytes_in += ADAPTIVE_MAGIC_SIZE + words_read * sizeof(uint64_t);
+        stats->bytes_out += bytes_out;
+    }
+}
+
+// Helper function to check whether a node is a leaf. Internal nodes have
+// two children, neither of which is the root in slot 0
+static inline int is_leaf(const Huffman_node *node)
+{
+    return node->left_node == 0;
+}
+
+// Helper function to split the NYT leaf into a new NYT leaf, as left
+// child, and a leaf of frequency 0 for c, as right child
+static void add_character(T coder, int c)
+{
+    assert(coder->num_nodes + 2 <= ADAPTIVE_MAX_NODES);
+    unsigned parent = coder->nyt;
+    unsigned leaf = coder->num_nodes;
+    unsigned nyt = coder->num_nodes + 1;
+    coder->num_nodes += 2;
+
+    Huffman_node *nodes = coder->nodes;
+    nodes[leaf] = (Huffman_node){0, 0, 0, (char)c};
+    nodes[nyt] = (Huffman_node){0, 0, 0, 0};
+    nodes[parent].left_node = (uint16_t)nyt;
+    nodes[parent].right_node = (uint16_t)leaf;
+    coder->parents[leaf] = (uint16_t)parent;
+    coder->parents[nyt] = (uint16_t)parent;
+    coder->leaves[c] = (uint16_t)leaf;
+    coder->nyt = (uint16_t)nyt;
+}
+
+// Helper function to increment the frequency of the leaf of c and of its
+// ancestors. The sibling of the NYT leaf has the frequency of its parent,
+// and every other node of that frequency is a leaf, so when the parent is
+// the first slot of the frequency it either moves after those leaves, or
+// is incremented right after its only child of that frequency
+static void update(T coder, int c)
+{
+    unsigned slot = coder->leaves[c];
+    unsigned parent = coder->parents[slot];
+    if (parent == coder->parents[coder->nyt] && first_slot(coder, slot) == parent)
+    {
+        if (parent + 1 == slot)
+        {
+            coder->nodes[slot].frequency++;
+            slot = parent;
+        }
+        else
+            swap_slots(coder, parent, slot - 1);
+    }
+    increment_path(coder, slot);
+}
+
+// Helper function to increment the frequency of the node in a slot and of
+// its ancestors. Each node is first swapped with the first slot of its
+// frequency, so that frequencies stay non-increasing across slots
+static void increment_path(T coder, unsigned slot)
+{
+    while (1)
+    {
+        unsigned leader = first_slot(coder, slot);
+        if (leader != slot)
+            swap_slots(coder, leader, slot);
+        coder->nodes[leader].frequency++;
+        if (leader == 0)
+            return;
+        slot = coder->parents[leader];
+    }
+}
+
+// Helper function to find the first slot of the frequency of a slot
+static inline unsigned first_slot(T coder, unsigned slot)
+{
+    uint64_t frequency = coder->nodes[slot].frequency;
+    while (slot > 0 && coder->nodes[slot - 1].frequency == frequency)
+        slot--;
+    return slot;
+}
+
+// Helper function to swap the subtrees in two slots, each slot keeping its
+// parent
+static void swap_slots(T coder, unsigned a, unsigned b)
+{
+    assert(a != coder->nyt && b != coder->nyt);
+    Huffman_node node = coder->nodes[a];
+    coder->nodes[a] = coder->nodes[b];
+    coder->nodes[b] = node;
+    link_children(coder, a);
+    link_children(coder, b);
+}
+
+// Helper function to point the children, or the character, of the node in
+// a slot back to that slot
+static void link_children(T coder, unsigned slot)
+{
+    Huffman_node *node = &coder->nodes[slot];
+    if (is_leaf(node))
+    {
+        coder->leaves[(unsigned char)node->key] = (uint16_t)slot;
+        return;
+    }
+    coder->parents[node->left_node] = (uint16_t)slot;
+    coder->parents[node->right_node] = (uint16_t)slot;
+}
+
+// Helper function to write the code of the node in a slot, the path from
+// the root to it. Bits are gathered from the leaf up, so that the code of
+// a node up to 64 deep is its value, written at once
+static void put_path(T coder, Bit_writer *writer, unsigned slot)
+{
+    uint64_t codes[ADAPTIVE_MAX_CODE_BITS / 64 + 1] = {0};
+    unsigned length = 0;
+    for (; slot != 0; slot = coder->parents[slot], length++)
+    {
+        uint64_t bit = coder->nodes[coder->parents[slot]].right_node == slot;
+        codes[length / 64] |= bit << (length % 64);
+    }
+    coder->num_bits += length;
+
+    // Deeper nodes are written from the root: the bits above the last
+    // multiple of 64, then 64 at a time
+    if (length % 64)
+        Bit_writer_put(writer, codes[length / 64], length % 64);
+    for (unsigned word = length / 64; word > 0; word--)
+        Bit_writer_put(writer, codes[word - 1], 64);
+}
@@ -0,0 +1,53 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: bitio.c
+*
+*   Description: Implementation of bit I/O module, which writes and
+*   reads streams of codes packed from the top of 64-bit words. The
+*   per-code functions are defined in the header
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include "../include/bitio.h"
+
+/*
+ * Function:        Bit_writer_init
+ * Description:     Starts writing codes to buffer
+ * Parameters:      Bit_writer *writer: writer to initialize
+ *                  uint8_t *buffer: output, large enough for every code
+ *                  written before the next Bit_writer_rewind
+ * Return:          void
+ */
+void Bit_writer_init(Bit_writer *writer, uint8_t *buffer)
+{
+    assert(writer && buffer);
+    writer->buffer = buffer;
+    writer->next = buffer;
+    writer->accumulator = 0;
+    writer->free_bits = 64;
+}
+
+/*
+ * Function:        Bit_writer_flush
+ * Description:     Stores the partly filled word, if any, padded with
+ *                  zeros. No code may be written afterwards
+ * Parameters:      Bit_writer *writer: pointer to the writer
+ * Return:          size_t: number of bytes in the buffer
+ */
+size_t Bit_writer_flush(Bit_writer *writer)
+{
+    assert(writer);
+    if (writer->free_bits < 64)
+    {
+        memcpy(writer->next, &writer->accumulator, sizeof(uint64_t));
+        writer->next += sizeof(uint64_t);
+        writer->accumulator = 0;
+        writer->free_bits = 64;
+    }
+    return Bit_writer_num_bytes(writer);
+}
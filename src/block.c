@@ -0,0 +1,2039 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: block.c
+*
+*   Description: Implementation of block module, which compresses one
+*   block of input in memory with its own canonical code table
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../include/block.h"
+#include "../include/bitio.h"
+#include "../include/histogram.h"
+
+#define SIZE_OF_UINT64_IN_BITS 64
+
+/* NUM_STREAMS byte: number of streams and flag of pairs below, number of
+ * tables or of pages of pairs minus one above, or RUNS_PAGES for runs.
+ * With the bits below clear, number of streams of matches above */
+#define STREAMS_MASK 0x0D
+#define PAIRS_FLAG 0x02
+#define TABLES_SHIFT 4
+#define RUNS_PAGES 0x0F
+#define MATCHES_MASK 0x0F
+
+/* Offsets in the header of a coded block of NUM_BITS, NUM_STREAMS and
+ * the packed code lengths */
+#define NUM_BITS_OFFSET BLOCK_PREFIX_SIZE
+#define STREAMS_OFFSET (NUM_BITS_OFFSET + sizeof(uint32_t))
+#define LENGTHS_OFFSET (STREAMS_OFFSET + 1)
+
+/* Size of the header of a filled block, its prefix and FILL_BYTE */
+#define FILLED_HEADER_SIZE (BLOCK_PREFIX_SIZE + 1)
+
+/* Bits taken in the header by one more code table, which clustering
+ * weighs against the bits the table saves */
+#define TABLE_COST_BITS (CANONICAL_PACKED_SIZE * 8)
+
+/* Rounds of moving previous bytes to their cheapest table */
+#define CLUSTER_ROUNDS 4
+
+/* Fewest occurrences of a byte pair for it to become a symbol, below
+ * which its code seldom pays for its place in the header */
+#define MIN_PAIR_COUNT 16
+
+/* Buckets of pair counts, from zero to the highest count, used to find
+ * the most frequent pairs without sorting them */
+#define NUM_COUNT_BUCKETS 4096
+
+/* Symbols of a block with runs: bytes, then runs, or match lengths with
+ * the distances of matches after them */
+#define RUN_ALPHABET_SIZE (MAX_NUM_CHAR + BLOCK_RUN_SYMBOLS)
+#define MATCH_ALPHABET_SIZE (RUN_ALPHABET_SIZE + BLOCK_DISTANCE_SYMBOLS)
+
+/* Match lengths take the symbols of runs */
+#if BLOCK_MIN_MATCH != BLOCK_MIN_RUN
+#error "Matches and runs must have the same fewest bytes"
+#endif
+
+/* Offset in the workspace of Block_encode of the matches of the block,
+ * followed by the workspace of the match finder */
+#define MATCHES_OFFSET ((BLOCK_WORKSPACE_SIZE + sizeof(uint64_t) - 1) / \
+                        sizeof(uint64_t) * sizeof(uint64_t))
+
+/* Bytes at the end of a block with runs that no run covers, so that the
+ * decoding loops can store the bytes of a round of streams after a run
+ * without checking */
+#define RUN_END_MARGIN (BLOCK_MAX_STREAMS - 1)
+
+/* structure of the workspace of Block_encode */
+typedef struct Encode_workspace
+{
+    uint32_t pair_counts[MAX_NUM_CHAR][MAX_NUM_CHAR]; // characters after each byte
+    uint64_t table_counts[BLOCK_MAX_TABLES][MAX_NUM_CHAR]; // characters of each table
+    Encoded_value codes[BLOCK_MAX_TABLES][MAX_NUM_CHAR];   // codes of each table
+    uint8_t successors[MAX_NUM_CHAR * MAX_NUM_CHAR]; // characters after each byte
+    uint16_t pair_index[MAX_NUM_CHAR][MAX_NUM_CHAR]; // symbol of each pair, 0 for none
+    uint8_t pairs[BLOCK_MAX_PAIRS][2];               // bytes of each pair symbol
+    uint32_t stream_counts[BLOCK_MAX_STREAMS][BLOCK_MAX_SYMBOLS]; // symbols of each stream
+    uint64_t symbol_counts[BLOCK_MAX_SYMBOLS];       // symbols of the block
+    uint8_t symbol_lengths[BLOCK_MAX_SYMBOLS];       // code lengths of bytes and pairs
+    Encoded_value symbol_codes[BLOCK_MAX_SYMBOLS];   // codes of bytes and pairs
+    uint32_t run_counts[BLOCK_MAX_STREAMS][RUN_ALPHABET_SIZE]; // bytes and runs of
+                                                               // each stream
+    uint64_t run_bits[BLOCK_MAX_STREAMS];            // bits of run lengths of each stream
+    uint64_t run_symbol_counts[RUN_ALPHABET_SIZE];   // bytes and runs of the block
+    uint8_t run_lengths[RUN_ALPHABET_SIZE];          // code lengths of bytes and runs
+    Encoded_value run_codes[RUN_ALPHABET_SIZE];      // codes of bytes and runs
+    uint32_t match_counts[BLOCK_MAX_STREAMS][RUN_ALPHABET_SIZE]; // bytes and match
+                                                                 // lengths of each stream
+    uint32_t distance_counts[BLOCK_MAX_STREAMS][BLOCK_DISTANCE_SYMBOLS]; // distances of
+                                                                         // each stream
+    uint64_t match_bits[BLOCK_MAX_STREAMS];          // bits of lengths and distances
+                                                     // of each stream
+    uint64_t match_symbol_counts[MATCH_ALPHABET_SIZE]; // bytes, lengths and distances
+                                                       // of the block
+    uint8_t match_lengths[MATCH_ALPHABET_SIZE];      // code lengths of bytes, lengths
+                                                     // and distances
+    Encoded_value match_codes[MATCH_ALPHABET_SIZE];  // codes of bytes, lengths and
+                                                     // distances
+    uint64_t merge_lists[CANONICAL_ALPHABET_WORKSPACE_SIZE(BLOCK_MAX_SYMBOLS) /
+                         sizeof(uint64_t)];
+} Encode_workspace;
+
+/* structure of the characters following one previous byte, as used to
+ * cluster previous bytes */
+typedef struct Context
+{
+    const uint32_t *counts;   // MAX_NUM_CHAR counts of the next characters
+    const uint8_t *next;      // characters with a non-zero count
+    int num_next;             // number of such characters
+    float own_bits;           // estimated bits with a table of its own
+} Context;
+
+/* structure of the distance codes of a block with matches */
+typedef struct Distance_codes
+{
+    const Decoded_value *table; // decoding table of distance symbols
+    unsigned root_bits;         // width of its root
+} Distance_codes;
+
+const Except_T Block_Corrupted = {"Corrupted compressed block"};
+
+/* Helper function prototypes */
+static uint32_t jump_table_size(unsigned num_streams, unsigned num_tables,
+                                unsigned num_pairs, unsigned num_run_symbols,
+                                unsigned num_distance_symbols);
+static uint64_t code_bits(const uint64_t *counts, const uint8_t *lengths,
+                          unsigned num_symbols);
+static unsigned max_length(const uint8_t *lengths, unsigned num_symbols);
+static void count_pairs(const uint8_t *src, uint32_t size,
+                        uint32_t (*pair_counts)[MAX_NUM_CHAR], uint64_t *counts);
+static unsigned context_tables(Encode_workspace *space, const Block_options *options,
+                               uint8_t (*lengths)[MAX_NUM_CHAR], uint8_t *context_map,
+                               uint64_t *num_bits);
+static unsigned cluster_contexts(const uint32_t (*pair_counts)[MAX_NUM_CHAR],
+                                 uint8_t *successors, unsigned max_tables,
+                                 uint8_t *context_map);
+static void estimate_bits(const uint32_t *counts, float *bits);
+static float context_bits(const Context *context, const float *bits);
+static void assign_contexts(const Context *contexts, int num_contexts,
+                            float (*bits)[MAX_NUM_CHAR], unsigned num_tables,
+                            uint8_t *assignment, float *removal_bits);
+static unsigned update_tables(const Context *contexts, int num_contexts,
+                              float (*bits)[MAX_NUM_CHAR], unsigned num_tables,
+                              uint8_t *assignment);
+static unsigned pair_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                             const Block_options *options, const uint64_t *counts,
+                             uint64_t best_bits, uint64_t *num_bits);
+static unsigned choose_pairs(const uint32_t (*pair_counts)[MAX_NUM_CHAR],
+                             unsigned max_pairs, uint8_t (*pairs)[2],
+                             uint16_t (*pair_index)[MAX_NUM_CHAR]);
+static void count_symbols(const uint8_t *src, uint32_t size,
+                          const uint16_t (*pair_index)[MAX_NUM_CHAR],
+                          unsigned num_streams, unsigned num_symbols,
+                          uint32_t (*stream_counts)[BLOCK_MAX_SYMBOLS]);
+static uint8_t *encode_pairs(const Encode_workspace *space, const uint8_t *src,
+                             uint32_t size, unsigned num_streams, unsigned num_symbols,
+                             uint8_t *jump_table, uint8_t *payload, uint32_t *num_bits);
+static unsigned run_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                            const Block_options *options, uint64_t best_bits,
+                            uint64_t *num_bits);
+static void count_runs(const uint8_t *src, uint32_t size, unsigned num_streams,
+                       uint32_t (*stream_counts)[RUN_ALPHABET_SIZE], uint64_t *run_bits);
+static uint8_t *encode_runs(const Encode_workspace *space, const uint8_t *src,
+                            uint32_t size, unsigned num_streams, uint8_t *jump_table,
+                            uint8_t *payload, uint32_t *num_bits);
+static unsigned match_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                              const Block_options *options, const Lz77_match *matches,
+                              uint32_t num_matches, uint64_t best_bits, uint64_t *num_bits);
+static void count_matches(const uint8_t *src, uint32_t size, const Lz77_match *matches,
+                          uint32_t num_matches, unsigned num_streams,
+                          Encode_workspace *space);
+static uint8_t *encode_matches(const Encode_workspace *space, const uint8_t *src,
+                               uint32_t size, const Lz77_match *matches,
+                               uint32_t num_matches, unsigned num_streams,
+                               uint8_t *jump_table, uint8_t *payload, uint32_t *num_bits);
+static size_t write_plain_block(const uint8_t *src, uint32_t raw_size, unsigned coding,
+                                uint8_t *dst);
+static uint8_t *start_streams(const uint32_t *stream_bits, unsigned num_streams,
+                              Bit_writer *writers, uint8_t *jump_table,
+                              uint8_t *payload, uint32_t *num_bits);
+static uint32_t next_run(const uint8_t *src, uint32_t i, uint32_t end);
+static uint32_t run_length(const uint8_t *src, uint32_t size, uint8_t c);
+static unsigned run_symbol(uint32_t run);
+static unsigned distance_symbol(uint32_t distance);
+static void read_plain_header(const uint8_t *src, Block_header *header);
+static void read_context_tables(const uint8_t *src, Block_header *header);
+static void read_pairs(const uint8_t *src, Block_header *header);
+static const uint32_t *pair_decoding_table(const Block_header *header,
+                                           Decoded_value *table, unsigned *root_bits);
+static void run_decoding_table(const Block_header *header, Decoded_value *table,
+                               unsigned *root_bits, Distance_codes *distances);
+static void widen_table(Decoded_value *table, unsigned bits);
+static void decode_contexts(const Decoded_value *const *context_tables,
+                            Bit_reader *readers, unsigned num_streams,
+                            uint8_t *dst, uint32_t raw_size);
+static void decode_pairs(const Decoded_value *table, unsigned root_bits,
+                         const uint32_t *symbol_bytes, Bit_reader *readers,
+                         unsigned num_streams, uint8_t *dst, uint32_t raw_size);
+static void decode_runs(const Decoded_value *table, unsigned root_bits,
+                        const Distance_codes *distances, Bit_reader *readers,
+                        unsigned num_streams, uint8_t *dst, uint32_t raw_size);
+static uint32_t stream_length(uint32_t raw_size, unsigned num_streams,
+                              unsigned stream);
+static inline BITIO_INLINE uint16_t decode_symbol(const Decoded_value *table,
+                                                  unsigned root_bits,
+                                                  Bit_reader *reader);
+static inline BITIO_INLINE uint8_t *put_symbol(uint8_t *dst, uint32_t bytes);
+static uint8_t *fill_run(uint8_t *dst, const uint8_t *start, const uint8_t *end,
+                         uint16_t symbol, Bit_reader *reader,
+                         const Distance_codes *distances);
+static void copy_match(uint8_t *dst, uint64_t distance, uint64_t length);
+static inline BITIO_INLINE uint8_t *put_run_symbol(uint8_t *dst, const uint8_t *start,
+                                                   const uint8_t *end, uint16_t symbol,
+                                                   Bit_reader *reader,
+                                                   const Distance_codes *distances);
+static inline BITIO_INLINE uint8_t decode_context_symbol(const Decoded_value *table,
+                                                         Bit_reader *reader);
+
+/*
+ * Function:        Block_bound
+ * Description:     Gets the largest possible size of an encoded block
+ * Parameters:      size_t raw_size: number of bytes in the block
+ *                  unsigned max_code_length: maximum length of codes
+ * Return:          size_t: bytes needed for header and payload
+ */
+size_t Block_bound(size_t raw_size, unsigned max_code_length)
+{
+    // Every stream may end with a partly filled word
+    size_t num_words = (raw_size * max_code_length + SIZE_OF_UINT64_IN_BITS - 1) /
+                       SIZE_OF_UINT64_IN_BITS + BLOCK_MAX_STREAMS;
+    return BLOCK_HEADER_SIZE + BLOCK_MAX_JUMP_TABLE_SIZE + num_words * sizeof(uint64_t);
+}
+
+/*
+ * Function:        Block_default_options
+ * Description:     Gets the options of a block with a single code table
+ * Parameters:      void
+ * Return:          Block_options: longest codes, default number of streams
+ *                  and a single table, without pairs, runs or matches
+ */
+Block_options Block_default_options(void)
+{
+    Block_options options;
+    options.max_code_length = CANONICAL_MAX_CODE_LENGTH;
+    options.num_streams = BLOCK_DEFAULT_STREAMS;
+    options.max_tables = 1;
+    options.max_pairs = 0;
+    options.runs = 0;
+    options.match_level = 0;
+    options.window_bits = LZ77_DEFAULT_WINDOW_BITS;
+    return options;
+}
+
+/*
+ * Function:        Block_workspace_size
+ * Description:     Gets the number of bytes of workspace used by
+ *                  Block_encode: BLOCK_WORKSPACE_SIZE, followed when
+ *                  matches are allowed by room for the matches of the
+ *                  block and the chains of the match finder
+ * Parameters:      uint32_t raw_size: number of bytes in the block
+ *                  Block_options *options: options of the block
+ * Return:          size_t: bytes of workspace
+ */
+size_t Block_workspace_size(uint32_t raw_size, const Block_options *options)
+{
+    assert(options);
+    if (options->match_level == 0)
+        return BLOCK_WORKSPACE_SIZE;
+    return MATCHES_OFFSET + LZ77_MAX_MATCHES(raw_size) * sizeof(Lz77_match) +
+           Lz77_workspace_size(raw_size, options->window_bits);
+}
+
+/*
+ * Function:        Block_encode
+ * Description:     Counts characters of one block, builds its canonical
+ *                  codes and writes header, jump table and payload to dst.
+ *                  With more than one table allowed, previous bytes whose
+ *                  next characters are alike are clustered to share a
+ *                  table, and several tables are used only if they take
+ *                  fewer bits than a single one, tables included. With
+ *                  pairs allowed, the most frequent byte pairs become
+ *                  symbols of their own when that takes fewer bits than
+ *                  the tables chosen so far, the pairs included. Likewise
+ *                  with runs allowed, for runs of a byte, and with
+ *                  matches allowed, for the matches found by the LZ77
+ *                  module. A block is stored as it is instead when the
+ *                  codes chosen would not make it smaller, and filled
+ *                  with its byte when it has a single one
+ * Parameters:      uint8_t *src: bytes of the block
+ *                  uint32_t raw_size: number of bytes in the block, > 0
+ *                  Block_options *options: maximum length of codes, number
+ *                  of streams, 1, 4 or 8, of tables, 1 to
+ *                  BLOCK_MAX_TABLES, and of pairs, 0 to BLOCK_MAX_PAIRS,
+ *                  whether runs are allowed, and the level, 0 to
+ *                  LZ77_MAX_LEVEL, and window of matches
+ *                  uint8_t *dst: output of at least Block_bound bytes
+ *                  void *workspace: Block_workspace_size bytes aligned like
+ *                  malloc, so that nothing is allocated
+ *                  Stats *stats: updated with timings and codes, or NULL
+ * Return:          size_t: number of bytes written to dst
+ */
+size_t Block_encode(const uint8_t *src, uint32_t raw_size,
+                    const Block_options *options, uint8_t *dst,
+                    void *workspace, Stats *stats)
+{
+    assert(src && options && dst && workspace && raw_size > 0);
+    unsigned num_streams = options->num_streams;
+    assert(num_streams == 1 || num_streams == 4 || num_streams == 8);
+    assert(options->max_tables >= 1 && options->max_tables <= BLOCK_MAX_TABLES);
+    assert(options->max_pairs <= BLOCK_MAX_PAIRS);
+    assert(options->match_level <= LZ77_MAX_LEVEL);
+    assert(sizeof(Encode_workspace) <= BLOCK_WORKSPACE_SIZE);
+    Encode_workspace *space = workspace;
+
+    // Count characters of this block only, and after each byte when
+    // several tables or pairs are allowed, then find its matches
+    double start = Stats_start(stats);
+    uint64_t counts[HISTOGRAM_SIZE] = {0};
+    if (options->max_tables > 1 || options->max_pairs > 0)
+        count_pairs(src, raw_size, space->pair_counts, counts);
+    else
+        Histogram_count(src, raw_size, counts);
+    if (counts[src[0]] == raw_size)
+    {
+        start = Stats_lap(stats, STATS_COUNT, start);
+        size_t size = write_plain_block(src, raw_size, BLOCK_FILLED, dst);
+        Stats_lap(stats, STATS_ENCODE, start);
+        Stats_add_block(stats, counts, 0, 0, 0);
+        return size;
+    }
+    Lz77_match *matches = (Lz77_match *)((uint8_t *)workspace + MATCHES_OFFSET);
+    uint32_t num_matches = 0;
+    if (options->match_level > 0)
+        num_matches = Lz77_find_matches(src, raw_size,
+                                        raw_size > RUN_END_MARGIN ? raw_size - RUN_END_MARGIN : 0,
+                                        options->match_level, options->window_bits, matches,
+                                        matches + LZ77_MAX_MATCHES(raw_size));
+    start = Stats_lap(stats, STATS_COUNT, start);
+
+    // Build canonical codes from their lengths
+    uint8_t lengths[BLOCK_MAX_TABLES][MAX_NUM_CHAR];
+    uint8_t context_map[MAX_NUM_CHAR] = {0};
+    Canonical_code_lengths(counts, options->max_code_length, lengths[0],
+                           space->merge_lists);
+    uint64_t num_code_bits = code_bits(counts, lengths[0], MAX_NUM_CHAR);
+    unsigned num_tables = 1;
+    if (options->max_tables > 1)
+        num_tables = context_tables(space, options, lengths, context_map, &num_code_bits);
+
+    // Pairs replace the tables chosen so far if they take fewer bits, runs
+    // replace either of them, and matches any of them
+    uint64_t best_bits = num_code_bits;
+    if (num_tables > 1)
+        best_bits += (uint64_t)num_tables * TABLE_COST_BITS;
+    unsigned num_pairs = 0;
+    if (options->max_pairs > 0)
+    {
+        num_pairs = pair_symbols(space, src, raw_size, options, counts, best_bits,
+                                 &num_code_bits);
+        if (num_pairs > 0)
+        {
+            num_tables = 1;
+            memcpy(lengths[0], space->symbol_lengths, MAX_NUM_CHAR);
+            best_bits = num_code_bits +
+                        (uint64_t)num_pairs / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE_SIZE * 8;
+        }
+    }
+    unsigned num_run_symbols = 0;
+    if (options->runs)
+    {
+        num_run_symbols = run_symbols(space, src, raw_size, options, best_bits,
+                                      &num_code_bits);
+        if (num_run_symbols > 0)
+        {
+            num_tables = 1;
+            num_pairs = 0;
+            memcpy(lengths[0], space->run_lengths, MAX_NUM_CHAR);
+            best_bits = num_code_bits + BLOCK_RUN_SYMBOLS / 2 * 8;
+        }
+    }
+    unsigned num_distance_symbols = 0;
+    if (num_matches > 0)
+    {
+        num_distance_symbols = match_symbols(space, src, raw_size, options, matches,
+                                             num_matches, best_bits, &num_code_bits);
+        if (num_distance_symbols > 0)
+        {
+            num_tables = 1;
+            num_pairs = 0;
+            num_run_symbols = BLOCK_RUN_SYMBOLS;
+            memcpy(lengths[0], space->match_lengths, MAX_NUM_CHAR);
+        }
+    }
+    start = Stats_lap(stats, STATS_CODE_LENGTHS, start);
+
+    // The codes chosen are packed only if they make the block smaller, each
+    // stream ending with half a word on average, and their header longer
+    // than that of a stored block
+    uint32_t tables_size = jump_table_size(num_streams, num_tables, num_pairs,
+                                           num_run_symbols, num_distance_symbols);
+    if (num_code_bits / 8 + num_streams * sizeof(uint32_t) + tables_size +
+        BLOCK_HEADER_SIZE - BLOCK_PREFIX_SIZE >= raw_size)
+    {
+        size_t size = write_plain_block(src, raw_size, BLOCK_STORED, dst);
+        Stats_lap(stats, STATS_ENCODE, start);
+        Stats_add_block(stats, counts, (uint64_t)raw_size * 8, 8, 0);
+        return size;
+    }
+
+    const Encoded_value *context_codes[MAX_NUM_CHAR];
+    if (num_pairs > 0)
+        Canonical_alphabet_codes(space->symbol_lengths, MAX_NUM_CHAR + num_pairs,
+                                 space->symbol_codes);
+    if (num_distance_symbols > 0)
+    {
+        Canonical_alphabet_codes(space->match_lengths, RUN_ALPHABET_SIZE, space->match_codes);
+        Canonical_alphabet_codes(space->match_lengths + RUN_ALPHABET_SIZE,
+                                 BLOCK_DISTANCE_SYMBOLS, space->match_codes + RUN_ALPHABET_SIZE);
+    }
+    else if (num_run_symbols > 0)
+        Canonical_alphabet_codes(space->run_lengths, RUN_ALPHABET_SIZE, space->run_codes);
+    for (unsigned table = 0; table < num_tables; table++)
+        Canonical_codes(lengths[table], space->codes[table]);
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        context_codes[c] = space->codes[context_map[c]];
+    start = Stats_lap(stats, STATS_TABLES, start);
+
+    // Pack every stream from the top of 64-bit words, one after the other
+    uint8_t *jump_table = dst + BLOCK_HEADER_SIZE;
+    uint8_t *payload = jump_table + tables_size;
+    uint8_t *out = payload;
+    uint32_t num_bits = 0;
+    if (num_pairs > 0)
+        out = encode_pairs(space, src, raw_size, num_streams, MAX_NUM_CHAR + num_pairs,
+                           jump_table, payload, &num_bits);
+    else if (num_distance_symbols > 0)
+        out = encode_matches(space, src, raw_size, matches, num_matches, num_streams,
+                             jump_table, payload, &num_bits);
+    else if (num_run_symbols > 0)
+        out = encode_runs(space, src, raw_size, num_streams, jump_table, payload, &num_bits);
+    else
+    {
+        for (unsigned stream = 0; stream < num_streams; stream++)
+        {
+            Bit_writer writer;
+            Bit_writer_init(&writer, out);
+            uint32_t i = stream;
+            if (num_tables == 1)
+            {
+                for (; i < raw_size; i += num_streams)
+                {
+                    Encoded_value code = space->codes[0][src[i]];
+                    Bit_writer_put(&writer, code.bit_value, code.bit_length);
+                }
+            }
+            else
+            {
+                // The first character follows a zero byte
+                if (i == 0)
+                {
+                    Encoded_value code = context_codes[0][src[0]];
+                    Bit_writer_put(&writer, code.bit_value, code.bit_length);
+                    i += num_streams;
+                }
+                for (; i < raw_size; i += num_streams)
+                {
+                    Encoded_value code = context_codes[src[i - 1]][src[i]];
+                    Bit_writer_put(&writer, code.bit_value, code.bit_length);
+                }
+            }
+            uint32_t stream_bits = (uint32_t)Bit_writer_num_bits(&writer);
+            out += Bit_writer_flush(&writer);
+            num_bits += stream_bits;
+
+            if (stream + 1 < num_streams)
+                memcpy(jump_table + stream * sizeof(uint32_t), &stream_bits,
+                       sizeof(uint32_t));
+        }
+    }
+
+    // Header: <RAW_SIZE><NUM_BITS><NUM_STREAMS><PACKED_CODE_LENGTHS>, and
+    // the context map and other tables, the pairs, the runs or the matches
+    // after the jump table
+    memcpy(dst, &raw_size, sizeof(uint32_t));
+    dst[sizeof(uint32_t)] = BLOCK_CODED;
+    memcpy(dst + NUM_BITS_OFFSET, &num_bits, sizeof(uint32_t));
+    if (num_distance_symbols > 0)
+        dst[STREAMS_OFFSET] = (uint8_t)(num_streams << TABLES_SHIFT);
+    else if (num_pairs > 0)
+        dst[STREAMS_OFFSET] = (uint8_t)(num_streams | PAIRS_FLAG |
+                                       (num_pairs / BLOCK_PAIR_PAGE - 1) << TABLES_SHIFT);
+    else if (num_run_symbols > 0)
+        dst[STREAMS_OFFSET] = (uint8_t)(num_streams | PAIRS_FLAG |
+                                       RUNS_PAGES << TABLES_SHIFT);
+    else
+        dst[STREAMS_OFFSET] = (uint8_t)(num_streams | (num_tables - 1) << TABLES_SHIFT);
+    Canonical_pack_lengths(lengths[0], dst + LENGTHS_OFFSET);
+    uint8_t *tables = jump_table + (num_streams - 1) * sizeof(uint32_t);
+    if (num_tables > 1)
+    {
+        Canonical_pack_lengths(context_map, tables);
+        for (unsigned table = 1; table < num_tables; table++)
+            Canonical_pack_lengths(lengths[table], tables + table * CANONICAL_PACKED_SIZE);
+    }
+    if (num_pairs > 0)
+    {
+        memcpy(tables, space->pairs, num_pairs * sizeof(space->pairs[0]));
+        Canonical_alphabet_pack_lengths(space->symbol_lengths + MAX_NUM_CHAR, num_pairs,
+                                        tables + num_pairs * sizeof(space->pairs[0]));
+    }
+    if (num_distance_symbols > 0)
+    {
+        Canonical_alphabet_pack_lengths(space->match_lengths + MAX_NUM_CHAR, BLOCK_RUN_SYMBOLS,
+                                        tables);
+        Canonical_alphabet_pack_lengths(space->match_lengths + RUN_ALPHABET_SIZE,
+                                        BLOCK_DISTANCE_SYMBOLS, tables + BLOCK_RUN_SYMBOLS / 2);
+    }
+    else if (num_run_symbols > 0)
+        Canonical_alphabet_pack_lengths(space->run_lengths + MAX_NUM_CHAR, BLOCK_RUN_SYMBOLS,
+                                        tables);
+
+    // The words the streams end with may take more bytes than estimated,
+    // and the block is then stored after all, so that no block grows by
+    // more than the header of a stored block
+    if ((size_t)(out - dst) > BLOCK_PREFIX_SIZE + raw_size)
+    {
+        size_t size = write_plain_block(src, raw_size, BLOCK_STORED, dst);
+        Stats_lap(stats, STATS_ENCODE, start);
+        Stats_add_block(stats, counts, (uint64_t)raw_size * 8, 8, 0);
+        return size;
+    }
+    Stats_lap(stats, STATS_ENCODE, start);
+
+    unsigned longest = 0;
+    if (num_pairs > 0)
+        longest = max_length(space->symbol_lengths, MAX_NUM_CHAR + num_pairs);
+    if (num_distance_symbols > 0)
+        longest = max_length(space->match_lengths, MATCH_ALPHABET_SIZE);
+    else if (num_run_symbols > 0)
+        longest = max_length(space->run_lengths, RUN_ALPHABET_SIZE);
+    for (unsigned table = 0; num_pairs == 0 && num_run_symbols == 0 &&
+         table < num_tables; table++)
+        if (max_length(lengths[table], MAX_NUM_CHAR) > longest)
+            longest = max_length(lengths[table], MAX_NUM_CHAR);
+    Stats_add_block(stats, counts, num_code_bits, longest,
+                    (out - payload) / sizeof(uint64_t));
+    return out - dst;
+}
+
+/*
+ * Function:        Block_payload_size
+ * Description:     Gets the number of bytes holding num_bits encoded bits
+ * Parameters:      uint32_t num_bits: number of encoded bits
+ * Return:          uint32_t: size of the payload, a whole number of words
+ */
+uint32_t Block_payload_size(uint32_t num_bits)
+{
+    uint32_t num_words = num_bits / SIZE_OF_UINT64_IN_BITS +
+                         (num_bits % SIZE_OF_UINT64_IN_BITS != 0);
+    return num_words * sizeof(uint64_t);
+}
+
+/*
+ * Function:        Block_header_size
+ * Description:     Gets the size of a block header from the mode in its
+ *                  first BLOCK_PREFIX_SIZE bytes. Raises Block_Corrupted
+ *                  if the mode is unknown
+ * Parameters:      uint8_t *src: BLOCK_PREFIX_SIZE bytes of the header
+ * Return:          size_t: bytes of the header, BLOCK_HEADER_SIZE for a
+ *                  coded block
+ */
+size_t Block_header_size(const uint8_t *src)
+{
+    assert(src);
+    uint8_t coding = src[sizeof(uint32_t)];
+    if (coding == BLOCK_STORED)
+        return BLOCK_PREFIX_SIZE;
+    if (coding == BLOCK_FILLED)
+        return FILLED_HEADER_SIZE;
+    if (coding != BLOCK_CODED)
+        RAISE(Block_Corrupted);
+    return BLOCK_HEADER_SIZE;
+}
+
+/*
+ * Function:        Block_read_header
+ * Description:     Parses the Block_header_size bytes of a block header,
+ *                  up to its jump table of header->jump_table_size bytes.
+ *                  Raises Block_Corrupted if the mode is unknown or the
+ *                  sizes are inconsistent
+ * Parameters:      uint8_t *src: bytes of the header
+ *                  Block_header *header: updated after the function is called
+ * Return:          void
+ */
+void Block_read_header(const uint8_t *src, Block_header *header)
+{
+    assert(src && header);
+    memcpy(&header->raw_size, src, sizeof(uint32_t));
+    header->header_size = (uint32_t)Block_header_size(src);
+    header->coding = src[sizeof(uint32_t)];
+    header->num_streams = 1;
+    header->num_tables = 1;
+    header->num_pairs = 0;
+    header->num_run_symbols = 0;
+    header->num_distance_symbols = 0;
+    memset(header->context_map, 0, sizeof(header->context_map));
+    if (header->coding != BLOCK_CODED)
+    {
+        read_plain_header(src, header);
+        return;
+    }
+    memcpy(&header->num_bits, src + NUM_BITS_OFFSET, sizeof(uint32_t));
+    uint8_t streams = src[STREAMS_OFFSET];
+    header->num_streams = streams & STREAMS_MASK;
+    Canonical_unpack_lengths(src + LENGTHS_OFFSET, header->lengths[0]);
+    if ((streams & MATCHES_MASK) == 0)
+    {
+        header->num_streams = streams >> TABLES_SHIFT;
+        header->num_run_symbols = BLOCK_RUN_SYMBOLS;
+        header->num_distance_symbols = BLOCK_DISTANCE_SYMBOLS;
+    }
+    else if ((streams & PAIRS_FLAG) && (streams >> TABLES_SHIFT) == RUNS_PAGES)
+        header->num_run_symbols = BLOCK_RUN_SYMBOLS;
+    else if (streams & PAIRS_FLAG)
+        header->num_pairs = ((streams >> TABLES_SHIFT) + 1) * BLOCK_PAIR_PAGE;
+    else
+        header->num_tables = (streams >> TABLES_SHIFT) + 1;
+
+    // Every character takes between 1 and CANONICAL_MAX_CODE_LENGTH bits,
+    // a pair of them at least 1 bit, and a run or match of them at most as
+    // many bits and at least 1
+    uint32_t min_bits = header->raw_size;
+    if (header->num_pairs > 0)
+        min_bits = header->raw_size / 2 + header->raw_size % 2;
+    if (header->num_run_symbols > 0)
+        min_bits = header->raw_size > 0;
+    if (header->num_bits < min_bits ||
+        (uint64_t)header->num_bits > (uint64_t)header->raw_size * CANONICAL_MAX_CODE_LENGTH)
+        RAISE(Block_Corrupted);
+    if (header->num_streams != 1 && header->num_streams != 4 && header->num_streams != 8)
+        RAISE(Block_Corrupted);
+    if (header->num_pairs > BLOCK_MAX_PAIRS)
+        RAISE(Block_Corrupted);
+
+    header->jump_table_size = jump_table_size(header->num_streams, header->num_tables,
+                                              header->num_pairs, header->num_run_symbols,
+                                              header->num_distance_symbols);
+    header->stream_bits[0] = header->num_bits;
+    header->payload_size = Block_payload_size(header->num_bits);
+}
+
+/*
+ * Function:        Block_read_jump_table
+ * Description:     Parses the jump table following the header and sets the
+ *                  size of every stream, then the context map and code
+ *                  lengths of a block with several tables, the pairs
+ *                  and their code lengths, or the code lengths of runs,
+ *                  or of the lengths and distances of matches. Raises
+ *                  Block_Corrupted if the sizes or tables are inconsistent
+ * Parameters:      uint8_t *src: header->jump_table_size bytes of the table
+ *                  Block_header *header: header parsed by Block_read_header,
+ *                  updated after the function is called
+ * Return:          void
+ */
+void Block_read_jump_table(const uint8_t *src, Block_header *header)
+{
+    assert(src && header);
+    if (header->coding != BLOCK_CODED)
+        return;
+    uint32_t bits_left = header->num_bits;
+    header->payload_size = 0;
+    for (unsigned stream = 0; stream < header->num_streams; stream++)
+    {
+        uint32_t stream_bits = bits_left;
+        if (stream + 1 < header->num_streams)
+            memcpy(&stream_bits, src + stream * sizeof(uint32_t), sizeof(uint32_t));
+
+        // Same bounds as the whole block, for the characters of this stream.
+        // With pairs, the stream holds no more symbols than characters, and
+        // with runs or matches, its symbols may stand for any number of them
+        uint32_t length = stream_length(header->raw_size, header->num_streams, stream);
+        uint32_t min_bits = header->num_pairs > 0 || header->num_run_symbols > 0 ? 0 : length;
+        uint64_t max_bits = (uint64_t)length * CANONICAL_MAX_CODE_LENGTH;
+        if (header->num_run_symbols > 0)
+            max_bits = bits_left;
+        if (stream_bits > bits_left || stream_bits < min_bits || stream_bits > max_bits)
+            RAISE(Block_Corrupted);
+
+        header->stream_bits[stream] = stream_bits;
+        header->payload_size += Block_payload_size(stream_bits);
+        bits_left -= stream_bits;
+    }
+    const uint8_t *tables = src + (header->num_streams - 1) * sizeof(uint32_t);
+    if (header->num_tables > 1)
+        read_context_tables(tables, header);
+    if (header->num_pairs > 0)
+        read_pairs(tables, header);
+    if (header->num_run_symbols > 0)
+        Canonical_alphabet_unpack_lengths(tables, BLOCK_RUN_SYMBOLS, header->run_lengths);
+    if (header->num_distance_symbols > 0)
+        Canonical_alphabet_unpack_lengths(tables + BLOCK_RUN_SYMBOLS / 2, BLOCK_DISTANCE_SYMBOLS,
+                                          header->distance_lengths);
+}
+
+/*
+ * Function:        Block_decode
+ * Description:     Decodes the payload of a block, advancing every stream
+ *                  in the same loop, or copies or fills a stored or
+ *                  filled block at once. With several tables, each character
+ *                  is decoded in the table of the one before it. With
+ *                  pairs, each symbol gives one or two bytes. With runs,
+ *                  each run is filled at once, and with matches, each
+ *                  match is copied 8 bytes at a time. Raises
+ *                  Huffman_Invalid_Lengths if the code lengths are
+ *                  corrupted, and Block_Corrupted if pairs, runs or
+ *                  matches go past the end of the block, or a run or
+ *                  match reaches before its start
+ * Parameters:      Block_header *header: parsed header and jump table
+ *                  uint8_t *payload: header->payload_size encoded bytes
+ *                  uint8_t *dst: output of header->raw_size bytes
+ *                  void *workspace: BLOCK_DECODE_WORKSPACE_SIZE bytes aligned
+ *                  like malloc, holding the decoding tables
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          void
+ */
+void Block_decode(const Block_header *header, const uint8_t *payload,
+                  uint8_t *dst, void *workspace, Stats *stats)
+{
+    assert(header && payload && dst && workspace);
+
+    double start = Stats_start(stats);
+    if (header->coding == BLOCK_STORED)
+    {
+        memcpy(dst, payload, header->raw_size);
+        Stats_lap(stats, STATS_DECODE, start);
+        return;
+    }
+    if (header->coding == BLOCK_FILLED)
+    {
+        memset(dst, header->fill_byte, header->raw_size);
+        Stats_lap(stats, STATS_DECODE, start);
+        return;
+    }
+    Decoded_value *table = workspace;
+    unsigned root_bits = 0;
+    const Decoded_value *context_tables[MAX_NUM_CHAR];
+    const uint32_t *symbol_bytes = NULL;
+    Distance_codes distances = {NULL, 0};
+    if (header->num_pairs > 0)
+        symbol_bytes = pair_decoding_table(header, table, &root_bits);
+    else if (header->num_run_symbols > 0)
+        run_decoding_table(header, table, &root_bits, &distances);
+    else if (header->num_tables == 1)
+        Canonical_decoding_table(header->lengths[0], table, &root_bits);
+    else
+    {
+        // Every table is as wide as the root, one after the other
+        for (unsigned t = 0; t < header->num_tables; t++)
+        {
+            Decoded_value *context_table = table + (t << DECODING_TABLE_BITS);
+            Canonical_decoding_table(header->lengths[t], context_table, &root_bits);
+            widen_table(context_table, root_bits);
+        }
+        for (int c = 0; c < MAX_NUM_CHAR; c++)
+            context_tables[c] = table + (header->context_map[c] << DECODING_TABLE_BITS);
+    }
+    start = Stats_lap(stats, STATS_TABLES, start);
+
+    unsigned num_streams = header->num_streams;
+    Bit_reader readers[BLOCK_MAX_STREAMS];
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        uint32_t stream_size = Block_payload_size(header->stream_bits[stream]);
+        Bit_reader_init(&readers[stream], payload, stream_size / sizeof(uint64_t));
+        payload += stream_size;
+    }
+    if (header->num_tables > 1)
+    {
+        decode_contexts(context_tables, readers, num_streams, dst, header->raw_size);
+        Stats_lap(stats, STATS_DECODE, start);
+        return;
+    }
+    if (header->num_pairs > 0)
+    {
+        decode_pairs(table, root_bits, symbol_bytes, readers, num_streams, dst,
+                     header->raw_size);
+        Stats_lap(stats, STATS_DECODE, start);
+        return;
+    }
+    if (header->num_run_symbols > 0)
+    {
+        decode_runs(table, root_bits, distances.table ? &distances : NULL, readers,
+                    num_streams, dst, header->raw_size);
+        Stats_lap(stats, STATS_DECODE, start);
+        return;
+    }
+
+    // Streams do not depend on each other, so that the processor overlaps
+    // their table lookups within an iteration. The hot loops work on local
+    // copies of the readers and of the size, which the compiler keeps in
+    // registers since stores to dst may alias anything
+    uint32_t raw_size = header->raw_size;
+    uint32_t i = 0;
+    if (num_streams == 1)
+    {
+        Bit_reader reader = readers[0];
+        for (; i < raw_size; i++)
+            dst[i] = decode_symbol(table, root_bits, &reader);
+    }
+    else if (num_streams == 4)
+    {
+        Bit_reader reader0 = readers[0], reader1 = readers[1];
+        Bit_reader reader2 = readers[2], reader3 = readers[3];
+        for (; i + 4 <= raw_size; i += 4)
+        {
+            dst[i] = decode_symbol(table, root_bits, &reader0);
+            dst[i + 1] = decode_symbol(table, root_bits, &reader1);
+            dst[i + 2] = decode_symbol(table, root_bits, &reader2);
+            dst[i + 3] = decode_symbol(table, root_bits, &reader3);
+        }
+        readers[0] = reader0;
+        readers[1] = reader1;
+        readers[2] = reader2;
+        readers[3] = reader3;
+    }
+    else if (num_streams == 8)
+    {
+        for (; i + 8 <= raw_size; i += 8)
+            for (unsigned stream = 0; stream < 8; stream++)
+                dst[i + stream] = decode_symbol(table, root_bits, &readers[stream]);
+    }
+    for (; i < raw_size; i++)
+        dst[i] = decode_symbol(table, root_bits, &readers[i % num_streams]);
+    Stats_lap(stats, STATS_DECODE, start);
+}
+
+// Helper function to get the number of bytes following the header: the
+// jump table, then the context map and every table but the first, the
+// pages of pairs or the code lengths of runs, or of the lengths and
+// distances of matches
+static uint32_t jump_table_size(unsigned num_streams, unsigned num_tables,
+                                unsigned num_pairs, unsigned num_run_symbols,
+                                unsigned num_distance_symbols)
+{
+    uint32_t size = (num_streams - 1) * sizeof(uint32_t);
+    if (num_tables > 1)
+        size += num_tables * CANONICAL_PACKED_SIZE;
+    size += num_pairs / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE_SIZE;
+    size += num_run_symbols / 2 + num_distance_symbols / 2;
+    return size;
+}
+
+// Helper function to get the number of bits of the codes of every symbol
+static uint64_t code_bits(const uint64_t *counts, const uint8_t *lengths,
+                          unsigned num_symbols)
+{
+    uint64_t num_bits = 0;
+    for (unsigned c = 0; c < num_symbols; c++)
+        num_bits += counts[c] * lengths[c];
+    return num_bits;
+}
+
+// Helper function to get the longest of the code lengths
+static unsigned max_length(const uint8_t *lengths, unsigned num_symbols)
+{
+    unsigned longest = 0;
+    for (unsigned c = 0; c < num_symbols; c++)
+        if (lengths[c] > longest)
+            longest = lengths[c];
+    return longest;
+}
+
+// Helper function to count the characters following each byte, the first
+// one following a zero byte, and the characters of the whole block
+static void count_pairs(const uint8_t *src, uint32_t size,
+                        uint32_t (*pair_counts)[MAX_NUM_CHAR], uint64_t *counts)
+{
+    memset(pair_counts, 0, MAX_NUM_CHAR * sizeof(pair_counts[0]));
+    pair_counts[0][src[0]]++;
+    for (uint32_t i = 1; i < size; i++)
+        pair_counts[src[i - 1]][src[i]]++;
+    for (int prev = 0; prev < MAX_NUM_CHAR; prev++)
+        for (int c = 0; c < MAX_NUM_CHAR; c++)
+            counts[c] += pair_counts[prev][c];
+}
+
+// Helper function to cluster previous bytes into tables and build their
+// code lengths, no longer than the root decoding table. Returns the number
+// of tables, and updates lengths, context_map and num_bits only if the
+// tables, context map included, take fewer bits than the single table
+static unsigned context_tables(Encode_workspace *space, const Block_options *options,
+                               uint8_t (*lengths)[MAX_NUM_CHAR], uint8_t *context_map,
+                               uint64_t *num_bits)
+{
+    uint8_t table_map[MAX_NUM_CHAR];
+    unsigned num_tables = cluster_contexts((const uint32_t (*)[MAX_NUM_CHAR])space->pair_counts,
+                                           space->successors, options->max_tables,
+                                           table_map);
+    if (num_tables == 1)
+        return 1;
+
+    memset(space->table_counts, 0, num_tables * sizeof(space->table_counts[0]));
+    for (int prev = 0; prev < MAX_NUM_CHAR; prev++)
+        for (int c = 0; c < MAX_NUM_CHAR; c++)
+            space->table_counts[table_map[prev]][c] += space->pair_counts[prev][c];
+
+    unsigned max_code_length = options->max_code_length < BLOCK_CONTEXT_MAX_CODE_LENGTH ?
+                               options->max_code_length : BLOCK_CONTEXT_MAX_CODE_LENGTH;
+    uint8_t table_lengths[BLOCK_MAX_TABLES][MAX_NUM_CHAR];
+    uint64_t table_bits = 0;
+    for (unsigned table = 0; table < num_tables; table++)
+    {
+        Canonical_code_lengths(space->table_counts[table], max_code_length,
+                               table_lengths[table], space->merge_lists);
+        table_bits += code_bits(space->table_counts[table], table_lengths[table], MAX_NUM_CHAR);
+    }
+
+    // The context map and the extra tables follow the jump table
+    if (table_bits + (uint64_t)num_tables * TABLE_COST_BITS >= *num_bits)
+        return 1;
+    memcpy(lengths, table_lengths, num_tables * sizeof(table_lengths[0]));
+    memcpy(context_map, table_map, MAX_NUM_CHAR);
+    *num_bits = table_bits;
+    return num_tables;
+}
+
+// Helper function to cluster previous bytes whose next characters are
+// alike into at most max_tables tables, as k-means would: tables are
+// seeded with the previous bytes coded worst by the tables so far, then
+// each byte moves to the table coding its next characters in the fewest
+// bits. A table whose bytes would cost fewer bits than TABLE_COST_BITS
+// more in other tables is dropped. Returns the number of tables, with
+// the table of each byte in context_map
+static unsigned cluster_contexts(const uint32_t (*pair_counts)[MAX_NUM_CHAR],
+                                 uint8_t *successors, unsigned max_tables,
+                                 uint8_t *context_map)
+{
+    // Previous bytes followed by at least one character, with the list of
+    // these characters so that costs only visit non-zero counts
+    Context contexts[MAX_NUM_CHAR];
+    uint8_t context_bytes[MAX_NUM_CHAR];
+    int num_contexts = 0;
+    uint32_t num_successors = 0;
+    uint32_t most_frequent = 0;
+    int seed = 0;
+    for (int prev = 0; prev < MAX_NUM_CHAR; prev++)
+    {
+        Context *context = &contexts[num_contexts];
+        context->counts = pair_counts[prev];
+        context->next = successors + num_successors;
+        context->num_next = 0;
+        uint32_t total = 0;
+        for (int c = 0; c < MAX_NUM_CHAR; c++)
+        {
+            if (pair_counts[prev][c] == 0)
+                continue;
+            successors[num_successors++] = (uint8_t)c;
+            context->num_next++;
+            total += pair_counts[prev][c];
+        }
+        if (total == 0)
+            continue;
+        if (total > most_frequent)
+        {
+            most_frequent = total;
+            seed = num_contexts;
+        }
+        context_bytes[num_contexts++] = (uint8_t)prev;
+    }
+    memset(context_map, 0, MAX_NUM_CHAR);
+    if (num_contexts < 2)
+        return 1;
+
+    float bits[BLOCK_MAX_TABLES][MAX_NUM_CHAR];
+    float best_bits[MAX_NUM_CHAR];
+    for (int k = 0; k < num_contexts; k++)
+    {
+        estimate_bits(contexts[k].counts, bits[0]);
+        contexts[k].own_bits = context_bits(&contexts[k], bits[0]);
+        best_bits[k] = HUGE_VALF;
+    }
+
+    // Seed the first table with the most frequent previous byte
+    unsigned num_tables = 0;
+    for (;;)
+    {
+        estimate_bits(contexts[seed].counts, bits[num_tables]);
+        num_tables++;
+        float worst_loss = 0;
+        for (int k = 0; k < num_contexts; k++)
+        {
+            float k_bits = context_bits(&contexts[k], bits[num_tables - 1]);
+            if (k_bits < best_bits[k])
+                best_bits[k] = k_bits;
+            if (best_bits[k] - contexts[k].own_bits > worst_loss)
+            {
+                worst_loss = best_bits[k] - contexts[k].own_bits;
+                seed = k;
+            }
+        }
+        if (num_tables == max_tables || worst_loss < TABLE_COST_BITS)
+            break;
+    }
+    if (num_tables == 1)
+        return 1;
+
+    uint8_t assignment[MAX_NUM_CHAR];
+    for (int round = 0; round < CLUSTER_ROUNDS && num_tables > 1; round++)
+    {
+        assign_contexts(contexts, num_contexts, bits, num_tables, assignment, NULL);
+        num_tables = update_tables(contexts, num_contexts, bits, num_tables, assignment);
+    }
+
+    while (num_tables > 1)
+    {
+        float removal_bits[BLOCK_MAX_TABLES];
+        assign_contexts(contexts, num_contexts, bits, num_tables, assignment, removal_bits);
+        unsigned cheapest = 0;
+        for (unsigned table = 1; table < num_tables; table++)
+            if (removal_bits[table] < removal_bits[cheapest])
+                cheapest = table;
+        if (removal_bits[cheapest] >= TABLE_COST_BITS)
+            break;
+
+        memcpy(bits[cheapest], bits[num_tables - 1], sizeof(bits[0]));
+        num_tables--;
+        assign_contexts(contexts, num_contexts, bits, num_tables, assignment, NULL);
+        num_tables = update_tables(contexts, num_contexts, bits, num_tables, assignment);
+    }
+
+    // The tables were last estimated from this assignment, so none is empty
+    for (int k = 0; k < num_contexts; k++)
+        context_map[context_bytes[k]] = num_tables > 1 ? assignment[k] : 0;
+    return num_tables;
+}
+
+// Helper function to estimate the bits of each character in a code built
+// from counts, every character counting half an occurrence more so that
+// characters not seen yet get a long code rather than none
+static void estimate_bits(const uint32_t *counts, float *bits)
+{
+    uint64_t total = 0;
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        total += counts[c];
+    float total_bits = log2f((float)total + MAX_NUM_CHAR / 2);
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        bits[c] = total_bits - log2f((float)counts[c] + 0.5f);
+}
+
+// Helper function to estimate the bits of the characters following a
+// previous byte, coded with the given bits per character
+static float context_bits(const Context *context, const float *bits)
+{
+    float sum = 0;
+    for (int i = 0; i < context->num_next; i++)
+        sum += (float)context->counts[context->next[i]] * bits[context->next[i]];
+    return sum;
+}
+
+// Helper function to move each previous byte to the table coding it in the
+// fewest bits. If removal_bits is not NULL, it is updated with the bits
+// each table's bytes would cost more in their next best table
+static void assign_contexts(const Context *contexts, int num_contexts,
+                            float (*bits)[MAX_NUM_CHAR], unsigned num_tables,
+                            uint8_t *assignment, float *removal_bits)
+{
+    if (removal_bits)
+        for (unsigned table = 0; table < num_tables; table++)
+            removal_bits[table] = 0;
+    for (int k = 0; k < num_contexts; k++)
+    {
+        float best = HUGE_VALF, second = HUGE_VALF;
+        for (unsigned table = 0; table < num_tables; table++)
+        {
+            float k_bits = context_bits(&contexts[k], bits[table]);
+            if (k_bits < best)
+            {
+                second = best;
+                best = k_bits;
+                assignment[k] = (uint8_t)table;
+            }
+            else if (k_bits < second)
+                second = k_bits;
+        }
+        if (removal_bits)
+            removal_bits[assignment[k]] += second - best;
+    }
+}
+
+// Helper function to estimate the bits of every table again from the
+// previous bytes assigned to it, dropping tables with none. Returns the
+// number of tables left, renumbering the assignment to match
+static unsigned update_tables(const Context *contexts, int num_contexts,
+                              float (*bits)[MAX_NUM_CHAR], unsigned num_tables,
+                              uint8_t *assignment)
+{
+    uint32_t table_counts[BLOCK_MAX_TABLES][MAX_NUM_CHAR];
+    int num_bytes[BLOCK_MAX_TABLES] = {0};
+    memset(table_counts, 0, num_tables * sizeof(table_counts[0]));
+    for (int k = 0; k < num_contexts; k++)
+    {
+        num_bytes[assignment[k]]++;
+        for (int i = 0; i < contexts[k].num_next; i++)
+            table_counts[assignment[k]][contexts[k].next[i]] +=
+                contexts[k].counts[contexts[k].next[i]];
+    }
+
+    uint8_t renumber[BLOCK_MAX_TABLES];
+    unsigned num_left = 0;
+    for (unsigned table = 0; table < num_tables; table++)
+    {
+        if (num_bytes[table] == 0)
+            continue;
+        renumber[table] = (uint8_t)num_left;
+        estimate_bits(table_counts[table], bits[num_left++]);
+    }
+    for (int k = 0; k < num_contexts; k++)
+        assignment[k] = renumber[assignment[k]];
+    return num_left;
+}
+
+// Helper function to choose the most frequent byte pairs, then to parse
+// the block into bytes and pairs, counting the symbols of each stream, and
+// build the code lengths of bytes and pairs. Pairs are only chosen while
+// every symbol seen may get a code of at most max_code_length bits.
+// Returns the number of pairs, a whole number of pages, and updates
+// num_bits only if the symbols and the pairs take fewer bits than
+// best_bits
+static unsigned pair_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                             const Block_options *options, const uint64_t *counts,
+                             uint64_t best_bits, uint64_t *num_bits)
+{
+    unsigned num_bytes = 0;
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        num_bytes += counts[c] != 0;
+    unsigned max_pairs = ((unsigned)1 << options->max_code_length) - num_bytes;
+    if (options->max_pairs < max_pairs)
+        max_pairs = options->max_pairs;
+
+    unsigned num_chosen = choose_pairs((const uint32_t (*)[MAX_NUM_CHAR])space->pair_counts,
+                                       max_pairs, space->pairs, space->pair_index);
+    if (num_chosen == 0)
+        return 0;
+    unsigned num_pairs = (num_chosen + BLOCK_PAIR_PAGE - 1) / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE;
+    memset(space->pairs[num_chosen], 0, (num_pairs - num_chosen) * sizeof(space->pairs[0]));
+
+    unsigned num_symbols = MAX_NUM_CHAR + num_pairs;
+    count_symbols(src, size, (const uint16_t (*)[MAX_NUM_CHAR])space->pair_index,
+                  options->num_streams, num_symbols, space->stream_counts);
+    for (unsigned symbol = 0; symbol < num_symbols; symbol++)
+    {
+        space->symbol_counts[symbol] = 0;
+        for (unsigned stream = 0; stream < options->num_streams; stream++)
+            space->symbol_counts[symbol] += space->stream_counts[stream][symbol];
+    }
+    Canonical_alphabet_code_lengths(space->symbol_counts, num_symbols,
+                                    options->max_code_length, space->symbol_lengths,
+                                    space->merge_lists);
+
+    uint64_t symbol_bits = code_bits(space->symbol_counts, space->symbol_lengths,
+                                     num_symbols);
+    if (symbol_bits + (uint64_t)num_pairs / BLOCK_PAIR_PAGE * BLOCK_PAIR_PAGE_SIZE * 8 >=
+        best_bits)
+        return 0;
+    *num_bits = symbol_bits;
+    return num_pairs;
+}
+
+// Helper function to choose at most max_pairs byte pairs, the most
+// frequent first, among those seen at least MIN_PAIR_COUNT times. Counts
+// are bucketed from zero to the highest one, and the pairs of the last
+// bucket that does not fit whole are taken in order of bytes. Chosen pairs
+// are listed in order of bytes, with their symbol in pair_index, which is
+// 0 for the other pairs. Returns the number of pairs chosen
+static unsigned choose_pairs(const uint32_t (*pair_counts)[MAX_NUM_CHAR],
+                             unsigned max_pairs, uint8_t (*pairs)[2],
+                             uint16_t (*pair_index)[MAX_NUM_CHAR])
+{
+    uint32_t highest = 0;
+    for (int first = 0; first < MAX_NUM_CHAR; first++)
+        for (int second = 0; second < MAX_NUM_CHAR; second++)
+            if (pair_counts[first][second] > highest)
+                highest = pair_counts[first][second];
+    unsigned shift = 0;
+    while ((highest >> shift) >= NUM_COUNT_BUCKETS)
+        shift++;
+
+    uint32_t buckets[NUM_COUNT_BUCKETS] = {0};
+    for (int first = 0; first < MAX_NUM_CHAR; first++)
+        for (int second = 0; second < MAX_NUM_CHAR; second++)
+            if (pair_counts[first][second] >= MIN_PAIR_COUNT)
+                buckets[pair_counts[first][second] >> shift]++;
+
+    // Buckets from lowest up are taken whole, and the one below in part
+    int lowest = NUM_COUNT_BUCKETS;
+    unsigned num_whole = 0;
+    while (lowest > 0 && num_whole + buckets[lowest - 1] <= max_pairs)
+        num_whole += buckets[--lowest];
+    unsigned num_partial = max_pairs - num_whole;
+
+    memset(pair_index, 0, MAX_NUM_CHAR * sizeof(pair_index[0]));
+    unsigned num_pairs = 0;
+    for (int first = 0; first < MAX_NUM_CHAR; first++)
+    {
+        for (int second = 0; second < MAX_NUM_CHAR; second++)
+        {
+            uint32_t count = pair_counts[first][second];
+            if (count < MIN_PAIR_COUNT || (int)(count >> shift) < lowest - 1)
+                continue;
+            if ((int)(count >> shift) == lowest - 1)
+            {
+                if (num_partial == 0)
+                    continue;
+                num_partial--;
+            }
+            pairs[num_pairs][0] = (uint8_t)first;
+            pairs[num_pairs][1] = (uint8_t)second;
+            pair_index[first][second] = (uint16_t)(MAX_NUM_CHAR + num_pairs++);
+        }
+    }
+    return num_pairs;
+}
+
+// Helper function to parse the block from its first byte, coding a pair
+// wherever one starts and a byte otherwise, and to count the symbols of
+// each stream, symbol i going to stream i % num_streams
+static void count_symbols(const uint8_t *src, uint32_t size,
+                          const uint16_t (*pair_index)[MAX_NUM_CHAR],
+                          unsigned num_streams, unsigned num_symbols,
+                          uint32_t (*stream_counts)[BLOCK_MAX_SYMBOLS])
+{
+    for (unsigned stream = 0; stream < num_streams; stream++)
+        memset(stream_counts[stream], 0, num_symbols * sizeof(uint32_t));
+
+    // The kind of symbol is selected without a branch, which text would
+    // mispredict about as often as not
+    unsigned stream = 0, last_stream = num_streams - 1;
+    uint32_t i = 0;
+    while (i + 1 < size)
+    {
+        unsigned pair = pair_index[src[i]][src[i + 1]];
+        stream_counts[stream][pair ? pair : src[i]]++;
+        i += pair ? 2 : 1;
+        stream = (stream + 1) & last_stream;
+    }
+    if (i < size)
+        stream_counts[stream][src[i]]++;
+}
+
+// Helper function to parse the block as count_symbols does and write the
+// code of each symbol to its stream. Streams are laid out one after the
+// other, from the bits their counts take, and written side by side.
+// Returns the end of the payload
+static uint8_t *encode_pairs(const Encode_workspace *space, const uint8_t *src,
+                             uint32_t size, unsigned num_streams, unsigned num_symbols,
+                             uint8_t *jump_table, uint8_t *payload, uint32_t *num_bits)
+{
+    Bit_writer writers[BLOCK_MAX_STREAMS];
+    uint32_t stream_bits[BLOCK_MAX_STREAMS] = {0};
+    for (unsigned stream = 0; stream < num_streams; stream++)
+        for (unsigned symbol = 0; symbol < num_symbols; symbol++)
+            stream_bits[stream] += space->stream_counts[stream][symbol] *
+                                   space->symbol_codes[symbol].bit_length;
+    uint8_t *out = start_streams(stream_bits, num_streams, writers, jump_table, payload,
+                                 num_bits);
+
+    unsigned stream = 0, last_stream = num_streams - 1;
+    uint32_t i = 0;
+    while (i + 1 < size)
+    {
+        unsigned pair = space->pair_index[src[i]][src[i + 1]];
+        Encoded_value code = space->symbol_codes[pair ? pair : src[i]];
+        Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+        i += pair ? 2 : 1;
+        stream = (stream + 1) & last_stream;
+    }
+    if (i < size)
+    {
+        Encoded_value code = space->symbol_codes[src[i]];
+        Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+    }
+    for (stream = 0; stream < num_streams; stream++)
+        Bit_writer_flush(&writers[stream]);
+    return out;
+}
+
+// Helper function to parse the block into bytes and runs as count_runs
+// does, counting the symbols of each stream, and build the code lengths of
+// bytes and runs. Returns BLOCK_RUN_SYMBOLS, updating num_bits, only if
+// the codes and run lengths with the code lengths of runs take fewer bits
+// than best_bits, and 0 otherwise
+static unsigned run_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                            const Block_options *options, uint64_t best_bits,
+                            uint64_t *num_bits)
+{
+    count_runs(src, size, options->num_streams, space->run_counts, space->run_bits);
+    uint64_t run_bits = 0;
+    unsigned num_seen = 0, num_runs = 0;
+    for (unsigned symbol = 0; symbol < RUN_ALPHABET_SIZE; symbol++)
+    {
+        space->run_symbol_counts[symbol] = 0;
+        for (unsigned stream = 0; stream < options->num_streams; stream++)
+            space->run_symbol_counts[symbol] += space->run_counts[stream][symbol];
+        num_seen += space->run_symbol_counts[symbol] != 0;
+        if (symbol >= MAX_NUM_CHAR)
+            num_runs += space->run_symbol_counts[symbol] != 0;
+    }
+    if (num_runs == 0 || num_seen > (unsigned)1 << options->max_code_length)
+        return 0;
+    for (unsigned stream = 0; stream < options->num_streams; stream++)
+        run_bits += space->run_bits[stream];
+
+    Canonical_alphabet_code_lengths(space->run_symbol_counts, RUN_ALPHABET_SIZE,
+                                    options->max_code_length, space->run_lengths,
+                                    space->merge_lists);
+    run_bits += code_bits(space->run_symbol_counts, space->run_lengths, RUN_ALPHABET_SIZE);
+    if (run_bits + BLOCK_RUN_SYMBOLS / 2 * 8 >= best_bits)
+        return 0;
+    *num_bits = run_bits;
+    return BLOCK_RUN_SYMBOLS;
+}
+
+// Helper function to parse the block from its first byte, coding a run
+// wherever the byte before is repeated at least BLOCK_MIN_RUN times before
+// the last RUN_END_MARGIN bytes and a byte otherwise, and to count the
+// symbols and the bits of run lengths of each stream, symbol i going to
+// stream i % num_streams
+static void count_runs(const uint8_t *src, uint32_t size, unsigned num_streams,
+                       uint32_t (*stream_counts)[RUN_ALPHABET_SIZE], uint64_t *run_bits)
+{
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        memset(stream_counts[stream], 0, RUN_ALPHABET_SIZE * sizeof(uint32_t));
+        run_bits[stream] = 0;
+    }
+
+    // Bytes up to the next run are counted without looking for runs
+    unsigned last_stream = num_streams - 1, stream = 1 & last_stream;
+    stream_counts[0][src[0]]++;
+    uint32_t run_end = size > RUN_END_MARGIN ? size - RUN_END_MARGIN : 0;
+    uint32_t i = 1;
+    while (i < size)
+    {
+        uint32_t next = next_run(src, i, run_end);
+        if (next == run_end)
+            next = size;
+        for (; i < next; i++, stream = (stream + 1) & last_stream)
+            stream_counts[stream][src[i]]++;
+        if (i == size)
+            break;
+
+        uint32_t run = run_length(src + i, run_end - i, src[i]);
+        unsigned symbol = run_symbol(run);
+        stream_counts[stream][MAX_NUM_CHAR + symbol]++;
+        run_bits[stream] += symbol;
+        i += run;
+        stream = (stream + 1) & last_stream;
+    }
+}
+
+// Helper function to parse the block as count_runs does and write the code
+// of each symbol to its stream, followed by the length of each run.
+// Streams are written side by side as in encode_pairs. Returns the end of
+// the payload
+static uint8_t *encode_runs(const Encode_workspace *space, const uint8_t *src,
+                            uint32_t size, unsigned num_streams, uint8_t *jump_table,
+                            uint8_t *payload, uint32_t *num_bits)
+{
+    Bit_writer writers[BLOCK_MAX_STREAMS];
+    uint32_t stream_bits[BLOCK_MAX_STREAMS];
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        stream_bits[stream] = (uint32_t)space->run_bits[stream];
+        for (unsigned symbol = 0; symbol < RUN_ALPHABET_SIZE; symbol++)
+            stream_bits[stream] += space->run_counts[stream][symbol] *
+                                   space->run_codes[symbol].bit_length;
+    }
+    uint8_t *out = start_streams(stream_bits, num_streams, writers, jump_table, payload,
+                                 num_bits);
+
+    unsigned last_stream = num_streams - 1, stream = 1 & last_stream;
+    Bit_writer_put(&writers[0], space->run_codes[src[0]].bit_value,
+                   space->run_codes[src[0]].bit_length);
+    uint32_t run_end = size > RUN_END_MARGIN ? size - RUN_END_MARGIN : 0;
+    uint32_t i = 1;
+    while (i < size)
+    {
+        uint32_t next = next_run(src, i, run_end);
+        if (next == run_end)
+            next = size;
+        for (; i < next; i++, stream = (stream + 1) & last_stream)
+        {
+            Encoded_value code = space->run_codes[src[i]];
+            Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+        }
+        if (i == size)
+            break;
+
+        uint32_t run = run_length(src + i, run_end - i, src[i]);
+        unsigned symbol = run_symbol(run);
+        Encoded_value code = space->run_codes[MAX_NUM_CHAR + symbol];
+        Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+        if (symbol > 0)
+            Bit_writer_put(&writers[stream], run - BLOCK_MIN_RUN + 1 - (1u << symbol),
+                           symbol);
+        i += run;
+        stream = (stream + 1) & last_stream;
+    }
+    for (stream = 0; stream < num_streams; stream++)
+        Bit_writer_flush(&writers[stream]);
+    return out;
+}
+
+// Helper function to count the symbols of each stream of the block parsed
+// into bytes and matches, and build the code lengths of bytes and lengths
+// and of distances. Returns BLOCK_DISTANCE_SYMBOLS, updating num_bits, only
+// if the codes and the bits of lengths and distances with the code lengths
+// of both take fewer bits than best_bits, and 0 otherwise
+static unsigned match_symbols(Encode_workspace *space, const uint8_t *src, uint32_t size,
+                              const Block_options *options, const Lz77_match *matches,
+                              uint32_t num_matches, uint64_t best_bits, uint64_t *num_bits)
+{
+    count_matches(src, size, matches, num_matches, options->num_streams, space);
+    uint64_t *counts = space->match_symbol_counts;
+    uint64_t match_bits = 0;
+    unsigned num_seen = 0;
+    for (unsigned stream = 0; stream < options->num_streams; stream++)
+        match_bits += space->match_bits[stream];
+    for (unsigned symbol = 0; symbol < MATCH_ALPHABET_SIZE; symbol++)
+    {
+        counts[symbol] = 0;
+        for (unsigned stream = 0; stream < options->num_streams; stream++)
+            counts[symbol] += symbol < RUN_ALPHABET_SIZE ?
+                              space->match_counts[stream][symbol] :
+                              space->distance_counts[stream][symbol - RUN_ALPHABET_SIZE];
+        if (symbol < RUN_ALPHABET_SIZE)
+            num_seen += counts[symbol] != 0;
+    }
+    if (num_seen > (unsigned)1 << options->max_code_length)
+        return 0;
+
+    Canonical_alphabet_code_lengths(counts, RUN_ALPHABET_SIZE, options->max_code_length,
+                                    space->match_lengths, space->merge_lists);
+    Canonical_alphabet_code_lengths(counts + RUN_ALPHABET_SIZE, BLOCK_DISTANCE_SYMBOLS,
+                                    options->max_code_length,
+                                    space->match_lengths + RUN_ALPHABET_SIZE,
+                                    space->merge_lists);
+    match_bits += code_bits(counts, space->match_lengths, MATCH_ALPHABET_SIZE);
+    if (match_bits + (BLOCK_RUN_SYMBOLS + BLOCK_DISTANCE_SYMBOLS) / 2 * 8 >= best_bits)
+        return 0;
+    *num_bits = match_bits;
+    return BLOCK_DISTANCE_SYMBOLS;
+}
+
+// Helper function to count the bytes between matches and the length and
+// distance symbols of each match, with the bits of their lengths and
+// distances, in each stream, symbol i going to stream i % num_streams
+static void count_matches(const uint8_t *src, uint32_t size, const Lz77_match *matches,
+                          uint32_t num_matches, unsigned num_streams,
+                          Encode_workspace *space)
+{
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        memset(space->match_counts[stream], 0, sizeof(space->match_counts[0]));
+        memset(space->distance_counts[stream], 0, sizeof(space->distance_counts[0]));
+        space->match_bits[stream] = 0;
+    }
+
+    unsigned last_stream = num_streams - 1, stream = 0;
+    uint32_t i = 0;
+    for (uint32_t m = 0; m < num_matches; m++)
+    {
+        for (; i < matches[m].position; i++, stream = (stream + 1) & last_stream)
+            space->match_counts[stream][src[i]]++;
+        unsigned length_symbol = run_symbol(matches[m].length);
+        unsigned distance = distance_symbol(matches[m].distance);
+        space->match_counts[stream][MAX_NUM_CHAR + length_symbol]++;
+        space->distance_counts[stream][distance]++;
+        space->match_bits[stream] += length_symbol + distance;
+        i += matches[m].length;
+        stream = (stream + 1) & last_stream;
+    }
+    for (; i < size; i++, stream = (stream + 1) & last_stream)
+        space->match_counts[stream][src[i]]++;
+}
+
+// Helper function to write the code of each byte and match to its stream
+// as count_matches counts them, each length code being followed by the
+// bits of the length, the distance code and the bits of the distance.
+// Streams are written side by side as in encode_pairs. Returns the end of
+// the payload
+static uint8_t *encode_matches(const Encode_workspace *space, const uint8_t *src,
+                               uint32_t size, const Lz77_match *matches,
+                               uint32_t num_matches, unsigned num_streams,
+                               uint8_t *jump_table, uint8_t *payload, uint32_t *num_bits)
+{
+    const Encoded_value *codes = space->match_codes;
+    const Encoded_value *distance_codes = space->match_codes + RUN_ALPHABET_SIZE;
+    Bit_writer writers[BLOCK_MAX_STREAMS];
+    uint32_t stream_bits[BLOCK_MAX_STREAMS];
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        stream_bits[stream] = (uint32_t)space->match_bits[stream];
+        for (unsigned symbol = 0; symbol < RUN_ALPHABET_SIZE; symbol++)
+            stream_bits[stream] += space->match_counts[stream][symbol] *
+                                   codes[symbol].bit_length;
+        for (unsigned symbol = 0; symbol < BLOCK_DISTANCE_SYMBOLS; symbol++)
+            stream_bits[stream] += space->distance_counts[stream][symbol] *
+                                   distance_codes[symbol].bit_length;
+    }
+    uint8_t *out = start_streams(stream_bits, num_streams, writers, jump_table, payload,
+                                 num_bits);
+
+    unsigned last_stream = num_streams - 1, stream = 0;
+    uint32_t i = 0;
+    for (uint32_t m = 0; m <= num_matches; m++)
+    {
+        uint32_t next = m < num_matches ? matches[m].position : size;
+        for (; i < next; i++, stream = (stream + 1) & last_stream)
+            Bit_writer_put(&writers[stream], codes[src[i]].bit_value, codes[src[i]].bit_length);
+        if (m == num_matches)
+            break;
+
+        uint32_t length = matches[m].length, distance = matches[m].distance;
+        unsigned length_symbol = run_symbol(length);
+        unsigned distance_bits = distance_symbol(distance);
+        Encoded_value code = codes[MAX_NUM_CHAR + length_symbol];
+        Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+        if (length_symbol > 0)
+            Bit_writer_put(&writers[stream], length - BLOCK_MIN_MATCH + 1 - (1u << length_symbol),
+                           length_symbol);
+        code = distance_codes[distance_bits];
+        Bit_writer_put(&writers[stream], code.bit_value, code.bit_length);
+        if (distance_bits > 0)
+            Bit_writer_put(&writers[stream], distance - (1u << distance_bits), distance_bits);
+        i += length;
+        stream = (stream + 1) & last_stream;
+    }
+    for (stream = 0; stream < num_streams; stream++)
+        Bit_writer_flush(&writers[stream]);
+    return out;
+}
+
+// Helper function to write a block that is stored or filled, whose header
+// is its raw size and mode, followed by its bytes or the byte filling it.
+// Returns the number of bytes written
+static size_t write_plain_block(const uint8_t *src, uint32_t raw_size, unsigned coding,
+                                uint8_t *dst)
+{
+    memcpy(dst, &raw_size, sizeof(uint32_t));
+    dst[sizeof(uint32_t)] = (uint8_t)coding;
+    if (coding == BLOCK_FILLED)
+    {
+        dst[BLOCK_PREFIX_SIZE] = src[0];
+        return FILLED_HEADER_SIZE;
+    }
+    memcpy(dst + BLOCK_PREFIX_SIZE, src, raw_size);
+    return BLOCK_PREFIX_SIZE + raw_size;
+}
+
+// Helper function to start a writer for each stream of the given number of
+// bits, streams being laid out one after the other, and to write their
+// sizes to the jump table. Returns the end of the payload
+static uint8_t *start_streams(const uint32_t *stream_bits, unsigned num_streams,
+                              Bit_writer *writers, uint8_t *jump_table,
+                              uint8_t *payload, uint32_t *num_bits)
+{
+    uint8_t *out = payload;
+    *num_bits = 0;
+    for (unsigned stream = 0; stream < num_streams; stream++)
+    {
+        Bit_writer_init(&writers[stream], out);
+        out += Block_payload_size(stream_bits[stream]);
+        *num_bits += stream_bits[stream];
+
+        if (stream + 1 < num_streams)
+            memcpy(jump_table + stream * sizeof(uint32_t), &stream_bits[stream],
+                   sizeof(uint32_t));
+    }
+    return out;
+}
+
+// Helper function to find the first position from i where the byte before
+// is repeated at least BLOCK_MIN_RUN times before end. Bytes are compared
+// with the ones before them 8 at a time, moving by fewer bytes so that
+// every run starting among the first ones is seen whole. Up to 7 bytes
+// past end are read, which the RUN_END_MARGIN bytes after it cover.
+// Returns end if there is no such position
+static uint32_t next_run(const uint8_t *src, uint32_t i, uint32_t end)
+{
+    if (i + BLOCK_MIN_RUN > end)
+        return end;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const uint64_t low_bits = 0x7F7F7F7F7F7F7F7FULL;
+    for (; i < end; i += sizeof(uint64_t) - BLOCK_MIN_RUN + 1)
+    {
+        uint64_t word, previous;
+        memcpy(&word, src + i, sizeof(uint64_t));
+        memcpy(&previous, src + i - 1, sizeof(uint64_t));
+
+        // The top bit of each byte is set where a byte equals the one before
+        uint64_t diff = word ^ previous;
+        uint64_t equal = ~(((diff & low_bits) + low_bits) | diff | low_bits);
+        uint64_t runs = equal;
+        for (unsigned repeat = 1; repeat < BLOCK_MIN_RUN; repeat++)
+            runs &= equal >> 8 * repeat;
+        if (runs)
+        {
+            i += __builtin_ctzll(runs) / 8;
+            break;
+        }
+    }
+#else
+    while (i < end && run_length(src + i, end - i, src[i - 1]) < BLOCK_MIN_RUN)
+        i++;
+#endif
+    return i + BLOCK_MIN_RUN <= end ? i : end;
+}
+
+// Helper function to get the number of bytes equal to c from the top of
+// src, comparing 8 bytes at a time
+static uint32_t run_length(const uint8_t *src, uint32_t size, uint8_t c)
+{
+    uint64_t pattern = 0x0101010101010101ULL * c;
+    uint32_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, src + i, sizeof(uint64_t));
+        if (word != pattern)
+        {
+            // The first differing byte is the lowest one in memory order
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + __builtin_ctzll(word ^ pattern) / 8;
+#else
+            return i + __builtin_clzll(word ^ pattern) / 8;
+#endif
+        }
+    }
+    while (i < size && src[i] == c)
+        i++;
+    return i;
+}
+
+// Helper function to get the run symbol of a run of at least BLOCK_MIN_RUN
+// bytes, the number of bits of its length after the code
+static unsigned run_symbol(uint32_t run)
+{
+    return 31 - __builtin_clz(run - BLOCK_MIN_RUN + 1);
+}
+
+// Helper function to get the distance symbol of a match, the number of bits
+// of its distance after the code
+static unsigned distance_symbol(uint32_t distance)
+{
+    return 31 - __builtin_clz(distance);
+}
+
+// Helper function to finish parsing the header of a stored or filled
+// block, whose payload is its bytes or nothing. Raises Block_Corrupted if
+// the block is empty
+static void read_plain_header(const uint8_t *src, Block_header *header)
+{
+    if (header->raw_size == 0)
+        RAISE(Block_Corrupted);
+    if (header->coding == BLOCK_FILLED)
+        header->fill_byte = src[BLOCK_PREFIX_SIZE];
+    header->num_bits = 0;
+    header->jump_table_size = 0;
+    header->stream_bits[0] = 0;
+    header->payload_size = header->coding == BLOCK_STORED ? header->raw_size : 0;
+}
+
+// Helper function to parse the context map and the code lengths of every
+// table but the first, which must be no longer than the root decoding
+// table. Raises Block_Corrupted otherwise
+static void read_context_tables(const uint8_t *src, Block_header *header)
+{
+    Canonical_unpack_lengths(src, header->context_map);
+    for (unsigned table = 1; table < header->num_tables; table++)
+        Canonical_unpack_lengths(src + table * CANONICAL_PACKED_SIZE, header->lengths[table]);
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        if (header->context_map[c] >= header->num_tables)
+            RAISE(Block_Corrupted);
+    for (unsigned table = 0; table < header->num_tables; table++)
+        if (max_length(header->lengths[table], MAX_NUM_CHAR) > BLOCK_CONTEXT_MAX_CODE_LENGTH)
+            RAISE(Block_Corrupted);
+}
+
+// Helper function to parse the bytes and the code lengths of every pair
+static void read_pairs(const uint8_t *src, Block_header *header)
+{
+    memcpy(header->pairs, src, header->num_pairs * sizeof(header->pairs[0]));
+    Canonical_alphabet_unpack_lengths(src + header->num_pairs * sizeof(header->pairs[0]),
+                                      header->num_pairs, header->pair_lengths);
+}
+
+// Helper function to build the decoding table of bytes and pairs, followed
+// in the workspace by the bytes of every symbol: the first one in the low
+// byte, the second one of a pair above it, and the number of bytes in the
+// high half. Returns the bytes of every symbol
+static const uint32_t *pair_decoding_table(const Block_header *header,
+                                           Decoded_value *table, unsigned *root_bits)
+{
+    unsigned num_symbols = MAX_NUM_CHAR + header->num_pairs;
+    uint8_t lengths[BLOCK_MAX_SYMBOLS];
+    memcpy(lengths, header->lengths[0], MAX_NUM_CHAR);
+    memcpy(lengths + MAX_NUM_CHAR, header->pair_lengths, header->num_pairs);
+    Canonical_alphabet_decoding_table(lengths, num_symbols, table, root_bits);
+
+    uint32_t *symbol_bytes =
+        (uint32_t *)(table + CANONICAL_ALPHABET_DECODING_TABLE_SIZE(BLOCK_MAX_SYMBOLS));
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        symbol_bytes[c] = (uint32_t)c | (uint32_t)1 << 16;
+    for (unsigned pair = 0; pair < header->num_pairs; pair++)
+        symbol_bytes[MAX_NUM_CHAR + pair] = header->pairs[pair][0] |
+                                            (uint32_t)header->pairs[pair][1] << 8 |
+                                            (uint32_t)2 << 16;
+    return symbol_bytes;
+}
+
+// Helper function to build the decoding table of bytes and runs, or of
+// bytes and match lengths, followed in the workspace by the decoding table
+// of distances
+static void run_decoding_table(const Block_header *header, Decoded_value *table,
+                               unsigned *root_bits, Distance_codes *distances)
+{
+    uint8_t lengths[RUN_ALPHABET_SIZE];
+    memcpy(lengths, header->lengths[0], MAX_NUM_CHAR);
+    memcpy(lengths + MAX_NUM_CHAR, header->run_lengths, BLOCK_RUN_SYMBOLS);
+    Canonical_alphabet_decoding_table(lengths, RUN_ALPHABET_SIZE, table, root_bits);
+    if (header->num_distance_symbols == 0)
+        return;
+
+    Decoded_value *distance_table = table + CANONICAL_ALPHABET_DECODING_TABLE_SIZE(
+                                                RUN_ALPHABET_SIZE);
+    Canonical_alphabet_decoding_table(header->distance_lengths, BLOCK_DISTANCE_SYMBOLS,
+                                      distance_table, &distances->root_bits);
+    distances->table = distance_table;
+}
+
+// Helper function to repeat the entries of a root table indexed by bits
+// bits over DECODING_TABLE_BITS bits, whose low bits they ignore. Going
+// down, every entry is copied before being overwritten
+static void widen_table(Decoded_value *table, unsigned bits)
+{
+    unsigned shift = DECODING_TABLE_BITS - bits;
+    if (shift == 0)
+        return;
+    for (uint32_t i = ((uint32_t)1 << DECODING_TABLE_BITS) - 1; i > 0; i--)
+        table[i] = table[i >> shift];
+}
+
+// Helper function to decode a block with several tables, each character
+// in the table of the previous one. Streams are still advanced in the same
+// loop, but each lookup waits for the character before it
+static void decode_contexts(const Decoded_value *const *context_tables,
+                            Bit_reader *readers, unsigned num_streams,
+                            uint8_t *dst, uint32_t raw_size)
+{
+    uint8_t prev = 0;
+    uint32_t i = 0;
+    if (num_streams == 1)
+    {
+        Bit_reader reader = readers[0];
+        for (; i < raw_size; i++)
+            prev = dst[i] = decode_context_symbol(context_tables[prev], &reader);
+    }
+    else if (num_streams == 4)
+    {
+        Bit_reader reader0 = readers[0], reader1 = readers[1];
+        Bit_reader reader2 = readers[2], reader3 = readers[3];
+        for (; i + 4 <= raw_size; i += 4)
+        {
+            prev = dst[i] = decode_context_symbol(context_tables[prev], &reader0);
+            prev = dst[i + 1] = decode_context_symbol(context_tables[prev], &reader1);
+            prev = dst[i + 2] = decode_context_symbol(context_tables[prev], &reader2);
+            prev = dst[i + 3] = decode_context_symbol(context_tables[prev], &reader3);
+        }
+        readers[0] = reader0;
+        readers[1] = reader1;
+        readers[2] = reader2;
+        readers[3] = reader3;
+    }
+    else if (num_streams == 8)
+    {
+        for (; i + 8 <= raw_size; i += 8)
+            for (unsigned stream = 0; stream < 8; stream++)
+                prev = dst[i + stream] = decode_context_symbol(context_tables[prev],
+                                                               &readers[stream]);
+    }
+    for (; i < raw_size; i++)
+        prev = dst[i] = decode_context_symbol(context_tables[prev], &readers[i % num_streams]);
+}
+
+// Helper function to decode a block of bytes and pairs, symbol i from
+// stream i % num_streams. Every symbol stores two bytes, the second one
+// being overwritten by the next symbol when it stands for a single byte,
+// so that the loops do not branch on the kind of symbol. The last symbols
+// are decoded one at a time, checking that they end with the block
+static void decode_pairs(const Decoded_value *table, unsigned root_bits,
+                         const uint32_t *symbol_bytes, Bit_reader *readers,
+                         unsigned num_streams, uint8_t *dst, uint32_t raw_size)
+{
+    uint8_t *end = dst + raw_size;
+    if (num_streams == 1)
+    {
+        Bit_reader reader = readers[0];
+        while (end - dst >= 2)
+            dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits, &reader)]);
+        readers[0] = reader;
+    }
+    else if (num_streams == 4)
+    {
+        Bit_reader reader0 = readers[0], reader1 = readers[1];
+        Bit_reader reader2 = readers[2], reader3 = readers[3];
+        while (end - dst >= 8)
+        {
+            dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits, &reader0)]);
+            dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits, &reader1)]);
+            dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits, &reader2)]);
+            dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits, &reader3)]);
+        }
+        readers[0] = reader0;
+        readers[1] = reader1;
+        readers[2] = reader2;
+        readers[3] = reader3;
+    }
+    else if (num_streams == 8)
+    {
+        while (end - dst >= 16)
+            for (unsigned stream = 0; stream < 8; stream++)
+                dst = put_symbol(dst, symbol_bytes[decode_symbol(table, root_bits,
+                                                                 &readers[stream])]);
+    }
+
+    // Every stream was advanced as often, so the next symbol is in the first
+    for (unsigned stream = 0; dst < end; stream = (stream + 1) % num_streams)
+    {
+        uint32_t bytes = symbol_bytes[decode_symbol(table, root_bits, &readers[stream])];
+        if ((bytes >> 16) > (uint32_t)(end - dst))
+            RAISE(Block_Corrupted);
+        dst[0] = (uint8_t)bytes;
+        if ((bytes >> 16) == 2)
+            dst[1] = (uint8_t)(bytes >> 8);
+        dst += bytes >> 16;
+    }
+}
+
+// Helper function to decode a block of bytes and runs, or of bytes and
+// matches when distances is not NULL, symbol i from stream i % num_streams.
+// No run or match ends within the last RUN_END_MARGIN bytes, so that after
+// one the loops have room for the bytes of their round. Each run is filled
+// at once, as a repeat of the byte before it, and each match copied
+static void decode_runs(const Decoded_value *table, unsigned root_bits,
+                        const Distance_codes *distances, Bit_reader *readers,
+                        unsigned num_streams, uint8_t *dst, uint32_t raw_size)
+{
+    const uint8_t *start = dst, *end = dst + raw_size;
+    if (num_streams == 1)
+    {
+        Bit_reader reader = readers[0];
+        while (dst < end)
+            dst = put_run_symbol(dst, start, end,
+                                 decode_symbol(table, root_bits, &reader), &reader,
+                                 distances);
+        return;
+    }
+    if (num_streams == 4)
+    {
+        Bit_reader reader0 = readers[0], reader1 = readers[1];
+        Bit_reader reader2 = readers[2], reader3 = readers[3];
+        while (end - dst >= 4)
+        {
+            dst = put_run_symbol(dst, start, end,
+                                 decode_symbol(table, root_bits, &reader0), &reader0,
+                                 distances);
+            dst = put_run_symbol(dst, start, end,
+                                 decode_symbol(table, root_bits, &reader1), &reader1,
+                                 distances);
+            dst = put_run_symbol(dst, start, end,
+                                 decode_symbol(table, root_bits, &reader2), &reader2,
+                                 distances);
+            dst = put_run_symbol(dst, start, end,
+                                 decode_symbol(table, root_bits, &reader3), &reader3,
+                                 distances);
+        }
+        readers[0] = reader0;
+        readers[1] = reader1;
+        readers[2] = reader2;
+        readers[3] = reader3;
+    }
+    else
+    {
+        while (end - dst >= 8)
+            for (unsigned stream = 0; stream < 8; stream++)
+                dst = put_run_symbol(dst, start, end,
+                                     decode_symbol(table, root_bits, &readers[stream]),
+                                     &readers[stream], distances);
+    }
+
+    // Every stream was advanced as often, so the next symbol is in the first
+    for (unsigned stream = 0; dst < end; stream = (stream + 1) % num_streams)
+        dst = put_run_symbol(dst, start, end,
+                             decode_symbol(table, root_bits, &readers[stream]),
+                             &readers[stream], distances);
+}
+
+// Helper function to fill the run of a run symbol, reading its length from
+// the stream of the symbol, or to copy the match of a length symbol when
+// distances is not NULL, reading its distance after its length. Raises
+// Block_Corrupted if the run or match reaches before the start of the
+// block or ends within the last RUN_END_MARGIN bytes. Returns the position
+// after the run or match
+static uint8_t *fill_run(uint8_t *dst, const uint8_t *start, const uint8_t *end,
+                         uint16_t symbol, Bit_reader *reader,
+                         const Distance_codes *distances)
+{
+    unsigned length_bits = symbol - MAX_NUM_CHAR;
+    uint64_t run = BLOCK_MIN_RUN - 1 + ((uint64_t)1 << length_bits);
+    if (length_bits > 0)
+    {
+        Bit_reader_refill(reader);
+        run += Bit_reader_peek(reader, length_bits);
+        Bit_reader_consume(reader, length_bits);
+    }
+    uint64_t distance = 1;
+    if (distances)
+    {
+        unsigned distance_bits = decode_symbol(distances->table, distances->root_bits, reader);
+        distance = (uint64_t)1 << distance_bits;
+        if (distance_bits > 0)
+        {
+            Bit_reader_refill(reader);
+            distance += Bit_reader_peek(reader, distance_bits);
+            Bit_reader_consume(reader, distance_bits);
+        }
+    }
+    if (distance > (uint64_t)(dst - start) || run + RUN_END_MARGIN > (uint64_t)(end - dst))
+        RAISE(Block_Corrupted);
+    if (distance == 1)
+        memset(dst, dst[-1], run);
+    else
+        copy_match(dst, distance, run);
+    return dst + run;
+}
+
+// Helper function to copy length bytes from distance bytes back, 8 bytes at
+// a time, storing up to 7 bytes past them. Bytes less than 8 bytes back
+// repeat with a period of the distance, and are copied one at a time until
+// a whole number of periods spans at least 8 bytes, which the rest is then
+// copied from
+static void copy_match(uint8_t *dst, uint64_t distance, uint64_t length)
+{
+    uint64_t i = 0;
+    if (distance < sizeof(uint64_t))
+    {
+        const uint8_t *from = dst - distance;
+        uint64_t period = (sizeof(uint64_t) + distance - 1) / distance * distance;
+        for (; i < period && i < length; i++)
+            dst[i] = from[i];
+        distance = period;
+    }
+    for (; i < length; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, dst + i - distance, sizeof(uint64_t));
+        memcpy(dst + i, &word, sizeof(uint64_t));
+    }
+}
+
+// Helper function to get the number of characters encoded in a stream
+static uint32_t stream_length(uint32_t raw_size, unsigned num_streams,
+                              unsigned stream)
+{
+    return raw_size / num_streams + (stream < raw_size % num_streams);
+}
+
+// Helper function to decode one symbol, chaining into sub-tables for
+// codes longer than the root table
+static inline BITIO_INLINE uint16_t decode_symbol(const Decoded_value *table,
+                                                  unsigned root_bits,
+                                                  Bit_reader *reader)
+{
+    Bit_reader_refill(reader);
+    Decoded_value entry = table[Bit_reader_peek(reader, root_bits)];
+    while (entry.subtable_bits)
+    {
+        Bit_reader_consume(reader, entry.bit_length);
+        Bit_reader_refill(reader);
+        entry = table[entry.subtable + Bit_reader_peek(reader, entry.subtable_bits)];
+    }
+    Bit_reader_consume(reader, entry.bit_length);
+    return entry.symbol;
+}
+
+// Helper function to store the two bytes of a symbol, of which only the
+// first may stand for it. Returns the position after the bytes it stands
+// for
+static inline BITIO_INLINE uint8_t *put_symbol(uint8_t *dst, uint32_t bytes)
+{
+    dst[0] = (uint8_t)bytes;
+    dst[1] = (uint8_t)(bytes >> 8);
+    return dst + (bytes >> 16);
+}
+
+// Helper function to store a decoded byte, or fill the run of a run
+// symbol or copy the match of a length symbol. Returns the position after
+// them
+static inline BITIO_INLINE uint8_t *put_run_symbol(uint8_t *dst, const uint8_t *start,
+                                                   const uint8_t *end, uint16_t symbol,
+                                                   Bit_reader *reader,
+                                                   const Distance_codes *distances)
+{
+    if (symbol < MAX_NUM_CHAR)
+    {
+        *dst = (uint8_t)symbol;
+        return dst + 1;
+    }
+    return fill_run(dst, start, end, symbol, reader, distances);
+}
+
+// Helper function to decode one character in a table of root width only
+static inline BITIO_INLINE uint8_t decode_context_symbol(const Decoded_value *table,
+                                                         Bit_reader *reader)
+{
+    Bit_reader_refill(reader);
+    Decoded_value entry = table[Bit_reader_peek(reader, DECODING_TABLE_BITS)];
+    Bit_reader_consume(reader, entry.bit_length);
+    return (uint8_t)entry.symbol;
+}
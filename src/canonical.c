@@ -0,0 +1,585 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: canonical.c
+*
+*   Description: Implementation of canonical Huffman codes module. Code
+*   lengths are computed in linear time with the in-place algorithm of
+*   Moffat and Katajainen, and limited to a maximum with the package-merge
+*   algorithm when they are too long, so only the lengths need to be
+*   stored for the decompressor
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include "../include/canonical.h"
+
+
+/* structure of an item in a package-merge list: either a leaf for one
+ * character, or a package of two consecutive items of the previous list */
+typedef struct Merge_item
+{
+    uint64_t weight;
+    int symbol; // character of a leaf, -1 for packages
+    int first;  // index of the first packaged item in the previous list
+} Merge_item;
+
+/* Helper function prototypes */
+static int collect_leaves(const uint64_t *freq_array, unsigned num_symbols,
+                          Merge_item *leaves, uint8_t *lengths);
+static void sort_leaves(Merge_item *leaves, int num_leaves);
+static unsigned minimum_redundancy(const Merge_item *leaves, int num_leaves,
+                                   uint8_t *lengths);
+static void expand_item(Merge_item *lists, int list_length, int level,
+                        int index, uint8_t *lengths);
+static void first_codes(const uint8_t *lengths, unsigned num_symbols,
+                        uint64_t *next_code);
+
+/*
+ * Function:        Canonical_optimal_lengths
+ * Description:     Computes optimal code lengths without a maximum, as a
+ *                  Huffman tree would, in time linear in the number of
+ *                  characters once they are sorted by frequency. Characters
+ *                  with zero frequency get length 0, and a lone character
+ *                  gets length 1 as in Canonical_code_lengths
+ * Parameters:      uint64_t *freq_array: frequencies of each character
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ * Return:          unsigned: length of the longest code
+ */
+unsigned Canonical_optimal_lengths(const uint64_t *freq_array, uint8_t *lengths)
+{
+    assert(freq_array && lengths);
+    Merge_item leaves[MAX_NUM_CHAR];
+    int num_leaves = collect_leaves(freq_array, MAX_NUM_CHAR, leaves, lengths);
+    if (num_leaves == 1)
+        return 1;
+
+    sort_leaves(leaves, num_leaves);
+    return minimum_redundancy(leaves, num_leaves, lengths);
+}
+
+/*
+ * Function:        Canonical_code_lengths
+ * Description:     Computes optimal code lengths no longer than max_length.
+ *                  Lengths are those of Canonical_optimal_lengths when they
+ *                  fit, and are found with the package-merge algorithm
+ *                  otherwise. Characters with zero frequency get length 0.
+ *                  A lone character gets length 1 so that each occurrence
+ *                  still takes one bit
+ * Parameters:      uint64_t *freq_array: frequencies of each character
+ *                  unsigned max_length: maximum code length, between
+ *                  CANONICAL_MIN_CODE_LENGTH and CANONICAL_MAX_CODE_LENGTH
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ *                  void *workspace: CANONICAL_WORKSPACE_SIZE bytes aligned
+ *                  like malloc, or NULL to allocate them
+ * Return:          void
+ */
+void Canonical_code_lengths(const uint64_t *freq_array, unsigned max_length,
+                            uint8_t *lengths, void *workspace)
+{
+    Canonical_alphabet_code_lengths(freq_array, MAX_NUM_CHAR, max_length, lengths,
+                                    workspace);
+}
+
+/*
+ * Function:        Canonical_alphabet_code_lengths
+ * Description:     Computes optimal code lengths no longer than max_length
+ *                  as Canonical_code_lengths does, for an alphabet of
+ *                  num_symbols symbols. At most 2^max_length symbols may
+ *                  have a nonzero frequency
+ * Parameters:      uint64_t *freq_array: frequencies of each symbol
+ *                  unsigned num_symbols: size of the alphabet, between 2
+ *                  and CANONICAL_MAX_SYMBOLS
+ *                  unsigned max_length: maximum code length, between
+ *                  CANONICAL_MIN_CODE_LENGTH and CANONICAL_MAX_CODE_LENGTH
+ *                  uint8_t *lengths: num_symbols code lengths, updated
+ *                  after the function is called
+ *                  void *workspace: CANONICAL_ALPHABET_WORKSPACE_SIZE(
+ *                  num_symbols) bytes aligned like malloc, or NULL to
+ *                  allocate them
+ * Return:          void
+ */
+void Canonical_alphabet_code_lengths(const uint64_t *freq_array, unsigned num_symbols,
+                                     unsigned max_length, uint8_t *lengths,
+                                     void *workspace)
+{
+    assert(freq_array && lengths);
+    assert(num_symbols >= 2 && num_symbols <= CANONICAL_MAX_SYMBOLS);
+    assert(max_length >= CANONICAL_MIN_CODE_LENGTH &&
+           max_length <= CANONICAL_MAX_CODE_LENGTH);
+
+    Merge_item leaves[CANONICAL_MAX_SYMBOLS];
+    int num_leaves = collect_leaves(freq_array, num_symbols, leaves, lengths);
+    if (num_leaves == 1)
+        return;
+    assert((unsigned)num_leaves <= (unsigned)1 << max_length);
+
+    // Most blocks have codes short enough already, and package-merge is
+    // only needed when the limit binds
+    sort_leaves(leaves, num_leaves);
+    if (minimum_redundancy(leaves, num_leaves, lengths) <= max_length)
+        return;
+    for (int i = 0; i < num_leaves; i++)
+        lengths[leaves[i].symbol] = 0;
+
+    // lists[level] holds the merged list for code length max_length - level,
+    // of at most every leaf plus every package
+    int list_length = 2 * num_leaves;
+    assert(CANONICAL_MAX_CODE_LENGTH * list_length * sizeof(Merge_item) <=
+           CANONICAL_ALPHABET_WORKSPACE_SIZE(num_symbols));
+    Merge_item *lists = workspace;
+    if (!workspace)
+        lists = malloc(max_length * list_length * sizeof(Merge_item));
+    assert(lists);
+    int list_lengths[CANONICAL_MAX_CODE_LENGTH];
+
+    for (int i = 0; i < num_leaves; i++)
+        lists[i] = leaves[i];
+    list_lengths[0] = num_leaves;
+
+    for (unsigned level = 1; level < max_length; level++)
+    {
+        Merge_item *prev = lists + (level - 1) * list_length;
+        Merge_item *curr = lists + level * list_length;
+        int num_packages = list_lengths[level - 1] / 2;
+        int leaf = 0, package = 0, length = 0;
+
+        // Merge leaves with packages of the previous list, leaves first
+        // on equal weight
+        while (leaf < num_leaves || package < num_packages)
+        {
+            uint64_t package_weight = 0;
+            if (package < num_packages)
+                package_weight = prev[2 * package].weight +
+                                 prev[2 * package + 1].weight;
+
+            if (package == num_packages ||
+                (leaf < num_leaves && leaves[leaf].weight <= package_weight))
+            {
+                curr[length++] = leaves[leaf++];
+            }
+            else
+            {
+                curr[length].weight = package_weight;
+                curr[length].symbol = -1;
+                curr[length].first = 2 * package;
+                length++;
+                package++;
+            }
+        }
+        list_lengths[level] = length;
+    }
+
+    // Every leaf inside the 2n - 2 cheapest items of the last list adds
+    // one bit to the code length of its character
+    for (int i = 0; i < 2 * num_leaves - 2; i++)
+        expand_item(lists, list_length, max_length - 1, i, lengths);
+
+    if (!workspace)
+        free(lists);
+}
+
+// Helper function to list the symbols with a nonzero frequency, in
+// order of symbol, and to clear their lengths. A lone symbol is paired
+// with an unused one so the code is complete and the decoder never meets
+// a missing branch. Returns the number of leaves
+static int collect_leaves(const uint64_t *freq_array, unsigned num_symbols,
+                          Merge_item *leaves, uint8_t *lengths)
+{
+    int num_leaves = 0;
+    for (int i = 0; i < (int)num_symbols; i++)
+    {
+        lengths[i] = 0;
+        if (freq_array[i] == 0)
+            continue;
+        leaves[num_leaves].weight = freq_array[i];
+        leaves[num_leaves].symbol = i;
+        leaves[num_leaves].first = -1;
+        num_leaves++;
+    }
+    assert(num_leaves > 0);
+
+    if (num_leaves == 1)
+    {
+        lengths[leaves[0].symbol] = 1;
+        lengths[(leaves[0].symbol + 1) % num_symbols] = 1;
+    }
+    return num_leaves;
+}
+
+// Helper function to order leaves by frequency, then character, with a
+// radix sort on each byte of the frequencies. Leaves come in order of
+// character and every pass is stable, which breaks ties by character.
+// Bytes that are the same in every frequency, such as the high bytes of
+// small counts, are skipped
+static void sort_leaves(Merge_item *leaves, int num_leaves)
+{
+    uint64_t all_ones = ~(uint64_t)0, any_ones = 0;
+    for (int i = 0; i < num_leaves; i++)
+    {
+        all_ones &= leaves[i].weight;
+        any_ones |= leaves[i].weight;
+    }
+    uint64_t varying = all_ones ^ any_ones;
+
+    Merge_item buffer[CANONICAL_MAX_SYMBOLS];
+    Merge_item *from = leaves, *to = buffer;
+    for (unsigned shift = 0; shift < 64; shift += 8)
+    {
+        if (((varying >> shift) & 0xFF) == 0)
+            continue;
+
+        int starts[256] = {0};
+        for (int i = 0; i < num_leaves; i++)
+            starts[(from[i].weight >> shift) & 0xFF]++;
+        for (int byte = 0, start = 0; byte < 256; byte++)
+        {
+            int count = starts[byte];
+            starts[byte] = start;
+            start += count;
+        }
+        for (int i = 0; i < num_leaves; i++)
+            to[starts[(from[i].weight >> shift) & 0xFF]++] = from[i];
+
+        Merge_item *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != leaves)
+        for (int i = 0; i < num_leaves; i++)
+            leaves[i] = from[i];
+}
+
+// Helper function to set the optimal code lengths of at least 2 leaves
+// sorted by frequency, with the in-place algorithm of Moffat and
+// Katajainen. A first pass merges the leaves with the internal nodes,
+// which are made in order of weight, storing each node's parent where its
+// weight was. A second pass turns parents into depths, and a third hands
+// out the leaf depths from the longest code. Returns the longest length
+static unsigned minimum_redundancy(const Merge_item *leaves, int num_leaves,
+                                   uint8_t *lengths)
+{
+    assert(num_leaves >= 2 && num_leaves <= CANONICAL_MAX_SYMBOLS);
+    uint64_t nodes[CANONICAL_MAX_SYMBOLS];
+    for (int i = 0; i < num_leaves; i++)
+        nodes[i] = leaves[i].weight;
+
+    // Internal node next takes the two lightest of the next leaves and the
+    // internal nodes from root, leaves first on equal weight
+    int root = 0, leaf = 2;
+    nodes[0] += nodes[1];
+    for (int next = 1; next < num_leaves - 1; next++)
+    {
+        if (leaf >= num_leaves || nodes[root] < nodes[leaf])
+        {
+            nodes[next] = nodes[root];
+            nodes[root++] = next;
+        }
+        else
+            nodes[next] = nodes[leaf++];
+
+        if (leaf >= num_leaves || (root < next && nodes[root] < nodes[leaf]))
+        {
+            nodes[next] += nodes[root];
+            nodes[root++] = next;
+        }
+        else
+            nodes[next] += nodes[leaf++];
+    }
+
+    // Depth of each internal node, from the root at num_leaves - 2
+    nodes[num_leaves - 2] = 0;
+    for (int next = num_leaves - 3; next >= 0; next--)
+        nodes[next] = nodes[nodes[next]] + 1;
+
+    // Nodes at each depth not used by internal nodes are leaves, the
+    // heaviest getting the shortest codes
+    int available = 1, used = 0, depth = 0, next = num_leaves - 1;
+    root = num_leaves - 2;
+    while (available > 0)
+    {
+        while (root >= 0 && (int)nodes[root] == depth)
+        {
+            used++;
+            root--;
+        }
+        while (available > used)
+        {
+            lengths[leaves[next--].symbol] = (uint8_t)depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+    return lengths[leaves[0].symbol];
+}
+
+// Helper function to count the leaves contained in an item
+static void expand_item(Merge_item *lists, int list_length, int level,
+                        int index, uint8_t *lengths)
+{
+    Merge_item *item = lists + level * list_length + index;
+    if (item->symbol >= 0)
+    {
+        lengths[item->symbol]++;
+        return;
+    }
+    expand_item(lists, list_length, level - 1, item->first, lengths);
+    expand_item(lists, list_length, level - 1, item->first + 1, lengths);
+}
+
+/*
+ * Function:        Canonical_pack_lengths
+ * Description:     Packs MAX_NUM_CHAR code lengths into 4 bits each
+ * Parameters:      uint8_t *lengths: code lengths of each character
+ *                  uint8_t *packed: CANONICAL_PACKED_SIZE bytes output
+ * Return:          void
+ */
+void Canonical_pack_lengths(const uint8_t *lengths, uint8_t *packed)
+{
+    Canonical_alphabet_pack_lengths(lengths, MAX_NUM_CHAR, packed);
+}
+
+/*
+ * Function:        Canonical_unpack_lengths
+ * Description:     Unpacks code lengths packed by Canonical_pack_lengths
+ * Parameters:      uint8_t *packed: CANONICAL_PACKED_SIZE bytes input
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths output
+ * Return:          void
+ */
+void Canonical_unpack_lengths(const uint8_t *packed, uint8_t *lengths)
+{
+    Canonical_alphabet_unpack_lengths(packed, MAX_NUM_CHAR, lengths);
+}
+
+/*
+ * Function:        Canonical_alphabet_pack_lengths
+ * Description:     Packs the code lengths of an alphabet into 4 bits each
+ * Parameters:      uint8_t *lengths: code lengths of each symbol
+ *                  unsigned num_symbols: size of the alphabet, even
+ *                  uint8_t *packed: num_symbols / 2 bytes output
+ * Return:          void
+ */
+void Canonical_alphabet_pack_lengths(const uint8_t *lengths, unsigned num_symbols,
+                                     uint8_t *packed)
+{
+    assert(lengths && packed && num_symbols % 2 == 0);
+    for (unsigned i = 0; i < num_symbols / 2; i++)
+    {
+        assert(lengths[2 * i] <= CANONICAL_MAX_CODE_LENGTH);
+        assert(lengths[2 * i + 1] <= CANONICAL_MAX_CODE_LENGTH);
+        packed[i] = (uint8_t)((lengths[2 * i] << 4) | lengths[2 * i + 1]);
+    }
+}
+
+/*
+ * Function:        Canonical_alphabet_unpack_lengths
+ * Description:     Unpacks code lengths packed by
+ *                  Canonical_alphabet_pack_lengths
+ * Parameters:      uint8_t *packed: num_symbols / 2 bytes input
+ *                  unsigned num_symbols: size of the alphabet, even
+ *                  uint8_t *lengths: num_symbols code lengths output
+ * Return:          void
+ */
+void Canonical_alphabet_unpack_lengths(const uint8_t *packed, unsigned num_symbols,
+                                       uint8_t *lengths)
+{
+    assert(packed && lengths && num_symbols % 2 == 0);
+    for (unsigned i = 0; i < num_symbols / 2; i++)
+    {
+        lengths[2 * i] = packed[i] >> 4;
+        lengths[2 * i + 1] = packed[i] & 0xF;
+    }
+}
+
+/*
+ * Function:        Canonical_codes
+ * Description:     Assigns canonical codes to valid code lengths, in order
+ *                  of length then character, as Huffman_tree_build_canonical
+ *                  does, without building the tree
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, 0 for
+ *                  characters without a code
+ *                  Encoded_value *codes: MAX_NUM_CHAR codes, updated after
+ *                  the function is called
+ * Return:          void
+ */
+void Canonical_codes(const uint8_t *lengths, Encoded_value *codes)
+{
+    Canonical_alphabet_codes(lengths, MAX_NUM_CHAR, codes);
+}
+
+/*
+ * Function:        Canonical_alphabet_codes
+ * Description:     Assigns canonical codes to valid code lengths of an
+ *                  alphabet, in order of length then symbol
+ * Parameters:      uint8_t *lengths: num_symbols code lengths, 0 for
+ *                  symbols without a code
+ *                  unsigned num_symbols: size of the alphabet, at most
+ *                  CANONICAL_MAX_SYMBOLS
+ *                  Encoded_value *codes: num_symbols codes, updated after
+ *                  the function is called
+ * Return:          void
+ */
+void Canonical_alphabet_codes(const uint8_t *lengths, unsigned num_symbols,
+                              Encoded_value *codes)
+{
+    assert(lengths && codes && num_symbols <= CANONICAL_MAX_SYMBOLS);
+    uint64_t next_code[CANONICAL_MAX_CODE_LENGTH + 1];
+    first_codes(lengths, num_symbols, next_code);
+    for (unsigned i = 0; i < num_symbols; i++)
+    {
+        codes[i].bit_length = lengths[i];
+        codes[i].bit_value = lengths[i] ? next_code[lengths[i]]++ : 0;
+    }
+}
+
+/*
+ * Function:        Canonical_decoding_table
+ * Description:     Builds the decoding table of canonical codes straight
+ *                  from their lengths, with the layout of
+ *                  Huffman_tree_create_decoding_table. Raises
+ *                  Huffman_Invalid_Lengths if the lengths do not form a
+ *                  complete prefix code
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, at most
+ *                  CANONICAL_MAX_CODE_LENGTH
+ *                  Decoded_value *table: CANONICAL_DECODING_TABLE_SIZE
+ *                  entries, updated after the function is called
+ *                  unsigned *root_bits: updated with the root table width
+ * Return:          void
+ */
+void Canonical_decoding_table(const uint8_t *lengths, Decoded_value *table,
+                              unsigned *root_bits)
+{
+    Canonical_alphabet_decoding_table(lengths, MAX_NUM_CHAR, table, root_bits);
+}
+
+/*
+ * Function:        Canonical_alphabet_decoding_table
+ * Description:     Builds the decoding table of the canonical codes of an
+ *                  alphabet as Canonical_decoding_table does, the symbol
+ *                  of each entry being an index in the alphabet. Raises
+ *                  Huffman_Invalid_Lengths if the lengths do not form a
+ *                  complete prefix code
+ * Parameters:      uint8_t *lengths: num_symbols code lengths, at most
+ *                  CANONICAL_MAX_CODE_LENGTH
+ *                  unsigned num_symbols: size of the alphabet, at most
+ *                  CANONICAL_MAX_SYMBOLS
+ *                  Decoded_value *table: CANONICAL_ALPHABET_DECODING_TABLE_SIZE(
+ *                  num_symbols) entries, updated after the function is called
+ *                  unsigned *root_bits: updated with the root table width
+ * Return:          void
+ */
+void Canonical_alphabet_decoding_table(const uint8_t *lengths, unsigned num_symbols,
+                                       Decoded_value *table, unsigned *root_bits)
+{
+    assert(lengths && table && root_bits);
+    assert(num_symbols <= CANONICAL_MAX_SYMBOLS);
+
+    // The Kraft sum of a complete prefix code is exactly one
+    uint32_t kraft_sum = 0;
+    unsigned max_length = 0;
+    for (unsigned i = 0; i < num_symbols; i++)
+    {
+        if (lengths[i] > CANONICAL_MAX_CODE_LENGTH)
+            RAISE(Huffman_Invalid_Lengths);
+        if (lengths[i] == 0)
+            continue;
+        kraft_sum += (uint32_t)1 << (CANONICAL_MAX_CODE_LENGTH - lengths[i]);
+        if (lengths[i] > max_length)
+            max_length = lengths[i];
+    }
+    if (kraft_sum != (uint32_t)1 << CANONICAL_MAX_CODE_LENGTH)
+        RAISE(Huffman_Invalid_Lengths);
+
+    unsigned bits = max_length < DECODING_TABLE_BITS ? max_length : DECODING_TABLE_BITS;
+    uint64_t next_code[CANONICAL_MAX_CODE_LENGTH + 1];
+    first_codes(lengths, num_symbols, next_code);
+
+    // Codes longer than the root table are grouped by their first bits,
+    // each group getting a sub-table as wide as its longest code needs
+    uint16_t codes[CANONICAL_MAX_SYMBOLS];
+    uint8_t subtable_bits[1 << DECODING_TABLE_BITS] = {0};
+    for (unsigned i = 0; i < num_symbols; i++)
+    {
+        if (lengths[i] == 0)
+            continue;
+        codes[i] = (uint16_t)next_code[lengths[i]]++;
+        if (lengths[i] > bits)
+        {
+            unsigned extra = lengths[i] - bits;
+            uint32_t prefix = codes[i] >> extra;
+            if (extra > subtable_bits[prefix])
+                subtable_bits[prefix] = (uint8_t)extra;
+        }
+    }
+
+    uint32_t size = (uint32_t)1 << bits;
+    for (uint32_t prefix = 0; prefix < ((uint32_t)1 << bits); prefix++)
+    {
+        if (subtable_bits[prefix] == 0)
+            continue;
+        table[prefix].subtable = size;
+        table[prefix].symbol = 0;
+        table[prefix].bit_length = (uint8_t)bits;
+        table[prefix].subtable_bits = subtable_bits[prefix];
+        size += (uint32_t)1 << subtable_bits[prefix];
+    }
+    assert(size <= CANONICAL_ALPHABET_DECODING_TABLE_SIZE(num_symbols));
+
+    // Each code fills every entry whose index starts with it
+    for (unsigned i = 0; i < num_symbols; i++)
+    {
+        if (lengths[i] == 0)
+            continue;
+        Decoded_value entry;
+        entry.subtable = 0;
+        entry.symbol = (uint16_t)i;
+        entry.subtable_bits = 0;
+
+        uint32_t first, count;
+        if (lengths[i] <= bits)
+        {
+            entry.bit_length = lengths[i];
+            first = (uint32_t)codes[i] << (bits - lengths[i]);
+            count = (uint32_t)1 << (bits - lengths[i]);
+        }
+        else
+        {
+            unsigned extra = lengths[i] - bits;
+            const Decoded_value *link = &table[codes[i] >> extra];
+            entry.bit_length = (uint8_t)extra;
+            first = link->subtable + ((codes[i] & (((uint32_t)1 << extra) - 1))
+                                      << (link->subtable_bits - extra));
+            count = (uint32_t)1 << (link->subtable_bits - extra);
+        }
+        for (uint32_t j = 0; j < count; j++)
+            table[first + j] = entry;
+    }
+    *root_bits = bits;
+}
+
+// Helper function to get the first canonical code of each length, which
+// follows the last code of the shorter length
+static void first_codes(const uint8_t *lengths, unsigned num_symbols,
+                        uint64_t *next_code)
+{
+    uint64_t length_count[CANONICAL_MAX_CODE_LENGTH + 1] = {0};
+    for (unsigned i = 0; i < num_symbols; i++)
+        length_count[lengths[i]]++;
+    length_count[0] = 0;
+
+    uint64_t code = 0;
+    next_code[0] = 0;
+    for (int length = 1; length <= CANONICAL_MAX_CODE_LENGTH; length++)
+    {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+}
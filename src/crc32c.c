@@ -0,0 +1,199 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: crc32c.c
+*
+*   Description: Implementation of CRC32C module, which computes the
+*   Castagnoli CRC of a buffer with the SSE4.2 instruction or with
+*   slicing-by-8 tables
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include "../include/crc32c.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+/* Castagnoli polynomial, with its bits in reverse order as the CRC is
+ * computed from the lowest bit of each byte */
+#define POLYNOMIAL 0x82F63B78u
+
+/* x^0 and x^8 in the same reversed order, x^k being bit 31 - k */
+#define X_POWER_0 0x80000000u
+#define X_POWER_8 0x00800000u
+
+/* Fewest bytes split into three interleaved parts, below which combining
+ * their CRCs takes longer than it saves */
+#define INTERLEAVE_MIN_SIZE (1 << 16)
+
+/* Tables of slicing-by-8: table k gives the CRC of a byte followed by k
+ * zero bytes. Filled once, by the first thread computing a CRC */
+static uint32_t tables[8][256];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+/* Helper function prototypes */
+static void fill_tables(void);
+static inline uint64_t read64(const uint8_t *src);
+static uint32_t update_portable(uint32_t state, const uint8_t *src, size_t size);
+static uint32_t multiply(uint32_t a, uint32_t b);
+static uint32_t shift(uint32_t state, size_t size);
+#ifdef CRC32C_HAVE_SSE42
+static uint32_t update_sse42(uint32_t state, const uint8_t *src, size_t size);
+#endif
+
+/*
+ * Function:        Crc32c_update
+ * Description:     Extends the CRC32C of the bytes before src with the
+ *                  bytes of src, using the SSE4.2 instruction when the
+ *                  processor supports it
+ * Parameters:      uint32_t crc: CRC32C of the bytes before, 0 for none
+ *                  uint8_t *src: bytes to add
+ *                  size_t size: number of bytes in src
+ * Return:          uint32_t: CRC32C of the bytes before followed by src
+ */
+uint32_t Crc32c_update(uint32_t crc, const uint8_t *src, size_t size)
+{
+#ifdef CRC32C_HAVE_SSE42
+    assert(src || size == 0);
+    if (__builtin_cpu_supports("sse4.2"))
+        return ~update_sse42(~crc, src, size);
+#endif
+    return Crc32c_update_portable(crc, src, size);
+}
+
+/*
+ * Function:        Crc32c_update_portable
+ * Description:     Same as Crc32c_update, without processor-specific
+ *                  instructions
+ * Parameters:      uint32_t crc: CRC32C of the bytes before, 0 for none
+ *                  uint8_t *src: bytes to add
+ *                  size_t size: number of bytes in src
+ * Return:          uint32_t: CRC32C of the bytes before followed by src
+ */
+uint32_t Crc32c_update_portable(uint32_t crc, const uint8_t *src, size_t size)
+{
+    assert(src || size == 0);
+    pthread_once(&tables_once, fill_tables);
+    return ~update_portable(~crc, src, size);
+}
+
+// Helper function to fill the tables of slicing-by-8
+static void fill_tables(void)
+{
+    for (uint32_t byte = 0; byte < 256; byte++)
+    {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 1 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+        tables[0][byte] = crc;
+    }
+    for (uint32_t byte = 0; byte < 256; byte++)
+        for (int k = 1; k < 8; k++)
+            tables[k][byte] = (tables[k - 1][byte] >> 8) ^
+                              tables[0][tables[k - 1][byte] & 0xFF];
+}
+
+// Helper function to read 8 bytes of src, the first one lowest
+static inline uint64_t read64(const uint8_t *src)
+{
+    uint64_t word;
+    memcpy(&word, src, sizeof(uint64_t));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Helper function to add the bytes of src to the state of a CRC, without
+// the inversions before and after, 8 bytes at a time
+static uint32_t update_portable(uint32_t state, const uint8_t *src, size_t size)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word = read64(src + i) ^ state;
+        state = tables[7][word & 0xFF] ^ tables[6][(word >> 8) & 0xFF] ^
+                tables[5][(word >> 16) & 0xFF] ^ tables[4][(word >> 24) & 0xFF] ^
+                tables[3][(word >> 32) & 0xFF] ^ tables[2][(word >> 40) & 0xFF] ^
+                tables[1][(word >> 48) & 0xFF] ^ tables[0][word >> 56];
+    }
+    for (; i < size; i++)
+        state = (state >> 8) ^ tables[0][(state ^ src[i]) & 0xFF];
+    return state;
+}
+
+// Helper function to multiply two polynomials modulo the CRC polynomial,
+// a being non-zero
+static uint32_t multiply(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t mask = X_POWER_0; ; mask >>= 1)
+    {
+        if (a & mask)
+        {
+            product ^= b;
+            if ((a & (mask - 1)) == 0)
+                return product;
+        }
+        b = b & 1 ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+    }
+}
+
+// Helper function to get the state of a CRC after size zero bytes, which
+// multiplies it by x^(8 * size)
+static uint32_t shift(uint32_t state, size_t size)
+{
+    uint32_t power = X_POWER_0;
+    for (uint32_t square = X_POWER_8; size > 0; size >>= 1)
+    {
+        if (size & 1)
+            power = multiply(power, square);
+        square = multiply(square, square);
+    }
+    return multiply(power, state);
+}
+
+#ifdef CRC32C_HAVE_SSE42
+// Helper function to add the bytes of src to the state of a CRC with the
+// SSE4.2 instruction. Each instruction waits for the one before on the
+// same CRC, so that large buffers are split into three parts whose CRCs
+// are computed side by side, then combined: the CRC of two parts is the
+// CRC of the first followed by zeros, plus the CRC of the second
+__attribute__((target("sse4.2")))
+static uint32_t update_sse42(uint32_t state, const uint8_t *src, size_t size)
+{
+    if (size >= INTERLEAVE_MIN_SIZE)
+    {
+        size_t part = size / 3 / sizeof(uint64_t) * sizeof(uint64_t);
+        const uint8_t *first = src, *second = src + part, *third = src + 2 * part;
+        uint64_t crc0 = state, crc1 = 0, crc2 = 0;
+        for (size_t i = 0; i < part; i += sizeof(uint64_t))
+        {
+            crc0 = _mm_crc32_u64(crc0, read64(first + i));
+            crc1 = _mm_crc32_u64(crc1, read64(second + i));
+            crc2 = _mm_crc32_u64(crc2, read64(third + i));
+        }
+        state = shift((uint32_t)crc0, part) ^ (uint32_t)crc1;
+        state = shift(state, part) ^ (uint32_t)crc2;
+        src += 3 * part;
+        size -= 3 * part;
+    }
+
+    uint64_t crc = state;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        crc = _mm_crc32_u64(crc, read64(src + i));
+    state = (uint32_t)crc;
+    for (; i < size; i++)
+        state = _mm_crc32_u8(state, src[i]);
+    return state;
+}
+#endif
@@ -0,0 +1,816 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: frame.c
+*
+*   Description: Implementation of frame module, which streams a file
+*   through the block module in a single pass, so input and output
+*   can be pipes
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/block.h"
+#include "../include/crc32c.h"
+#include "../include/frame.h"
+#include "../include/thread_pool.h"
+#include "../include/mapped_file.h"
+
+/* structure of one block to be encoded on the thread pool */
+typedef struct Block_job
+{
+    const uint8_t *raw;       // input bytes of the block
+    uint32_t raw_size;        // number of input bytes
+    uint8_t *buffer;          // block read from a stream, NULL if mapped
+    uint8_t *encoded;         // output of Block_bound bytes
+    size_t encoded_size;      // number of encoded bytes
+    void *workspace;          // Block_workspace_size bytes for Block_encode
+    Block_options options;    // code lengths, streams and tables of the block
+    int checksums;            // whether the checksum of the block is computed
+    uint32_t checksum;        // CRC32C of the input bytes
+    int has_stats;            // whether stats of the block are collected
+    Stats stats;              // stats of the block, merged once written
+} Block_job;
+
+/* structure of one block to be decoded on the thread pool */
+typedef struct Decode_job
+{
+    const Frame_index_entry *entry; // index entry of the block
+    int in_fd;                      // descriptor of the compressed file
+    const uint8_t *in_data;         // mapped compressed file, or NULL
+    uint64_t in_size;               // number of mapped compressed bytes
+    int out_fd;                     // descriptor of outfile, -1 if unused
+    uint8_t *out_data;              // mapped decompressed file, or NULL
+    uint8_t *encoded;               // block read from file
+    uint8_t *raw;                   // decoded bytes of the block
+    void *workspace;                // BLOCK_DECODE_WORKSPACE_SIZE bytes of tables
+    int checksums;                  // whether the block is followed by a checksum
+    int verify;                     // whether decoded bytes are checked against it
+    int failed;                     // set if the block is corrupted
+    int checksum_failed;            // set if the block does not match its checksum
+    int write_failed;               // set if writing to out_fd failed
+    int has_stats;                  // whether stats of the block are collected
+    Stats stats;                    // stats of the block, merged once written
+} Decode_job;
+
+const Except_T Frame_Write_Failed = {"Failed to write decompressed file"};
+const Except_T Frame_Checksum_Failed = {"Decompressed block does not match its checksum"};
+const Except_T Frame_No_Index = {"Compressed file has no block index"};
+
+/* Helper function prototypes */
+static int read_batch(FILE *infile, Mapped_File_T mapped, uint64_t *position,
+                      Block_job *batch, unsigned num_jobs, uint32_t block_size,
+                      int *end_of_file);
+static void submit_batch(Thread_Pool_T thread_pool, Block_job *batch,
+                         int num_jobs);
+static void encode_block_job(void *arg);
+static int index_is_contiguous(const Frame_index_entry *index, uint64_t num_entries,
+                               uint64_t blocks_end);
+static uint32_t read_block_size(FILE *infile, int *checksums);
+static void decompress_parallel(FILE *infile, Mapped_File_T mapped, FILE *outfile,
+                                Frame_index_entry *index, uint64_t num_blocks,
+                                uint32_t block_size, unsigned num_threads,
+                                int checksums, int verify, Stats *stats);
+static void decode_block_job(void *arg);
+static int writes_at_offsets(FILE *outfile);
+
+/*
+ * Function:        Frame_default_options
+ * Description:     Gets the options used when none is given
+ * Parameters:      void
+ * Return:          Frame_options: default block size, code length and
+ *                  number of streams, with a single code table per block,
+ *                  checksums, a single thread and no stats
+ */
+Frame_options Frame_default_options(void)
+{
+    Frame_options options;
+    options.block_size = FRAME_DEFAULT_BLOCK_SIZE;
+    options.max_code_length = CANONICAL_MAX_CODE_LENGTH;
+    options.num_streams = BLOCK_DEFAULT_STREAMS;
+    options.max_tables = 1;
+    options.max_pairs = 0;
+    options.runs = 0;
+    options.match_level = 0;
+    options.window_bits = LZ77_DEFAULT_WINDOW_BITS;
+    options.checksums = 1;
+    options.num_threads = 1;
+    options.stats = NULL;
+    return options;
+}
+
+/*
+ * Function:        Frame_compress
+ * Description:     Reads infile block by block until end of file and
+ *                  writes each block with its own code table to outfile.
+ *                  Blocks are encoded in batches of num_threads blocks on
+ *                  a thread pool, while the next batch is read and the
+ *                  previous one written in order. Output does not depend
+ *                  on the number of threads. Regular input files are
+ *                  mapped and encoded in place
+ * Parameters:      FILE *infile: pointer to the input file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  Frame_options *options: block size, maximum length of
+ *                  codes, number of streams and of encoding threads
+ * Return:          void
+ */
+void Frame_compress(FILE *infile, FILE *outfile, const Frame_options *options)
+{
+    assert(infile && outfile && options);
+    uint32_t block_size = options->block_size;
+    unsigned num_threads = options->num_threads;
+    assert(block_size >= FRAME_MIN_BLOCK_SIZE && block_size <= FRAME_MAX_BLOCK_SIZE);
+
+    // Blocks of a mapped input are sliced from the mapping from the current
+    // position, instead of being read into buffers
+    Mapped_File_T mapped = Mapped_file_open(infile);
+    uint64_t position = 0;
+    if (mapped)
+        position = (uint64_t)ftell(infile);
+
+    // Two batches of jobs: one being encoded while the other is read
+    // from infile and written to outfile
+    Block_job *batches[2];
+    int batch_sizes[2] = {0, 0};
+    for (int b = 0; b < 2; b++)
+    {
+        batches[b] = malloc(num_threads * sizeof(Block_job));
+        assert(batches[b]);
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            batches[b][i].buffer = mapped ? NULL : malloc(block_size);
+            batches[b][i].encoded = malloc(Block_bound(block_size,
+                                                       options->max_code_length));
+            batches[b][i].options.max_code_length = options->max_code_length;
+            batches[b][i].options.num_streams = options->num_streams;
+            batches[b][i].options.max_tables = options->max_tables;
+            batches[b][i].options.max_pairs = options->max_pairs;
+            batches[b][i].options.runs = options->runs;
+            batches[b][i].options.match_level = options->match_level;
+            batches[b][i].options.window_bits = options->window_bits;
+            batches[b][i].workspace = malloc(Block_workspace_size(block_size,
+                                                                  &batches[b][i].options));
+            batches[b][i].checksums = options->checksums != 0;
+            batches[b][i].has_stats = options->stats != NULL;
+            assert((mapped || batches[b][i].buffer) && batches[b][i].encoded &&
+                   batches[b][i].workspace);
+        }
+    }
+    Thread_Pool_T thread_pool = Thread_pool_new(num_threads);
+
+    // Header: <FRAME_MAGIC><BLOCK_SIZE>, flagged when blocks have checksums
+    uint32_t checksum_size = options->checksums ? FRAME_CHECKSUM_SIZE : 0;
+    uint32_t header_block_size = block_size | (checksum_size ? FRAME_CHECKSUMS_FLAG : 0);
+    fwrite(FRAME_MAGIC, 1, FRAME_MAGIC_SIZE, outfile);
+    fwrite(&header_block_size, sizeof(uint32_t), 1, outfile);
+
+    // Block index entries, appended as blocks are written
+    uint64_t offset = FRAME_MAGIC_SIZE + sizeof(uint32_t);
+    uint64_t raw_offset = 0;
+    uint64_t num_blocks = 0;
+    uint64_t index_capacity = 64;
+    Frame_index_entry *index = malloc(index_capacity * sizeof(Frame_index_entry));
+    assert(index);
+
+    Stats *stats = options->stats;
+    int curr = 0;
+    int end_of_file = 0;
+    double start = Stats_start(stats);
+    batch_sizes[curr] = read_batch(infile, mapped, &position, batches[curr],
+                                   num_threads, block_size, &end_of_file);
+    Stats_lap(stats, STATS_READ, start);
+    submit_batch(thread_pool, batches[curr], batch_sizes[curr]);
+
+    while (batch_sizes[curr] > 0)
+    {
+        int next = 1 - curr;
+        start = Stats_start(stats);
+        batch_sizes[next] = end_of_file ? 0 :
+                            read_batch(infile, mapped, &position, batches[next],
+                                       num_threads, block_size, &end_of_file);
+        Stats_lap(stats, STATS_READ, start);
+
+        Thread_pool_wait(thread_pool);
+        submit_batch(thread_pool, batches[next], batch_sizes[next]);
+
+        for (int i = 0; i < batch_sizes[curr]; i++)
+        {
+            Block_job *job = &batches[curr][i];
+            start = Stats_start(stats);
+            fwrite(job->encoded, 1, job->encoded_size, outfile);
+            if (checksum_size)
+                fwrite(&job->checksum, sizeof(uint32_t), 1, outfile);
+            Stats_lap(stats, STATS_WRITE, start);
+            if (job->has_stats)
+                Stats_merge(stats, &job->stats);
+
+            if (num_blocks == index_capacity)
+            {
+                index_capacity *= 2;
+                index = realloc(index, index_capacity * sizeof(Frame_index_entry));
+                assert(index);
+            }
+            index[num_blocks].offset = offset;
+            index[num_blocks].raw_offset = raw_offset;
+            index[num_blocks].raw_size = job->raw_size;
+            index[num_blocks].size = (uint32_t)job->encoded_size + checksum_size;
+            num_blocks++;
+            offset += job->encoded_size + checksum_size;
+            raw_offset += job->raw_size;
+        }
+        curr = next;
+    }
+
+    // Trailer: <END_MARKER>[index_entry_1]...<NUM_BLOCKS><FRAME_INDEX_MAGIC>
+    uint32_t end_marker = 0;
+    fwrite(&end_marker, sizeof(uint32_t), 1, outfile);
+    fwrite(index, sizeof(Frame_index_entry), num_blocks, outfile);
+    fwrite(&num_blocks, sizeof(uint64_t), 1, outfile);
+    fwrite(FRAME_INDEX_MAGIC, 1, FRAME_MAGIC_SIZE, outfile);
+    free(index);
+    if (stats)
+    {
+        stats->bytes_in += raw_offset;
+        stats->bytes_out += offset + sizeof(uint32_t) +
+                            num_blocks * sizeof(Frame_index_entry) + FRAME_FOOTER_SIZE;
+    }
+
+    Thread_pool_free(&thread_pool);
+    if (mapped)
+    {
+        // Leave infile past the consumed bytes, as if they had been read
+        fseek(infile, (long)position, SEEK_SET);
+        Mapped_file_free(&mapped);
+    }
+    for (int b = 0; b < 2; b++)
+    {
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            free(batches[b][i].buffer);
+            free(batches[b][i].encoded);
+            free(batches[b][i].workspace);
+        }
+        free(batches[b]);
+    }
+}
+
+// Helper function to read up to num_jobs blocks into a batch, or point
+// them into the mapped input at position. Returns the number of blocks
+// read; a short block means the input has ended
+static int read_batch(FILE *infile, Mapped_File_T mapped, uint64_t *position,
+                      Block_job *batch, unsigned num_jobs, uint32_t block_size,
+                      int *end_of_file)
+{
+    int num_read = 0;
+    for (unsigned i = 0; i < num_jobs && !*end_of_file; i++)
+    {
+        size_t raw_size = 0;
+        if (mapped)
+        {
+            uint64_t left = Mapped_file_size(mapped) - *position;
+            raw_size = left < block_size ? (size_t)left : block_size;
+            batch[i].raw = Mapped_file_data(mapped) + *position;
+            *position += raw_size;
+        }
+        else
+        {
+            // fread keeps reading a pipe until the block is full or input ends
+            raw_size = fread(batch[i].buffer, 1, block_size, infile);
+            batch[i].raw = batch[i].buffer;
+        }
+        if (raw_size < block_size)
+            *end_of_file = 1;
+        if (raw_size == 0)
+            break;
+        batch[i].raw_size = (uint32_t)raw_size;
+        num_read++;
+    }
+    return num_read;
+}
+
+// Helper function to queue every block of a batch for encoding
+static void submit_batch(Thread_Pool_T thread_pool, Block_job *batch,
+                         int num_jobs)
+{
+    for (int i = 0; i < num_jobs; i++)
+        Thread_pool_submit(thread_pool, encode_block_job, &batch[i]);
+}
+
+// Helper function run on the thread pool to encode one block
+static void encode_block_job(void *arg)
+{
+    Block_job *job = arg;
+    if (job->has_stats)
+        Stats_init(&job->stats);
+    Stats *stats = job->has_stats ? &job->stats : NULL;
+    job->encoded_size = Block_encode(job->raw, job->raw_size, &job->options,
+                                     job->encoded, job->workspace, stats);
+    if (job->checksums)
+    {
+        double start = Stats_start(stats);
+        job->checksum = Crc32c_update(0, job->raw, job->raw_size);
+        Stats_lap(stats, STATS_CHECKSUM, start);
+    }
+}
+
+/*
+ * Function:        Frame_read_index
+ * Description:     Reads the block index from the end of a seekable
+ *                  compressed file. Raises Block_Corrupted if the index is
+ *                  inconsistent with the file
+ * Parameters:      FILE *infile: pointer to the compressed file
+ *                  uint64_t *num_blocks: updated with the number of blocks
+ * Return:          Array of num_blocks entries to be freed by the caller,
+ *                  or NULL if infile cannot seek or has no index
+ */
+Frame_index_entry *Frame_read_index(FILE *infile, uint64_t *num_blocks)
+{
+    assert(infile && num_blocks);
+    long position = ftell(infile);
+    if (position < 0 || fseek(infile, 0, SEEK_END) != 0)
+        return NULL;
+    long file_size = ftell(infile);
+
+    // Footer: <NUM_BLOCKS><FRAME_INDEX_MAGIC>
+    uint64_t num_entries = 0;
+    char magic[FRAME_MAGIC_SIZE];
+    if (file_size < (long)(FRAME_MAGIC_SIZE + sizeof(uint32_t) + FRAME_FOOTER_SIZE) ||
+        fseek(infile, file_size - (long)FRAME_FOOTER_SIZE, SEEK_SET) != 0 ||
+        fread(&num_entries, sizeof(uint64_t), 1, infile) != 1 ||
+        fread(magic, 1, FRAME_MAGIC_SIZE, infile) != FRAME_MAGIC_SIZE ||
+        memcmp(magic, FRAME_INDEX_MAGIC, FRAME_MAGIC_SIZE) != 0)
+    {
+        fseek(infile, position, SEEK_SET);
+        return NULL;
+    }
+
+    // Index sits between the end marker and the footer
+    uint64_t blocks_end = file_size - FRAME_FOOTER_SIZE - sizeof(uint32_t);
+    if (num_entries > blocks_end / sizeof(Frame_index_entry))
+        RAISE(Block_Corrupted);
+    uint64_t index_size = num_entries * sizeof(Frame_index_entry);
+    blocks_end -= index_size;
+
+    // An empty index is still an array, told apart from NULL for no index
+    Frame_index_entry *index = malloc(num_entries > 0 ? index_size : 1);
+    assert(index);
+    if (fseek(infile, (long)blocks_end + sizeof(uint32_t), SEEK_SET) != 0 ||
+        fread(index, 1, index_size, infile) != index_size ||
+        !index_is_contiguous(index, num_entries, blocks_end))
+    {
+        free(index);
+        RAISE(Block_Corrupted);
+    }
+
+    fseek(infile, position, SEEK_SET);
+    *num_blocks = num_entries;
+    return index;
+}
+
+// Helper function to check that the blocks of an index follow each other
+// in both files, from the frame header to blocks_end
+static int index_is_contiguous(const Frame_index_entry *index, uint64_t num_entries,
+                               uint64_t blocks_end)
+{
+    uint64_t offset = FRAME_MAGIC_SIZE + sizeof(uint32_t);
+    uint64_t raw_offset = 0;
+    for (uint64_t i = 0; i < num_entries; i++)
+    {
+        if (index[i].offset != offset || index[i].raw_offset != raw_offset ||
+            index[i].raw_size == 0 || index[i].size < BLOCK_PREFIX_SIZE)
+            return 0;
+        offset += index[i].size;
+        raw_offset += index[i].raw_size;
+    }
+    return offset == blocks_end;
+}
+
+/*
+ * Function:        Frame_decompress
+ * Description:     Decodes blocks and writes them to outfile. infile must
+ *                  be positioned right after FRAME_MAGIC. With more than
+ *                  one thread or a regular infile, blocks located through
+ *                  the index are decoded in parallel, in place when the
+ *                  files can be mapped, so that a single thread also
+ *                  decodes regular files through the index. Other inputs,
+ *                  such as pipes, are streamed up to the end marker.
+ *                  Raises Block_Corrupted on malformed or truncated input,
+ *                  and Frame_Checksum_Failed when verifying a block that
+ *                  does not match its checksum
+ * Parameters:      FILE *infile: pointer to the compressed file or pipe
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  unsigned num_threads: number of decoding threads
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums, when the file has them
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          void
+ */
+void Frame_decompress(FILE *infile, FILE *outfile, unsigned num_threads,
+                      int verify, Stats *stats)
+{
+    assert(infile && outfile);
+
+    int checksums = 0;
+    uint32_t block_size = read_block_size(infile, &checksums);
+
+    Mapped_File_T mapped = Mapped_file_open(infile);
+    if (num_threads > 1 || mapped)
+    {
+        uint64_t num_blocks = 0;
+        Frame_index_entry *index = Frame_read_index(infile, &num_blocks);
+        if (index)
+        {
+            TRY
+                decompress_parallel(infile, mapped, outfile, index, num_blocks,
+                                    block_size, num_threads, checksums,
+                                    verify && checksums, stats);
+            FINALLY
+                free(index);
+                if (mapped)
+                    Mapped_file_free(&mapped);
+            END_TRY;
+            return;
+        }
+    }
+    if (mapped)
+        Mapped_file_free(&mapped);
+
+    uint8_t *raw = malloc(block_size);
+    uint8_t *payload = malloc(Block_bound(block_size, CANONICAL_MAX_CODE_LENGTH));
+    void *workspace = malloc(BLOCK_DECODE_WORKSPACE_SIZE);
+    assert(raw && payload && workspace);
+
+    uint8_t header_bytes[BLOCK_HEADER_SIZE + BLOCK_MAX_JUMP_TABLE_SIZE];
+    Block_header header;
+    if (stats)
+        stats->bytes_in += FRAME_MAGIC_SIZE + 2 * sizeof(uint32_t);
+    // Buffers are freed before an exception on a block propagates
+    TRY
+        while (1)
+        {
+            // A zero raw size in place of a header marks the end of the
+            // blocks, and the mode after any other gives the header size
+            double start = Stats_start(stats);
+            if (fread(header_bytes, sizeof(uint32_t), 1, infile) != 1)
+                RAISE(Block_Corrupted);
+            uint32_t raw_size;
+            memcpy(&raw_size, header_bytes, sizeof(uint32_t));
+            if (raw_size == 0)
+                break;
+
+            if (fread(header_bytes + sizeof(uint32_t), 1, 1, infile) != 1)
+                RAISE(Block_Corrupted);
+            size_t rest_size = Block_header_size(header_bytes) - BLOCK_PREFIX_SIZE;
+            if (fread(header_bytes + BLOCK_PREFIX_SIZE, 1, rest_size, infile) != rest_size)
+                RAISE(Block_Corrupted);
+            Block_read_header(header_bytes, &header);
+            if (header.raw_size > block_size ||
+                fread(header_bytes + header.header_size, 1, header.jump_table_size,
+                      infile) != header.jump_table_size)
+                RAISE(Block_Corrupted);
+            Block_read_jump_table(header_bytes + header.header_size, &header);
+
+            uint32_t checksum = 0;
+            if (fread(payload, 1, header.payload_size, infile) != header.payload_size ||
+                (checksums && fread(&checksum, sizeof(uint32_t), 1, infile) != 1))
+                RAISE(Block_Corrupted);
+            Stats_lap(stats, STATS_READ, start);
+            Block_decode(&header, payload, raw, workspace, stats);
+            if (verify && checksums)
+            {
+                start = Stats_start(stats);
+                uint32_t raw_checksum = Crc32c_update(0, raw, header.raw_size);
+                Stats_lap(stats, STATS_CHECKSUM, start);
+                if (raw_checksum != checksum)
+                    RAISE(Frame_Checksum_Failed);
+            }
+            start = Stats_start(stats);
+            fwrite(raw, 1, header.raw_size, outfile);
+            Stats_lap(stats, STATS_WRITE, start);
+
+            if (stats)
+            {
+                stats->bytes_in += header.header_size + header.jump_table_size +
+                                   header.payload_size + (checksums ? FRAME_CHECKSUM_SIZE : 0);
+                stats->bytes_out += header.raw_size;
+                stats->num_blocks++;
+            }
+        }
+    FINALLY
+        free(raw);
+        free(payload);
+        free(workspace);
+    END_TRY;
+}
+
+/*
+ * Function:        Frame_decompress_range
+ * Description:     Writes to outfile the decompressed bytes from offset to
+ *                  offset + length, clipped to the end of the decompressed
+ *                  file. Only the blocks covering them are read and
+ *                  decoded, found through the block index, so that the
+ *                  block size sets the granularity of access. infile must
+ *                  be seekable and positioned right after FRAME_MAGIC.
+ *                  Raises Frame_No_Index if it has no block index, and
+ *                  the exceptions of Frame_decompress
+ * Parameters:      FILE *infile: pointer to the compressed file
+ *                  FILE *outfile: pointer to the output file or pipe
+ *                  uint64_t offset: position of the first byte to write
+ *                  uint64_t length: number of bytes to write
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums, when the file has them
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          uint64_t: number of bytes written
+ */
+uint64_t Frame_decompress_range(FILE *infile, FILE *outfile, uint64_t offset,
+                                uint64_t length, int verify, Stats *stats)
+{
+    assert(infile && outfile);
+
+    int checksums = 0;
+    uint32_t block_size = read_block_size(infile, &checksums);
+    uint64_t num_blocks = 0;
+    Frame_index_entry *index = Frame_read_index(infile, &num_blocks);
+    if (!index)
+        RAISE(Frame_No_Index);
+    size_t max_size = Block_bound(block_size, CANONICAL_MAX_CODE_LENGTH) +
+                      (checksums ? FRAME_CHECKSUM_SIZE : 0);
+
+    uint64_t raw_total = 0;
+    if (num_blocks > 0)
+        raw_total = index[num_blocks - 1].raw_offset + index[num_blocks - 1].raw_size;
+    // The range from begin to end is clipped to the decompressed file
+    uint64_t begin = offset < raw_total ? offset : raw_total;
+    uint64_t end = begin + (length < raw_total - begin ? length : raw_total - begin);
+
+    // Blocks are in order of raw offset, so that the first one ending past
+    // begin is found by bisection
+    uint64_t first = 0, last = num_blocks;
+    while (first < last)
+    {
+        uint64_t middle = first + (last - first) / 2;
+        if (index[middle].raw_offset + index[middle].raw_size <= begin)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    // Each block is decoded as a job of the parallel decoder would, on
+    // this thread and into a buffer
+    Decode_job job;
+    job.in_fd = fileno(infile);
+    job.in_data = NULL;
+    job.in_size = 0;
+    job.out_fd = -1;
+    job.out_data = NULL;
+    job.encoded = malloc(max_size);
+    job.raw = malloc(block_size);
+    job.workspace = malloc(BLOCK_DECODE_WORKSPACE_SIZE);
+    job.checksums = checksums;
+    job.verify = verify && checksums;
+    job.has_stats = stats != NULL;
+    assert(job.encoded && job.raw && job.workspace);
+
+    TRY
+        for (uint64_t i = first; i < num_blocks && index[i].raw_offset < end; i++)
+        {
+            const Frame_index_entry *entry = &index[i];
+            if (entry->raw_size > block_size || entry->size > max_size)
+                RAISE(Block_Corrupted);
+            job.entry = entry;
+            decode_block_job(&job);
+            if (job.failed)
+                RAISE(Block_Corrupted);
+            if (job.checksum_failed)
+                RAISE(Frame_Checksum_Failed);
+
+            // The first and last blocks are only partly in the range
+            uint64_t from = begin > entry->raw_offset ? begin - entry->raw_offset : 0;
+            uint64_t to = end - entry->raw_offset < entry->raw_size ?
+                          end - entry->raw_offset : entry->raw_size;
+            double start = Stats_start(stats);
+            fwrite(job.raw + from, 1, (size_t)(to - from), outfile);
+            Stats_lap(stats, STATS_WRITE, start);
+            if (stats)
+            {
+                Stats_merge(stats, &job.stats);
+                stats->bytes_in += entry->size;
+                stats->num_blocks++;
+            }
+        }
+    FINALLY
+        free(job.encoded);
+        free(job.raw);
+        free(job.workspace);
+        free(index);
+    END_TRY;
+    if (stats)
+        stats->bytes_out += end - begin;
+    return end - begin;
+}
+
+// Helper function to read the block size following FRAME_MAGIC, and
+// whether blocks are followed by checksums
+static uint32_t read_block_size(FILE *infile, int *checksums)
+{
+    uint32_t block_size = 0;
+    if (fread(&block_size, sizeof(uint32_t), 1, infile) != 1)
+        RAISE(Block_Corrupted);
+    *checksums = (block_size & FRAME_CHECKSUMS_FLAG) != 0;
+    block_size &= ~FRAME_CHECKSUMS_FLAG;
+    if (block_size < FRAME_MIN_BLOCK_SIZE || block_size > FRAME_MAX_BLOCK_SIZE)
+        RAISE(Block_Corrupted);
+    return block_size;
+}
+
+// Helper function to decode blocks listed in the index in batches of one
+// block per thread. Each worker reads its block at its offset, and writes
+// the decoded bytes at their final position when outfile allows it. Blocks
+// are decoded straight from and into the files when they are mapped
+static void decompress_parallel(FILE *infile, Mapped_File_T mapped, FILE *outfile,
+                                Frame_index_entry *index, uint64_t num_blocks,
+                                uint32_t block_size, unsigned num_threads,
+                                int checksums, int verify, Stats *stats)
+{
+    size_t max_size = Block_bound(block_size, CANONICAL_MAX_CODE_LENGTH) +
+                      (checksums ? FRAME_CHECKSUM_SIZE : 0);
+    for (uint64_t i = 0; i < num_blocks; i++)
+        if (index[i].raw_size > block_size || index[i].size > max_size)
+            RAISE(Block_Corrupted);
+
+    // Outfile is preallocated to its final size and mapped where possible
+    uint64_t raw_total = 0;
+    if (num_blocks > 0)
+        raw_total = index[num_blocks - 1].raw_offset + index[num_blocks - 1].raw_size;
+    Mapped_File_T mapped_out = NULL;
+    int out_fd = -1;
+    if (writes_at_offsets(outfile))
+    {
+        if (raw_total > 0)
+            mapped_out = Mapped_file_create(outfile, raw_total);
+        if (!mapped_out)
+            out_fd = fileno(outfile);
+    }
+
+    Decode_job *jobs = malloc(num_threads * sizeof(Decode_job));
+    assert(jobs);
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        jobs[i].in_fd = fileno(infile);
+        jobs[i].in_data = mapped ? Mapped_file_data(mapped) : NULL;
+        jobs[i].in_size = mapped ? Mapped_file_size(mapped) : 0;
+        jobs[i].out_fd = out_fd;
+        jobs[i].out_data = mapped_out ? Mapped_file_data(mapped_out) : NULL;
+        jobs[i].encoded = mapped ? NULL : malloc(max_size);
+        jobs[i].raw = mapped_out ? NULL : malloc(block_size);
+        jobs[i].workspace = malloc(BLOCK_DECODE_WORKSPACE_SIZE);
+        jobs[i].checksums = checksums;
+        jobs[i].verify = verify;
+        jobs[i].has_stats = stats != NULL;
+        assert((mapped || jobs[i].encoded) && (mapped_out || jobs[i].raw) &&
+               jobs[i].workspace);
+    }
+    Thread_Pool_T thread_pool = Thread_pool_new(num_threads);
+
+    TRY
+        for (uint64_t first = 0; first < num_blocks; first += num_threads)
+        {
+            unsigned num_jobs = num_threads;
+            if (num_blocks - first < num_jobs)
+                num_jobs = (unsigned)(num_blocks - first);
+
+            for (unsigned i = 0; i < num_jobs; i++)
+            {
+                jobs[i].entry = &index[first + i];
+                Thread_pool_submit(thread_pool, decode_block_job, &jobs[i]);
+            }
+            Thread_pool_wait(thread_pool);
+
+            // Pipes and appending files are written in order instead
+            for (unsigned i = 0; i < num_jobs; i++)
+            {
+                if (jobs[i].failed)
+                    RAISE(Block_Corrupted);
+                if (jobs[i].checksum_failed)
+                    RAISE(Frame_Checksum_Failed);
+                if (jobs[i].write_failed)
+                    RAISE(Frame_Write_Failed);
+                double start = Stats_start(stats);
+                if (out_fd < 0 && !mapped_out)
+                    fwrite(jobs[i].raw, 1, jobs[i].entry->raw_size, outfile);
+                Stats_lap(stats, STATS_WRITE, start);
+                if (jobs[i].has_stats)
+                    Stats_merge(stats, &jobs[i].stats);
+            }
+        }
+    FINALLY
+        Thread_pool_free(&thread_pool);
+        if (mapped_out)
+            Mapped_file_free(&mapped_out);
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            free(jobs[i].encoded);
+            free(jobs[i].raw);
+            free(jobs[i].workspace);
+        }
+        free(jobs);
+    END_TRY;
+    if (stats)
+    {
+        struct stat file_stat;
+        if (fstat(fileno(infile), &file_stat) == 0)
+            stats->bytes_in += (uint64_t)file_stat.st_size;
+        stats->bytes_out += raw_total;
+        stats->num_blocks += num_blocks;
+    }
+}
+
+// Helper function run on the thread pool to read, decode and possibly
+// write one block
+static void decode_block_job(void *arg)
+{
+    Decode_job *job = arg;
+    const Frame_index_entry *entry = job->entry;
+    uint8_t *raw = job->out_data ? job->out_data + entry->raw_offset : job->raw;
+    Stats *stats = job->has_stats ? &job->stats : NULL;
+    job->failed = 0;
+    job->checksum_failed = 0;
+    job->write_failed = 0;
+    if (stats)
+        Stats_init(stats);
+
+    TRY
+        double start = Stats_start(stats);
+        const uint8_t *encoded = job->encoded;
+        size_t size = entry->size;
+        if (job->in_data)
+        {
+            if (entry->offset + size > job->in_size)
+                RAISE(Block_Corrupted);
+            encoded = job->in_data + entry->offset;
+        }
+        else if (pread(job->in_fd, job->encoded, size, (off_t)entry->offset) !=
+                 (ssize_t)size)
+            RAISE(Block_Corrupted);
+        Stats_lap(stats, STATS_READ, start);
+
+        // The block and its checksum must fill exactly the size given by
+        // the index
+        size_t checksum_size = job->checksums ? FRAME_CHECKSUM_SIZE : 0;
+        Block_header header;
+        if (Block_header_size(encoded) > size)
+            RAISE(Block_Corrupted);
+        Block_read_header(encoded, &header);
+        if (header.raw_size != entry->raw_size ||
+            header.header_size + header.jump_table_size + checksum_size > size)
+            RAISE(Block_Corrupted);
+        Block_read_jump_table(encoded + header.header_size, &header);
+        if (header.header_size + header.jump_table_size + header.payload_size +
+            checksum_size != size)
+            RAISE(Block_Corrupted);
+        Block_decode(&header, encoded + header.header_size + header.jump_table_size, raw,
+                     job->workspace, stats);
+        if (job->verify)
+        {
+            uint32_t checksum;
+            memcpy(&checksum, encoded + size - checksum_size, sizeof(uint32_t));
+            start = Stats_start(stats);
+            uint32_t raw_checksum = Crc32c_update(0, raw, entry->raw_size);
+            Stats_lap(stats, STATS_CHECKSUM, start);
+            if (raw_checksum != checksum)
+                RAISE(Frame_Checksum_Failed);
+        }
+    EXCEPT(Frame_Checksum_Failed)
+        job->checksum_failed = 1;
+    ELSE
+        job->failed = 1;
+    END_TRY;
+
+    double start = Stats_start(stats);
+    if (!job->failed && !job->checksum_failed && job->out_fd >= 0 &&
+        pwrite(job->out_fd, raw, entry->raw_size, (off_t)entry->raw_offset) !=
+        (ssize_t)entry->raw_size)
+        job->write_failed = 1;
+    Stats_lap(stats, STATS_WRITE, start);
+}
+
+// Helper function to check outfile is a regular file written from its
+// start, so that blocks can be written at their offsets
+static int writes_at_offsets(FILE *outfile)
+{
+    struct stat file_stat;
+    int fd = fileno(outfile);
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+        return 0;
+    if (fcntl(fd, F_GETFL) & O_APPEND)
+        return 0;
+    return ftell(outfile) == 0 && lseek(fd, 0, SEEK_CUR) == 0;
+}
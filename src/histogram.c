@@ -0,0 +1,156 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: histogram.c
+*
+*   Description: Implementation of histogram module, which counts the
+*   occurrences of every byte of a buffer over interleaved sub-histograms
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <string.h>
+#include "../include/histogram.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HISTOGRAM_HAVE_AVX2 1
+#endif
+
+/* Bytes counted before the 32-bit sub-histograms are merged, so that
+ * none of them can overflow */
+#define SLICE_SIZE ((size_t)1 << 30)
+
+/* Helper function prototypes */
+static void count_slice_portable(const uint8_t *src, size_t size, uint64_t *counts);
+#ifdef HISTOGRAM_HAVE_AVX2
+static void count_slice_avx2(const uint8_t *src, size_t size, uint64_t *counts);
+#endif
+
+/*
+ * Function:        Histogram_count
+ * Description:     Adds the occurrences of each byte of src to counts,
+ *                  using the AVX2 kernel when the processor supports it
+ * Parameters:      uint8_t *src: bytes to count
+ *                  size_t size: number of bytes in src
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts, updated after
+ *                  the function is called
+ * Return:          void
+ */
+void Histogram_count(const uint8_t *src, size_t size, uint64_t *counts)
+{
+#ifdef HISTOGRAM_HAVE_AVX2
+    assert((src || size == 0) && counts);
+    if (__builtin_cpu_supports("avx2"))
+    {
+        for (size_t i = 0; i < size; i += SLICE_SIZE)
+            count_slice_avx2(src + i, size - i < SLICE_SIZE ? size - i : SLICE_SIZE,
+                             counts);
+        return;
+    }
+#endif
+    Histogram_count_portable(src, size, counts);
+}
+
+/*
+ * Function:        Histogram_count_portable
+ * Description:     Same as Histogram_count, without processor-specific
+ *                  instructions
+ * Parameters:      uint8_t *src: bytes to count
+ *                  size_t size: number of bytes in src
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts, updated after
+ *                  the function is called
+ * Return:          void
+ */
+void Histogram_count_portable(const uint8_t *src, size_t size, uint64_t *counts)
+{
+    assert((src || size == 0) && counts);
+    for (size_t i = 0; i < size; i += SLICE_SIZE)
+        count_slice_portable(src + i, size - i < SLICE_SIZE ? size - i : SLICE_SIZE,
+                             counts);
+}
+
+// Helper function to count up to SLICE_SIZE bytes over four sub-histograms,
+// 16 bytes per iteration, read as two 64-bit words
+static void count_slice_portable(const uint8_t *src, size_t size, uint64_t *counts)
+{
+    uint32_t tables[4][HISTOGRAM_SIZE];
+    memset(tables, 0, sizeof(tables));
+
+    size_t i = 0;
+    for (; i + 2 * sizeof(uint64_t) <= size; i += 2 * sizeof(uint64_t))
+    {
+        uint64_t low, high;
+        memcpy(&low, src + i, sizeof(uint64_t));
+        memcpy(&high, src + i + sizeof(uint64_t), sizeof(uint64_t));
+        for (int shift = 0; shift < 64; shift += 32)
+        {
+            tables[0][(uint8_t)(low >> shift)]++;
+            tables[1][(uint8_t)(low >> (shift + 8))]++;
+            tables[2][(uint8_t)(low >> (shift + 16))]++;
+            tables[3][(uint8_t)(low >> (shift + 24))]++;
+            tables[0][(uint8_t)(high >> shift)]++;
+            tables[1][(uint8_t)(high >> (shift + 8))]++;
+            tables[2][(uint8_t)(high >> (shift + 16))]++;
+            tables[3][(uint8_t)(high >> (shift + 24))]++;
+        }
+    }
+    for (; i < size; i++)
+        tables[0][src[i]]++;
+
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        counts[c] += (uint64_t)tables[0][c] + tables[1][c] + tables[2][c] + tables[3][c];
+}
+
+#ifdef HISTOGRAM_HAVE_AVX2
+// Helper function to count up to SLICE_SIZE bytes over eight sub-histograms,
+// 32 bytes per iteration. A vector holding a single repeated byte, as in
+// long runs of zeros, is counted with one addition
+__attribute__((target("avx2")))
+static void count_slice_avx2(const uint8_t *src, size_t size, uint64_t *counts)
+{
+    uint32_t tables[8][HISTOGRAM_SIZE];
+    memset(tables, 0, sizeof(tables));
+
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i first = _mm256_set1_epi8((char)src[i]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, first)) == -1)
+        {
+            tables[0][src[i]] += sizeof(__m256i);
+            continue;
+        }
+
+        uint64_t words[4] = {(uint64_t)_mm256_extract_epi64(bytes, 0),
+                             (uint64_t)_mm256_extract_epi64(bytes, 1),
+                             (uint64_t)_mm256_extract_epi64(bytes, 2),
+                             (uint64_t)_mm256_extract_epi64(bytes, 3)};
+        for (int w = 0; w < 4; w++)
+        {
+            tables[0][(uint8_t)words[w]]++;
+            tables[1][(uint8_t)(words[w] >> 8)]++;
+            tables[2][(uint8_t)(words[w] >> 16)]++;
+            tables[3][(uint8_t)(words[w] >> 24)]++;
+            tables[4][(uint8_t)(words[w] >> 32)]++;
+            tables[5][(uint8_t)(words[w] >> 40)]++;
+            tables[6][(uint8_t)(words[w] >> 48)]++;
+            tables[7][(uint8_t)(words[w] >> 56)]++;
+        }
+    }
+    for (; i < size; i++)
+        tables[0][src[i]]++;
+
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+    {
+        uint64_t sum = 0;
+        for (int t = 0; t < 8; t++)
+            sum += tables[t][c];
+        counts[c] += sum;
+    }
+}
+#endif
@@ -0,0 +1,251 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: huffman.c
+*
+*   Description: Implementation of huffman module, which compresses and
+*   decompresses buffers in memory through the block module
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <string.h>
+#include "../include/huffman.h"
+#include "../include/crc32c.h"
+#include "../include/frame.h"
+
+/* Bytes of the frame header, <FRAME_MAGIC><BLOCK_SIZE> */
+#define HEADER_SIZE (FRAME_MAGIC_SIZE + sizeof(uint32_t))
+
+const Except_T Huffman_Output_Too_Small = {"Output buffer too small"};
+
+/* Helper function prototypes */
+static size_t compress_single(const uint8_t *in, size_t src_size, uint8_t *out,
+                              size_t dst_capacity, void *workspace);
+static size_t decode_single(const uint8_t *in, size_t src_size, uint8_t *out,
+                            size_t dst_capacity, void *workspace);
+static size_t decode_frame(const uint8_t *in, size_t src_size, uint8_t *out,
+                           size_t dst_capacity, void *workspace);
+static size_t decode_block(const uint8_t *in, size_t src_size, size_t *position,
+                           uint8_t *out, size_t dst_capacity, uint32_t block_size,
+                           size_t checksum_size, void *workspace);
+
+/*
+ * Function:        Huffman_compress_bound
+ * Description:     Gets the largest possible size of a compressed buffer
+ * Parameters:      size_t src_size: number of bytes to compress
+ * Return:          size_t: capacity of dst that always suffices
+ */
+size_t Huffman_compress_bound(size_t src_size)
+{
+    if (src_size <= FRAME_DEFAULT_BLOCK_SIZE)
+        return HUFFMAN_SINGLE_MAGIC_SIZE + (src_size > 0 ?
+               Block_bound(src_size, CANONICAL_MAX_CODE_LENGTH) : sizeof(uint32_t));
+    size_t num_full = src_size / FRAME_DEFAULT_BLOCK_SIZE;
+    size_t last_size = src_size % FRAME_DEFAULT_BLOCK_SIZE;
+    size_t bound = HEADER_SIZE + sizeof(uint32_t) +
+                   num_full * Block_bound(FRAME_DEFAULT_BLOCK_SIZE, CANONICAL_MAX_CODE_LENGTH);
+    if (last_size)
+        bound += Block_bound(last_size, CANONICAL_MAX_CODE_LENGTH);
+    return bound;
+}
+
+/*
+ * Function:        Huffman_compress
+ * Description:     Compresses src into dst, as a single block if it fits
+ *                  in one, or else one block of FRAME_DEFAULT_BLOCK_SIZE
+ *                  bytes at a time. Raises Huffman_Output_Too_Small if dst
+ *                  may not hold the next block, which never happens with
+ *                  a capacity of Huffman_compress_bound(src_size)
+ * Parameters:      void *src: bytes to compress
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ *                  void *workspace: HUFFMAN_COMPRESS_WORKSPACE_SIZE bytes
+ *                  aligned like malloc
+ * Return:          size_t: number of bytes written to dst
+ */
+size_t Huffman_compress(const void *src, size_t src_size, void *dst,
+                        size_t dst_capacity, void *workspace)
+{
+    assert((src || src_size == 0) && dst && workspace);
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    if (src_size <= FRAME_DEFAULT_BLOCK_SIZE)
+        return compress_single(in, src_size, out, dst_capacity, workspace);
+    if (dst_capacity < HEADER_SIZE + sizeof(uint32_t))
+        RAISE(Huffman_Output_Too_Small);
+
+    uint32_t block_size = FRAME_DEFAULT_BLOCK_SIZE;
+    Block_options options = Block_default_options();
+    memcpy(out, FRAME_MAGIC, FRAME_MAGIC_SIZE);
+    memcpy(out + FRAME_MAGIC_SIZE, &block_size, sizeof(uint32_t));
+    size_t size = HEADER_SIZE;
+
+    // Blocks are encoded straight into dst, so that each must fit its
+    // bound, leaving room for the end marker
+    for (size_t i = 0; i < src_size; i += block_size)
+    {
+        uint32_t raw_size = src_size - i < block_size ? (uint32_t)(src_size - i) : block_size;
+        if (dst_capacity - size - sizeof(uint32_t) <
+            Block_bound(raw_size, CANONICAL_MAX_CODE_LENGTH))
+            RAISE(Huffman_Output_Too_Small);
+        size += Block_encode(in + i, raw_size, &options, out + size, workspace, NULL);
+    }
+
+    uint32_t end_marker = 0;
+    memcpy(out + size, &end_marker, sizeof(uint32_t));
+    return size + sizeof(uint32_t);
+}
+
+/*
+ * Function:        Huffman_decompress
+ * Description:     Decompresses a buffer made by Huffman_compress or
+ *                  `huffman`. Raises Block_Corrupted on malformed or
+ *                  truncated input, or blocks that do not match their
+ *                  checksums, and Huffman_Output_Too_Small if dst cannot
+ *                  hold the decoded bytes
+ * Parameters:      void *src: compressed bytes
+ *                  size_t src_size: number of bytes in src
+ *                  void *dst: output buffer
+ *                  size_t dst_capacity: number of bytes dst can hold
+ *                  void *workspace: HUFFMAN_DECOMPRESS_WORKSPACE_SIZE
+ *                  bytes aligned like malloc
+ * Return:          size_t: number of bytes written to dst
+ */
+size_t Huffman_decompress(const void *src, size_t src_size, void *dst,
+                          size_t dst_capacity, void *workspace)
+{
+    assert((src || src_size == 0) && (dst || dst_capacity == 0) && workspace);
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+
+    // Code lengths that do not form a prefix code are corrupted input too
+    volatile size_t size = 0;
+    TRY
+        if (src_size >= HUFFMAN_SINGLE_MAGIC_SIZE &&
+            memcmp(in, HUFFMAN_SINGLE_MAGIC, HUFFMAN_SINGLE_MAGIC_SIZE) == 0)
+            size = decode_single(in, src_size, out, dst_capacity, workspace);
+        else
+            size = decode_frame(in, src_size, out, dst_capacity, workspace);
+    EXCEPT(Huffman_Invalid_Lengths)
+        RAISE(Block_Corrupted);
+    END_TRY;
+    return size;
+}
+
+// Helper function to compress a buffer of at most one block as a single
+// block after HUFFMAN_SINGLE_MAGIC. Returns the number of bytes written
+static size_t compress_single(const uint8_t *in, size_t src_size, uint8_t *out,
+                              size_t dst_capacity, void *workspace)
+{
+    if (dst_capacity < Huffman_compress_bound(src_size))
+        RAISE(Huffman_Output_Too_Small);
+    memcpy(out, HUFFMAN_SINGLE_MAGIC, HUFFMAN_SINGLE_MAGIC_SIZE);
+    if (src_size == 0)
+    {
+        uint32_t raw_size = 0;
+        memcpy(out + HUFFMAN_SINGLE_MAGIC_SIZE, &raw_size, sizeof(uint32_t));
+        return HUFFMAN_SINGLE_MAGIC_SIZE + sizeof(uint32_t);
+    }
+    Block_options options = Block_default_options();
+    return HUFFMAN_SINGLE_MAGIC_SIZE +
+           Block_encode(in, (uint32_t)src_size, &options, out + HUFFMAN_SINGLE_MAGIC_SIZE,
+                        workspace, NULL);
+}
+
+// Helper function to decode the single block following
+// HUFFMAN_SINGLE_MAGIC, which must end the input, or the zero raw size of
+// the empty buffer. Returns the number of bytes written to dst
+static size_t decode_single(const uint8_t *in, size_t src_size, uint8_t *out,
+                            size_t dst_capacity, void *workspace)
+{
+    size_t position = HUFFMAN_SINGLE_MAGIC_SIZE;
+    uint32_t raw_size;
+    if (src_size - position < sizeof(uint32_t))
+        RAISE(Block_Corrupted);
+    memcpy(&raw_size, in + position, sizeof(uint32_t));
+    if (raw_size == 0)
+    {
+        if (src_size - position != sizeof(uint32_t))
+            RAISE(Block_Corrupted);
+        return 0;
+    }
+    size_t size = decode_block(in, src_size, &position, out, dst_capacity,
+                               FRAME_DEFAULT_BLOCK_SIZE, 0, workspace);
+    if (position != src_size)
+        RAISE(Block_Corrupted);
+    return size;
+}
+
+// Helper function to check the frame header, then decode the blocks
+// following it up to the end marker into dst. Returns the number of bytes
+// written to dst
+static size_t decode_frame(const uint8_t *in, size_t src_size, uint8_t *out,
+                           size_t dst_capacity, void *workspace)
+{
+    uint32_t block_size = 0;
+    if (src_size < HEADER_SIZE || memcmp(in, FRAME_MAGIC, FRAME_MAGIC_SIZE) != 0)
+        RAISE(Block_Corrupted);
+    memcpy(&block_size, in + FRAME_MAGIC_SIZE, sizeof(uint32_t));
+    size_t checksum_size = block_size & FRAME_CHECKSUMS_FLAG ? FRAME_CHECKSUM_SIZE : 0;
+    block_size &= ~FRAME_CHECKSUMS_FLAG;
+    if (block_size < FRAME_MIN_BLOCK_SIZE || block_size > FRAME_MAX_BLOCK_SIZE)
+        RAISE(Block_Corrupted);
+
+    // Anything after the end marker, such as the block index of files, is
+    // left unread
+    size_t position = HEADER_SIZE;
+    size_t size = 0;
+    while (1)
+    {
+        uint32_t raw_size;
+        if (src_size - position < sizeof(uint32_t))
+            RAISE(Block_Corrupted);
+        memcpy(&raw_size, in + position, sizeof(uint32_t));
+        if (raw_size == 0)
+            break;
+        size += decode_block(in, src_size, &position, out + size, dst_capacity - size,
+                             block_size, checksum_size, workspace);
+    }
+    return size;
+}
+
+// Helper function to decode the block at position, followed by a checksum
+// of checksum_size bytes, into dst and move position past them. Returns
+// the number of bytes written to dst
+static size_t decode_block(const uint8_t *in, size_t src_size, size_t *position,
+                           uint8_t *out, size_t dst_capacity, uint32_t block_size,
+                           size_t checksum_size, void *workspace)
+{
+    Block_header header;
+    size_t at = *position;
+    if (src_size - at < BLOCK_PREFIX_SIZE || src_size - at < Block_header_size(in + at))
+        RAISE(Block_Corrupted);
+    Block_read_header(in + at, &header);
+    at += header.header_size;
+    if (header.raw_size > block_size || src_size - at < header.jump_table_size)
+        RAISE(Block_Corrupted);
+    Block_read_jump_table(in + at, &header);
+    at += header.jump_table_size;
+    if (src_size - at < header.payload_size + checksum_size)
+        RAISE(Block_Corrupted);
+    if (dst_capacity < header.raw_size)
+        RAISE(Huffman_Output_Too_Small);
+
+    Block_decode(&header, in + at, out, workspace, NULL);
+    at += header.payload_size;
+    if (checksum_size)
+    {
+        uint32_t checksum;
+        memcpy(&checksum, in + at, sizeof(uint32_t));
+        if (Crc32c_update(0, out, header.raw_size) != checksum)
+            RAISE(Block_Corrupted);
+        at += checksum_size;
+    }
+    *position = at;
+    return header.raw_size;
+}
@@ -22,17 +22,36 @@
 
 #define T Huffman_Tree_T
 
-/* structure of Huffman Tree */
+const Except_T Huffman_Invalid_Lengths = {"Invalid Huffman code lengths"};
+
+/* structure of Huffman Tree. Nodes are stored in breadth-first order,
+ * with the root first, so that parents always come before their children */
 struct T
 {
     Array_T encoding_table;
-    Huffman_node *root;
+    Decoded_value *decoding_table;
+    unsigned decoding_table_bits;
+    uint32_t decoding_table_size;
+    Huffman_node nodes[HUFFMAN_TREE_MAX_NODES];
+    uint16_t num_nodes;
+    Huffman_node leaves[MAX_NUM_CHAR];  // leaves given to Huffman_tree_build
+    uint16_t num_leaves;
+    Huffman_node staged[HUFFMAN_TREE_MAX_NODES]; // nodes while building
+    Node staged_entries[MAX_NUM_CHAR];  // queue entries of the staged leaves
+    Priority_Queue_T min_queue;         // queue kept from one build to the next
 };
 
 /* Helper function prototypes */
-static void Huffman_tree_postorder_free(Huffman_node *root);
-static void add_leaf_to_table(Huffman_node *root, Array_T encoding, 
-                                unsigned int length, uint64_t value);
+static uint16_t new_node(Huffman_node *nodes, uint16_t *num_nodes, char key,
+                         uint64_t frequency);
+static void layout_nodes(T huffman_tree, const Huffman_node *staged,
+                         uint16_t root);
+static void get_heights(T huffman_tree, uint8_t *heights);
+static uint32_t add_decoding_table(T huffman_tree, const uint8_t *heights,
+                                   uint16_t root, unsigned bits);
+static void fill_decoding_table(T huffman_tree, const uint8_t *heights,
+                                uint16_t index, uint32_t offset, unsigned bits,
+                                unsigned depth, uint32_t code);
 
 /*
  * Function:        Huffman_tree_new
@@ -45,7 +64,13 @@ T Huffman_tree_new()
     assert(huffman_tree != NULL);
 
     huffman_tree->encoding_table = NULL;
-    huffman_tree->root = NULL;
+    huffman_tree->decoding_table = NULL;
+    huffman_tree->decoding_table_bits = 0;
+    huffman_tree->decoding_table_size = 0;
+    huffman_tree->num_nodes = 0;
+    huffman_tree->num_leaves = 0;
+    huffman_tree->min_queue = Priority_queue_new(0);
+    Priority_queue_reserve(huffman_tree->min_queue, MAX_NUM_CHAR);
 
     return huffman_tree;
 }
@@ -60,63 +85,219 @@ T Huffman_tree_new()
 void Huffman_tree_free(T *huffman_tree)
 {
     assert(huffman_tree && *huffman_tree);
-    Huffman_node *root = (*huffman_tree)->root;
-    Huffman_tree_postorder_free(root);
 
     if ((*huffman_tree)->encoding_table)
     {
         Array_free(&((*huffman_tree)->encoding_table));
     }
+    free((*huffman_tree)->decoding_table);
+    Priority_queue_free(&(*huffman_tree)->min_queue);
     free(*huffman_tree);
 }
 
-/**
- * Static helper function to perform Huffman tree deletion
+/*
+ * Function:        Huffman_tree_clear
+ * Description:     Removes every node and leaf of the tree, so that the
+ *                  tree can be built again. Tables are kept for the next
+ *                  call creating them
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ * Return:          void
  */
-static void Huffman_tree_postorder_free(Huffman_node *root)
+void Huffman_tree_clear(T huffman_tree)
 {
-    if (!root)
-        return;
-    Huffman_tree_postorder_free(root->left_node);
-    Huffman_tree_postorder_free(root->right_node);
-    free(root);
+    assert(huffman_tree);
+    huffman_tree->num_nodes = 0;
+    huffman_tree->num_leaves = 0;
+}
+
+/*
+ * Function:        Huffman_tree_new_leaf
+ * Description:     Adds a leaf to the tree, to be put in the entries
+ *                  given to Huffman_tree_build. A tree holds at most
+ *                  MAX_NUM_CHAR leaves until it is cleared, and the leaf
+ *                  is released with the tree
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  char key: character of the leaf
+ *                  uint64_t frequency: frequency of the character
+ * Return:          Pointer to struct `Huffman_node`
+ */
+Huffman_node *Huffman_tree_new_leaf(T huffman_tree, char key, uint64_t frequency)
+{
+    assert(huffman_tree && huffman_tree->num_leaves < MAX_NUM_CHAR);
+    uint16_t leaf = new_node(huffman_tree->leaves, &huffman_tree->num_leaves,
+                             key, frequency);
+    return &huffman_tree->leaves[leaf];
 }
 
 /*
  * Function:        Huffman_tree_build
- * Description:     Builds huffman tree given the array of node entries
+ * Description:     Builds huffman tree given the array of node entries,
+ *                  staging its nodes in space kept by the tree, so that
+ *                  building it again allocates nothing
  * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
- *                  Array_T entries: All node entries (char and frequency)
+ *                  Array_T entries: All node entries (char and frequency),
+ *                  whose leaves come from Huffman_tree_new_leaf
  * Return:          void     
  */
 void Huffman_tree_build(T huffman_tree, Array_T entries)
 {
-    Priority_Queue_T min_queue = Priority_queue_new(0);
-    Priority_queue_build(min_queue, entries);
+    assert(huffman_tree && entries && Array_length(entries) > 0);
+    assert(Array_length(entries) <= MAX_NUM_CHAR);
+
+    // Leaves are copied first, so that every node of the queue points
+    // into one array and children are known by their index in it. The
+    // staging area and queue belong to the tree, so that building it
+    // again allocates nothing
+    Huffman_node *staged = huffman_tree->staged;
+    uint16_t num_staged = 0;
+    int num_entries = Array_length(entries);
+    for (int i = 0; i < num_entries; i++)
+    {
+        Node *entry = (Node *)Array_get(entries, i);
+        Huffman_node *leaf = (Huffman_node *)entry->obj;
+        Node node = {&staged[new_node(staged, &num_staged, leaf->key, entry->value)],
+                     entry->value};
+        huffman_tree->staged_entries[i] = node;
+    }
+
+    struct Array_T staged_entries;
+    ArrayRep_init(&staged_entries, num_entries, sizeof(Node), huffman_tree->staged_entries);
+    Priority_Queue_T min_queue = huffman_tree->min_queue;
+    Priority_queue_build(min_queue, &staged_entries);
 
     while (Priority_queue_size(min_queue) > 1)
     {
         // Extract first min nodes
         Node *first_element = (Node *)Priority_queue_pop(min_queue);
+        uint16_t left = (Huffman_node *)first_element->obj - staged;
         Node *second_element = (Node *)Priority_queue_pop(min_queue);
+        uint16_t right = (Huffman_node *)second_element->obj - staged;
 
         // Create new parent node from 2 extracted min nodes
-        Huffman_node *obj = malloc(sizeof(Huffman_node));
-        assert(obj);
-        obj->left_node = (Huffman_node *)first_element->obj;
-        obj->right_node = (Huffman_node *)second_element->obj;
-
-        int new_freq = first_element->value + second_element->value;
-        obj->frequency = new_freq;
-        obj->key = '-';
+        uint64_t new_freq = staged[left].frequency + staged[right].frequency;
+        uint16_t parent = new_node(staged, &num_staged, '-', new_freq);
+        staged[parent].left_node = left;
+        staged[parent].right_node = right;
 
-        Priority_queue_insert(min_queue, obj, new_freq);
+        Priority_queue_insert(min_queue, &staged[parent], new_freq);
     }
-    // Assign extracted root node to root attributes
-    // of the Huffman tree
+    // Root is the last node extracted, and is moved to the front of the
+    // nodes of the tree along with the rest in breadth-first order
     Node *root = (Node *)Priority_queue_pop(min_queue);
-    huffman_tree->root = (Huffman_node *)root->obj;
-    Priority_queue_free(&min_queue);
+    layout_nodes(huffman_tree, staged, (Huffman_node *)root->obj - staged);
+}
+
+/*
+ * Function:        Huffman_tree_build_canonical
+ * Description:     Builds the canonical Huffman tree for the given code
+ *                  lengths. Codes are assigned in order of length, then
+ *                  character, so the lengths alone describe the tree.
+ *                  Raises Huffman_Invalid_Lengths if the lengths do not
+ *                  form a complete prefix code
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  uint8_t *lengths: MAX_NUM_CHAR code lengths, 0 for
+ *                  characters without a code
+ * Return:          void
+ */
+void Huffman_tree_build_canonical(T huffman_tree, const uint8_t *lengths)
+{
+    assert(huffman_tree && lengths && huffman_tree->num_nodes == 0);
+
+    // Count codes of each length, checking the Kraft sum is exactly one
+    uint64_t length_count[64] = {0};
+    uint64_t kraft_sum = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+    {
+        if (lengths[i] == 0)
+            continue;
+        if (lengths[i] >= 64)
+            RAISE(Huffman_Invalid_Lengths);
+
+        uint64_t weight = (uint64_t)1 << (63 - lengths[i]);
+        if (kraft_sum + weight < kraft_sum || kraft_sum + weight > ((uint64_t)1 << 63))
+            RAISE(Huffman_Invalid_Lengths);
+        kraft_sum += weight;
+        length_count[lengths[i]]++;
+    }
+    if (kraft_sum != ((uint64_t)1 << 63))
+        RAISE(Huffman_Invalid_Lengths);
+
+    // First code of each length follows the last code of the shorter length
+    uint64_t next_code[64] = {0};
+    uint64_t code = 0;
+    for (int length = 1; length < 64; length++)
+    {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+
+    // Insert each code into the tree, creating internal nodes on the way.
+    // The root is node 0, so that no child has index 0
+    Huffman_node staged[HUFFMAN_TREE_MAX_NODES];
+    uint16_t num_staged = 0;
+    new_node(staged, &num_staged, '-', 0);
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+    {
+        unsigned length = lengths[i];
+        if (length == 0)
+            continue;
+        uint64_t value = next_code[length]++;
+
+        uint16_t curr = 0;
+        for (unsigned bit = length; bit > 1; bit--)
+        {
+            uint16_t *child = ((value >> (bit - 1)) & 0x1) ?
+                              &staged[curr].right_node : &staged[curr].left_node;
+            if (!*child)
+                *child = new_node(staged, &num_staged, '-', 0);
+            curr = *child;
+        }
+
+        uint16_t leaf = new_node(staged, &num_staged, (char)i, 0);
+        if (value & 0x1)
+            staged[curr].right_node = leaf;
+        else
+            staged[curr].left_node = leaf;
+    }
+    layout_nodes(huffman_tree, staged, 0);
+}
+
+// Helper function to append a node without children to nodes. Returns its
+// index
+static uint16_t new_node(Huffman_node *nodes, uint16_t *num_nodes, char key,
+                         uint64_t frequency)
+{
+    uint16_t index = (*num_nodes)++;
+    nodes[index].frequency = frequency;
+    nodes[index].left_node = 0;
+    nodes[index].right_node = 0;
+    nodes[index].key = key;
+    return index;
+}
+
+// Helper function to copy the tree rooted at staged[root] into the nodes
+// of the tree in breadth-first order. Each node taken from the queue of
+// staged indices gets the next free positions for its children
+static void layout_nodes(T huffman_tree, const Huffman_node *staged,
+                         uint16_t root)
+{
+    uint16_t order[HUFFMAN_TREE_MAX_NODES];
+    uint16_t tail = 0;
+    order[tail++] = root;
+    for (uint16_t i = 0; i < tail; i++)
+    {
+        Huffman_node node = staged[order[i]];
+        if (node.left_node || node.right_node)
+        {
+            assert(tail + 2 <= HUFFMAN_TREE_MAX_NODES);
+            order[tail] = node.left_node;
+            node.left_node = tail++;
+            order[tail] = node.right_node;
+            node.right_node = tail++;
+        }
+        huffman_tree->nodes[i] = node;
+    }
+    huffman_tree->num_nodes = tail;
 }
 
 /*
@@ -128,12 +309,29 @@ void Huffman_tree_build(T huffman_tree, Array_T entries)
  */
 Array_T Huffman_tree_create_encoding_table(T huffman_tree)
 {
-    assert(huffman_tree->root);
+    assert(huffman_tree->num_nodes > 0);
     
     // Allocate dictionary as an array of capacity 256
     Array_T encoding = Array_new(MAX_NUM_CHAR, sizeof(Encoded_value));
 
-    add_leaf_to_table(huffman_tree->root, encoding, 0, 0);
+    // Parents come before their children, so the code of every node is
+    // known by the time it is reached
+    const Huffman_node *nodes = huffman_tree->nodes;
+    Encoded_value codes[HUFFMAN_TREE_MAX_NODES];
+    codes[0].bit_value = 0;
+    codes[0].bit_length = 0;
+    for (uint16_t i = 0; i < huffman_tree->num_nodes; i++)
+    {
+        if (!nodes[i].left_node && !nodes[i].right_node)
+        {
+            Array_put(encoding, (unsigned char)nodes[i].key, &codes[i]);
+            continue;
+        }
+        codes[nodes[i].left_node].bit_value = codes[i].bit_value << 1;
+        codes[nodes[i].left_node].bit_length = codes[i].bit_length + 1;
+        codes[nodes[i].right_node].bit_value = (codes[i].bit_value << 1) + 0x1;
+        codes[nodes[i].right_node].bit_length = codes[i].bit_length + 1;
+    }
     if (huffman_tree->encoding_table)
         Array_free(&huffman_tree->encoding_table);
     huffman_tree->encoding_table = encoding;
@@ -141,36 +339,138 @@ Array_T Huffman_tree_create_encoding_table(T huffman_tree)
     return huffman_tree->encoding_table;
 }
 
-// Helper function to add leaf node to encoding table
-static void add_leaf_to_table(Huffman_node *root, Array_T encoding, 
-                                unsigned int length, uint64_t value)
+/*
+ * Function:        Huffman_tree_create_decoding_table
+ * Description:     Builds a lookup table that decodes up to
+ *                  DECODING_TABLE_BITS bits of the encoded stream in one
+ *                  step. Longer codes continue through chained sub-tables
+ *                  of up to DECODING_SUBTABLE_BITS bits each. The table is
+ *                  owned by the tree and freed along with it.
+ * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
+ *                  unsigned *root_bits: updated with the index width of the
+ *                  root table (1 if the tree is a single leaf, whose
+ *                  character then takes one bit)
+ * Return           Pointer to the root table of `Decoded_value` entries
+ */
+Decoded_value *Huffman_tree_create_decoding_table(T huffman_tree,
+                                                  unsigned *root_bits)
 {
-    // Base case: leaf node
-    if (!(root->left_node) && !(root->right_node))
+    assert(huffman_tree && huffman_tree->num_nodes > 0 && root_bits);
+
+    free(huffman_tree->decoding_table);
+    huffman_tree->decoding_table = NULL;
+    huffman_tree->decoding_table_size = 0;
+
+    // Root table is no wider than the deepest code
+    uint8_t heights[HUFFMAN_TREE_MAX_NODES];
+    get_heights(huffman_tree, heights);
+    unsigned bits = heights[0];
+    if (bits > DECODING_TABLE_BITS)
+        bits = DECODING_TABLE_BITS;
+
+    // A lone leaf has no code: its character is read one bit at a time,
+    // as walking the tree did, rather than consuming nothing
+    if (bits == 0)
+        bits = 1;
+    add_decoding_table(huffman_tree, heights, 0, bits);
+    if (heights[0] == 0)
+        for (uint32_t i = 0; i < huffman_tree->decoding_table_size; i++)
+            huffman_tree->decoding_table[i].bit_length = 1;
+    huffman_tree->decoding_table_bits = bits;
+
+    *root_bits = bits;
+    return huffman_tree->decoding_table;
+}
+
+// Helper function to get the length of the longest code below each node.
+// Children come after their parents, so nodes are visited backwards
+static void get_heights(T huffman_tree, uint8_t *heights)
+{
+    const Huffman_node *nodes = huffman_tree->nodes;
+    for (int i = huffman_tree->num_nodes - 1; i >= 0; i--)
     {
-        Encoded_value *encoded_val = malloc(sizeof(Encoded_value));
-        assert(encoded_val);
-        encoded_val->bit_value = value;
-        encoded_val->bit_length = length;
-
-        // printf("Bit value: %"PRIu64", Bit length: %d\n", value, length);
-        Array_put(encoding, (int)(root->key), encoded_val);
-        free(encoded_val);
+        if (!nodes[i].left_node && !nodes[i].right_node)
+        {
+            heights[i] = 0;
+            continue;
+        }
+        uint8_t left = heights[nodes[i].left_node];
+        uint8_t right = heights[nodes[i].right_node];
+        heights[i] = 1 + (left > right ? left : right);
+    }
+}
+
+// Helper function to append a table of 2^bits entries decoding the
+// subtree at root. Returns the offset of the new table
+static uint32_t add_decoding_table(T huffman_tree, const uint8_t *heights,
+                                   uint16_t root, unsigned bits)
+{
+    uint32_t offset = huffman_tree->decoding_table_size;
+    uint32_t new_size = offset + ((uint32_t)1 << bits);
+
+    huffman_tree->decoding_table = realloc(huffman_tree->decoding_table,
+                                           new_size * sizeof(Decoded_value));
+    assert(huffman_tree->decoding_table);
+    huffman_tree->decoding_table_size = new_size;
+
+    fill_decoding_table(huffman_tree, heights, root, offset, bits, 0, 0);
+    return offset;
+}
+
+// Helper function to fill the entries of one table. Leaves shallower than
+// the table width are replicated across every index sharing their prefix,
+// and internal nodes at the full width get a chained sub-table
+static void fill_decoding_table(T huffman_tree, const uint8_t *heights,
+                                uint16_t index, uint32_t offset, unsigned bits,
+                                unsigned depth, uint32_t code)
+{
+    const Huffman_node *node = &huffman_tree->nodes[index];
+    Decoded_value entry;
+
+    if (!(node->left_node) && !(node->right_node))
+    {
+        entry.subtable = 0;
+        entry.symbol = (unsigned char)node->key;
+        entry.bit_length = depth;
+        entry.subtable_bits = 0;
+
+        uint32_t first = offset + (code << (bits - depth));
+        uint32_t count = (uint32_t)1 << (bits - depth);
+        for (uint32_t i = 0; i < count; i++)
+            huffman_tree->decoding_table[first + i] = entry;
+        return;
+    }
+    if (depth == bits)
+    {
+        unsigned sub_bits = heights[index];
+        if (sub_bits > DECODING_SUBTABLE_BITS)
+            sub_bits = DECODING_SUBTABLE_BITS;
+
+        // Table may move while the sub-table is appended, so the entry
+        // is written only after it has been built
+        entry.subtable = add_decoding_table(huffman_tree, heights, index, sub_bits);
+        entry.symbol = 0;
+        entry.bit_length = bits;
+        entry.subtable_bits = sub_bits;
+        huffman_tree->decoding_table[offset + code] = entry;
         return;
     }
-    // Recursively calculate encoding value til leave node is reached
-    add_leaf_to_table(root->left_node, encoding, length + 1, value << 1);
-    add_leaf_to_table(root->right_node, encoding, length + 1, (value << 1) + 0x1);
+    fill_decoding_table(huffman_tree, heights, node->left_node, offset, bits,
+                        depth + 1, code << 1);
+    fill_decoding_table(huffman_tree, heights, node->right_node, offset, bits,
+                        depth + 1, (code << 1) + 0x1);
 }
 
 /*
  * Function:        Huffman_tree_get_root
- * Description:     Returns the root of Huffman Tree
+ * Description:     Returns the root of Huffman Tree, which is the first of
+ *                  its nodes in breadth-first order. Children of any node
+ *                  are found at their index from the root
  * Parameters:      T huffman_tree: pointer to struct `Huffman_Tree_T`
  * Return           Pointer to struct `Huffman_node`
  */
 Huffman_node *Huffman_tree_get_root(T huffman_tree)
 {
-    assert(huffman_tree && huffman_tree->root);
-    return huffman_tree->root;
+    assert(huffman_tree && huffman_tree->num_nodes > 0);
+    return &huffman_tree->nodes[0];
 }
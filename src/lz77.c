@@ -0,0 +1,262 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: lz77.c
+*
+*   Description: Implementation of LZ77 module, which finds repeated
+*   strings of a buffer through hash chains
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <string.h>
+#include "../include/lz77.h"
+
+/* Bounds of the number of bits of the hash of a position, fewer for
+ * small buffers so that the heads to clear fit their size */
+#define MIN_HASH_BITS 8
+#define MAX_HASH_BITS 16
+
+/* Multiplier of Knuth's multiplicative hash */
+#define HASH_MULTIPLIER 2654435761u
+
+/* structure of the effort of a level: most positions of a chain compared,
+ * length of a match long enough to be taken without looking further, and
+ * length of a match good enough that a quarter of the chain is compared
+ * at the next position */
+typedef struct Level
+{
+    unsigned max_chain;
+    uint32_t nice_length;
+    uint32_t good_length;
+} Level;
+
+static const Level levels[LZ77_MAX_LEVEL + 1] = {
+    {0, 0, 0}, {4, 16, 0}, {8, 32, 0}, {16, 32, 0}, {16, 64, 8},
+    {32, 128, 8}, {64, 128, 8}, {128, 256, 16}, {256, 512, 32}, {1024, 1024, 32}
+};
+
+/* structure of the state of the match finder. Heads and chains hold
+ * positions plus one, so that zero ends a chain */
+typedef struct Finder
+{
+    const uint8_t *src;
+    uint32_t end;             // most bytes covered by matches
+    uint32_t *heads;          // most recent position of each hash
+    uint32_t *chain;          // position before each one with the same hash
+    uint32_t window;          // farthest distance plus one
+    uint32_t window_mask;     // position of each one in chain
+    unsigned hash_shift;      // 32 - bits of a hash
+    uint32_t nice_length;     // length of a match taken at once
+} Finder;
+
+/* Helper function prototypes */
+static unsigned hash_bits(uint32_t size, unsigned window_bits);
+static inline uint32_t read32(const uint8_t *src);
+static inline uint32_t hash(const Finder *finder, uint32_t position);
+static inline void insert(Finder *finder, uint32_t position);
+static uint32_t longest_match(const Finder *finder, uint32_t position, uint32_t length,
+                              unsigned max_chain, uint32_t *distance);
+static uint32_t common_length(const uint8_t *a, const uint8_t *b, uint32_t max_length);
+
+/*
+ * Function:        Lz77_workspace_size
+ * Description:     Gets the number of bytes of workspace used to find the
+ *                  matches of a buffer: the head of each hash chain and
+ *                  the next position of each position of the window
+ * Parameters:      uint32_t size: number of bytes in the buffer
+ *                  unsigned window_bits: number of bits of the farthest
+ *                  distance
+ * Return:          size_t: bytes of workspace
+ */
+size_t Lz77_workspace_size(uint32_t size, unsigned window_bits)
+{
+    assert(window_bits >= LZ77_MIN_WINDOW_BITS && window_bits <= LZ77_MAX_WINDOW_BITS);
+    size_t window = (size_t)1 << window_bits;
+    size_t num_positions = size < window ? size : window;
+    return (((size_t)1 << hash_bits(size, window_bits)) + num_positions) * sizeof(uint32_t);
+}
+
+/*
+ * Function:        Lz77_find_matches
+ * Description:     Parses src from its first byte into bytes and matches
+ *                  of at least LZ77_MIN_MATCH bytes, ending at most at end,
+ *                  and at most 2^window_bits - 1 bytes away. Bytes from
+ *                  end to size may still be repeated by matches ending
+ *                  before end
+ * Parameters:      uint8_t *src: bytes to parse
+ *                  uint32_t size: number of bytes in src
+ *                  uint32_t end: most bytes covered by matches, <= size
+ *                  unsigned level: effort, LZ77_MIN_LEVEL to LZ77_MAX_LEVEL
+ *                  unsigned window_bits: LZ77_MIN_WINDOW_BITS to
+ *                  LZ77_MAX_WINDOW_BITS
+ *                  Lz77_match *matches: room for LZ77_MAX_MATCHES(end)
+ *                  matches, updated after the function is called
+ *                  void *workspace: Lz77_workspace_size bytes aligned like
+ *                  malloc, so that nothing is allocated
+ * Return:          uint32_t: number of matches, in order of position
+ */
+uint32_t Lz77_find_matches(const uint8_t *src, uint32_t size, uint32_t end,
+                           unsigned level, unsigned window_bits,
+                           Lz77_match *matches, void *workspace)
+{
+    assert((src || size == 0) && matches && workspace && end <= size);
+    assert(level >= LZ77_MIN_LEVEL && level <= LZ77_MAX_LEVEL);
+    assert(window_bits >= LZ77_MIN_WINDOW_BITS && window_bits <= LZ77_MAX_WINDOW_BITS);
+    unsigned bits = hash_bits(size, window_bits);
+    Finder finder;
+    finder.src = src;
+    finder.end = end;
+    finder.heads = workspace;
+    finder.chain = finder.heads + ((size_t)1 << bits);
+    finder.window = (uint32_t)1 << window_bits;
+    finder.window_mask = finder.window - 1;
+    finder.hash_shift = 32 - bits;
+    finder.nice_length = levels[level].nice_length;
+    memset(finder.heads, 0, ((size_t)1 << bits) * sizeof(uint32_t));
+
+    // Positions inside a match are chained too, up to the last one with
+    // LZ77_MIN_MATCH bytes to hash
+    uint32_t num_matches = 0;
+    uint32_t position = 0;
+    while (position + LZ77_MIN_MATCH <= end)
+    {
+        uint32_t distance = 0;
+        uint32_t length = longest_match(&finder, position, LZ77_MIN_MATCH - 1,
+                                        levels[level].max_chain, &distance);
+        insert(&finder, position);
+        if (length < LZ77_MIN_MATCH)
+        {
+            position++;
+            continue;
+        }
+
+        // A longer match at the next position is taken instead, the byte
+        // at this one staying a byte. It is looked for less hard after a
+        // good match
+        while (level >= LZ77_LAZY_LEVEL && length < finder.nice_length &&
+               position + 1 + LZ77_MIN_MATCH <= end)
+        {
+            unsigned max_chain = levels[level].max_chain;
+            if (length >= levels[level].good_length)
+                max_chain /= 4;
+            uint32_t next_distance = 0;
+            uint32_t next_length = longest_match(&finder, position + 1, length, max_chain,
+                                                 &next_distance);
+            if (next_length <= length)
+                break;
+            insert(&finder, ++position);
+            length = next_length;
+            distance = next_distance;
+        }
+
+        matches[num_matches].position = position;
+        matches[num_matches].length = length;
+        matches[num_matches].distance = distance;
+        num_matches++;
+        uint32_t match_end = position + length;
+        uint32_t last = size - LZ77_MIN_MATCH + 1;
+        for (position++; position < match_end && position < last; position++)
+            insert(&finder, position);
+        position = match_end;
+    }
+    return num_matches;
+}
+
+// Helper function to get the number of bits of the hash of a position,
+// enough for one chain per position of the window or of the buffer
+static unsigned hash_bits(uint32_t size, unsigned window_bits)
+{
+    unsigned bits = MIN_HASH_BITS;
+    while (bits < MAX_HASH_BITS && bits < window_bits && ((uint32_t)1 << bits) < size)
+        bits++;
+    return bits;
+}
+
+// Helper function to read 4 bytes of src in memory order
+static inline uint32_t read32(const uint8_t *src)
+{
+    uint32_t value;
+    memcpy(&value, src, sizeof(uint32_t));
+    return value;
+}
+
+// Helper function to hash the first LZ77_MIN_MATCH bytes at a position
+static inline uint32_t hash(const Finder *finder, uint32_t position)
+{
+    return (read32(finder->src + position) * HASH_MULTIPLIER) >> finder->hash_shift;
+}
+
+// Helper function to put a position at the head of its chain
+static inline void insert(Finder *finder, uint32_t position)
+{
+    uint32_t *head = &finder->heads[hash(finder, position)];
+    finder->chain[position & finder->window_mask] = *head;
+    *head = position + 1;
+}
+
+// Helper function to compare the bytes at a position with those of the
+// positions chained before it within the window, up to max_chain of
+// them. Returns the longest common length found above length, with its
+// distance, or length if there is none
+static uint32_t longest_match(const Finder *finder, uint32_t position, uint32_t length,
+                              unsigned max_chain, uint32_t *distance)
+{
+    uint32_t max_length = finder->end - position;
+    if (length >= max_length)
+        return length;
+    const uint8_t *here = finder->src + position;
+    uint32_t first = read32(here);
+    uint32_t candidate = finder->heads[hash(finder, position)];
+    for (unsigned chain = max_chain; candidate != 0 && chain > 0; chain--)
+    {
+        // Entries of the chain are overwritten once a window away
+        uint32_t there = candidate - 1;
+        if (position - there >= finder->window)
+            break;
+
+        // Only a match differing from the best one at its end can be longer
+        const uint8_t *bytes = finder->src + there;
+        if (bytes[length] == here[length] && read32(bytes) == first)
+        {
+            uint32_t common = common_length(bytes, here, max_length);
+            if (common > length)
+            {
+                length = common;
+                *distance = position - there;
+                if (length >= finder->nice_length || length == max_length)
+                    break;
+            }
+        }
+        candidate = finder->chain[there & finder->window_mask];
+    }
+    return length;
+}
+
+// Helper function to get the number of equal bytes from the top of a and
+// b, up to max_length, comparing 8 bytes at a time
+static uint32_t common_length(const uint8_t *a, const uint8_t *b, uint32_t max_length)
+{
+    uint32_t i = 0;
+    for (; i + sizeof(uint64_t) <= max_length; i += sizeof(uint64_t))
+    {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, a + i, sizeof(uint64_t));
+        memcpy(&word_b, b + i, sizeof(uint64_t));
+        if (word_a != word_b)
+        {
+            // The first differing byte is the lowest one in memory order
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + __builtin_ctzll(word_a ^ word_b) / 8;
+#else
+            return i + __builtin_clzll(word_a ^ word_b) / 8;
+#endif
+        }
+    }
+    while (i < max_length && a[i] == b[i])
+        i++;
+    return i;
+}
@@ -12,32 +12,211 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../hanson/include/except.h"
 #include "../include/huffman_tree.h"
 #include "../include/utils.h"
+#include "../include/canonical.h"
+#include "../include/block.h"
+#include "../include/frame.h"
+#include "../include/thread_pool.h"
+#include "../include/stats.h"
+#include "../include/adaptive.h"
 
 // Helper function definitions
-void compress(char *infile_name, char *outfile_name);
-void decompress(char *infile_name, char *outfile_name);
+void compress(char *infile_name, char *outfile_name, const Frame_options *options,
+              int adaptive);
+void decompress(char *infile_name, char *outfile_name, unsigned num_threads,
+                int verify, Stats *stats);
+void decompress_range(char *infile_name, char *outfile_name, uint64_t offset,
+                      uint64_t length, int verify, Stats *stats);
+static int parse_range(const char *text, uint64_t *offset, uint64_t *length);
+static void decompress_whole_file(FILE *infile, FILE *outfile, Stats *stats);
+static void report_stats(const Stats *stats, const char *operation,
+                         int print_stats, char *json_file_name);
+static FILE *open_file(char *file_name, char *mode);
+static void usage(char *program_name);
 
 int main(int argc, char* argv[]) {
-    if (argc != 3 && argc != 4) 
+    if (argc < 3)
+        usage(argv[0]);
+
+    // Parse options and up to two file names following the command
+    Frame_options options = Frame_default_options();
+    Stats stats;
+    Stats_init(&stats);
+    int print_stats = 0;
+    char *stats_json_name = NULL;
+    int adaptive = 0;
+    int has_range = 0;
+    uint64_t range_offset = 0, range_length = 0;
+    char *file_names[2] = {NULL, NULL};
+    int num_file_names = 0;
+    for (int i = 2; i < argc; i++)
     {
-        fprintf(stderr, "Usage: %s <{-c/--compress, -d/--decompress}> "
-                "<input file name> [output file name]\n",
-                argv[0]);
-        exit(1);
+        if ((!strcmp(argv[i], "-L")) || (!strcmp(argv[i], "--max-code-length")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            options.max_code_length = (unsigned)atoi(argv[++i]);
+            if (options.max_code_length < CANONICAL_MIN_CODE_LENGTH ||
+                options.max_code_length > CANONICAL_MAX_CODE_LENGTH)
+            {
+                fprintf(stderr, "Maximum code length must be between %d and %d\n",
+                        CANONICAL_MIN_CODE_LENGTH, CANONICAL_MAX_CODE_LENGTH);
+                exit(1);
+            }
+        }
+        else if ((!strcmp(argv[i], "-B")) || (!strcmp(argv[i], "--block-size")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            long block_size_kib = atol(argv[++i]);
+            if (block_size_kib < FRAME_MIN_BLOCK_SIZE / 1024 ||
+                block_size_kib > FRAME_MAX_BLOCK_SIZE / 1024)
+            {
+                fprintf(stderr, "Block size must be between %d and %d KiB\n",
+                        FRAME_MIN_BLOCK_SIZE / 1024, FRAME_MAX_BLOCK_SIZE / 1024);
+                exit(1);
+            }
+            options.block_size = (uint32_t)block_size_kib * 1024;
+        }
+        else if ((!strcmp(argv[i], "-S")) || (!strcmp(argv[i], "--streams")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            options.num_streams = (unsigned)atoi(argv[++i]);
+            if (options.num_streams != 1 && options.num_streams != 4 &&
+                options.num_streams != 8)
+            {
+                fprintf(stderr, "Number of streams must be 1, 4 or 8\n");
+                exit(1);
+            }
+        }
+        else if ((!strcmp(argv[i], "-C")) || (!strcmp(argv[i], "--context")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            int tables = atoi(argv[++i]);
+            if (tables < 1 || tables > BLOCK_MAX_TABLES)
+            {
+                fprintf(stderr, "Number of context tables must be between 1 and %d\n",
+                        BLOCK_MAX_TABLES);
+                exit(1);
+            }
+            options.max_tables = (unsigned)tables;
+        }
+        else if ((!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "--pairs")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            int pairs = atoi(argv[++i]);
+            if (pairs < 0 || pairs > BLOCK_MAX_PAIRS)
+            {
+                fprintf(stderr, "Number of byte pairs must be between 0 and %d\n",
+                        BLOCK_MAX_PAIRS);
+                exit(1);
+            }
+            options.max_pairs = (unsigned)pairs;
+        }
+        else if ((!strcmp(argv[i], "-R")) || (!strcmp(argv[i], "--runs")))
+            options.runs = 1;
+        else if ((!strcmp(argv[i], "-M")) || (!strcmp(argv[i], "--matches")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            int level = atoi(argv[++i]);
+            if (level < 0 || level > LZ77_MAX_LEVEL)
+            {
+                fprintf(stderr, "Match level must be between 0 and %d\n", LZ77_MAX_LEVEL);
+                exit(1);
+            }
+            options.match_level = (unsigned)level;
+        }
+        else if ((!strcmp(argv[i], "-W")) || (!strcmp(argv[i], "--window")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            int window_bits = atoi(argv[++i]);
+            if (window_bits < LZ77_MIN_WINDOW_BITS || window_bits > LZ77_MAX_WINDOW_BITS)
+            {
+                fprintf(stderr, "Window bits must be between %d and %d\n",
+                        LZ77_MIN_WINDOW_BITS, LZ77_MAX_WINDOW_BITS);
+                exit(1);
+            }
+            options.window_bits = (unsigned)window_bits;
+        }
+        else if ((!strcmp(argv[i], "-T")) || (!strcmp(argv[i], "--threads")))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            int threads = atoi(argv[++i]);
+            if (threads < 1 || threads > THREAD_POOL_MAX_THREADS)
+            {
+                fprintf(stderr, "Number of threads must be between 1 and %d\n",
+                        THREAD_POOL_MAX_THREADS);
+                exit(1);
+            }
+            options.num_threads = (unsigned)threads;
+        }
+        else if ((!strcmp(argv[i], "-A")) || (!strcmp(argv[i], "--adaptive")))
+            adaptive = 1;
+        else if (!strcmp(argv[i], "--verify"))
+            options.checksums = 1;
+        else if (!strcmp(argv[i], "--no-verify"))
+            options.checksums = 0;
+        else if (!strcmp(argv[i], "--range"))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            if (!parse_range(argv[++i], &range_offset, &range_length))
+            {
+                fprintf(stderr, "Range must be <offset>:<length> in bytes\n");
+                exit(1);
+            }
+            has_range = 1;
+        }
+        else if (!strcmp(argv[i], "--stats"))
+        {
+            print_stats = 1;
+            options.stats = &stats;
+        }
+        else if (!strcmp(argv[i], "--stats-json"))
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            stats_json_name = argv[++i];
+            options.stats = &stats;
+        }
+        else if (num_file_names < 2)
+            file_names[num_file_names++] = argv[i];
+        else
+            usage(argv[0]);
     }
-    else if ((!strcmp(argv[1], "-c")) || (!strcmp(argv[1], "--compress")))
+    if (num_file_names == 0)
+        usage(argv[0]);
+
+    if ((!strcmp(argv[1], "-c")) || (!strcmp(argv[1], "--compress")))
     {
-        char *input_file_name = argv[2];
-        char *compressed_file_name = (argc == 4) ? argv[3] : "default_compressed";
-        compress(input_file_name, compressed_file_name);
+        char *input_file_name = file_names[0];
+        char *compressed_file_name = file_names[1] ? file_names[1] : "default_compressed";
+        double start = Stats_start(options.stats);
+        compress(input_file_name, compressed_file_name, &options, adaptive);
+        stats.total_seconds = Stats_start(options.stats) - start;
+        report_stats(options.stats, "compress", print_stats, stats_json_name);
     }
     else if ((!strcmp(argv[1], "-d"))|| (!strcmp(argv[1], "--decompress")))
     {
-        char *compressed_file_name = argv[2];
-        char *decompressed_file_name = argv[3] ? argv[3] : "default_decompressed";
-        decompress(compressed_file_name, decompressed_file_name);
+        char *compressed_file_name = file_names[0];
+        char *decompressed_file_name = file_names[1] ? file_names[1] : "default_decompressed";
+        double start = Stats_start(options.stats);
+        if (has_range)
+            decompress_range(compressed_file_name, decompressed_file_name, range_offset,
+                             range_length, options.checksums, options.stats);
+        else
+            decompress(compressed_file_name, decompressed_file_name, options.num_threads,
+                       options.checksums, options.stats);
+        stats.total_seconds = Stats_start(options.stats) - start;
+        report_stats(options.stats, "decompress", print_stats, stats_json_name);
     }
     else
     {
@@ -46,92 +225,282 @@ int main(int argc, char* argv[]) {
     }
 }
 
+// Helper function to print usage and exit
+static void usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s <{-c/--compress, -d/--decompress}> "
+            "[-L/--max-code-length <%d-%d>] [-B/--block-size <KiB>] "
+            "[-S/--streams <1, 4, 8>] [-C/--context <1-%d>] [-P/--pairs <0-%d>] "
+            "[-R/--runs] [-M/--matches <0-%d>] [-W/--window <%d-%d>] "
+            "[-T/--threads <1-%d>] [-A/--adaptive] [--verify] [--no-verify] "
+            "[--range <offset>:<length>] "
+            "[--stats] [--stats-json <file name>] "
+            "<input file name> [output file name]\n"
+            "Use `-` as file name for stdin or stdout\n",
+            program_name, CANONICAL_MIN_CODE_LENGTH, CANONICAL_MAX_CODE_LENGTH,
+            BLOCK_MAX_TABLES, BLOCK_MAX_PAIRS, LZ77_MAX_LEVEL, LZ77_MIN_WINDOW_BITS,
+            LZ77_MAX_WINDOW_BITS, THREAD_POOL_MAX_THREADS);
+    exit(1);
+}
+
+// Helper function to parse a range given as <offset>:<length>, in bytes.
+// Returns 0 if text is not one
+static int parse_range(const char *text, uint64_t *offset, uint64_t *length)
+{
+    char *end;
+    if (*text < '0' || *text > '9')
+        return 0;
+    *offset = strtoull(text, &end, 10);
+    if (*end != ':' || end[1] < '0' || end[1] > '9')
+        return 0;
+    *length = strtoull(end + 1, &end, 10);
+    return *end == '\0';
+}
+
+// Helper function to open a file, or stdin/stdout for `-`
+static FILE *open_file(char *file_name, char *mode)
+{
+    if (!strcmp(file_name, "-"))
+        return mode[0] == 'r' ? stdin : stdout;
+    return fopen(file_name, mode);
+}
+
 /*
  * Function:        compress
- * Description:     Write compressed encoded data to file
- * Parameters:      FILE *infile: pointer to the input file
- *                  FILE *outfile: pointer to the output file
+ * Description:     Write compressed encoded data to file, one block at a
+ *                  time so that input and output can be pipes
+ * Parameters:      char *infile_name: input file name, `-` for stdin
+ *                  char *outfile_name: output file name, `-` for stdout
+ *                  Frame_options *options: block size, maximum length of
+ *                  codes, number of streams, of tables and of encoding
+ *                  threads
+ *                  int adaptive: whether to code the input in one pass
+ *                  with the adaptive coder instead of in blocks
  * Return:          void
  */
-void compress(char *infile_name, char *outfile_name) 
+void compress(char *infile_name, char *outfile_name, const Frame_options *options,
+              int adaptive)
 {
-    FILE *infile = fopen(infile_name, "rb");
+    FILE *infile = open_file(infile_name, "rb");
     if (!infile)
     {
         fprintf(stderr, "Input file `%s` does not exist!\n", infile_name);
         exit(1);
     }
 
-    // Reads in from file 
-    int freq_array_length = 0;
-    int *_freq_array = get_frequency_of_characters_from_file(infile, &freq_array_length);
-    Array_T freq_array = create_unique_characters_freq_array(_freq_array, freq_array_length);
-    
-    // Builds Huffman tree
-    Huffman_Tree_T huffman_tree = Huffman_tree_new();
-    Huffman_tree_build(huffman_tree, freq_array);
-    Array_T encoding = Huffman_tree_create_encoding_table(huffman_tree);
-    
-    FILE *outfile = fopen(outfile_name, "wb");
+    FILE *outfile = open_file(outfile_name, "wb");
     if (!outfile)
     {
         fprintf(stderr, "File `%s` cannot be opened!\n", outfile_name);
         exit(1);
     }
 
-    // Writes header to compressed file
-    write_total_num_bits(_freq_array, encoding, outfile);
-    write_header(freq_array, outfile);
-    
-    // Writes compressed body
-    write_body(encoding, infile, outfile);
-    
-    // Deallocates memory and close out files
-    free(_freq_array);
-    Array_free(&freq_array);
-    Huffman_tree_free(&huffman_tree);
+    if (adaptive)
+        Adaptive_compress_file(infile, outfile, options->stats);
+    else
+        Frame_compress(infile, outfile, options);
+
     fclose(infile);
-    fclose(outfile); 
+    fclose(outfile);
 }
 
 /*
  * Function:        decompress
- * Description:     Write decompressed decoded data to file
- * Parameters:      FILE *infile: pointer to the input file
- *                  FILE *outfile: pointer to the output file
+ * Description:     Write decompressed decoded data to file. Block-framed
+ *                  files are streamed, or decoded in parallel when seekable,
+ *                  adaptively coded files are streamed, files in the older
+ *                  whole-file formats must be seekable
+ * Parameters:      char *infile_name: input file name, `-` for stdin
+ *                  char *outfile_name: output file name, `-` for stdout
+ *                  unsigned num_threads: number of decoding threads
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums
+ *                  Stats *stats: updated with timings, or NULL
  * Return:          void
  */
-void decompress(char *infile_name, char *outfile_name) 
+void decompress(char *infile_name, char *outfile_name, unsigned num_threads,
+                int verify, Stats *stats)
 {
-    FILE *infile = fopen(infile_name, "r");
+    FILE *infile = open_file(infile_name, "rb");
     if (!infile)
     {
         fprintf(stderr, "Compressed file `%s` does not exist!\n", infile_name);
         exit(1);
     }
 
-    // Reads in header and build Huffman tree for decoding
-    uint64_t total_num_bits = read_total_num_bits(infile);
-    Array_T entries = read_header(infile);
+    // Opened for reading too, so that blocks can be decoded in place
+    FILE *outfile = open_file(outfile_name, "w+b");
+    if (!outfile)
+    {
+        fprintf(stderr, "File `%s` cannot be opened!\n", outfile_name);
+        exit(1);
+    }
 
-    Huffman_Tree_T huffman_tree = Huffman_tree_new();
-    Huffman_tree_build(huffman_tree, entries);
-    Huffman_tree_create_encoding_table(huffman_tree);
+    char magic[FRAME_MAGIC_SIZE];
+    size_t magic_size = fread(magic, 1, FRAME_MAGIC_SIZE, infile);
+    if (magic_size == FRAME_MAGIC_SIZE && !memcmp(magic, FRAME_MAGIC, FRAME_MAGIC_SIZE))
+    {
+        TRY
+            Frame_decompress(infile, outfile, num_threads, verify, stats);
+        EXCEPT(Block_Corrupted)
+            fprintf(stderr, "Compressed file `%s` is corrupted!\n", infile_name);
+            exit(1);
+        EXCEPT(Huffman_Invalid_Lengths)
+            fprintf(stderr, "Compressed file `%s` is corrupted!\n", infile_name);
+            exit(1);
+        EXCEPT(Frame_Checksum_Failed)
+            fprintf(stderr, "Compressed file `%s` is corrupted: decompressed data does "
+                    "not match its checksums!\n", infile_name);
+            exit(1);
+        EXCEPT(Frame_Write_Failed)
+            fprintf(stderr, "File `%s` cannot be written!\n", outfile_name);
+            exit(1);
+        END_TRY;
+    }
+    else if (magic_size == ADAPTIVE_MAGIC_SIZE &&
+             !memcmp(magic, ADAPTIVE_MAGIC, ADAPTIVE_MAGIC_SIZE))
+    {
+        TRY
+            Adaptive_decompress_file(infile, outfile, stats);
+        EXCEPT(Adaptive_Corrupted)
+            fprintf(stderr, "Compressed file `%s` is corrupted!\n", infile_name);
+            exit(1);
+        END_TRY;
+    }
+    else
+    {
+        if (fseek(infile, 0, SEEK_SET) != 0)
+        {
+            fprintf(stderr, "Only block-framed files can be decompressed from a pipe\n");
+            exit(1);
+        }
+        decompress_whole_file(infile, outfile, stats);
+    }
+
+    fclose(infile);
+    fclose(outfile);
+}
+
+/*
+ * Function:        decompress_range
+ * Description:     Write the decompressed bytes from offset to offset +
+ *                  length to file, decoding only the blocks covering them.
+ *                  The compressed file must be block-framed and seekable
+ * Parameters:      char *infile_name: input file name, `-` for stdin
+ *                  char *outfile_name: output file name, `-` for stdout
+ *                  uint64_t offset: position of the first decompressed byte
+ *                  uint64_t length: number of decompressed bytes
+ *                  int verify: whether decoded blocks are checked against
+ *                  their checksums
+ *                  Stats *stats: updated with timings, or NULL
+ * Return:          void
+ */
+void decompress_range(char *infile_name, char *outfile_name, uint64_t offset,
+                      uint64_t length, int verify, Stats *stats)
+{
+    FILE *infile = open_file(infile_name, "rb");
+    if (!infile)
+    {
+        fprintf(stderr, "Compressed file `%s` does not exist!\n", infile_name);
+        exit(1);
+    }
 
-    FILE *outfile = fopen(outfile_name, "wb");
+    FILE *outfile = open_file(outfile_name, "wb");
     if (!outfile)
     {
         fprintf(stderr, "File `%s` cannot be opened!\n", outfile_name);
         exit(1);
     }
 
+    char magic[FRAME_MAGIC_SIZE];
+    if (fread(magic, 1, FRAME_MAGIC_SIZE, infile) != FRAME_MAGIC_SIZE ||
+        memcmp(magic, FRAME_MAGIC, FRAME_MAGIC_SIZE))
+    {
+        fprintf(stderr, "Only block-framed files can be decompressed in ranges\n");
+        exit(1);
+    }
+
+    TRY
+        Frame_decompress_range(infile, outfile, offset, length, verify, stats);
+    EXCEPT(Frame_No_Index)
+        fprintf(stderr, "Compressed file `%s` must be seekable, with a block index, "
+                "to be decompressed in ranges\n", infile_name);
+        exit(1);
+    EXCEPT(Block_Corrupted)
+        fprintf(stderr, "Compressed file `%s` is corrupted!\n", infile_name);
+        exit(1);
+    EXCEPT(Huffman_Invalid_Lengths)
+        fprintf(stderr, "Compressed file `%s` is corrupted!\n", infile_name);
+        exit(1);
+    EXCEPT(Frame_Checksum_Failed)
+        fprintf(stderr, "Compressed file `%s` is corrupted: decompressed data does "
+                "not match its checksums!\n", infile_name);
+        exit(1);
+    END_TRY;
+
+    fclose(infile);
+    fclose(outfile);
+}
+
+// Helper function to decompress files written in a single piece, with
+// either canonical code lengths or character frequencies in the header
+static void decompress_whole_file(FILE *infile, FILE *outfile, Stats *stats)
+{
+    // Reads in header and build Huffman tree for decoding
+    double start = Stats_start(stats);
+    uint8_t lengths[MAX_NUM_CHAR];
+    uint64_t total_num_bits = 0;
+    Array_T entries = NULL;
+    Huffman_Tree_T huffman_tree = Huffman_tree_new();
+    if (read_canonical_header(lengths, infile))
+    {
+        total_num_bits = read_total_num_bits(infile);
+        Huffman_tree_build_canonical(huffman_tree, lengths);
+    }
+    else
+    {
+        total_num_bits = read_total_num_bits(infile);
+        entries = read_header(infile, huffman_tree);
+        Huffman_tree_build(huffman_tree, entries);
+    }
+    Huffman_tree_create_encoding_table(huffman_tree);
+    start = Stats_lap(stats, STATS_TABLES, start);
+
     // Reads in body, decodes body, and write to outfile
     read_body(huffman_tree, total_num_bits, infile, outfile);
-    
-    // Deallocates memory and close out filse
-    Array_free(&entries);
+    Stats_lap(stats, STATS_DECODE, start);
+    long in_position = ftell(infile), out_position = ftell(outfile);
+    if (stats && in_position >= 0 && out_position >= 0)
+    {
+        stats->bytes_in += (uint64_t)in_position;
+        stats->bytes_out += (uint64_t)out_position;
+    }
+
+    // Deallocates memory
+    if (entries)
+        Array_free(&entries);
     Huffman_tree_free(&huffman_tree);
-    fclose(infile);
-    fclose(outfile); 
 }
 
+// Helper function to print stats to stderr and write them to a JSON file,
+// as asked by --stats and --stats-json
+static void report_stats(const Stats *stats, const char *operation,
+                         int print_stats, char *json_file_name)
+{
+    if (!stats)
+        return;
+    if (print_stats)
+        Stats_print(stats, operation, stderr);
+    if (json_file_name)
+    {
+        FILE *json_file = open_file(json_file_name, "w");
+        if (!json_file)
+        {
+            fprintf(stderr, "File `%s` cannot be opened!\n", json_file_name);
+            exit(1);
+        }
+        Stats_write_json(stats, operation, json_file);
+        if (json_file != stdout)
+            fclose(json_file);
+    }
+}
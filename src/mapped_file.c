@@ -0,0 +1,141 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: mapped_file.c
+*
+*   Description: Implementation of memory-mapped files, which let
+*   blocks be encoded and decoded in place instead of being copied
+*   through stdio buffers
+*
+*   See comments on top of each function to understand the interface
+*   of implemented data structure
+*
+****************************************************************/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/mapped_file.h"
+
+#define T Mapped_File_T
+
+/* structure of Mapped File */
+struct T
+{
+    uint8_t *data;
+    uint64_t size;
+};
+
+/* Helper function prototypes */
+static T new_mapping(int fd, uint64_t size, int prot, int advice);
+
+/*
+ * Function:        Mapped_file_open
+ * Description:     Maps the whole of a regular file for sequential reading
+ * Parameters:      FILE *file: pointer to the file to map
+ * Return:          Pointer to newly created mapping, or NULL if file is
+ *                  empty, is not a regular file or cannot be mapped
+ */
+T Mapped_file_open(FILE *file)
+{
+    assert(file);
+    struct stat file_stat;
+    int fd = fileno(file);
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+        file_stat.st_size <= 0 || (uint64_t)file_stat.st_size > SIZE_MAX)
+        return NULL;
+    return new_mapping(fd, file_stat.st_size, PROT_READ, MADV_SEQUENTIAL);
+}
+
+/*
+ * Function:        Mapped_file_create
+ * Description:     Preallocates a regular file opened for both reading and
+ *                  writing to size bytes and maps it for writing
+ * Parameters:      FILE *file: pointer to the file to map
+ *                  uint64_t size: size of the file once written, > 0
+ * Return:          Pointer to newly created mapping, or NULL if file
+ *                  cannot be resized or mapped, or if its blocks cannot be
+ *                  reserved on a file system that supports it
+ */
+T Mapped_file_create(FILE *file, uint64_t size)
+{
+    assert(file && size > 0);
+    struct stat file_stat;
+    int fd = fileno(file);
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+        (fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDWR || size > SIZE_MAX)
+        return NULL;
+
+    // Reserve blocks up front so that writing to the mapping cannot run
+    // out of space, which would raise SIGBUS. File systems that cannot
+    // reserve blocks are only resized, other failures such as a full disk
+    // leave the file to be written without mapping
+    fflush(file);
+    int error = posix_fallocate(fd, 0, (off_t)size);
+    if (error != 0 && error != EINVAL && error != EOPNOTSUPP)
+        return NULL;
+    if (ftruncate(fd, (off_t)size) != 0)
+        return NULL;
+    return new_mapping(fd, size, PROT_READ | PROT_WRITE, MADV_NORMAL);
+}
+
+/*
+ * Function:        Mapped_file_data
+ * Description:     Gets the mapped bytes, which are read-only for files
+ *                  mapped with Mapped_file_open
+ * Parameters:      T mapped_file: pointer to struct `Mapped_File_T`
+ * Return:          uint8_t *: first byte of the file
+ */
+uint8_t *Mapped_file_data(T mapped_file)
+{
+    assert(mapped_file);
+    return mapped_file->data;
+}
+
+/*
+ * Function:        Mapped_file_size
+ * Description:     Gets the number of mapped bytes
+ * Parameters:      T mapped_file: pointer to struct `Mapped_File_T`
+ * Return:          uint64_t: size of the file
+ */
+uint64_t Mapped_file_size(T mapped_file)
+{
+    assert(mapped_file);
+    return mapped_file->size;
+}
+
+/*
+ * Function:        Mapped_file_free
+ * Description:     Unmaps the file and deallocates the mapping. Written
+ *                  bytes are kept in the file
+ * Parameters:      T *mapped_file: double pointer to struct `Mapped_File_T`
+ * Return:          void
+ */
+void Mapped_file_free(T *mapped_file)
+{
+    assert(mapped_file && *mapped_file);
+    munmap((*mapped_file)->data, (size_t)(*mapped_file)->size);
+    free(*mapped_file);
+    *mapped_file = NULL;
+}
+
+// Helper function to map size bytes of a file descriptor, shared with the
+// file so that writes reach it
+static T new_mapping(int fd, uint64_t size, int prot, int advice)
+{
+    void *data = mmap(NULL, (size_t)size, prot, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+    madvise(data, (size_t)size, advice);
+
+    T mapped_file = malloc(sizeof(*mapped_file));
+    assert(mapped_file);
+    mapped_file->data = data;
+    mapped_file->size = size;
+    return mapped_file;
+}
@@ -15,39 +15,33 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "../hanson/include/except.h"
 #include "../include/priority_queue.h"
 
 #define T Priority_Queue_T
 
-/* Macros to find left child, right child, parent index */
-#define left_child(x) 2 * x + 1
-#define right_child(x) 2 * x + 2
-#define parent(x) (x - 1) / 2
+/* Index of the first child and of the parent in a heap of given arity */
+#define first_child(x, arity) ((arity) * (x) + 1)
+#define parent(x, arity) (((x) - 1) / (arity))
 
 Except_T HEAP_UNDERFLOW = {"Heap underflow"};
 
 /* structure of Priority Queue */
 struct T
 {
-    int type;        // min-heap or max heap
-    int size;        // size of queue
-    Array_T entries; // array of node entries
+    int type;       // min-heap or max heap
+    int arity;      // number of children of each node
+    int size;       // size of queue
+    int capacity;   // number of nodes entries can hold
+    Node *entries;  // array of node entries
 };
 
 /* Helper function prototypes */
-static void max_heapify(T priority_queue, int parent_index);
-static void min_heapify(T priority_queue, int parent_index);
+static int has_priority(T priority_queue, uint64_t value, uint64_t other);
+static void sift_down(T priority_queue, int index, Node moving);
+static void sift_up(T priority_queue, int index, Node moving);
 
-static Node *create_node_from_obj(void *obj, int value)
-{
-    assert(obj);
-    Node *new_node = malloc(sizeof(Node));
-    assert(new_node);
-    new_node->obj = obj;
-    new_node->value = value;
-    return new_node;
-}
 
 /*
  * Function:        Priority_queue_new
@@ -61,14 +55,33 @@ static Node *create_node_from_obj(void *obj, int value)
  * Return:          Pointer to created priority queue 
  */
 T Priority_queue_new(int type)
+{
+    return Priority_queue_new_d_ary(type, 2);
+}
+
+/*
+ * Function:        Priority_queue_new_d_ary
+ * Description:     Allocates a heap whose nodes have arity children
+ *                  instead of 2. Wider nodes make the heap shallower, so
+ *                  that popping compares more children per level but
+ *                  moves through fewer levels
+ * Parameters:      int type: 0 for min-heap, 1 for max-heap
+ *                  int arity: number of children of each node, between
+ *                  2 and PRIORITY_QUEUE_MAX_ARITY
+ * Return:          Pointer to created priority queue
+ */
+T Priority_queue_new_d_ary(int type, int arity)
 {
     assert(type == 0 || type == 1);
+    assert(arity >= 2 && arity <= PRIORITY_QUEUE_MAX_ARITY);
 
     T priority_queue = malloc(sizeof(*priority_queue));
     assert(priority_queue != NULL);
 
     priority_queue->type = type;
+    priority_queue->arity = arity;
     priority_queue->size = 0;
+    priority_queue->capacity = 0;
     priority_queue->entries = NULL;
 
     return priority_queue;
@@ -84,10 +97,43 @@ T Priority_queue_new(int type)
 void Priority_queue_free(T *priority_queue)
 {
     assert(priority_queue && *priority_queue);
-    Array_free(&((*priority_queue)->entries));
+    free((*priority_queue)->entries);
     free(*priority_queue);
 }
 
+/*
+ * Function:        Priority_queue_reserve
+ * Description:     Makes room for capacity nodes, so that inserting up to
+ *                  that many nodes allocates nothing
+ * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
+ *                  int capacity: number of nodes the queue may hold
+ * Return:          void
+ */
+void Priority_queue_reserve(T priority_queue, int capacity)
+{
+    assert(priority_queue && capacity >= 0);
+    if (capacity <= priority_queue->capacity)
+        return;
+
+    priority_queue->entries = realloc(priority_queue->entries,
+                                      (size_t)capacity * sizeof(Node));
+    assert(priority_queue->entries);
+    priority_queue->capacity = capacity;
+}
+
+/*
+ * Function:        Priority_queue_clear
+ * Description:     Removes every node, keeping the memory of the queue
+ *                  for the next nodes
+ * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
+ * Return:          void
+ */
+void Priority_queue_clear(T priority_queue)
+{
+    assert(priority_queue);
+    priority_queue->size = 0;
+}
+
 /*
  * Function:        Priority_queue_size
  * Description:     Gets length of priority queue
@@ -96,238 +142,112 @@ void Priority_queue_free(T *priority_queue)
  */
 int Priority_queue_size(T priority_queue)
 {
-    assert(priority_queue && priority_queue->entries);
+    assert(priority_queue);
     return priority_queue->size;
 }
 
 /*
  * Function:        Priority_queue_build
- * Description:     Build heap given queue and entries array
+ * Description:     Build heap given queue and entries array. Nodes already
+ *                  in the queue are replaced
  * Parameters:      T priority_queue: pointer to struct `Priority_Queue_T`
  *                  Array_T entries: All entries in the heap
  * Return:          void     
  */
 void Priority_queue_build(T priority_queue, Array_T entries)
 {
-    assert(priority_queue);
-    Array_T copy_entries = Array_copy(entries, Array_length(entries));
-    priority_queue->entries = copy_entries;
-    priority_queue->size = Array_length(entries);
-
-    int entries_length = Array_length(priority_queue->entries);
-
-    // Build min heap if priority type is 0
-    if (priority_queue->type == 0)
-    {
-        for (int i = entries_length / 2 - 1; i >= 0; i--)
-        {
-            min_heapify(priority_queue, i);
-        }
-    }
-    // Build max heap if priority type is 1
-    else if (priority_queue->type == 1)
-    {
-        for (int i = entries_length / 2 - 1; i >= 0; i--)
-        {
-            max_heapify(priority_queue, i);
-        }
-    }
+    assert(priority_queue && entries);
+    assert(entries->size == sizeof(Node));
+
+    int entries_length = Array_length(entries);
+    Priority_queue_reserve(priority_queue, entries_length);
+    if (entries_length > 0)
+        memcpy(priority_queue->entries, entries->array,
+               (size_t)entries_length * sizeof(Node));
+    priority_queue->size = entries_length;
+
+    // Sift every parent down, from the last one
+    if (entries_length < 2)
+        return;
+    for (int i = parent(entries_length - 1, priority_queue->arity); i >= 0; i--)
+        sift_down(priority_queue, i, priority_queue->entries[i]);
 }
 
-/**
- * Static helper function to perform heapify for max heap
- */
-static void max_heapify(T priority_queue, int parent_index)
+// Helper function to check whether value comes out of the heap before
+// other, which is when it is smaller in a min-heap and larger in a max-heap
+static inline int has_priority(T priority_queue, uint64_t value, uint64_t other)
 {
-    assert(priority_queue && priority_queue->entries);
-
-    Node *parent = (Node *)Array_get(priority_queue->entries, parent_index);
-    assert(parent);
-
-    int entries_length = priority_queue->size;
-
-    Node *largest_node = parent;
-    int largest_node_index = parent_index;
+    return priority_queue->type == 0 ? value < other : value > other;
+}
 
-    // Compare parent node with both left and right child if both exist
-    if (right_child(parent_index) < entries_length)
-    {
-        Node *left = (Node *)Array_get(priority_queue->entries,
-                                       left_child(parent_index));
-        Node *right = (Node *)Array_get(priority_queue->entries,
-                                        right_child(parent_index));
-
-        if (left->value > parent->value)
-        {
-            largest_node = left;
-            largest_node_index = left_child(parent_index);
-        }
-        if (right->value > largest_node->value)
-        {
-            largest_node = right;
-            largest_node_index = right_child(parent_index);
-        }
-    }
-    // Compare parent node with left child if only left child exists
-    else if (left_child(parent_index) < entries_length)
-    {
-        Node *left = (Node *)Array_get(priority_queue->entries, left_child(parent_index));
+// Helper function to put moving at index or below it. Children that come
+// before moving are moved up into the hole left at their parent, and moving
+// is written once where the hole stops
+static void sift_down(T priority_queue, int index, Node moving)
+{
+    Node *entries = priority_queue->entries;
+    int size = priority_queue->size;
+    int arity = priority_queue->arity;
 
-        if (left->value > parent->value)
-        {
-            largest_node = left;
-            largest_node_index = left_child(parent_index);
-        }
-    }
-    // Swap parent with child to maintain heap rules, call heapify recursively
-    if (largest_node_index != parent_index)
+    while (1)
     {
-        Node deref_largest_node = *largest_node;
-        Node deref_parent_node = *parent;
-
-        Array_put(priority_queue->entries, parent_index, &deref_largest_node);
-        Array_put(priority_queue->entries, largest_node_index, &deref_parent_node);
-
-        max_heapify(priority_queue, largest_node_index);
+        int first = first_child(index, arity);
+        if (first >= size)
+            break;
+        int last = first + arity < size ? first + arity : size;
+
+        // First child wins ties, as the left child of a binary heap
+        int best = first;
+        for (int child = first + 1; child < last; child++)
+            if (has_priority(priority_queue, entries[child].value, entries[best].value))
+                best = child;
+
+        if (!has_priority(priority_queue, entries[best].value, moving.value))
+            break;
+        entries[index] = entries[best];
+        index = best;
     }
+    entries[index] = moving;
 }
 
-/**
- * Static helper function to perform heapify for min heap
- */
-static void min_heapify(T priority_queue, int parent_index)
+// Helper function to put moving at index or above it, moving parents that
+// come after it down into the hole
+static void sift_up(T priority_queue, int index, Node moving)
 {
-    assert(priority_queue && priority_queue->entries);
-
-    Node *parent = (Node *)Array_get(priority_queue->entries, parent_index);
-    assert(parent);
-
-    int entries_length = priority_queue->size;
+    Node *entries = priority_queue->entries;
+    int arity = priority_queue->arity;
 
-    Node *smallest_node = parent;
-    int smallest_node_index = parent_index;
-
-    // Compare parent node with both left and right child if both exist
-    if (right_child(parent_index) < entries_length)
-    {
-        Node *left = (Node *)Array_get(priority_queue->entries,
-                                       left_child(parent_index));
-        Node *right = (Node *)Array_get(priority_queue->entries,
-                                        right_child(parent_index));
-
-        if (left->value < parent->value)
-        {
-            smallest_node = left;
-            smallest_node_index = left_child(parent_index);
-        }
-        if (right->value < smallest_node->value)
-        {
-            smallest_node = right;
-            smallest_node_index = right_child(parent_index);
-        }
-    }
-    // Compare parent node with left child if only left child exists
-    else if (left_child(parent_index) < entries_length)
+    while (index > 0)
     {
-        Node *left = (Node *)Array_get(priority_queue->entries,
-                                       left_child(parent_index));
-
-        if (left->value < parent->value)
-        {
-            smallest_node = left;
-            smallest_node_index = left_child(parent_index);
-        }
-    }
-    // Swap parent with child to maintain heap rules, call heapify recursively
-    if (smallest_node_index != parent_index)
-    {
-        Node deref_smallest_node = *smallest_node;
-        Node deref_parent_node = *parent;
-
-        Array_put(priority_queue->entries, parent_index, &deref_smallest_node);
-        Array_put(priority_queue->entries, smallest_node_index, &deref_parent_node);
-
-        min_heapify(priority_queue, smallest_node_index);
+        int parent_index = parent(index, arity);
+        if (!has_priority(priority_queue, moving.value, entries[parent_index].value))
+            break;
+        entries[index] = entries[parent_index];
+        index = parent_index;
     }
+    entries[index] = moving;
 }
 
 /*
  * Function:        Priority_queue_insert
- * Description:     Inserts object to heap data structure
+ * Description:     Inserts object to heap data structure. The queue grows
+ *                  by doubling when it is full
  * Parameters:      *   T priority_queue: pointer to struct `Priority_Queue_T`
  *                  *   void pointer: Object inserted
- *                  *   int value: value associated to the object for heapifying
+ *                  *   uint64_t value: value associated to the object for heapifying
  *                  
  * Return:          void
  */
-void Priority_queue_insert(T priority_queue, void *item, unsigned int value)
+void Priority_queue_insert(T priority_queue, void *item, uint64_t value)
 {
-    assert(priority_queue);
-    if (!priority_queue->entries)
-    {
-        priority_queue->entries = Array_new(1, sizeof(Node));
-    }
-    int array_size = Array_length(priority_queue->entries);
-
-    // Dynamically allocated space for insertion if necessary
-    if (priority_queue->size >= array_size)
-    {
-        Array_T expanded_entries = Array_copy(priority_queue->entries, 2 * array_size);
-        Array_free(&(priority_queue->entries));
-        priority_queue->entries = expanded_entries;
-    }
-
-    Node *new_node = create_node_from_obj(item, value);
-    Array_put(priority_queue->entries, priority_queue->size, new_node);
-    free(new_node);
+    assert(priority_queue && item);
+    if (priority_queue->size == priority_queue->capacity)
+        Priority_queue_reserve(priority_queue, priority_queue->capacity ?
+                                               2 * priority_queue->capacity : 16);
 
-    int index = priority_queue->size;
+    Node new_node = {item, value};
     priority_queue->size++;
-
-    // Min-heap
-    if (priority_queue->type == 0)
-    {
-        int parent_index = parent(index);
-        Node *parent = (Node *)Array_get(priority_queue->entries, parent_index);
-        Node *current = (Node *)Array_get(priority_queue->entries, index);
-
-        // swap inserted node with parent until heap order is achieved
-        while (index > 0 && current->value < parent->value)
-        {
-            Node deref_parent = *parent;
-            Node deref_current = *current;
-
-            Array_put(priority_queue->entries, parent_index, &deref_current);
-            Array_put(priority_queue->entries, index, &deref_parent);
-
-            current = parent;
-            index = parent_index;
-            parent_index = parent(index);
-            parent = (Node *)Array_get(priority_queue->entries, parent_index);
-        }
-    }
-    // Max heap
-    else if (priority_queue->type == 1)
-    {
-        int parent_index = parent(index);
-        Node *parent = (Node *)Array_get(priority_queue->entries, parent_index);
-        Node *current = (Node *)Array_get(priority_queue->entries, index);
-
-        // swap inserted node with parent until heap order is achieved
-        while (index > 0 && current->value > parent->value)
-        {
-            Node deref_parent = *parent;
-            Node deref_current = *current;
-
-            Array_put(priority_queue->entries, parent_index, &deref_current);
-            Array_put(priority_queue->entries, index, &deref_parent);
-
-            current = parent;
-            index = parent_index;
-            parent_index = parent(index);
-            parent = (Node *)Array_get(priority_queue->entries, parent_index);
-        }
-    }
+    sift_up(priority_queue, priority_queue->size - 1, new_node);
 }
 
 /*
@@ -339,44 +259,35 @@ void Priority_queue_insert(T priority_queue, void *item, unsigned int value)
  */
 void *Priority_queue_top(T priority_queue)
 {
-    assert(priority_queue && priority_queue->entries);
-    assert(Array_length(priority_queue->entries) > 0);
-
-    return Array_get(priority_queue->entries, 0);
+    assert(priority_queue && priority_queue->size > 0);
+    return &priority_queue->entries[0];
 }
 
 /*
  * Function:        Priority_queue_pop
  * Description:     Pops the node with maximum or minimum value depending on
- *                  type of heap. If priority queue is empty, raise Exception
+ *                  type of heap. If priority queue is empty, raise Exception.
+ *                  The node stays valid until the next insertion
  * Parameters:      *   T priority_queue: pointer to struct `Priority_Queue_T`            
  *                  
  * Return:          void pointer: max/min node in the queue
  */
 void *Priority_queue_pop(T priority_queue)
 {
-    assert(priority_queue && priority_queue->entries);
+    assert(priority_queue);
     if (priority_queue->size == 0)
         RAISE(HEAP_UNDERFLOW);
 
-    Node deref_top = *(Node *)Array_get(priority_queue->entries, 0);
-    Node deref_end = *(Node *)Array_get(priority_queue->entries,
-                                        priority_queue->size - 1);
-
-    Array_put(priority_queue->entries, 0, &deref_end);
-    Array_put(priority_queue->entries, priority_queue->size - 1, &deref_top);
-
-    priority_queue->size--;
+    // Top is kept in the slot freed at the end of the heap, and the last
+    // node sinks from the root
+    Node *entries = priority_queue->entries;
+    Node top = entries[0];
+    Node last = entries[--priority_queue->size];
+    if (priority_queue->size > 0)
+        sift_down(priority_queue, 0, last);
+    entries[priority_queue->size] = top;
 
-    if (priority_queue->type == 0)
-    {
-        min_heapify(priority_queue, 0);
-    }
-    else if (priority_queue->type == 1)
-    {
-        max_heapify(priority_queue, 0);
-    }
-    return (Node *)Array_get(priority_queue->entries, priority_queue->size);
+    return &entries[priority_queue->size];
 }
 
 // extern void Priority_queue_map(T priority_queue,
@@ -0,0 +1,248 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: stats.c
+*
+*   Description: Implementation of stats module, which collects timings
+*   and compression statistics of a run and reports them
+*
+*   See comments on top of each function to understand the interface
+*
+****************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "../include/stats.h"
+
+/* Names of the phases, in the order of Stats_phase */
+static const char *phase_names[STATS_NUM_PHASES] = {
+    "read", "count", "code_lengths", "tables", "encode", "decode", "checksum",
+    "write"
+};
+
+/* Helper function prototypes */
+static double entropy_bits(const uint64_t *counts, uint64_t *total);
+static double per_character(double bits, uint64_t num_characters);
+
+/*
+ * Function:        Stats_init
+ * Description:     Resets every statistic to zero
+ * Parameters:      Stats *stats: statistics to reset
+ * Return:          void
+ */
+void Stats_init(Stats *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(Stats));
+}
+
+/*
+ * Function:        Stats_start
+ * Description:     Reads the monotonic clock, to start timing a phase
+ * Parameters:      Stats *stats: statistics, or NULL
+ * Return:          double: current time in seconds, 0 if stats is NULL
+ */
+double Stats_start(const Stats *stats)
+{
+    if (!stats)
+        return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*
+ * Function:        Stats_lap
+ * Description:     Adds the time since start to a phase
+ * Parameters:      Stats *stats: statistics, or NULL
+ *                  Stats_phase phase: phase that just ended
+ *                  double start: time the phase started, from Stats_start
+ *                  or the previous Stats_lap
+ * Return:          double: current time, to start timing the next phase
+ */
+double Stats_lap(Stats *stats, Stats_phase phase, double start)
+{
+    if (!stats)
+        return 0;
+    assert(phase < STATS_NUM_PHASES);
+    double now = Stats_start(stats);
+    stats->phase_seconds[phase] += now - start;
+    return now;
+}
+
+/*
+ * Function:        Stats_add_block
+ * Description:     Records the characters of a coded block and the codes
+ *                  that encode them
+ * Parameters:      Stats *stats: statistics, or NULL
+ *                  uint64_t *counts: HISTOGRAM_SIZE counts of the block
+ *                  uint64_t code_bits: bits of the codes of every character
+ *                  unsigned max_code_length: longest code of the block
+ *                  uint64_t num_words: number of words of the payload
+ * Return:          void
+ */
+void Stats_add_block(Stats *stats, const uint64_t *counts, uint64_t code_bits,
+                     unsigned max_code_length, uint64_t num_words)
+{
+    if (!stats)
+        return;
+    assert(counts);
+    uint64_t num_characters = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        stats->counts[c] += counts[c];
+    stats->code_bits += code_bits;
+    if (max_code_length > stats->max_code_length)
+        stats->max_code_length = max_code_length;
+    stats->block_entropy_bits += entropy_bits(counts, &num_characters);
+    stats->num_words += num_words;
+    stats->num_blocks++;
+}
+
+/*
+ * Function:        Stats_merge
+ * Description:     Adds the statistics collected on another thread
+ * Parameters:      Stats *stats: statistics updated, or NULL
+ *                  Stats *other: statistics added to them
+ * Return:          void
+ */
+void Stats_merge(Stats *stats, const Stats *other)
+{
+    if (!stats)
+        return;
+    assert(other);
+    for (int phase = 0; phase < STATS_NUM_PHASES; phase++)
+        stats->phase_seconds[phase] += other->phase_seconds[phase];
+    stats->total_seconds += other->total_seconds;
+    stats->bytes_in += other->bytes_in;
+    stats->bytes_out += other->bytes_out;
+    stats->num_blocks += other->num_blocks;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        stats->counts[c] += other->counts[c];
+    stats->block_entropy_bits += other->block_entropy_bits;
+    stats->code_bits += other->code_bits;
+    stats->num_words += other->num_words;
+    if (other->max_code_length > stats->max_code_length)
+        stats->max_code_length = other->max_code_length;
+}
+
+/*
+ * Function:        Stats_entropy
+ * Description:     Gets the order-0 entropy of the characters counted
+ * Parameters:      Stats *stats: statistics of a compression
+ * Return:          double: entropy in bits per character, 0 if none
+ */
+double Stats_entropy(const Stats *stats)
+{
+    assert(stats);
+    uint64_t num_characters = 0;
+    double bits = entropy_bits(stats->counts, &num_characters);
+    return per_character(bits, num_characters);
+}
+
+/*
+ * Function:        Stats_print
+ * Description:     Prints the statistics as text
+ * Parameters:      Stats *stats: statistics to print
+ *                  char *operation: "compress" or "decompress"
+ *                  FILE *file: where to print, usually stderr
+ * Return:          void
+ */
+void Stats_print(const Stats *stats, const char *operation, FILE *file)
+{
+    assert(stats && operation && file);
+    fprintf(file, "%s: %llu bytes in, %llu bytes out, %llu blocks, %.3f s",
+            operation, (unsigned long long)stats->bytes_in,
+            (unsigned long long)stats->bytes_out,
+            (unsigned long long)stats->num_blocks, stats->total_seconds);
+    // Throughput is given in uncompressed bytes either way
+    uint64_t raw_bytes = strcmp(operation, "decompress") ? stats->bytes_in : stats->bytes_out;
+    if (stats->total_seconds > 0)
+        fprintf(file, " (%.1f MB/s)", raw_bytes / stats->total_seconds / 1e6);
+    fprintf(file, "\n");
+
+    fprintf(file, "  phase seconds, summed over threads:");
+    for (int phase = 0; phase < STATS_NUM_PHASES; phase++)
+        if (stats->phase_seconds[phase] > 0)
+            fprintf(file, " %s %.3f", phase_names[phase], stats->phase_seconds[phase]);
+    fprintf(file, "\n");
+
+    // Code statistics are only known when compressing
+    uint64_t num_characters = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        num_characters += stats->counts[c];
+    if (num_characters == 0)
+        return;
+    fprintf(file, "  entropy %.4f bits/char, %.4f within blocks; output %.4f bits/char\n",
+            Stats_entropy(stats),
+            per_character(stats->block_entropy_bits, num_characters),
+            per_character(stats->bytes_out * 8.0, num_characters));
+    fprintf(file, "  code length average %.4f, max %u; %llu words flushed\n",
+            per_character((double)stats->code_bits, num_characters),
+            stats->max_code_length, (unsigned long long)stats->num_words);
+}
+
+/*
+ * Function:        Stats_write_json
+ * Description:     Writes the statistics as a JSON object
+ * Parameters:      Stats *stats: statistics to write
+ *                  char *operation: "compress" or "decompress"
+ *                  FILE *file: where to write
+ * Return:          void
+ */
+void Stats_write_json(const Stats *stats, const char *operation, FILE *file)
+{
+    assert(stats && operation && file);
+    uint64_t num_characters = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        num_characters += stats->counts[c];
+
+    fprintf(file, "{\n  \"operation\": \"%s\",\n", operation);
+    fprintf(file, "  \"total_seconds\": %.6f,\n", stats->total_seconds);
+    fprintf(file, "  \"bytes_in\": %llu,\n  \"bytes_out\": %llu,\n",
+            (unsigned long long)stats->bytes_in, (unsigned long long)stats->bytes_out);
+    fprintf(file, "  \"num_blocks\": %llu,\n", (unsigned long long)stats->num_blocks);
+    fprintf(file, "  \"phase_seconds\": {");
+    for (int phase = 0; phase < STATS_NUM_PHASES; phase++)
+        fprintf(file, "%s\"%s\": %.6f", phase ? ", " : "", phase_names[phase],
+                stats->phase_seconds[phase]);
+    fprintf(file, "}");
+    if (num_characters > 0)
+    {
+        fprintf(file, ",\n  \"entropy_bits_per_char\": %.6f,\n", Stats_entropy(stats));
+        fprintf(file, "  \"block_entropy_bits_per_char\": %.6f,\n",
+                per_character(stats->block_entropy_bits, num_characters));
+        fprintf(file, "  \"output_bits_per_char\": %.6f,\n",
+                per_character(stats->bytes_out * 8.0, num_characters));
+        fprintf(file, "  \"max_code_length\": %u,\n", stats->max_code_length);
+        fprintf(file, "  \"average_code_length\": %.6f,\n",
+                per_character((double)stats->code_bits, num_characters));
+        fprintf(file, "  \"num_words_flushed\": %llu",
+                (unsigned long long)stats->num_words);
+    }
+    fprintf(file, "\n}\n");
+}
+
+// Helper function to get the entropy in bits of a set of counts, and
+// update total with their sum
+static double entropy_bits(const uint64_t *counts, uint64_t *total)
+{
+    uint64_t sum = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        sum += counts[c];
+    *total += sum;
+
+    double bits = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        if (counts[c])
+            bits -= counts[c] * log2((double)counts[c] / sum);
+    return bits;
+}
+
+// Helper function to divide a number of bits among characters
+static double per_character(double bits, uint64_t num_characters)
+{
+    return num_characters ? bits / num_characters : 0;
+}
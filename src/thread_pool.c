@@ -0,0 +1,203 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: thread_pool.c
+*
+*   Description: Implementation of a pool of worker threads, which will
+*   be used to encode and decode blocks in parallel
+*
+*   See comments on top of each function to understand the interface
+*   of implemented data structure
+*
+****************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../include/thread_pool.h"
+
+#define T Thread_Pool_T
+
+/* structure of a queued job */
+typedef struct Job
+{
+    void (*run)(void *arg);
+    void *arg;
+} Job;
+
+/* structure of Thread Pool */
+struct T
+{
+    pthread_t *threads;
+    unsigned num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_available; // signalled when a job is queued
+    pthread_cond_t all_done;      // signalled when no job is left
+
+    Job *queue;         // circular buffer of queued jobs
+    int queue_capacity;
+    int queue_head;     // index of the next job to run
+    int queue_size;     // number of queued jobs
+    int num_running;    // number of jobs being run
+    int shutdown;       // set when workers must exit
+};
+
+/* Helper function prototypes */
+static void *worker(void *arg);
+
+/*
+ * Function:        Thread_pool_new
+ * Description:     Allocates the pool and starts its worker threads
+ * Parameters:      unsigned num_threads: number of worker threads,
+ *                  between 1 and THREAD_POOL_MAX_THREADS
+ * Return:          Pointer to newly created thread pool
+ */
+T Thread_pool_new(unsigned num_threads)
+{
+    assert(num_threads >= 1 && num_threads <= THREAD_POOL_MAX_THREADS);
+
+    T thread_pool = malloc(sizeof(*thread_pool));
+    assert(thread_pool);
+
+    thread_pool->queue_capacity = 2 * num_threads;
+    thread_pool->queue = malloc(thread_pool->queue_capacity * sizeof(Job));
+    thread_pool->threads = malloc(num_threads * sizeof(pthread_t));
+    assert(thread_pool->queue && thread_pool->threads);
+
+    thread_pool->num_threads = num_threads;
+    thread_pool->queue_head = 0;
+    thread_pool->queue_size = 0;
+    thread_pool->num_running = 0;
+    thread_pool->shutdown = 0;
+    pthread_mutex_init(&thread_pool->lock, NULL);
+    pthread_cond_init(&thread_pool->job_available, NULL);
+    pthread_cond_init(&thread_pool->all_done, NULL);
+
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        int failed = pthread_create(&thread_pool->threads[i], NULL, worker,
+                                    thread_pool);
+        assert(!failed);
+        (void)failed;
+    }
+    return thread_pool;
+}
+
+/*
+ * Function:        Thread_pool_free
+ * Description:     Waits for submitted jobs, stops the worker threads
+ *                  and deallocates the pool
+ * Parameters:      T *thread_pool: double pointer to struct `Thread_Pool_T`
+ * Return:          void
+ */
+void Thread_pool_free(T *thread_pool)
+{
+    assert(thread_pool && *thread_pool);
+    T pool = *thread_pool;
+    Thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+    *thread_pool = NULL;
+}
+
+/*
+ * Function:        Thread_pool_submit
+ * Description:     Queues a job to be run by the next idle worker thread
+ * Parameters:      T thread_pool: pointer to struct `Thread_Pool_T`
+ *                  void job(void *arg): function run by the worker
+ *                  void *arg: argument passed to the job
+ * Return:          void
+ */
+void Thread_pool_submit(T thread_pool, void job(void *arg), void *arg)
+{
+    assert(thread_pool && job);
+    pthread_mutex_lock(&thread_pool->lock);
+
+    // Dynamically allocate space for queued jobs if necessary, unrolling
+    // the circular buffer into the front of the new one
+    if (thread_pool->queue_size == thread_pool->queue_capacity)
+    {
+        int capacity = 2 * thread_pool->queue_capacity;
+        Job *queue = malloc(capacity * sizeof(Job));
+        assert(queue);
+        for (int i = 0; i < thread_pool->queue_size; i++)
+            queue[i] = thread_pool->queue[(thread_pool->queue_head + i) %
+                                          thread_pool->queue_capacity];
+        free(thread_pool->queue);
+        thread_pool->queue = queue;
+        thread_pool->queue_capacity = capacity;
+        thread_pool->queue_head = 0;
+    }
+
+    int tail = (thread_pool->queue_head + thread_pool->queue_size) %
+               thread_pool->queue_capacity;
+    thread_pool->queue[tail].run = job;
+    thread_pool->queue[tail].arg = arg;
+    thread_pool->queue_size++;
+
+    pthread_cond_signal(&thread_pool->job_available);
+    pthread_mutex_unlock(&thread_pool->lock);
+}
+
+/*
+ * Function:        Thread_pool_wait
+ * Description:     Blocks until every submitted job has finished
+ * Parameters:      T thread_pool: pointer to struct `Thread_Pool_T`
+ * Return:          void
+ */
+void Thread_pool_wait(T thread_pool)
+{
+    assert(thread_pool);
+    pthread_mutex_lock(&thread_pool->lock);
+    while (thread_pool->queue_size > 0 || thread_pool->num_running > 0)
+        pthread_cond_wait(&thread_pool->all_done, &thread_pool->lock);
+    pthread_mutex_unlock(&thread_pool->lock);
+}
+
+/**
+ * Static helper function run by each worker thread: takes jobs off the
+ * queue until the pool shuts down
+ */
+static void *worker(void *arg)
+{
+    T thread_pool = arg;
+    pthread_mutex_lock(&thread_pool->lock);
+    while (1)
+    {
+        while (thread_pool->queue_size == 0 && !thread_pool->shutdown)
+            pthread_cond_wait(&thread_pool->job_available, &thread_pool->lock);
+        if (thread_pool->queue_size == 0)
+            break;
+
+        Job job = thread_pool->queue[thread_pool->queue_head];
+        thread_pool->queue_head = (thread_pool->queue_head + 1) %
+                                  thread_pool->queue_capacity;
+        thread_pool->queue_size--;
+        thread_pool->num_running++;
+
+        pthread_mutex_unlock(&thread_pool->lock);
+        job.run(job.arg);
+        pthread_mutex_lock(&thread_pool->lock);
+
+        thread_pool->num_running--;
+        if (thread_pool->queue_size == 0 && thread_pool->num_running == 0)
+            pthread_cond_broadcast(&thread_pool->all_done);
+    }
+    pthread_mutex_unlock(&thread_pool->lock);
+    return NULL;
+}
@@ -13,13 +13,23 @@
 // #include <stdint.h>
 // #include <inttypes.h>
 #include <assert.h>
+#include <string.h>
 #include "../include/priority_queue.h"
 #include "../include/huffman_tree.h"
 #include "../include/utils.h"
-#include "../include/bitpack.h"
+#include "../include/bitio.h"
+#include "../include/histogram.h"
+#include "../include/canonical.h"
 
 #define SIZE_OF_CHAR_IN_BITS 8
 #define SIZE_OF_UINT64_IN_BITS 64
+#define READ_BUFFER_WORDS 4096
+#define IN_BUFFER_SIZE 65536
+#define OUT_BUFFER_SIZE 65536
+
+/* Helper function prototypes */
+static inline void refill_from_file(Bit_reader *reader, uint64_t *words,
+                                    FILE *infile);
 
 /*
  * Function:        get_frequency_of_characters_from_file
@@ -27,23 +37,24 @@
  * Parameters:      FILE *infile: pointer to file
  *                  Pointer to num_unique_chars, which will be updated
  *                  after the function is called
- * Return           int: frequencies of each character array
+ * Return           uint64_t: frequencies of each character array
  */
-int *get_frequency_of_characters_from_file(FILE *infile, int *num_unique_chars)
+uint64_t *get_frequency_of_characters_from_file(FILE *infile, int *num_unique_chars)
 {
     assert(infile);
-    int *freq_array = (int *)calloc(MAX_NUM_CHAR, sizeof(int));
+    uint64_t *freq_array = (uint64_t *)calloc(MAX_NUM_CHAR, sizeof(uint64_t));
+    assert(freq_array);
     int _num_unique_chars = 0;
 
-    // Create a table where the index is the character, value is
-    // the frequency of that character in the file
-    int c;
-    while ((c = fgetc(infile)) != EOF)
-    {
-        if (freq_array[c] == 0)
+    // Count the file in chunks into a table where the index is the
+    // character, value is the frequency of that character in the file
+    uint8_t in_buffer[IN_BUFFER_SIZE];
+    size_t in_size;
+    while ((in_size = fread(in_buffer, 1, IN_BUFFER_SIZE, infile)) > 0)
+        Histogram_count(in_buffer, in_size, freq_array);
+    for (int c = 0; c < MAX_NUM_CHAR; c++)
+        if (freq_array[c] > 0)
             _num_unique_chars++;
-        freq_array[c]++;
-    }
     assert(_num_unique_chars > 0);
 
     *num_unique_chars = _num_unique_chars;
@@ -55,40 +66,33 @@ int *get_frequency_of_characters_from_file(FILE *infile, int *num_unique_chars)
  * Function:        create_unique_characters_freq_array
  * Description:     Builds array of unique character frequencies for Huffman 
  *                  tree building later on
- * Parameters:      int *freq_array: pointer to frequency array
+ * Parameters:      uint64_t *freq_array: pointer to frequency array
  *                  int num_unique_char: length of freq_array
+ *                  Huffman_Tree_T huffman_tree: tree the leaves are
+ *                  allocated in, and later built from the array
  * Return           Array_T
  */
-Array_T create_unique_characters_freq_array(int *freq_array, int num_unique_char)
+Array_T create_unique_characters_freq_array(const uint64_t *freq_array,
+                                            int num_unique_char,
+                                            Huffman_Tree_T huffman_tree)
 {
+    assert(freq_array && huffman_tree);
+
     // Allocate space for the Array_T to be returned
     Array_T freq_array_from_file = Array_new(num_unique_char, sizeof(Node));
     int array_index = 0;
     for (int i = 0; i < MAX_NUM_CHAR; i++)
     {
-        // Create a Priority_queue Node from the key value pari in the table
+        // Create a Priority_queue Node from the key value pair in the
+        // table, with its leaf in the memory of the tree. Array_put copies
+        // the node into the array
         if (freq_array[i] != 0)
         {
-            // Allocate space for Priority_queue Node
-            Node *node = malloc(sizeof(Node));
-            assert(node);
-            node->value = freq_array[i];
-
-            // Allocate space for Huffman_node (obj pointer of Priority_queue Node)
-            Huffman_node *obj = malloc(sizeof(Huffman_node));
-            assert(obj);
-            obj->frequency = freq_array[i];
-            obj->key = (char)i;
-            obj->left_node = NULL;
-            obj->right_node = NULL;
-            node->obj = obj;
-
-            // Put Priority_queue node to the allocated array
-            Array_put(freq_array_from_file, array_index, node);
+            Node node;
+            node.value = freq_array[i];
+            node.obj = Huffman_tree_new_leaf(huffman_tree, (char)i, freq_array[i]);
+            Array_put(freq_array_from_file, array_index, &node);
             array_index++;
-
-            free(node);
-            continue;
         }
     }
     return freq_array_from_file;
@@ -100,11 +104,12 @@ Array_T create_unique_characters_freq_array(int *freq_array, int num_unique_char
  *                  compressed file.
  * 
  * Parameters:      FILE *outfile: pointer to file
- *                  int *freq_array
+ *                  uint64_t *freq_array
  *                  Array_T encoding
  * Return:          void
  */
-void write_total_num_bits(int *freq_array, Array_T encoding, FILE *outfile)
+void write_total_num_bits(const uint64_t *freq_array, Array_T encoding,
+                          FILE *outfile)
 {
     assert(freq_array && encoding && outfile);
     uint64_t total_num_bits = 0;
@@ -158,7 +163,11 @@ void write_header(Array_T freq_array, FILE *outfile)
     {
         Node *curr_node = (Node *)Array_get(freq_array, i);
         char key = ((Huffman_node *)(curr_node->obj))->key;
-        int value = curr_node->value;
+
+        // Frequencies are 32-bit in this header; larger inputs are
+        // compressed block by block instead
+        assert(curr_node->value <= UINT32_MAX);
+        int value = (int)(uint32_t)curr_node->value;
 
         fputc(key, outfile);
         putw(value, outfile);
@@ -170,11 +179,13 @@ void write_header(Array_T freq_array, FILE *outfile)
  * Description:     Read header in compressed file. Returns an Array_T so
  *                  decompressor can rebuild Huffman tree
  * Parameters:      FILE *infile: pointer to file
+ *                  Huffman_Tree_T huffman_tree: tree the leaves are
+ *                  allocated in, and later built from the array
  * Return:          Pointer to struct `Array_T`
  */
-Array_T read_header(FILE *infile)
+Array_T read_header(FILE *infile, Huffman_Tree_T huffman_tree)
 {
-    assert(infile);
+    assert(infile && huffman_tree);
 
     // Get total number of unique char in file
     int freq_array_length = getw(infile);
@@ -183,30 +194,69 @@ Array_T read_header(FILE *infile)
     for (int i = 0; i < freq_array_length; i++)
     {
         char key = fgetc(infile);
-        int value = getw(infile);
-
-        // printf("%c: %d\n", key, value);
-        // Create new Priority_queue Node from header
-        Node *node = malloc(sizeof(Node));
-        assert(node);
-        node->value = value;
-
-        // Create Huffman_node from header
-        Huffman_node *obj = malloc(sizeof(Huffman_node));
-        assert(obj);
-        obj->frequency = value;
-        obj->key = key;
-        obj->left_node = NULL;
-        obj->right_node = NULL;
-        node->obj = obj;
-
-        // Insert Priority_queue Node to allocated array
-        Array_put(entries, i, node);
-        free(node);
+        uint64_t value = (uint32_t)getw(infile);
+
+        // Create new Priority_queue Node from header, with its leaf in the
+        // memory of the tree
+        Node node;
+        node.value = value;
+        node.obj = Huffman_tree_new_leaf(huffman_tree, key, value);
+        Array_put(entries, i, &node);
     }
     return entries;
 }
 
+/*
+ * Function:        write_canonical_header
+ * Description:     Write header of a file compressed with canonical codes
+ *                  in the following format. The code lengths alone allow
+ *                  decompressor to rebuild the canonical Huffman tree
+ *
+ *                  <CANONICAL_MAGIC><PACKED_CODE_LENGTHS>
+ *
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths
+ *                  FILE *outfile: pointer to file
+ * Return:          void
+ */
+void write_canonical_header(const uint8_t *lengths, FILE *outfile)
+{
+    assert(lengths && outfile);
+    uint8_t packed[CANONICAL_PACKED_SIZE];
+    Canonical_pack_lengths(lengths, packed);
+
+    fwrite(CANONICAL_MAGIC, 1, CANONICAL_MAGIC_SIZE, outfile);
+    fwrite(packed, 1, CANONICAL_PACKED_SIZE, outfile);
+}
+
+/*
+ * Function:        read_canonical_header
+ * Description:     Read header of a file compressed with canonical codes.
+ *                  If the file does not start with CANONICAL_MAGIC, the
+ *                  file position is restored and nothing is read
+ * Parameters:      uint8_t *lengths: MAX_NUM_CHAR code lengths, updated
+ *                  after the function is called
+ *                  FILE *infile: pointer to file
+ * Return:          int: 1 if the canonical header was read, 0 otherwise
+ */
+int read_canonical_header(uint8_t *lengths, FILE *infile)
+{
+    assert(lengths && infile);
+    char magic[CANONICAL_MAGIC_SIZE];
+    size_t magic_size = fread(magic, 1, CANONICAL_MAGIC_SIZE, infile);
+
+    if (magic_size != CANONICAL_MAGIC_SIZE ||
+        memcmp(magic, CANONICAL_MAGIC, CANONICAL_MAGIC_SIZE) != 0)
+    {
+        fseek(infile, -(long)magic_size, SEEK_CUR);
+        return 0;
+    }
+
+    uint8_t packed[CANONICAL_PACKED_SIZE] = {0};
+    fread(packed, 1, CANONICAL_PACKED_SIZE, infile);
+    Canonical_unpack_lengths(packed, lengths);
+    return 1;
+}
+
 /*
  * Function:        write_body
  * Description:     Write body to compressed file
@@ -218,61 +268,32 @@ Array_T read_header(FILE *infile)
 void write_body(Array_T encoding, FILE *infile, FILE *outfile)
 {
     assert(infile && outfile && encoding);
-    uint64_t word = 0;
-    unsigned int current_lsb = SIZE_OF_UINT64_IN_BITS;
-    int c = 0;
-    Encoded_value *curr = NULL;
+    Encoded_value codes[MAX_NUM_CHAR];
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        codes[i] = *(Encoded_value *)Array_get(encoding, i);
 
-    while (1)
-    {
-        // Iterate through each character until uint64_bit word is filled to capacity
-        while ((c = fgetc(infile)) != EOF)
-        {
-            curr = (Encoded_value *)Array_get(encoding, c);
-            // If there's not enough space (filled to capacity), break out of the loop
-            if (current_lsb < curr->bit_length)
-                break;
-            // Pack bit to uint64_t word
-            current_lsb -= curr->bit_length;
-            word = Bitpack_newu(word, curr->bit_length, current_lsb, curr->bit_value);
-        }
+    // Every code stores at most one word, so the buffer is written out
+    // as soon as it is full
+    unsigned char in_buffer[IN_BUFFER_SIZE];
+    uint8_t out_buffer[OUT_BUFFER_SIZE];
+    Bit_writer writer;
+    Bit_writer_init(&writer, out_buffer);
 
-        // Breaks out of the loop if end of file
-        if (c == EOF)
-        {
-            fwrite(&word, sizeof(uint64_t), 1, outfile);
-            return;
-        }
-        // If there are remaining bits to be filled in previous uint64_t word
-        else if (current_lsb > 0)
-        {
-            // Divide current bit word into 2 halves: front and back,
-            // where front will be packed with previous uint64_t word,
-            // and back will be packed with new uint64_t word
-            unsigned int back_bits_len = curr->bit_length - current_lsb;
-
-            // Divide current bits into 2 halves
-            uint64_t front_bits = curr->bit_value >> back_bits_len;
-            uint64_t back_bits = (curr->bit_value << (64 - back_bits_len)) >> (64 - back_bits_len);
-
-            // Pack front bits and write to file
-            word = Bitpack_newu(word, current_lsb, 0, front_bits);
-            fwrite(&word, sizeof(uint64_t), 1, outfile);
-
-            // Pack back bits to new word
-            word = 0;
-            current_lsb = SIZE_OF_UINT64_IN_BITS - back_bits_len;
-            word = Bitpack_newu(word, back_bits_len, current_lsb, back_bits);
-        }
-        // If there is no space left to be packed for previous uint64_t word
-        else
+    size_t in_size;
+    while ((in_size = fread(in_buffer, 1, IN_BUFFER_SIZE, infile)) > 0)
+    {
+        for (size_t i = 0; i < in_size; i++)
         {
-            // write word to file
-            fwrite(&word, sizeof(uint64_t), 1, outfile);
-            current_lsb = SIZE_OF_UINT64_IN_BITS - curr->bit_length;
-            word = Bitpack_newu(word, curr->bit_length, current_lsb, curr->bit_value);
+            Encoded_value code = codes[in_buffer[i]];
+            Bit_writer_put(&writer, code.bit_value, code.bit_length);
+            if (Bit_writer_num_bytes(&writer) == OUT_BUFFER_SIZE)
+            {
+                fwrite(out_buffer, 1, OUT_BUFFER_SIZE, outfile);
+                Bit_writer_rewind(&writer);
+            }
         }
     }
+    fwrite(out_buffer, 1, Bit_writer_flush(&writer), outfile);
 }
 
 /*
@@ -287,33 +308,52 @@ void write_body(Array_T encoding, FILE *infile, FILE *outfile)
 void read_body(Huffman_Tree_T encoding, uint64_t total_num_bits, FILE *infile, FILE *outfile)
 {
     assert(infile && outfile && encoding);
-    Huffman_node *root = Huffman_tree_get_root(encoding);
-    Huffman_node *curr = root;
-    uint64_t word = 0;
+    unsigned root_bits = 0;
+    Decoded_value *table = Huffman_tree_create_decoding_table(encoding, &root_bits);
+
+    uint64_t words[READ_BUFFER_WORDS];
+    Bit_reader reader;
+    Bit_reader_init(&reader, (const uint8_t *)words, 0);
+
+    unsigned char out_buffer[OUT_BUFFER_SIZE];
+    size_t out_size = 0;
 
-    // Iterate through all encoded bits
-    for (uint64_t i = 0; i < total_num_bits; i++)
+    // Decode one character per lookup until all encoded bits are consumed
+    uint64_t num_bits_read = 0;
+    while (num_bits_read < total_num_bits)
     {
-        int j = i % 64 + 1;
-
-        // Read in new word after 64 bits are read
-        if (j == 1)
-            fread(&word, sizeof(uint64_t), 1, infile);
-
-        uint64_t first_bit = Bitpack_getu(word, 1, 64 - j);
-        
-        // Travese through the Huffman encoding tree based on
-        // bit read from encoded file
-        if (first_bit == 0 && curr->left_node)
-            curr = curr->left_node;
-        else if (first_bit == 1 && curr->right_node)
-            curr = curr->right_node;
-        
-        // Write to file if reached the leaf of Huffman tree
-        if (!curr->left_node && !curr->right_node)
+        refill_from_file(&reader, words, infile);
+        Decoded_value entry = table[Bit_reader_peek(&reader, root_bits)];
+
+        // Codes longer than the root table continue through sub-tables
+        while (entry.subtable_bits)
+        {
+            Bit_reader_consume(&reader, entry.bit_length);
+            num_bits_read += entry.bit_length;
+            refill_from_file(&reader, words, infile);
+            entry = table[entry.subtable +
+                          Bit_reader_peek(&reader, entry.subtable_bits)];
+        }
+        Bit_reader_consume(&reader, entry.bit_length);
+        num_bits_read += entry.bit_length;
+
+        out_buffer[out_size++] = (unsigned char)entry.symbol;
+        if (out_size == OUT_BUFFER_SIZE)
         {
-            fputc(curr->key, outfile);
-            curr = root;
+            fwrite(out_buffer, 1, out_size, outfile);
+            out_size = 0;
         }
     }
+    fwrite(out_buffer, 1, out_size, outfile);
+}
+
+// Helper function to top up the bit reader, reading the next chunk of
+// encoded words from the compressed file once the current one is used up
+static inline void refill_from_file(Bit_reader *reader, uint64_t *words,
+                                    FILE *infile)
+{
+    if (Bit_reader_needs_input(reader))
+        Bit_reader_feed(reader, (const uint8_t *)words,
+                        fread(words, sizeof(uint64_t), READ_BUFFER_WORDS, infile));
+    Bit_reader_refill(reader);
 }
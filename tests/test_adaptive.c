@@ -0,0 +1,177 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_adaptive.c
+*
+*   Description: Test driver for adaptive module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../hanson/include/except.h"
+#include "../include/adaptive.h"
+
+#define LARGE_SIZE 200000
+
+static Adaptive_Coder_T coder;
+
+// Compresses then decompresses size bytes of src and checks the output
+// matches. Returns the compressed size
+static size_t round_trip(const uint8_t *src, size_t size)
+{
+    size_t bound = Adaptive_compress_bound(size);
+    uint8_t *compressed = malloc(bound);
+    uint8_t *decompressed = malloc(size + 1);
+    assert(compressed && decompressed);
+
+    size_t compressed_size = Adaptive_compress(coder, src, size, compressed, bound);
+    assert(compressed_size <= bound);
+    assert(Adaptive_coder_num_bits(coder) <=
+           (compressed_size - ADAPTIVE_MAGIC_SIZE) * 8);
+    size_t decompressed_size = Adaptive_decompress(coder, compressed, compressed_size,
+                                                   decompressed, size + 1);
+    assert(decompressed_size == size);
+    assert(size == 0 || memcmp(src, decompressed, size) == 0);
+
+    free(compressed);
+    free(decompressed);
+    return compressed_size;
+}
+
+int main() {
+    static uint8_t buffer[LARGE_SIZE];
+    coder = Adaptive_coder_new();
+    srand(19);
+
+    printf("%s", "   - Round trip of empty and tiny buffers: ");
+    assert(round_trip(buffer, 0) == ADAPTIVE_MAGIC_SIZE + sizeof(uint64_t));
+    buffer[0] = 'x';
+    assert(round_trip(buffer, 1) == ADAPTIVE_MAGIC_SIZE + sizeof(uint64_t));
+    memcpy(buffer, "abracadabra", 11);
+    round_trip(buffer, 11);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Skewed input is compressed as it is read: ");
+    for (int i = 0; i < LARGE_SIZE; i++)
+        buffer[i] = "aaaabbbccd\n"[rand() % 11];
+    assert(round_trip(buffer, LARGE_SIZE) < LARGE_SIZE / 2);
+
+    // Only the first 64 bytes are random, the codes adapt to the rest
+    for (int i = 64; i < LARGE_SIZE; i++)
+        buffer[i] = 'z';
+    assert(round_trip(buffer, LARGE_SIZE) < LARGE_SIZE / 6);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip of every character: ");
+    for (int i = 0; i < LARGE_SIZE; i++)
+        buffer[i] = rand() % 256;
+    assert(round_trip(buffer, LARGE_SIZE) < LARGE_SIZE + LARGE_SIZE / 50);
+    for (int i = 0; i < 256; i++)
+        buffer[i] = (uint8_t)(255 - i);
+    round_trip(buffer, 256);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Output too small is reported: ");
+    static uint8_t compressed[LARGE_SIZE * 2];
+    volatile int raised = 0;
+    TRY
+        Adaptive_compress(coder, buffer, 5000, compressed, 1000);
+    EXCEPT(Adaptive_Output_Too_Small)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    volatile size_t size = Adaptive_compress(coder, buffer, 5000, compressed, sizeof(compressed));
+    raised = 0;
+    TRY
+        Adaptive_decompress(coder, compressed, size, buffer + 5000, 4999);
+    EXCEPT(Adaptive_Output_Too_Small)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Truncated or corrupted input is rejected: ");
+    for (volatile size_t cut = 0; cut < size; cut += 8)
+    {
+        raised = 0;
+        TRY
+            Adaptive_decompress(coder, compressed, cut, buffer + 5000, 5000);
+        EXCEPT(Adaptive_Corrupted)
+            raised = 1;
+        END_TRY;
+        assert(raised);
+    }
+
+    // The second code escapes the first character again
+    Bit_writer writer;
+    Bit_writer_init(&writer, compressed + ADAPTIVE_MAGIC_SIZE);
+    memcpy(compressed, ADAPTIVE_MAGIC, ADAPTIVE_MAGIC_SIZE);
+    Bit_writer_put(&writer, 'a', ADAPTIVE_ESCAPE_BITS);
+    Bit_writer_put(&writer, 0, 1);
+    Bit_writer_put(&writer, 'a', ADAPTIVE_ESCAPE_BITS);
+    size = ADAPTIVE_MAGIC_SIZE + Bit_writer_flush(&writer);
+    raised = 0;
+    TRY
+        Adaptive_decompress(coder, compressed, size, buffer + 5000, 5000);
+    EXCEPT(Adaptive_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Buffers and files share one format: ");
+    for (int i = 0; i < LARGE_SIZE; i++)
+        buffer[i] = "aaaabbbccd\n"[rand() % 11];
+    FILE *raw = tmpfile();
+    FILE *infile = tmpfile();
+    FILE *outfile = tmpfile();
+    assert(raw && infile && outfile);
+    fwrite(buffer, 1, LARGE_SIZE, raw);
+    rewind(raw);
+    Stats stats;
+    Stats_init(&stats);
+    Adaptive_compress_file(raw, infile, &stats);
+    long file_size = ftell(infile);
+    assert(stats.bytes_in == LARGE_SIZE && stats.bytes_out == (uint64_t)file_size);
+    rewind(infile);
+    assert(fread(compressed, 1, file_size, infile) == (size_t)file_size);
+    static uint8_t decoded[LARGE_SIZE];
+    assert(Adaptive_decompress(coder, compressed, file_size, decoded, LARGE_SIZE) ==
+           LARGE_SIZE);
+    assert(memcmp(decoded, buffer, LARGE_SIZE) == 0);
+    assert((size_t)file_size == Adaptive_compress(coder, buffer, LARGE_SIZE, compressed,
+                                                  sizeof(compressed)));
+
+    fseek(infile, ADAPTIVE_MAGIC_SIZE, SEEK_SET);
+    Adaptive_decompress_file(infile, outfile, NULL);
+    assert(ftell(outfile) == LARGE_SIZE);
+    rewind(outfile);
+    assert(fread(decoded, 1, LARGE_SIZE, outfile) == LARGE_SIZE);
+    assert(memcmp(decoded, buffer, LARGE_SIZE) == 0);
+
+    // A truncated file is rejected rather than decoded from zeros
+    FILE *truncated = tmpfile();
+    assert(truncated);
+    fwrite(compressed, 1, file_size / 2, truncated);
+    fseek(truncated, ADAPTIVE_MAGIC_SIZE, SEEK_SET);
+    raised = 0;
+    TRY
+        Adaptive_decompress_file(truncated, outfile, NULL);
+    EXCEPT(Adaptive_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    fclose(truncated);
+    fclose(raw);
+    fclose(infile);
+    fclose(outfile);
+    printf("%s\n", "Passed");
+
+    Adaptive_coder_free(&coder);
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
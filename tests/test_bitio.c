@@ -0,0 +1,95 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_bitio.c
+*
+*   Description: Test driver for bit I/O module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/bitio.h"
+
+#define NUM_CODES 10000
+
+int main() {
+    static uint64_t values[NUM_CODES];
+    static unsigned lengths[NUM_CODES];
+    static uint8_t buffer[NUM_CODES * sizeof(uint64_t) + sizeof(uint64_t)];
+
+    printf("%s", "   - Write codes of 1 to 32 bits: ");
+    srand(7);
+    Bit_writer writer;
+    Bit_writer_init(&writer, buffer);
+    uint64_t total_bits = 0;
+    for (int i = 0; i < NUM_CODES; i++)
+    {
+        lengths[i] = 1 + rand() % 32;
+        values[i] = (uint64_t)rand() & ((1ULL << lengths[i]) - 1);
+        Bit_writer_put(&writer, values[i], lengths[i]);
+        total_bits += lengths[i];
+        assert(Bit_writer_num_bits(&writer) == total_bits);
+    }
+    size_t num_bytes = Bit_writer_flush(&writer);
+    assert(num_bytes == (total_bits + 63) / 64 * sizeof(uint64_t));
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Codes start from the top of the first word: ");
+    uint64_t first_word;
+    memcpy(&first_word, buffer, sizeof(uint64_t));
+    assert(first_word >> (64 - lengths[0]) == values[0]);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Read codes back from one chunk: ");
+    Bit_reader reader;
+    Bit_reader_init(&reader, buffer, num_bytes / sizeof(uint64_t));
+    for (int i = 0; i < NUM_CODES; i++)
+    {
+        Bit_reader_refill(&reader);
+        assert(Bit_reader_peek(&reader, lengths[i]) == values[i]);
+        Bit_reader_consume(&reader, lengths[i]);
+    }
+    Bit_reader_refill(&reader);
+    assert(Bit_reader_peek(&reader, BIT_READER_MIN_BITS) == 0);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Read codes back from chunks of 3 words: ");
+    size_t words_left = num_bytes / sizeof(uint64_t);
+    const uint8_t *chunk = buffer;
+    Bit_reader_init(&reader, chunk, 0);
+    for (int i = 0; i < NUM_CODES; i++)
+    {
+        if (Bit_reader_needs_input(&reader))
+        {
+            size_t num_words = words_left < 3 ? words_left : 3;
+            Bit_reader_feed(&reader, chunk, num_words);
+            chunk += num_words * sizeof(uint64_t);
+            words_left -= num_words;
+        }
+        Bit_reader_refill(&reader);
+        assert(Bit_reader_peek(&reader, lengths[i]) == values[i]);
+        Bit_reader_consume(&reader, lengths[i]);
+    }
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Write 64-bit codes across words and rewind: ");
+    Bit_writer_init(&writer, buffer);
+    Bit_writer_put(&writer, 1, 1);
+    Bit_writer_put(&writer, 0x8000000000000001ULL, 64);
+    assert(Bit_writer_num_bytes(&writer) == sizeof(uint64_t));
+    memcpy(&first_word, buffer, sizeof(uint64_t));
+    assert(first_word == 0xC000000000000000ULL);
+    Bit_writer_rewind(&writer);
+    assert(Bit_writer_flush(&writer) == sizeof(uint64_t));
+    uint64_t second_word;
+    memcpy(&second_word, buffer, sizeof(uint64_t));
+    assert(second_word == 0x8000000000000000ULL);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
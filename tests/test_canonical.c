@@ -0,0 +1,380 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_canonical.c
+*
+*   Description: Test driver for canonical Huffman codes module
+*
+****************************************************************/
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../hanson/include/except.h"
+#include "../include/huffman_tree.h"
+#include "../include/canonical.h"
+#include "../include/utils.h"
+
+// Sum of 2^-length over all codes, scaled by 2^max_length
+static uint64_t kraft_sum(uint8_t *lengths, unsigned max_length)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        if (lengths[i])
+            sum += (uint64_t)1 << (max_length - lengths[i]);
+    return sum;
+}
+
+// Frequencies of the first 40 Fibonacci numbers, which need codes of up
+// to 39 bits without a limit
+static const uint64_t *skewed_fibonacci()
+{
+    static uint64_t freq_array[MAX_NUM_CHAR];
+    uint64_t prev = 1, curr = 1;
+    for (int i = 0; i < 40; i++)
+    {
+        freq_array[i] = curr;
+        uint64_t next = prev + curr;
+        prev = curr;
+        curr = next;
+    }
+    return freq_array;
+}
+
+int main() {
+    uint64_t freq_array[MAX_NUM_CHAR];
+    uint8_t lengths[MAX_NUM_CHAR];
+
+    /* Fibonacci frequencies would need 39-bit codes without a limit */
+    printf("%s", "   - Length limit with Fibonacci frequencies: ");
+    memcpy(freq_array, skewed_fibonacci(), sizeof(freq_array));
+    Canonical_code_lengths(freq_array, 11, lengths, NULL);
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+    {
+        assert(lengths[i] <= 11);
+        assert((lengths[i] == 0) == (freq_array[i] == 0));
+    }
+    assert(kraft_sum(lengths, 11) == (uint64_t)1 << 11);
+    printf("%s\n", "Passed");
+
+    /* Equal frequencies over every character give 8-bit codes */
+    printf("%s", "   - Uniform frequencies: ");
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        freq_array[i] = 7;
+    Canonical_code_lengths(freq_array, CANONICAL_MIN_CODE_LENGTH, lengths, NULL);
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        assert(lengths[i] == 8);
+    printf("%s\n", "Passed");
+
+    /* Without a binding limit, package-merge is as good as Huffman */
+    printf("%s", "   - Optimal when limit is not reached: ");
+    FILE *infile = fopen("tests/utils_sample_test.txt", "rb");
+    assert(infile);
+    int num_unique_chars = 0;
+    uint64_t *sample_freq = get_frequency_of_characters_from_file(infile, &num_unique_chars);
+    Huffman_Tree_T tree = Huffman_tree_new();
+    Array_T entries = create_unique_characters_freq_array(sample_freq, num_unique_chars, tree);
+    Huffman_tree_build(tree, entries);
+    Array_T encoding = Huffman_tree_create_encoding_table(tree);
+
+    Canonical_code_lengths(sample_freq, CANONICAL_MAX_CODE_LENGTH, lengths, NULL);
+    uint64_t huffman_cost = 0, canonical_cost = 0;
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+    {
+        huffman_cost += (uint64_t)sample_freq[i] *
+                        ((Encoded_value *)Array_get(encoding, i))->bit_length;
+        canonical_cost += (uint64_t)sample_freq[i] * lengths[i];
+    }
+    assert(canonical_cost == huffman_cost);
+    Huffman_tree_free(&tree);
+    Array_free(&entries);
+    printf("%s\n", "Passed");
+
+    /* Counts of inputs larger than 4 GiB give the lengths of the same
+     * counts scaled down, both with and without a binding limit */
+    printf("%s", "   - Counts beyond 32 bits: ");
+    uint64_t large_freq[MAX_NUM_CHAR];
+    uint8_t large_lengths[MAX_NUM_CHAR];
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        large_freq[i] = sample_freq[i] << 30;
+    for (unsigned max_length = 9; max_length <= CANONICAL_MAX_CODE_LENGTH; max_length += 6)
+    {
+        Canonical_code_lengths(sample_freq, max_length, lengths, NULL);
+        Canonical_code_lengths(large_freq, max_length, large_lengths, NULL);
+        assert(memcmp(lengths, large_lengths, MAX_NUM_CHAR) == 0);
+    }
+    tree = Huffman_tree_new();
+    entries = create_unique_characters_freq_array(sample_freq, num_unique_chars, tree);
+    Huffman_tree_build(tree, entries);
+    encoding = Huffman_tree_create_encoding_table(tree);
+    Huffman_Tree_T large_tree = Huffman_tree_new();
+    Array_T large_entries = create_unique_characters_freq_array(large_freq, num_unique_chars,
+                                                                large_tree);
+    Huffman_tree_build(large_tree, large_entries);
+    assert(Huffman_tree_get_root(large_tree)->frequency > UINT32_MAX);
+    Array_T large_encoding = Huffman_tree_create_encoding_table(large_tree);
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        assert(((Encoded_value *)Array_get(large_encoding, i))->bit_length ==
+               ((Encoded_value *)Array_get(encoding, i))->bit_length);
+    Huffman_tree_free(&tree);
+    Huffman_tree_free(&large_tree);
+    Array_free(&entries);
+    Array_free(&large_entries);
+    printf("%s\n", "Passed");
+
+    /* A lone character still gets a one-bit code */
+    printf("%s", "   - Single character: ");
+    memset(freq_array, 0, sizeof(freq_array));
+    freq_array['z'] = 1000;
+    Canonical_code_lengths(freq_array, 12, lengths, NULL);
+    assert(lengths['z'] == 1);
+    assert(kraft_sum(lengths, 12) == (uint64_t)1 << 12);
+    printf("%s\n", "Passed");
+
+    /* Linear-time lengths cost as much as the lengths of a Huffman tree,
+     * for random frequencies with many ties and for Fibonacci ones */
+    printf("%s", "   - Linear-time lengths match Huffman tree: ");
+    srand(16);
+    for (int round = 0; round < 200; round++)
+    {
+        memset(freq_array, 0, sizeof(freq_array));
+        int num_chars = 2 + rand() % (MAX_NUM_CHAR - 1);
+        for (int i = 0; i < num_chars; i++)
+            freq_array[rand() % MAX_NUM_CHAR] = round % 2 ? (uint64_t)(1 + rand() % 5) :
+                                                (uint64_t)rand() << (rand() % 24);
+        if (round == 0)
+            memcpy(freq_array, skewed_fibonacci(), sizeof(freq_array));
+
+        int num_unique = 0;
+        for (int i = 0; i < MAX_NUM_CHAR; i++)
+            num_unique += freq_array[i] != 0;
+        unsigned longest = Canonical_optimal_lengths(freq_array, lengths);
+        if (num_unique == 1)
+            continue;
+
+        Huffman_Tree_T round_tree = Huffman_tree_new();
+        Array_T round_entries = create_unique_characters_freq_array(freq_array, num_unique,
+                                                                    round_tree);
+        Huffman_tree_build(round_tree, round_entries);
+        Array_T round_encoding = Huffman_tree_create_encoding_table(round_tree);
+        uint64_t tree_cost = 0, linear_cost = 0;
+        unsigned max_length = 0;
+        for (int i = 0; i < MAX_NUM_CHAR; i++)
+        {
+            assert((lengths[i] == 0) == (freq_array[i] == 0));
+            tree_cost += freq_array[i] *
+                         ((Encoded_value *)Array_get(round_encoding, i))->bit_length;
+            linear_cost += freq_array[i] * lengths[i];
+            if (lengths[i] > max_length)
+                max_length = lengths[i];
+        }
+        assert(linear_cost == tree_cost);
+        assert(longest == max_length);
+        assert(kraft_sum(lengths, max_length) == (uint64_t)1 << max_length);
+        Huffman_tree_free(&round_tree);
+        Array_free(&round_entries);
+    }
+    printf("%s\n", "Passed");
+
+    /* Packed lengths round trip */
+    printf("%s", "   - Pack and unpack lengths: ");
+    uint8_t packed[CANONICAL_PACKED_SIZE];
+    uint8_t unpacked[MAX_NUM_CHAR];
+    Canonical_code_lengths(sample_freq, 9, lengths, NULL);
+    Canonical_pack_lengths(lengths, packed);
+    Canonical_unpack_lengths(packed, unpacked);
+    assert(memcmp(lengths, unpacked, MAX_NUM_CHAR) == 0);
+    printf("%s\n", "Passed");
+
+    /* Canonical tree assigns consecutive codes in character order */
+    printf("%s", "   - Canonical codes: ");
+    tree = Huffman_tree_new();
+    Huffman_tree_build_canonical(tree, lengths);
+    encoding = Huffman_tree_create_encoding_table(tree);
+    Encoded_value last = {0, 0};
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+    {
+        Encoded_value *code = (Encoded_value *)Array_get(encoding, i);
+        if (lengths[i] == 0)
+            continue;
+        assert(code->bit_length == lengths[i]);
+        if (last.bit_length == code->bit_length)
+            assert(code->bit_value == last.bit_value + 1);
+        last = *code;
+    }
+    Huffman_tree_free(&tree);
+    printf("%s\n", "Passed");
+
+    /* Codes and decoding table built from the lengths alone match the tree */
+    printf("%s", "   - Codes and decoding table without a tree: ");
+    static Decoded_value table[CANONICAL_DECODING_TABLE_SIZE];
+    uint64_t skewed_freq[MAX_NUM_CHAR] = {0};
+    uint64_t fibonacci[2] = {1, 1};
+    for (int i = 0; i < 40; i++)
+    {
+        skewed_freq['A' + i] = fibonacci[i % 2];
+        fibonacci[i % 2] += fibonacci[1 - i % 2];
+    }
+    for (int round = 0; round < 2; round++)
+    {
+        // Lengths of the sample stay in the root table, skewed ones do not
+        if (round == 0)
+            Canonical_code_lengths(sample_freq, 9, lengths, NULL);
+        else
+            Canonical_code_lengths(skewed_freq, CANONICAL_MAX_CODE_LENGTH, lengths, NULL);
+
+        tree = Huffman_tree_new();
+        Huffman_tree_build_canonical(tree, lengths);
+        encoding = Huffman_tree_create_encoding_table(tree);
+        Encoded_value codes[MAX_NUM_CHAR];
+        Canonical_codes(lengths, codes);
+        unsigned root_bits = 0;
+        Canonical_decoding_table(lengths, table, &root_bits);
+        for (int i = 0; i < MAX_NUM_CHAR; i++)
+        {
+            if (lengths[i] == 0)
+                continue;
+            Encoded_value *code = (Encoded_value *)Array_get(encoding, i);
+            assert(codes[i].bit_length == code->bit_length);
+            assert(codes[i].bit_value == code->bit_value);
+
+            // Follow the code, padded with ones, through the table
+            uint64_t bits = ((code->bit_value + 1) << (32 - code->bit_length)) - 1;
+            unsigned used = 0;
+            Decoded_value entry = table[bits >> (32 - root_bits)];
+            while (entry.subtable_bits)
+            {
+                used += entry.bit_length;
+                entry = table[entry.subtable +
+                              (((bits << used) & 0xFFFFFFFF) >> (32 - entry.subtable_bits))];
+            }
+            assert(entry.symbol == i && used + entry.bit_length == lengths[i]);
+        }
+        Huffman_tree_free(&tree);
+    }
+    printf("%s\n", "Passed");
+
+    /* Symbols past a byte get lengths, codes and table entries as well */
+    printf("%s", "   - Alphabet larger than a byte: ");
+    static uint64_t alphabet_freq[CANONICAL_MAX_SYMBOLS];
+    static uint8_t alphabet_lengths[CANONICAL_MAX_SYMBOLS];
+    static uint8_t alphabet_packed[CANONICAL_MAX_SYMBOLS / 2];
+    static uint8_t alphabet_unpacked[CANONICAL_MAX_SYMBOLS];
+    static Encoded_value alphabet_codes[CANONICAL_MAX_SYMBOLS];
+    static Decoded_value alphabet_table[CANONICAL_ALPHABET_DECODING_TABLE_SIZE(
+                                        CANONICAL_MAX_SYMBOLS)];
+    for (int i = 0; i < CANONICAL_MAX_SYMBOLS; i++)
+        alphabet_freq[i] = i % 4 ? 1000000 / (i + 1) + 1 : 0;
+    for (unsigned max_length = 12; max_length <= CANONICAL_MAX_CODE_LENGTH; max_length += 3)
+    {
+        Canonical_alphabet_code_lengths(alphabet_freq, CANONICAL_MAX_SYMBOLS, max_length,
+                                        alphabet_lengths, NULL);
+        uint64_t sum = 0;
+        for (int i = 0; i < CANONICAL_MAX_SYMBOLS; i++)
+        {
+            assert((alphabet_lengths[i] == 0) == (alphabet_freq[i] == 0));
+            assert(alphabet_lengths[i] <= max_length);
+            if (alphabet_lengths[i])
+                sum += (uint64_t)1 << (max_length - alphabet_lengths[i]);
+        }
+        assert(sum == (uint64_t)1 << max_length);
+
+        Canonical_alphabet_pack_lengths(alphabet_lengths, CANONICAL_MAX_SYMBOLS,
+                                        alphabet_packed);
+        Canonical_alphabet_unpack_lengths(alphabet_packed, CANONICAL_MAX_SYMBOLS,
+                                          alphabet_unpacked);
+        assert(memcmp(alphabet_lengths, alphabet_unpacked, CANONICAL_MAX_SYMBOLS) == 0);
+
+        Canonical_alphabet_codes(alphabet_lengths, CANONICAL_MAX_SYMBOLS, alphabet_codes);
+        unsigned root_bits = 0;
+        Canonical_alphabet_decoding_table(alphabet_lengths, CANONICAL_MAX_SYMBOLS,
+                                          alphabet_table, &root_bits);
+        for (int i = 0; i < CANONICAL_MAX_SYMBOLS; i++)
+        {
+            if (alphabet_lengths[i] == 0)
+                continue;
+            Encoded_value code = alphabet_codes[i];
+            assert(code.bit_length == alphabet_lengths[i]);
+            uint64_t bits = ((code.bit_value + 1) << (32 - code.bit_length)) - 1;
+            unsigned used = 0;
+            Decoded_value entry = alphabet_table[bits >> (32 - root_bits)];
+            while (entry.subtable_bits)
+            {
+                used += entry.bit_length;
+                entry = alphabet_table[entry.subtable +
+                                       (((bits << used) & 0xFFFFFFFF) >>
+                                        (32 - entry.subtable_bits))];
+            }
+            assert(entry.symbol == i && used + entry.bit_length == alphabet_lengths[i]);
+        }
+    }
+    printf("%s\n", "Passed");
+
+    /* Lengths that over-subscribe the code space are rejected */
+    printf("%s", "   - Invalid lengths: ");
+    memset(lengths, 0, sizeof(lengths));
+    lengths['a'] = 1;
+    lengths['b'] = 1;
+    lengths['c'] = 1;
+    tree = Huffman_tree_new();
+    int raised = 0;
+    TRY
+        Huffman_tree_build_canonical(tree, lengths);
+    EXCEPT(Huffman_Invalid_Lengths)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    Huffman_tree_free(&tree);
+    raised = 0;
+    TRY
+        unsigned root_bits = 0;
+        Canonical_decoding_table(lengths, table, &root_bits);
+    EXCEPT(Huffman_Invalid_Lengths)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    printf("%s\n", "Passed");
+
+    /* Compress and decompress the sample file in canonical mode */
+    printf("%s", "   - Canonical round trip: ");
+    Canonical_code_lengths(sample_freq, 9, lengths, NULL);
+    tree = Huffman_tree_new();
+    Huffman_tree_build_canonical(tree, lengths);
+    encoding = Huffman_tree_create_encoding_table(tree);
+
+    FILE *compressed = tmpfile();
+    write_canonical_header(lengths, compressed);
+    write_total_num_bits(sample_freq, encoding, compressed);
+    write_body(encoding, infile, compressed);
+    Huffman_tree_free(&tree);
+    rewind(compressed);
+
+    uint8_t read_lengths[MAX_NUM_CHAR];
+    assert(read_canonical_header(read_lengths, compressed));
+    assert(memcmp(lengths, read_lengths, MAX_NUM_CHAR) == 0);
+    uint64_t total_num_bits = read_total_num_bits(compressed);
+    tree = Huffman_tree_new();
+    Huffman_tree_build_canonical(tree, read_lengths);
+
+    FILE *decompressed = tmpfile();
+    read_body(tree, total_num_bits, compressed, decompressed);
+    Huffman_tree_free(&tree);
+
+    rewind(infile);
+    rewind(decompressed);
+    int c;
+    while ((c = fgetc(infile)) != EOF)
+        assert(c == fgetc(decompressed));
+    assert(fgetc(decompressed) == EOF);
+    printf("%s\n", "Passed");
+
+    fclose(compressed);
+    fclose(decompressed);
+    fclose(infile);
+    free(sample_freq);
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
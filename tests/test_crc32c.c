@@ -0,0 +1,61 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_crc32c.c
+*
+*   Description: Test driver for CRC32C module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/crc32c.h"
+
+#define BUFFER_SIZE 300007
+
+int main() {
+    static uint8_t buffer[BUFFER_SIZE];
+
+    printf("%s", "   - Check value of \"123456789\": ");
+    const uint8_t *check = (const uint8_t *)"123456789";
+    assert(Crc32c_update(0, check, 9) == 0xE3069283u);
+    assert(Crc32c_update_portable(0, check, 9) == 0xE3069283u);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Accelerated and portable CRCs agree: ");
+    srand(24);
+    for (uint32_t i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = (uint8_t)rand();
+    static const size_t sizes[] = {1, 7, 8, 9, 63, 64, 1000, 65535, 65536, 65537,
+                                   200001, BUFFER_SIZE - 8};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        for (size_t offset = 0; offset < 8; offset++)
+            assert(Crc32c_update(0, buffer + offset, sizes[i]) ==
+                   Crc32c_update_portable(0, buffer + offset, sizes[i]));
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Updates in pieces give the CRC of the whole: ");
+    uint32_t whole = Crc32c_update(0, buffer, BUFFER_SIZE);
+    for (size_t split = 0; split < BUFFER_SIZE; split += 70001)
+    {
+        uint32_t crc = Crc32c_update(0, buffer, split);
+        assert(Crc32c_update(crc, buffer + split, BUFFER_SIZE - split) == whole);
+        crc = Crc32c_update_portable(0, buffer, split);
+        assert(Crc32c_update_portable(crc, buffer + split, BUFFER_SIZE - split) == whole);
+    }
+    assert(Crc32c_update(whole, buffer, 0) == whole);
+    assert(Crc32c_update(0, NULL, 0) == 0);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - A flipped bit changes the CRC: ");
+    buffer[BUFFER_SIZE / 2] ^= 0x10;
+    assert(Crc32c_update(0, buffer, BUFFER_SIZE) != whole);
+    assert(Crc32c_update_portable(0, buffer, BUFFER_SIZE) != whole);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
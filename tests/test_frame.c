@@ -0,0 +1,711 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_frame.c
+*
+*   Description: Test driver for block and frame modules
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include "../hanson/include/except.h"
+#include "../include/block.h"
+#include "../include/frame.h"
+
+static long round_trip_to(FILE *infile, FILE *compressed, FILE *decompressed,
+                          Frame_options options);
+
+// Gets compression options, which also give the number of decoding threads
+static Frame_options make_options(uint32_t block_size, unsigned max_code_length,
+                                  unsigned num_streams, unsigned num_threads)
+{
+    Frame_options options = Frame_default_options();
+    options.block_size = block_size;
+    options.max_code_length = max_code_length;
+    options.num_streams = num_streams;
+    options.num_threads = num_threads;
+    return options;
+}
+
+// Compresses then decompresses infile through temporary files and checks
+// the output matches. Returns the compressed size
+static long round_trip(FILE *infile, Frame_options options)
+{
+    FILE *compressed = tmpfile();
+    FILE *decompressed = tmpfile();
+    return round_trip_to(infile, compressed, decompressed, options);
+}
+
+// Same as round_trip, with the given temporary files
+static long round_trip_to(FILE *infile, FILE *compressed, FILE *decompressed,
+                          Frame_options options)
+{
+    assert(compressed && decompressed);
+
+    rewind(infile);
+    Frame_compress(infile, compressed, &options);
+    long compressed_size = ftell(compressed);
+
+    rewind(compressed);
+    char magic[FRAME_MAGIC_SIZE];
+    assert(fread(magic, 1, FRAME_MAGIC_SIZE, compressed) == FRAME_MAGIC_SIZE);
+    assert(memcmp(magic, FRAME_MAGIC, FRAME_MAGIC_SIZE) == 0);
+    Frame_decompress(compressed, decompressed, options.num_threads, 1, NULL);
+
+    rewind(infile);
+    rewind(decompressed);
+    int c;
+    while ((c = fgetc(infile)) != EOF)
+        assert(c == fgetc(decompressed));
+    assert(fgetc(decompressed) == EOF);
+
+    fclose(compressed);
+    fclose(decompressed);
+    return compressed_size;
+}
+
+// Decompresses compressed from its block size through a pipe when asked,
+// otherwise in place with num_threads. Returns 1 if a block does not
+// match its checksum, -1 if the output differs from expected
+static int decompress_checked(FILE *compressed, const uint8_t *expected, size_t size,
+                              unsigned num_threads, int verify, int through_pipe)
+{
+    FILE *volatile infile = compressed;
+    fseek(compressed, 0, SEEK_END);
+    long compressed_size = ftell(compressed);
+    fseek(compressed, FRAME_MAGIC_SIZE, SEEK_SET);
+    if (through_pipe)
+    {
+        // Small enough for the pipe to hold it all before it is read
+        int fds[2];
+        assert(pipe(fds) == 0);
+        for (long i = FRAME_MAGIC_SIZE; i < compressed_size; i++)
+        {
+            uint8_t byte = (uint8_t)fgetc(compressed);
+            assert(write(fds[1], &byte, 1) == 1);
+        }
+        close(fds[1]);
+        infile = fdopen(fds[0], "rb");
+        assert(infile);
+    }
+
+    FILE *decompressed = tmpfile();
+    volatile int result = 0;
+    TRY
+        Frame_decompress(infile, decompressed, num_threads, verify, NULL);
+    EXCEPT(Frame_Checksum_Failed)
+        result = 1;
+    END_TRY;
+    if (result == 0)
+    {
+        rewind(decompressed);
+        for (size_t i = 0; i < size; i++)
+            if (fgetc(decompressed) != expected[i])
+                result = -1;
+        if (fgetc(decompressed) != EOF)
+            result = -1;
+    }
+    if (through_pipe)
+        fclose(infile);
+    fclose(decompressed);
+    return result;
+}
+
+int main() {
+    FILE *sample = fopen("tests/utils_sample_test.txt", "rb");
+    assert(sample);
+
+    printf("%s", "   - Round trip with one block: ");
+    round_trip(sample, make_options(FRAME_MAX_BLOCK_SIZE, CANONICAL_MAX_CODE_LENGTH, 1, 1));
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with many small blocks: ");
+    round_trip(sample, make_options(FRAME_MIN_BLOCK_SIZE, CANONICAL_MIN_CODE_LENGTH, 4, 1));
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with 1, 4 and 8 streams: ");
+    for (unsigned num_streams = 1; num_streams <= 8; num_streams *= 2)
+    {
+        if (num_streams == 2)
+            continue;
+        round_trip(sample, make_options(3 * FRAME_MIN_BLOCK_SIZE + 5, 14, num_streams, 1));
+        round_trip(sample, make_options(3 * FRAME_MIN_BLOCK_SIZE + 5, 14, num_streams, 3));
+    }
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with context tables: ");
+    rewind(sample);
+    long single_size = round_trip(sample, make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, 4, 1));
+    for (unsigned num_streams = 1; num_streams <= 8; num_streams *= 2)
+    {
+        if (num_streams == 2)
+            continue;
+        Frame_options options = make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, num_streams, 2);
+        options.max_tables = BLOCK_MAX_TABLES;
+        assert(round_trip(sample, options) < single_size);
+        options = make_options(FRAME_MIN_BLOCK_SIZE, CANONICAL_MIN_CODE_LENGTH, num_streams, 3);
+        options.max_tables = 4;
+        round_trip(sample, options);
+    }
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with byte pairs: ");
+    for (unsigned num_streams = 1; num_streams <= 8; num_streams *= 2)
+    {
+        if (num_streams == 2)
+            continue;
+        Frame_options options = make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, num_streams, 2);
+        options.max_pairs = BLOCK_MAX_PAIRS;
+        assert(round_trip(sample, options) < single_size);
+        options = make_options(FRAME_MIN_BLOCK_SIZE * 64 + 1, CANONICAL_MIN_CODE_LENGTH,
+                               num_streams, 3);
+        long bytes_size = round_trip(sample, options);
+        options.max_pairs = 100;
+        assert(round_trip(sample, options) < bytes_size);
+        options.max_tables = BLOCK_MAX_TABLES;
+        round_trip(sample, options);
+    }
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with runs: ");
+    FILE *sparse = tmpfile();
+    assert(sparse);
+    srand(21);
+    for (int i = 0; i < 200; i++)
+    {
+        int run = rand() % 4 == 0 ? 300000 : rand() % 3000;
+        for (int j = 0; j < run; j++)
+            fputc(0, sparse);
+        for (int j = rand() % 500; j > 0; j--)
+            fputc(rand() % 256, sparse);
+    }
+    for (unsigned num_streams = 1; num_streams <= 8; num_streams *= 2)
+    {
+        if (num_streams == 2)
+            continue;
+        Frame_options options = make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, num_streams, 2);
+        long bytes_size = round_trip(sparse, options);
+        options.runs = 1;
+        assert(round_trip(sparse, options) < bytes_size / 10);
+        round_trip(sample, options);
+
+        // With codes of 8 bits, runs fit only beside a few bytes
+        options = make_options(FRAME_MIN_BLOCK_SIZE * 16 + 3, CANONICAL_MIN_CODE_LENGTH,
+                               num_streams, 3);
+        options.runs = 1;
+        round_trip(sparse, options);
+    }
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip with matches: ");
+    for (unsigned num_streams = 1; num_streams <= 8; num_streams *= 2)
+    {
+        if (num_streams == 2)
+            continue;
+        Frame_options options = make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, num_streams, 2);
+        options.match_level = LZ77_DEFAULT_LEVEL;
+        long matches_size = round_trip(sample, options);
+        assert(matches_size < single_size / 2);
+        options.match_level = LZ77_MAX_LEVEL;
+        assert(round_trip(sample, options) <= matches_size);
+        options.runs = 1;
+        round_trip(sparse, options);
+
+        // Small windows and short codes, and matches across few bytes
+        options = make_options(FRAME_MIN_BLOCK_SIZE * 16 + 3, CANONICAL_MIN_CODE_LENGTH,
+                               num_streams, 3);
+        options.match_level = LZ77_MIN_LEVEL;
+        options.window_bits = LZ77_MIN_WINDOW_BITS;
+        round_trip(sample, options);
+        round_trip(sparse, options);
+        options.max_pairs = 100;
+        options.max_tables = 4;
+        round_trip(sample, options);
+    }
+    fclose(sparse);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Output does not depend on number of threads: ");
+    FILE *outputs[3];
+    unsigned thread_counts[3] = {1, 4, 7};
+    for (int i = 0; i < 3; i++)
+    {
+        outputs[i] = tmpfile();
+        rewind(sample);
+        Frame_options options = make_options(2 * FRAME_MIN_BLOCK_SIZE, 13, 4,
+                                             thread_counts[i]);
+        Frame_compress(sample, outputs[i], &options);
+        rewind(outputs[i]);
+    }
+    int c;
+    while ((c = fgetc(outputs[0])) != EOF)
+    {
+        assert(c == fgetc(outputs[1]));
+        assert(c == fgetc(outputs[2]));
+    }
+    assert(fgetc(outputs[1]) == EOF && fgetc(outputs[2]) == EOF);
+    for (int i = 0; i < 3; i++)
+        fclose(outputs[i]);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Block index: ");
+    FILE *indexed = tmpfile();
+    rewind(sample);
+    Frame_options options = make_options(8 * FRAME_MIN_BLOCK_SIZE, 12, 4, 2);
+    Frame_compress(sample, indexed, &options);
+    long sample_size = ftell(sample);
+    uint64_t num_blocks = 0;
+    Frame_index_entry *index = Frame_read_index(indexed, &num_blocks);
+    assert(index);
+    assert(num_blocks == (uint64_t)(sample_size + 8 * FRAME_MIN_BLOCK_SIZE - 1) /
+                         (8 * FRAME_MIN_BLOCK_SIZE));
+    assert(index[0].offset == FRAME_MAGIC_SIZE + sizeof(uint32_t));
+    assert(index[num_blocks - 1].raw_offset + index[num_blocks - 1].raw_size ==
+           (uint64_t)sample_size);
+
+    // Blocks that do not follow each other make the index corrupted
+    fseek(indexed, -(long)(FRAME_FOOTER_SIZE + (num_blocks - 1) * sizeof(Frame_index_entry)),
+          SEEK_END);
+    uint64_t wrong_offset = 0;
+    fwrite(&wrong_offset, sizeof(uint64_t), 1, indexed);
+    volatile int index_corrupted = 0;
+    TRY
+        Frame_read_index(indexed, &num_blocks);
+    EXCEPT(Block_Corrupted)
+        index_corrupted = 1;
+    END_TRY;
+    assert(index_corrupted);
+    free(index);
+    fclose(indexed);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Ranges decode only the blocks covering them: ");
+    indexed = tmpfile();
+    options = make_options(FRAME_MIN_BLOCK_SIZE, 12, 4, 1);
+    rewind(sample);
+    Frame_compress(sample, indexed, &options);
+    static const uint64_t ranges[][3] = {
+        // offset, length, blocks covering them
+        {0, 100, 1}, {FRAME_MIN_BLOCK_SIZE - 10, 20, 2}, {3 * FRAME_MIN_BLOCK_SIZE, 0, 0},
+        {2 * FRAME_MIN_BLOCK_SIZE + 1, 3 * FRAME_MIN_BLOCK_SIZE, 4}
+    };
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]) + 2; i++)
+    {
+        // Then the end of the sample and past its end, clipped
+        uint64_t offset = i < 4 ? ranges[i][0] : (uint64_t)sample_size - 50 + (i - 4) * 100;
+        uint64_t length = i < 4 ? ranges[i][1] : 100;
+        uint64_t expected = offset + length <= (uint64_t)sample_size ? length :
+                            offset < (uint64_t)sample_size ? sample_size - offset : 0;
+        Stats range_stats;
+        Stats_init(&range_stats);
+        FILE *range = tmpfile();
+        fseek(indexed, FRAME_MAGIC_SIZE, SEEK_SET);
+        assert(Frame_decompress_range(indexed, range, offset, length, 1, &range_stats) ==
+               expected);
+        assert(ftell(range) == (long)expected && range_stats.bytes_out == expected);
+        if (i < 4)
+            assert(range_stats.num_blocks == ranges[i][2]);
+        rewind(range);
+        fseek(sample, (long)offset, SEEK_SET);
+        for (uint64_t j = 0; j < expected; j++)
+            assert(fgetc(range) == fgetc(sample));
+        fclose(range);
+    }
+
+    // Pipes have no index to find blocks
+    int fds[2];
+    assert(pipe(fds) == 0);
+    uint32_t pipe_block_size = FRAME_MIN_BLOCK_SIZE;
+    assert(write(fds[1], &pipe_block_size, sizeof(uint32_t)) == sizeof(uint32_t));
+    close(fds[1]);
+    FILE *pipe_end = fdopen(fds[0], "rb");
+    volatile int no_index = 0;
+    TRY
+        Frame_decompress_range(pipe_end, indexed, 0, 10, 1, NULL);
+    EXCEPT(Frame_No_Index)
+        no_index = 1;
+    END_TRY;
+    assert(no_index);
+    fclose(pipe_end);
+    fclose(indexed);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Parallel decompression at block offsets: ");
+    round_trip(sample, make_options(2 * FRAME_MIN_BLOCK_SIZE, 12, 8, 6));
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Parallel decompression to appending file: ");
+    char appended_name[] = "/tmp/test_frame_XXXXXX";
+    int appended_fd = mkstemp(appended_name);
+    assert(appended_fd >= 0);
+    FILE *appended = fdopen(appended_fd, "a+b");
+    round_trip_to(sample, tmpfile(), appended, make_options(3 * FRAME_MIN_BLOCK_SIZE, 12, 4, 3));
+    remove(appended_name);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip of empty input: ");
+    FILE *empty = tmpfile();
+    long empty_size = round_trip(empty, make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, 4, 3));
+    assert(empty_size == FRAME_MAGIC_SIZE + 2 * sizeof(uint32_t) + FRAME_FOOTER_SIZE);
+    fclose(empty);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip of binary input: ");
+    FILE *binary = tmpfile();
+    srand(149);
+    for (int i = 0; i < 100000; i++)
+        fputc((i % 7) ? rand() % 256 : 0, binary);
+    round_trip(binary, make_options(4 * FRAME_MIN_BLOCK_SIZE, 11, 4, 5));
+    fclose(binary);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Single character block: ");
+    static uint64_t workspace[BLOCK_WORKSPACE_SIZE / sizeof(uint64_t)];
+    uint8_t raw[3000];
+    uint8_t encoded[4096];
+    uint8_t decoded[3000];
+    Block_header header;
+    Block_options block_options = {12, 1, 1, 0, 0, 0, LZ77_DEFAULT_WINDOW_BITS};
+    memset(raw, 'x', sizeof(raw));
+    size_t encoded_size = Block_encode(raw, sizeof(raw), &block_options, encoded, workspace, NULL);
+    assert(encoded_size <= Block_bound(sizeof(raw), 12));
+    Block_read_header(encoded, &header);
+    assert(header.raw_size == sizeof(raw));
+    assert(header.coding == BLOCK_FILLED && header.fill_byte == 'x');
+    assert(header.num_bits == 0 && header.jump_table_size == 0 && header.payload_size == 0);
+    assert(encoded_size == BLOCK_PREFIX_SIZE + 1 && header.header_size == encoded_size);
+    Block_read_jump_table(encoded + header.header_size, &header);
+    Block_decode(&header, encoded + header.header_size, decoded, workspace, NULL);
+    assert(memcmp(raw, decoded, sizeof(raw)) == 0);
+
+    // No block has a mode past BLOCK_FILLED
+    encoded[sizeof(uint32_t)] = BLOCK_FILLED + 1;
+    volatile int corrupted = 0;
+    TRY
+        Block_read_header(encoded, &header);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Blocks stored when codes do not pay off: ");
+    // Fewer characters than streams take more bytes with their jump table
+    block_options.num_streams = 8;
+    encoded_size = Block_encode((const uint8_t *)"abc", 3, &block_options, encoded, workspace, NULL);
+    assert(encoded_size <= Block_bound(3, 12));
+    assert(encoded_size == BLOCK_PREFIX_SIZE + 3);
+    Block_read_header(encoded, &header);
+    assert(header.coding == BLOCK_STORED && header.payload_size == 3);
+    Block_read_jump_table(encoded + header.header_size, &header);
+    assert(header.jump_table_size == 0);
+    Block_decode(&header, encoded + header.header_size, decoded, workspace, NULL);
+    assert(memcmp(decoded, "abc", 3) == 0);
+
+    // So do random bytes, whatever the codes allowed
+    uint8_t noise[3000];
+    srand(23);
+    for (size_t i = 0; i < sizeof(noise); i++)
+        noise[i] = (uint8_t)rand();
+    Block_options all_options = {12, 4, BLOCK_MAX_TABLES, BLOCK_MAX_PAIRS, 1, 0,
+                                 LZ77_DEFAULT_WINDOW_BITS};
+    encoded_size = Block_encode(noise, sizeof(noise), &all_options, encoded, workspace, NULL);
+    assert(encoded_size == BLOCK_PREFIX_SIZE + sizeof(noise));
+    assert(encoded_size <= Block_bound(sizeof(noise), 12));
+    Block_read_header(encoded, &header);
+    assert(header.coding == BLOCK_STORED && header.num_bits == 0);
+    Block_decode(&header, encoded + header.header_size, decoded, workspace, NULL);
+    assert(memcmp(noise, decoded, sizeof(noise)) == 0);
+
+    // A stored block has bytes to copy
+    uint32_t raw_size = 0;
+    memcpy(encoded, &raw_size, sizeof(uint32_t));
+    corrupted = 0;
+    TRY
+        Block_read_header(encoded, &header);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Inconsistent jump table raises Block_Corrupted: ");
+    // A last byte of its own makes the block coded
+    raw[sizeof(raw) - 1] = 'y';
+    block_options.num_streams = 4;
+    encoded_size = Block_encode(raw, sizeof(raw), &block_options, encoded, workspace, NULL);
+    Block_read_header(encoded, &header);
+    uint32_t too_many_bits = header.num_bits + 1;
+    assert(header.coding == BLOCK_CODED);
+    memcpy(encoded + BLOCK_HEADER_SIZE, &too_many_bits, sizeof(uint32_t));
+    corrupted = 0;
+    TRY
+        Block_read_jump_table(encoded + BLOCK_HEADER_SIZE, &header);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Context tables only when they take fewer bits: ");
+    block_options.max_tables = BLOCK_MAX_TABLES;
+    encoded_size = Block_encode(raw, sizeof(raw), &block_options, encoded, workspace, NULL);
+    Block_read_header(encoded, &header);
+    assert(header.num_tables == 1);
+
+    // Every letter is followed by a single other one, while a single
+    // table needs about 5 bits for each. Tables are shared by letters,
+    // which take 2 bits on average
+    static uint8_t text[1 << 16], text_encoded[1 << 17], text_decoded[1 << 16];
+    for (size_t i = 0; i < sizeof(text); i++)
+        text[i] = (uint8_t)('a' + (i * 7) % 26);
+    encoded_size = Block_encode(text, sizeof(text), &block_options, text_encoded,
+                                workspace, NULL);
+    assert(encoded_size <= Block_bound(sizeof(text), 12));
+    assert(encoded_size < sizeof(text) / 3);
+    Block_read_header(text_encoded, &header);
+    assert(header.num_tables > 1 && header.num_bits < 3 * sizeof(text));
+    assert(header.jump_table_size == 3 * sizeof(uint32_t) +
+                                     header.num_tables * CANONICAL_PACKED_SIZE);
+    Block_read_jump_table(text_encoded + BLOCK_HEADER_SIZE, &header);
+    Block_decode(&header, text_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                 text_decoded, workspace, NULL);
+    assert(memcmp(text, text_decoded, sizeof(text)) == 0);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Codes longer than a root table raise Block_Corrupted: ");
+    text_encoded[BLOCK_HEADER_SIZE + 3 * sizeof(uint32_t) + CANONICAL_PACKED_SIZE] = 0xFF;
+    corrupted = 0;
+    TRY
+        Block_read_jump_table(text_encoded + BLOCK_HEADER_SIZE, &header);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Byte pairs only when they take fewer bits: ");
+    block_options.max_tables = 1;
+    block_options.max_pairs = BLOCK_MAX_PAIRS;
+    encoded_size = Block_encode(raw, sizeof(raw), &block_options, encoded, workspace, NULL);
+    Block_read_header(encoded, &header);
+    assert(header.num_pairs == 0);
+
+    // Pairs of letters take about as many bits as letters alone did, for
+    // half as many symbols
+    static uint8_t pairs_encoded[1 << 17];
+    encoded_size = Block_encode(text, sizeof(text), &block_options, pairs_encoded,
+                                workspace, NULL);
+    assert(encoded_size <= Block_bound(sizeof(text), 12));
+    assert(encoded_size < sizeof(text) / 3);
+    Block_read_header(pairs_encoded, &header);
+    assert(header.num_pairs == BLOCK_PAIR_PAGE && header.num_tables == 1);
+    assert(header.jump_table_size == 3 * sizeof(uint32_t) + BLOCK_PAIR_PAGE_SIZE);
+    Block_read_jump_table(pairs_encoded + BLOCK_HEADER_SIZE, &header);
+    memset(text_decoded, 0, sizeof(text_decoded));
+    Block_decode(&header, pairs_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                 text_decoded, workspace, NULL);
+    assert(memcmp(text, text_decoded, sizeof(text)) == 0);
+
+    // The last pair would run past a block one byte shorter
+    header.raw_size--;
+    corrupted = 0;
+    TRY
+        Block_decode(&header, pairs_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                     text_decoded, workspace, NULL);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Runs only when they take fewer bits: ");
+    block_options.max_pairs = 0;
+    block_options.runs = 1;
+    encoded_size = Block_encode(text, sizeof(text), &block_options, text_encoded,
+                                workspace, NULL);
+    Block_read_header(text_encoded, &header);
+    assert(header.num_run_symbols == 0);
+
+    // The block is its first byte, a run and the last bytes, which no run
+    // covers, a word in each stream
+    encoded_size = Block_encode(raw, sizeof(raw), &block_options, encoded, workspace, NULL);
+    assert(encoded_size == BLOCK_HEADER_SIZE + 3 * sizeof(uint32_t) +
+                          BLOCK_RUN_SYMBOLS / 2 + 4 * sizeof(uint64_t));
+    Block_read_header(encoded, &header);
+    assert(header.num_run_symbols == BLOCK_RUN_SYMBOLS && header.num_pairs == 0);
+    assert(header.jump_table_size == 3 * sizeof(uint32_t) + BLOCK_RUN_SYMBOLS / 2);
+    Block_read_jump_table(encoded + BLOCK_HEADER_SIZE, &header);
+    memset(decoded, 0, sizeof(decoded));
+    Block_decode(&header, encoded + BLOCK_HEADER_SIZE + header.jump_table_size, decoded,
+                 workspace, NULL);
+    assert(memcmp(raw, decoded, sizeof(raw)) == 0);
+
+    // The run would cover the end of a shorter block
+    header.raw_size = 100;
+    corrupted = 0;
+    TRY
+        Block_decode(&header, encoded + BLOCK_HEADER_SIZE + header.jump_table_size, decoded,
+                     workspace, NULL);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Matches only when they take fewer bits: ");
+    block_options.runs = 0;
+    block_options.match_level = LZ77_DEFAULT_LEVEL;
+    void *match_workspace = malloc(Block_workspace_size(sizeof(text), &block_options));
+    assert(match_workspace);
+    Block_encode(noise, sizeof(noise), &block_options, encoded, match_workspace, NULL);
+    Block_read_header(encoded, &header);
+    assert(header.num_distance_symbols == 0 && header.num_run_symbols == 0);
+
+    // The text repeats its first 26 letters, a single match after them
+    encoded_size = Block_encode(text, sizeof(text), &block_options, text_encoded,
+                                match_workspace, NULL);
+    assert(encoded_size < 300);
+    assert(text_encoded[BLOCK_PREFIX_SIZE + sizeof(uint32_t)] == block_options.num_streams << 4);
+    Block_read_header(text_encoded, &header);
+    assert(header.num_streams == block_options.num_streams && header.num_tables == 1);
+    assert(header.num_run_symbols == BLOCK_RUN_SYMBOLS &&
+           header.num_distance_symbols == BLOCK_DISTANCE_SYMBOLS);
+    assert(header.jump_table_size == 3 * sizeof(uint32_t) + BLOCK_RUN_SYMBOLS / 2 +
+                                     BLOCK_DISTANCE_SYMBOLS / 2);
+    Block_read_jump_table(text_encoded + BLOCK_HEADER_SIZE, &header);
+    memset(text_decoded, 0, sizeof(text_decoded));
+    Block_decode(&header, text_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                 text_decoded, workspace, NULL);
+    assert(memcmp(text, text_decoded, sizeof(text)) == 0);
+
+    // The match would cover the end of a shorter block
+    Block_header shorter = header;
+    shorter.raw_size = 1000;
+    corrupted = 0;
+    TRY
+        Block_decode(&shorter, text_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                     text_decoded, workspace, NULL);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+
+    // Distance 26 is in class 4, which moved to class 20 reaches before
+    // the block
+    assert(header.distance_lengths[4] > 0 && header.distance_lengths[20] == 0);
+    header.distance_lengths[20] = header.distance_lengths[4];
+    header.distance_lengths[4] = 0;
+    corrupted = 0;
+    TRY
+        Block_decode(&header, text_encoded + BLOCK_HEADER_SIZE + header.jump_table_size,
+                     text_decoded, workspace, NULL);
+    EXCEPT(Block_Corrupted)
+        corrupted = 1;
+    END_TRY;
+    assert(corrupted);
+    free(match_workspace);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Truncated input raises Block_Corrupted: ");
+    FILE *compressed = tmpfile();
+    rewind(sample);
+    options = make_options(FRAME_DEFAULT_BLOCK_SIZE, 12, 4, 1);
+    Frame_compress(sample, compressed, &options);
+    long size = ftell(compressed);
+    FILE *truncated = tmpfile();
+    rewind(compressed);
+    for (long i = 0; i < size / 2; i++)
+        fputc(fgetc(compressed), truncated);
+    rewind(truncated);
+    fseek(truncated, FRAME_MAGIC_SIZE, SEEK_SET);
+
+    FILE *decompressed = tmpfile();
+    volatile int raised = 0;
+    TRY
+        Frame_decompress(truncated, decompressed, 4, 1, NULL);
+    EXCEPT(Block_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    fclose(compressed);
+    fclose(truncated);
+    fclose(decompressed);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Checksums catch corrupted blocks: ");
+    // Random bytes are stored as they are, so a flipped byte still decodes
+    FILE *noise_file = tmpfile();
+    assert(fwrite(noise, 1, sizeof(noise), noise_file) == sizeof(noise));
+    options = make_options(FRAME_MIN_BLOCK_SIZE, 12, 4, 1);
+    options.checksums = 0;
+    long unchecked_size = round_trip(noise_file, options);
+    options.checksums = 1;
+    assert(round_trip(noise_file, options) == unchecked_size + (long)(3 * FRAME_CHECKSUM_SIZE));
+    options.num_threads = 2;
+    round_trip(noise_file, options);
+
+    compressed = tmpfile();
+    rewind(noise_file);
+    Frame_compress(noise_file, compressed, &options);
+    index = Frame_read_index(compressed, &num_blocks);
+    assert(index && num_blocks == 3);
+    assert(index[1].size == BLOCK_PREFIX_SIZE + FRAME_MIN_BLOCK_SIZE + FRAME_CHECKSUM_SIZE);
+    for (unsigned through_pipe = 0; through_pipe <= 1; through_pipe++)
+        for (unsigned num_threads = 1; num_threads <= 2; num_threads++)
+            assert(decompress_checked(compressed, noise, sizeof(noise), num_threads, 1,
+                                      through_pipe) == 0);
+    fseek(compressed, (long)index[1].offset + BLOCK_HEADER_SIZE + 10, SEEK_SET);
+    fputc(noise[FRAME_MIN_BLOCK_SIZE + 10] ^ 1, compressed);
+    for (unsigned through_pipe = 0; through_pipe <= 1; through_pipe++)
+        for (unsigned num_threads = 1; num_threads <= 2; num_threads++)
+        {
+            assert(decompress_checked(compressed, noise, sizeof(noise), num_threads, 1,
+                                      through_pipe) == 1);
+            assert(decompress_checked(compressed, noise, sizeof(noise), num_threads, 0,
+                                      through_pipe) == -1);
+        }
+    free(index);
+    fclose(compressed);
+    fclose(noise_file);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Stats count bytes, blocks and codes: ");
+    Stats stats;
+    Stats_init(&stats);
+    options = make_options(2 * FRAME_MIN_BLOCK_SIZE, 12, 4, 3);
+    options.stats = &stats;
+    compressed = tmpfile();
+    rewind(sample);
+    Frame_compress(sample, compressed, &options);
+    fseek(sample, 0, SEEK_END);
+    uint64_t total_size = (uint64_t)ftell(sample);
+    assert(stats.bytes_in == total_size);
+    assert(stats.bytes_out == (uint64_t)ftell(compressed));
+    assert(stats.num_blocks == (total_size + 2 * FRAME_MIN_BLOCK_SIZE - 1) /
+                               (2 * FRAME_MIN_BLOCK_SIZE));
+    assert(stats.max_code_length > 0 && stats.max_code_length <= 12);
+    assert(stats.block_entropy_bits <= (double)stats.code_bits);
+    assert(stats.code_bits <= stats.num_words * 64);
+
+    Stats_init(&stats);
+    decompressed = tmpfile();
+    fseek(compressed, FRAME_MAGIC_SIZE, SEEK_SET);
+    Frame_decompress(compressed, decompressed, 2, 1, &stats);
+    assert(stats.bytes_out == total_size);
+    assert(stats.num_blocks == (total_size + 2 * FRAME_MIN_BLOCK_SIZE - 1) /
+                               (2 * FRAME_MIN_BLOCK_SIZE));
+    assert(stats.phase_seconds[STATS_DECODE] > 0);
+    fclose(compressed);
+    fclose(decompressed);
+    printf("%s\n", "Passed");
+
+    fclose(sample);
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
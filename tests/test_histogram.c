@@ -0,0 +1,70 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_histogram.c
+*
+*   Description: Test driver for histogram module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/histogram.h"
+
+#define BUFFER_SIZE 100003
+
+// Counts src one byte at a time and checks both kernels agree with it
+static void check_counts(const uint8_t *src, size_t size)
+{
+    uint64_t expected[HISTOGRAM_SIZE] = {0};
+    uint64_t portable[HISTOGRAM_SIZE] = {0};
+    uint64_t counts[HISTOGRAM_SIZE] = {0};
+    for (size_t i = 0; i < size; i++)
+        expected[src[i]]++;
+    Histogram_count_portable(src, size, portable);
+    Histogram_count(src, size, counts);
+    assert(memcmp(expected, portable, sizeof(expected)) == 0);
+    assert(memcmp(expected, counts, sizeof(expected)) == 0);
+}
+
+int main() {
+    static uint8_t buffer[BUFFER_SIZE];
+
+    printf("%s", "   - Count random bytes: ");
+    srand(8);
+    for (int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = rand() % 256;
+    check_counts(buffer, BUFFER_SIZE);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Count runs of the same byte: ");
+    for (int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = (i / 1000) % 3 ? 0 : (uint8_t)(i % 7);
+    check_counts(buffer, BUFFER_SIZE);
+    memset(buffer, 0xff, BUFFER_SIZE);
+    check_counts(buffer, BUFFER_SIZE);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Count short and unaligned buffers: ");
+    for (int i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = (uint8_t)(i * 31);
+    for (size_t size = 0; size < 70; size++)
+        check_counts(buffer + 3, size);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Counts add up over calls: ");
+    uint64_t counts[HISTOGRAM_SIZE] = {0};
+    Histogram_count(buffer, 1000, counts);
+    Histogram_count(buffer + 1000, 1000, counts);
+    uint64_t total = 0;
+    for (int c = 0; c < HISTOGRAM_SIZE; c++)
+        total += counts[c];
+    assert(total == 2000);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
@@ -0,0 +1,188 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_huffman.c
+*
+*   Description: Test driver for huffman module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../hanson/include/except.h"
+#include "../include/huffman.h"
+#include "../include/frame.h"
+
+#define LARGE_SIZE (FRAME_DEFAULT_BLOCK_SIZE * 2 + 12345)
+
+static uint64_t workspace[HUFFMAN_COMPRESS_WORKSPACE_SIZE / sizeof(uint64_t)];
+static uint64_t decode_workspace[HUFFMAN_DECOMPRESS_WORKSPACE_SIZE / sizeof(uint64_t)];
+
+// Compresses then decompresses size bytes of src and checks the output
+// matches. Returns the compressed size
+static size_t round_trip(const uint8_t *src, size_t size)
+{
+    size_t bound = Huffman_compress_bound(size);
+    uint8_t *compressed = malloc(bound);
+    uint8_t *decompressed = malloc(size + 1);
+    assert(compressed && decompressed);
+
+    size_t compressed_size = Huffman_compress(src, size, compressed, bound, workspace);
+    assert(compressed_size <= bound);
+    size_t decompressed_size = Huffman_decompress(compressed, compressed_size,
+                                                  decompressed, size + 1, decode_workspace);
+    assert(decompressed_size == size);
+    assert(size == 0 || memcmp(src, decompressed, size) == 0);
+
+    free(compressed);
+    free(decompressed);
+    return compressed_size;
+}
+
+int main() {
+    static uint8_t buffer[LARGE_SIZE];
+    srand(12);
+    for (int i = 0; i < LARGE_SIZE; i++)
+        buffer[i] = "aaaabbbccd\n"[rand() % 11];
+
+    printf("%s", "   - Round trip of empty and tiny buffers: ");
+    assert(round_trip(buffer, 0) == HUFFMAN_SINGLE_MAGIC_SIZE + sizeof(uint32_t));
+    round_trip(buffer, 1);
+    round_trip(buffer, 100);
+    assert(round_trip(buffer, 100000) < 100000 / 2);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Round trip over several blocks: ");
+    size_t compressed_size = round_trip(buffer, LARGE_SIZE);
+    assert(compressed_size < LARGE_SIZE / 2);
+    for (int i = 0; i < LARGE_SIZE; i++)
+        buffer[i] = rand() % 256;
+    round_trip(buffer, LARGE_SIZE);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Incompressible small buffers grow by a few bytes: ");
+    static const size_t small_sizes[] = {1, 8, 64, 1000, FRAME_DEFAULT_BLOCK_SIZE};
+    for (size_t i = 0; i < sizeof(small_sizes) / sizeof(small_sizes[0]); i++)
+        assert(round_trip(buffer, small_sizes[i]) ==
+               HUFFMAN_SINGLE_MAGIC_SIZE + BLOCK_PREFIX_SIZE + small_sizes[i]);
+    memset(buffer + LARGE_SIZE - 64, 'x', 64);
+    assert(round_trip(buffer + LARGE_SIZE - 64, 64) ==
+           HUFFMAN_SINGLE_MAGIC_SIZE + BLOCK_PREFIX_SIZE + 1);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Output too small is reported: ");
+    static uint8_t compressed[LARGE_SIZE];
+    volatile int raised = 0;
+    TRY
+        Huffman_compress(buffer, 5000, compressed, 1000, workspace);
+    EXCEPT(Huffman_Output_Too_Small)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    size_t size = Huffman_compress(buffer, 5000, compressed, sizeof(compressed), workspace);
+    raised = 0;
+    TRY
+        Huffman_decompress(compressed, size, buffer + 5000, 4999, decode_workspace);
+    EXCEPT(Huffman_Output_Too_Small)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Truncated or corrupted input is rejected: ");
+    for (volatile size_t cut = 0; cut < size; cut += 97)
+    {
+        raised = 0;
+        TRY
+            Huffman_decompress(compressed, cut, buffer + 5000, 5000, decode_workspace);
+        EXCEPT(Block_Corrupted)
+            raised = 1;
+        END_TRY;
+        assert(raised);
+    }
+    raised = 0;
+    TRY
+        Huffman_decompress(compressed, size + 1, buffer + 5000, 5000, decode_workspace);
+    EXCEPT(Block_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    compressed[0] = 'X';
+    raised = 0;
+    TRY
+        Huffman_decompress(compressed, size, buffer + 5000, 5000, decode_workspace);
+    EXCEPT(Block_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+
+    // Code lengths that do not form a prefix code are corrupted input
+    static uint8_t text[5000];
+    for (size_t i = 0; i < sizeof(text); i++)
+        text[i] = (uint8_t)("aaaabbc"[i % 7]);
+    size = Huffman_compress(text, sizeof(text), compressed, sizeof(compressed), workspace);
+    memset(compressed + HUFFMAN_SINGLE_MAGIC_SIZE + BLOCK_HEADER_SIZE - CANONICAL_PACKED_SIZE,
+           0x11, CANONICAL_PACKED_SIZE);
+    raised = 0;
+    TRY
+        Huffman_decompress(compressed, size, buffer + 5000, 5000, decode_workspace);
+    EXCEPT(Block_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Buffers of several blocks and files share one format: ");
+    size_t bound = Huffman_compress_bound(LARGE_SIZE);
+    uint8_t *large = malloc(bound);
+    assert(large);
+    size = Huffman_compress(buffer, LARGE_SIZE, large, bound, workspace);
+    assert(memcmp(large, FRAME_MAGIC, FRAME_MAGIC_SIZE) == 0);
+    FILE *infile = tmpfile();
+    FILE *outfile = tmpfile();
+    assert(infile && outfile);
+    fwrite(large, 1, size, infile);
+    fseek(infile, FRAME_MAGIC_SIZE, SEEK_SET);
+    Frame_decompress(infile, outfile, 1, 1, NULL);
+    assert(ftell(outfile) == LARGE_SIZE);
+    rewind(outfile);
+    assert(fread(large, 1, LARGE_SIZE, outfile) == LARGE_SIZE);
+    assert(memcmp(large, buffer, LARGE_SIZE) == 0);
+    free(large);
+    static uint8_t decoded[5000];
+
+    // A compressed file, with its block index, decodes from memory
+    FILE *raw = tmpfile();
+    assert(raw);
+    fwrite(buffer, 1, 5000, raw);
+    rewind(raw);
+    rewind(outfile);
+    Frame_options options = Frame_default_options();
+    Frame_compress(raw, outfile, &options);
+    long file_size = ftell(outfile);
+    rewind(outfile);
+    assert(fread(compressed, 1, file_size, outfile) == (size_t)file_size);
+    assert(Huffman_decompress(compressed, file_size, decoded, 5000, decode_workspace) == 5000);
+    assert(memcmp(decoded, buffer, 5000) == 0);
+
+    // Its single block is checked against the checksum before the end marker
+    compressed[file_size - FRAME_FOOTER_SIZE - sizeof(Frame_index_entry) -
+               sizeof(uint32_t) - FRAME_CHECKSUM_SIZE] ^= 1;
+    raised = 0;
+    TRY
+        Huffman_decompress(compressed, file_size, decoded, 5000, decode_workspace);
+    EXCEPT(Block_Corrupted)
+        raised = 1;
+    END_TRY;
+    assert(raised);
+    fclose(raw);
+    fclose(infile);
+    fclose(outfile);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
@@ -11,64 +11,46 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <assert.h>
 #include "../hanson/include/array.h"
 #include "../include/huffman_tree.h"
 #include "../include/priority_queue.h"
 
+static void test_decoding_table();
+static void test_clear();
+static void test_layout();
+
 int main()
 {
+    Huffman_Tree_T a = Huffman_tree_new();
     Array_T array = Array_new(6, sizeof(Node));
     Node *node_1 = malloc(sizeof(Node));
-    Huffman_node *obj_1 = malloc(sizeof(Huffman_node));
-    obj_1->frequency = 10;
-    obj_1->key = 'a';
-    obj_1->left_node = NULL;
-    obj_1->right_node = NULL;
+    Huffman_node *obj_1 = Huffman_tree_new_leaf(a, 'a', 10);
     node_1->value = 10;
     node_1->obj = obj_1;
 
     Node *node_2 = malloc(sizeof(Node));
-    Huffman_node *obj_2 = malloc(sizeof(Huffman_node));
-    obj_2->frequency = 30;
-    obj_2->key = 'b';
-    obj_2->left_node = NULL;
-    obj_2->right_node = NULL;
+    Huffman_node *obj_2 = Huffman_tree_new_leaf(a, 'b', 30);
     node_2->value = 30;
     node_2->obj = obj_2;
 
     Node *node_3 = malloc(sizeof(Node));
-    Huffman_node *obj_3 = malloc(sizeof(Huffman_node));
-    obj_3->frequency = 12;
-    obj_3->key = 'c';
-    obj_3->left_node = NULL;
-    obj_3->right_node = NULL;
+    Huffman_node *obj_3 = Huffman_tree_new_leaf(a, 'c', 12);
     node_3->value = 12;
     node_3->obj = obj_3;
 
     Node *node_4 = malloc(sizeof(Node));
-    Huffman_node *obj_4 = malloc(sizeof(Huffman_node));
-    obj_4->frequency = 3;
-    obj_4->key = 'd';
-    obj_4->left_node = NULL;
-    obj_4->right_node = NULL;
+    Huffman_node *obj_4 = Huffman_tree_new_leaf(a, 'd', 3);
     node_4->value = 3;
     node_4->obj = obj_4;
 
     Node *node_5 = malloc(sizeof(Node));
-    Huffman_node *obj_5 = malloc(sizeof(Huffman_node));
-    obj_5->frequency = 1;
-    obj_5->key = 'e';
-    obj_5->left_node = NULL;
-    obj_5->right_node = NULL;
+    Huffman_node *obj_5 = Huffman_tree_new_leaf(a, 'e', 1);
     node_5->value = 1;
     node_5->obj = obj_5;
 
     Node *node_6 = malloc(sizeof(Node));
-    Huffman_node *obj_6 = malloc(sizeof(Huffman_node));
-    obj_6->frequency = 120;
-    obj_6->key = 'f';
-    obj_6->left_node = NULL;
-    obj_6->right_node = NULL;
+    Huffman_node *obj_6 = Huffman_tree_new_leaf(a, 'f', 120);
     node_6->value = 120;
     node_6->obj = obj_6;
 
@@ -79,7 +61,6 @@ int main()
     Array_put(array, 4, node_5);
     Array_put(array, 5, node_6);
 
-    Huffman_Tree_T a = Huffman_tree_new();
     Huffman_tree_build(a, array);
     Array_T encoding = Huffman_tree_create_encoding_table(a);
 
@@ -97,7 +78,7 @@ int main()
     printf("Obj 6's value in encoding table: %"PRIu64" \n", test_6->bit_value);
 
     Huffman_node *root = Huffman_tree_get_root(a);
-    printf("Root frequency: %d\n", root->frequency);
+    printf("Root frequency: %"PRIu64"\n", root->frequency);
 
     Huffman_tree_free(&a);
     Array_free(&array);
@@ -108,5 +89,146 @@ int main()
     free(node_5);
     free(node_6);
 
+    test_decoding_table();
+    test_clear();
+    test_layout();
     return 0;
 }
+
+/*
+ * Builds a tree from Fibonacci frequencies, whose codes are deep enough to
+ * need chained sub-tables, and checks every code decodes to its character
+ */
+static void test_decoding_table()
+{
+    const int NUM_KEYS = 30;
+    printf("%s", "Decoding table with Fibonacci frequencies: ");
+
+    Huffman_Tree_T fib_tree = Huffman_tree_new();
+    Array_T fib_array = Array_new(NUM_KEYS, sizeof(Node));
+    int prev = 1, curr = 1;
+    for (int i = 0; i < NUM_KEYS; i++)
+    {
+        Node node = {Huffman_tree_new_leaf(fib_tree, (char)(200 + i), curr), curr};
+        Array_put(fib_array, i, &node);
+
+        int next = prev + curr;
+        prev = curr;
+        curr = next;
+    }
+
+    Huffman_tree_build(fib_tree, fib_array);
+    Array_T encoding = Huffman_tree_create_encoding_table(fib_tree);
+
+    unsigned root_bits = 0;
+    Decoded_value *table = Huffman_tree_create_decoding_table(fib_tree, &root_bits);
+    assert(root_bits == DECODING_TABLE_BITS);
+
+    for (int i = 0; i < NUM_KEYS; i++)
+    {
+        Encoded_value *code = (Encoded_value *)Array_get(encoding, 200 + i);
+        assert(code->bit_length > 0 && code->bit_length < 64);
+
+        // Walk the tables with the code left-aligned in a 64-bit window
+        uint64_t window = code->bit_value << (64 - code->bit_length);
+        unsigned consumed = 0;
+        Decoded_value entry = table[window >> (64 - root_bits)];
+        while (entry.subtable_bits)
+        {
+            window <<= entry.bit_length;
+            consumed += entry.bit_length;
+            entry = table[entry.subtable + (window >> (64 - entry.subtable_bits))];
+        }
+        consumed += entry.bit_length;
+
+        assert(entry.symbol == 200 + i);
+        assert(consumed == code->bit_length);
+    }
+    printf("%s\n", "Passed");
+
+    Huffman_tree_free(&fib_tree);
+    Array_free(&fib_array);
+}
+
+/*
+ * Clears and rebuilds one tree many times, reusing its nodes, staging area
+ * and queue, and checks every build gives the same codes as a new tree,
+ * whatever the number of leaves of the build before
+ */
+static void test_clear()
+{
+    const int NUM_KEYS = 50;
+    const int NUM_BUILDS = 1000;
+    printf("%s", "Rebuilding a cleared tree: ");
+
+    Huffman_Tree_T tree = Huffman_tree_new();
+    Array_T entries = Array_new(NUM_KEYS, sizeof(Node));
+    uint64_t first_codes[NUM_KEYS];
+    for (int build = 0; build < NUM_BUILDS; build++)
+    {
+        // Odd builds use fewer leaves, so the staging area and queue are
+        // left with entries of a smaller tree before each checked build
+        int num_keys = build % 2 ? build % NUM_KEYS + 1 : NUM_KEYS;
+        Array_resize(entries, num_keys);
+        Huffman_tree_clear(tree);
+        for (int i = 0; i < num_keys; i++)
+        {
+            uint64_t frequency = (uint64_t)(i * i % 17 + 1);
+            Node node = {Huffman_tree_new_leaf(tree, (char)i, frequency), frequency};
+            Array_put(entries, i, &node);
+        }
+        Huffman_tree_build(tree, entries);
+        if (build % 2)
+            continue;
+        Array_T encoding = Huffman_tree_create_encoding_table(tree);
+        for (int i = 0; i < NUM_KEYS; i++)
+        {
+            Encoded_value *code = (Encoded_value *)Array_get(encoding, i);
+            uint64_t packed = code->bit_value << 8 | code->bit_length;
+            if (build == 0)
+                first_codes[i] = packed;
+            assert(packed == first_codes[i]);
+        }
+    }
+    printf("%s\n", "Passed");
+
+    Huffman_tree_free(&tree);
+    Array_free(&entries);
+}
+
+/*
+ * Checks the nodes of a canonical tree are stored in breadth-first order:
+ * children are numbered in the order their parents are, right after the
+ * nodes already reached, and the codes of the leaves cover every key
+ */
+static void test_layout()
+{
+    printf("%s", "Nodes in breadth-first order: ");
+    uint8_t lengths[MAX_NUM_CHAR];
+    for (int i = 0; i < MAX_NUM_CHAR; i++)
+        lengths[i] = 8;
+    lengths[0] = lengths[1] = 7;
+    lengths[2] = lengths[3] = 0;
+
+    Huffman_Tree_T tree = Huffman_tree_new();
+    Huffman_tree_build_canonical(tree, lengths);
+    Huffman_node *root = Huffman_tree_get_root(tree);
+
+    int num_nodes = 1, num_leaves = 0;
+    for (int i = 0; i < num_nodes; i++)
+    {
+        if (!root[i].left_node && !root[i].right_node)
+        {
+            num_leaves++;
+            continue;
+        }
+        assert(root[i].left_node == num_nodes);
+        assert(root[i].right_node == num_nodes + 1);
+        num_nodes += 2;
+    }
+    assert(num_leaves == MAX_NUM_CHAR - 2);
+    assert(num_nodes == 2 * num_leaves - 1);
+    printf("%s\n", "Passed");
+
+    Huffman_tree_free(&tree);
+}
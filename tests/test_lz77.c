@@ -0,0 +1,119 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_lz77.c
+*
+*   Description: Test driver for LZ77 module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/lz77.h"
+
+#define BUFFER_SIZE 200003
+
+// Finds the matches of src and checks that they are in order, repeat
+// earlier bytes within the window and end at most at end. Returns the
+// number of bytes and matches src is parsed into
+static uint32_t check_matches(const uint8_t *src, uint32_t size, uint32_t end,
+                              unsigned level, unsigned window_bits)
+{
+    Lz77_match *matches = malloc(LZ77_MAX_MATCHES(end) * sizeof(Lz77_match));
+    void *workspace = malloc(Lz77_workspace_size(size, window_bits));
+    assert(matches && workspace);
+    uint32_t num_matches = Lz77_find_matches(src, size, end, level, window_bits,
+                                             matches, workspace);
+    assert(num_matches <= LZ77_MAX_MATCHES(end));
+
+    uint32_t num_pieces = size;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < num_matches; i++)
+    {
+        const Lz77_match *match = &matches[i];
+        assert(match->position >= next);
+        assert(match->length >= LZ77_MIN_MATCH);
+        assert(match->position + match->length <= end);
+        assert(match->distance > 0 && match->distance <= match->position);
+        assert(match->distance < ((uint32_t)1 << window_bits));
+
+        // Matches may overlap the bytes they repeat
+        for (uint32_t j = 0; j < match->length; j++)
+            assert(src[match->position + j] == src[match->position - match->distance + j]);
+        next = match->position + match->length;
+        num_pieces -= match->length - 1;
+    }
+    free(matches);
+    free(workspace);
+    return num_pieces;
+}
+
+int main() {
+    static uint8_t buffer[BUFFER_SIZE];
+
+    printf("%s", "   - Matches repeat earlier bytes: ");
+    srand(22);
+    static const char *words[] = {"GET", "POST", " /index.html", " /api/v1/users",
+                                  " 200", " 404", " HTTP/1.1", "\n"};
+    for (uint32_t i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = 0;
+    for (uint32_t i = 0; i < BUFFER_SIZE - 16; )
+    {
+        const char *word = words[rand() % 8];
+        size_t length = strlen(word);
+        memcpy(buffer + i, word, length);
+        i += (uint32_t)length;
+    }
+    for (unsigned level = LZ77_MIN_LEVEL; level <= LZ77_MAX_LEVEL; level++)
+        assert(check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, level,
+                             LZ77_DEFAULT_WINDOW_BITS) < BUFFER_SIZE / 8);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Higher levels find fewer, longer matches: ");
+    for (uint32_t i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = (uint8_t)('a' + rand() % 4);
+    uint32_t fast = check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, LZ77_MIN_LEVEL,
+                                  LZ77_DEFAULT_WINDOW_BITS);
+    uint32_t lazy = check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, LZ77_DEFAULT_LEVEL,
+                                  LZ77_DEFAULT_WINDOW_BITS);
+    uint32_t best = check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, LZ77_MAX_LEVEL,
+                                  LZ77_DEFAULT_WINDOW_BITS);
+    assert(fast > lazy && lazy >= best);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Matches stay within window and end: ");
+    // The second half repeats the first, farther than small windows reach
+    for (uint32_t i = 0; i < BUFFER_SIZE / 2; i++)
+        buffer[i] = (uint8_t)rand();
+    memcpy(buffer + BUFFER_SIZE / 2, buffer, BUFFER_SIZE / 2);
+    assert(check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, 3, 17) < BUFFER_SIZE / 2 + 1000);
+    assert(check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE, 3, 16) > BUFFER_SIZE - 100);
+    assert(check_matches(buffer, BUFFER_SIZE, BUFFER_SIZE - 1000, LZ77_MAX_LEVEL,
+                         LZ77_MAX_WINDOW_BITS) < BUFFER_SIZE / 2 + 1100);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Runs are matches of distance 1: ");
+    memset(buffer, 'z', 1000);
+    Lz77_match matches[LZ77_MAX_MATCHES(1000)];
+    static uint32_t workspace[1 << 16];
+    assert(Lz77_workspace_size(1000, LZ77_MIN_WINDOW_BITS) <= sizeof(workspace));
+    assert(Lz77_find_matches(buffer, 1000, 1000, 1, LZ77_MIN_WINDOW_BITS, matches,
+                             workspace) == 1);
+    assert(matches[0].position == 1 && matches[0].length == 999 &&
+           matches[0].distance == 1);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Empty and short buffers have no matches: ");
+    for (uint32_t size = 0; size < 2 * LZ77_MIN_MATCH; size++)
+        assert(Lz77_find_matches(buffer, size, size, LZ77_MAX_LEVEL, LZ77_MIN_WINDOW_BITS,
+                                 matches, workspace) == (size > LZ77_MIN_MATCH));
+    assert(Lz77_find_matches(buffer, 100, 3, LZ77_MAX_LEVEL, LZ77_MIN_WINDOW_BITS,
+                             matches, workspace) == 0);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
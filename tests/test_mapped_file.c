@@ -0,0 +1,74 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_mapped_file.c
+*
+*   Description: Test driver for mapped file implementation
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include "../include/mapped_file.h"
+
+int main() {
+    printf("%s", "   - Map file for reading: ");
+    FILE *input = tmpfile();
+    for (int i = 0; i < 10000; i++)
+        fputc(i % 251, input);
+    fflush(input);
+    Mapped_File_T mapped = Mapped_file_open(input);
+    assert(mapped);
+    assert(Mapped_file_size(mapped) == 10000);
+    for (int i = 0; i < 10000; i++)
+        assert(Mapped_file_data(mapped)[i] == i % 251);
+    Mapped_file_free(&mapped);
+    assert(mapped == NULL);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Empty file and pipe are not mapped: ");
+    FILE *empty = tmpfile();
+    assert(Mapped_file_open(empty) == NULL);
+    int fds[2];
+    assert(pipe(fds) == 0);
+    FILE *pipe_end = fdopen(fds[0], "rb");
+    assert(Mapped_file_open(pipe_end) == NULL);
+    fclose(pipe_end);
+    close(fds[1]);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Map file for writing: ");
+    FILE *output = tmpfile();
+    mapped = Mapped_file_create(output, 5000);
+    assert(mapped);
+    memset(Mapped_file_data(mapped), 'z', 5000);
+    Mapped_file_free(&mapped);
+    fseek(output, 0, SEEK_END);
+    assert(ftell(output) == 5000);
+    rewind(output);
+    for (int i = 0; i < 5000; i++)
+        assert(fgetc(output) == 'z');
+    assert(fgetc(output) == EOF);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Write-only file is not mapped for writing: ");
+    char name[] = "/tmp/test_mapped_file_XXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    close(fd);
+    FILE *write_only = fopen(name, "wb");
+    assert(Mapped_file_create(write_only, 100) == NULL);
+    fclose(write_only);
+    remove(name);
+    printf("%s\n", "Passed");
+
+    fclose(input);
+    fclose(empty);
+    fclose(output);
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
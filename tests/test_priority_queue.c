@@ -9,6 +9,7 @@
 *
 *
 ****************************************************************/
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -44,11 +45,11 @@ int main() {
     for (int i = TEST_SAMPLES - 1; i >= 0; i--) {
         Node *top = (Node *)Priority_queue_top(max_q);
         int size = Priority_queue_size(max_q);
-        assert(top->value == i);
+        assert(top->value == (uint64_t)i);
         assert(size == i + 1);
     
         Node *pop = (Node *)Priority_queue_pop(max_q);
-        assert(pop->value == i);
+        assert(pop->value == (uint64_t)i);
     }
     printf("%s\n", "Passed");
    
@@ -64,13 +65,13 @@ int main() {
     for (int i = TEST_SAMPLES - 1; i >= 0; i--) {
         Node *top = (Node *)Priority_queue_top(max_q);
         int size = Priority_queue_size(max_q);
-        assert(top->value == i);
-        assert(((Node *)top->obj)->value == i);
+        assert(top->value == (uint64_t)i);
+        assert(((Node *)top->obj)->value == (uint64_t)i);
         assert(size == i + 1);
     
         Node *pop = (Node *)Priority_queue_pop(max_q);
         free((Node*) pop->obj);
-        assert(pop->value == i);
+        assert(pop->value == (uint64_t)i);
     }
     printf("%s\n", "Passed");
 
@@ -114,11 +115,11 @@ int main() {
     for (int i = 0; i < TEST_SAMPLES; i++) {
         Node *top = (Node *)Priority_queue_top(min_q);
         int size = Priority_queue_size(min_q);
-        assert(top->value == i);
+        assert(top->value == (uint64_t)i);
         assert(size == TEST_SAMPLES - i);
     
         Node *pop = (Node *)Priority_queue_pop(min_q);
-        assert(pop->value == i);
+        assert(pop->value == (uint64_t)i);
     }
     printf("%s\n", "Passed");
 
@@ -134,13 +135,13 @@ int main() {
     for (int i = 0; i < TEST_SAMPLES; i++)  {
         Node *top = (Node *)Priority_queue_top(min_q);
         int size = Priority_queue_size(min_q);
-        assert(top->value == i);
-        assert(((Node *)top->obj)->value == i);
+        assert(top->value == (uint64_t)i);
+        assert(((Node *)top->obj)->value == (uint64_t)i);
         assert(size == TEST_SAMPLES - i);
     
         Node *pop = (Node *)Priority_queue_pop(min_q);
         free((Node*) pop->obj);
-        assert(pop->value == i);
+        assert(pop->value == (uint64_t)i);
     }
     printf("%s\n", "Passed");
    
@@ -150,11 +151,84 @@ int main() {
         printf("%s \n", "   - Test for HEAP UNDERFLOW exception raised: Passed");
     END_TRY;
 
+    // Values past 32 bits, as the counts of inputs larger than 4 GiB
+    printf("%s", "   - Values beyond 32 bits: ");
+    int item = 0;
+    for (int i = 0; i < TEST_SAMPLES; i++)
+        Priority_queue_insert(min_q, &item, ((uint64_t)(i % 3) << 32) + TEST_SAMPLES - i);
+    uint64_t previous = 0;
+    for (int i = 0; i < TEST_SAMPLES; i++)
+    {
+        Node *pop = (Node *)Priority_queue_pop(min_q);
+        assert(pop->value >= previous);
+        previous = pop->value;
+    }
+    assert(previous > UINT32_MAX);
+    printf("%s\n", "Passed");
+
+    // Clearing keeps the memory, and reserved room is used without growing
+    printf("%s", "   - Reserve and clear: ");
+    Priority_queue_reserve(min_q, TEST_SAMPLES);
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < TEST_SAMPLES; i++)
+            Priority_queue_insert(min_q, &item, (uint64_t)((i * 7919) % TEST_SAMPLES));
+        assert(Priority_queue_size(min_q) == TEST_SAMPLES);
+        assert(((Node *)Priority_queue_top(min_q))->value == 0);
+        Priority_queue_clear(min_q);
+        assert(Priority_queue_size(min_q) == 0);
+    }
+    printf("%s\n", "Passed");
+
     printf("%s", "   - Deallocate queue and array: ");
     Array_free(&test_array);
     Priority_queue_free(&min_q);
     printf("%s\n", "Passed");
     printf("%s \n", "   - Done! All tests passed");
 
+    printf("\n");
+
+    /* TEST D-ARY HEAPS */
+    printf("%s %d %s\n", "TESTING D-ARY HEAPS with", TEST_SAMPLES, "test samples");
+
+    // Random values come out sorted for every arity, whether built from an
+    // array or inserted one by one
+    printf("%s", "   - Build, insert and pop with arity 2 to 8: ");
+    Array_T random_array = Array_new(TEST_SAMPLES, sizeof(Node));
+    srand(17);
+    for (int i = 0; i < TEST_SAMPLES; i++)
+    {
+        Node node = {&item, (uint64_t)(rand() % 1000)};
+        Array_put(random_array, i, &node);
+    }
+    for (int arity = 2; arity <= PRIORITY_QUEUE_MAX_ARITY; arity++)
+    {
+        for (int type = 0; type <= 1; type++)
+        {
+            Priority_Queue_T queue = Priority_queue_new_d_ary(type, arity);
+            Priority_queue_build(queue, random_array);
+            for (int i = 0; i < TEST_SAMPLES; i++)
+            {
+                Node *node = (Node *)Array_get(random_array, i);
+                Priority_queue_insert(queue, &item, node->value);
+            }
+            assert(Priority_queue_size(queue) == 2 * TEST_SAMPLES);
+
+            uint64_t last = type == 0 ? 0 : UINT64_MAX;
+            for (int i = 0; i < 2 * TEST_SAMPLES; i++)
+            {
+                Node *pop = (Node *)Priority_queue_pop(queue);
+                assert(type == 0 ? pop->value >= last : pop->value <= last);
+                last = pop->value;
+            }
+            assert(Priority_queue_size(queue) == 0);
+            Priority_queue_free(&queue);
+        }
+    }
+    Array_free(&random_array);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+
     return 0;
 }
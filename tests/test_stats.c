@@ -0,0 +1,78 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_stats.c
+*
+*   Description: Test driver for stats module
+*
+****************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "../include/stats.h"
+
+int main() {
+    printf("%s", "   - Entropy of equally frequent characters: ");
+    Stats stats;
+    Stats_init(&stats);
+    assert(Stats_entropy(&stats) == 0);
+    uint64_t counts[HISTOGRAM_SIZE] = {0};
+    for (int c = 'a'; c < 'a' + 4; c++)
+        counts[c] = 100;
+    Stats_add_block(&stats, counts, 800, 2, 13);
+    assert(fabs(Stats_entropy(&stats) - 2.0) < 1e-9);
+    assert(fabs(stats.block_entropy_bits - 800.0) < 1e-6);
+    assert(stats.code_bits == 800 && stats.num_words == 13);
+    assert(stats.max_code_length == 2 && stats.num_blocks == 1);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Merge blocks from another thread: ");
+    Stats other;
+    Stats_init(&other);
+    memset(counts, 0, sizeof(counts));
+    counts['z'] = 1200;
+    Stats_add_block(&other, counts, 1200, 1, 7);
+    other.phase_seconds[STATS_ENCODE] = 0.5;
+    Stats_merge(&stats, &other);
+    Stats_merge(NULL, &other);
+    assert(stats.num_blocks == 2 && stats.num_words == 20);
+    assert(stats.code_bits == 2000);
+    assert(stats.phase_seconds[STATS_ENCODE] == 0.5);
+    // One block is a single character, which has no entropy within it
+    assert(fabs(stats.block_entropy_bits - 800.0) < 1e-6);
+    assert(fabs(Stats_entropy(&stats) - (1 + 0.75 * log2(4.0 / 3))) < 1e-9);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Time phases with the monotonic clock: ");
+    assert(Stats_start(NULL) == 0);
+    assert(Stats_lap(NULL, STATS_READ, 0) == 0);
+    double start = Stats_start(&stats);
+    double end = Stats_lap(&stats, STATS_READ, start);
+    assert(end >= start && stats.phase_seconds[STATS_READ] == end - start);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Print text and JSON reports: ");
+    stats.bytes_in = 1600;
+    stats.bytes_out = 200;
+    FILE *report = tmpfile();
+    Stats_print(&stats, "compress", report);
+    assert(ftell(report) > 0);
+    rewind(report);
+    Stats_write_json(&stats, "compress", report);
+    long json_size = ftell(report);
+    rewind(report);
+    char *json = calloc(json_size + 1, 1);
+    assert(fread(json, 1, json_size, report) == (size_t)json_size);
+    assert(json[0] == '{' && strstr(json, "\"entropy_bits_per_char\": 1.311278"));
+    assert(strstr(json, "\"num_words_flushed\": 20"));
+    free(json);
+    fclose(report);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
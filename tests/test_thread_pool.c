@@ -0,0 +1,62 @@
+/****************************************************************
+*
+*   Huffman-compressor - Trung Truong - 2019
+*
+*   File name: test_thread_pool.c
+*
+*   Description: Test driver for thread pool implementation
+*
+****************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "../include/thread_pool.h"
+
+// Job that sums the integers up to its argument in place
+static void sum_job(void *arg)
+{
+    long *value = arg;
+    long sum = 0;
+    for (long i = 1; i <= *value; i++)
+        sum += i;
+    *value = sum;
+}
+
+int main() {
+    const int NUM_JOBS = 1000;
+    long results[1000];
+
+    printf("%s", "   - Run more jobs than threads: ");
+    Thread_Pool_T thread_pool = Thread_pool_new(4);
+    for (int i = 0; i < NUM_JOBS; i++)
+    {
+        results[i] = i;
+        Thread_pool_submit(thread_pool, sum_job, &results[i]);
+    }
+    Thread_pool_wait(thread_pool);
+    for (long i = 0; i < NUM_JOBS; i++)
+        assert(results[i] == i * (i + 1) / 2);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Reuse pool after waiting: ");
+    for (int i = 0; i < NUM_JOBS; i++)
+        Thread_pool_submit(thread_pool, sum_job, &results[i]);
+    Thread_pool_wait(thread_pool);
+    assert(results[2] == 6);
+    printf("%s\n", "Passed");
+
+    printf("%s", "   - Free pool with queued jobs: ");
+    for (int i = 0; i < NUM_JOBS; i++)
+    {
+        results[i] = 100;
+        Thread_pool_submit(thread_pool, sum_job, &results[i]);
+    }
+    Thread_pool_free(&thread_pool);
+    assert(thread_pool == NULL);
+    for (int i = 0; i < NUM_JOBS; i++)
+        assert(results[i] == 5050);
+    printf("%s\n", "Passed");
+
+    printf("%s \n", "   - Done! All tests passed");
+    return 0;
+}
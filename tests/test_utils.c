@@ -19,14 +19,15 @@ int main() {
     FILE *infile = fopen("tests/utils_sample_test.txt", "rb");
 
     int freq_array_length = 0;
-    int *_freq_array = get_frequency_of_characters_from_file(infile, &freq_array_length);
-    Array_T freq_array = create_unique_characters_freq_array(_freq_array, freq_array_length);
-    
+    uint64_t *_freq_array = get_frequency_of_characters_from_file(infile, &freq_array_length);
     Huffman_Tree_T huffman_tree = Huffman_tree_new();
+    Array_T freq_array = create_unique_characters_freq_array(_freq_array, freq_array_length,
+                                                             huffman_tree);
+
     Huffman_tree_build(huffman_tree, freq_array);
 
     Huffman_node *root = Huffman_tree_get_root(huffman_tree);
-    printf("Root frequency: %d\n", root->frequency);
+    printf("Root frequency: %"PRIu64"\n", root->frequency);
     Array_T encoding = Huffman_tree_create_encoding_table(huffman_tree);
     
     // Compress sample file to test_compressed
@@ -43,8 +44,8 @@ int main() {
     uint64_t total_num_bits = read_total_num_bits(compressed);
     printf("TOTAL NUM BITS: %"PRIu64" \n", total_num_bits);
 
-    Array_T entries = read_header(compressed);
     Huffman_Tree_T decompressed_huffman_tree = Huffman_tree_new();
+    Array_T entries = read_header(compressed, decompressed_huffman_tree);
     Huffman_tree_build(decompressed_huffman_tree, entries);
     Huffman_tree_create_encoding_table(decompressed_huffman_tree);
 
@@ -63,5 +64,38 @@ int main() {
     Array_free(&freq_array);
 
     fclose(infile);
+
+    // A file of a single character gives a one-leaf tree, whose character
+    // takes one bit of the body
+    FILE *single = tmpfile();
+    fputs("zzzz", single);
+    rewind(single);
+    _freq_array = get_frequency_of_characters_from_file(single, &freq_array_length);
+    Huffman_Tree_T single_tree = Huffman_tree_new();
+    freq_array = create_unique_characters_freq_array(_freq_array, freq_array_length,
+                                                     single_tree);
+    Huffman_tree_build(single_tree, freq_array);
+
+    FILE *body = tmpfile();
+    uint64_t zero = 0;
+    fwrite(&zero, sizeof(uint64_t), 1, body);
+    rewind(body);
+    FILE *single_decompressed = tmpfile();
+    read_body(single_tree, 5, body, single_decompressed);
+    rewind(single_decompressed);
+    char single_text[8] = {0};
+    size_t single_size = fread(single_text, 1, sizeof(single_text), single_decompressed);
+    if (single_size != 5 || strcmp(single_text, "zzzzz") != 0)
+    {
+        printf("%s \n", "SINGLE CHARACTER BODY FAILED!");
+        return 1;
+    }
+    printf("%s \n", "DONE DECOMPRESSING SINGLE CHARACTER!");
+    fclose(single);
+    fclose(body);
+    fclose(single_decompressed);
+    free(_freq_array);
+    Huffman_tree_free(&single_tree);
+    Array_free(&freq_array);
     return 0;
 }